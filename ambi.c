@@ -0,0 +1,156 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ambi.h"
+#include "logger.h"
+
+// Real spherical harmonics in ACN order with SN3D weights, from the unit
+// vector (x front, y left, z up)
+static void sh_eval(int order, double x, double y, double z, double *sh) {
+    sh[0] = 1.0;
+    if (order < 1)
+        return;
+    sh[1] = y;
+    sh[2] = z;
+    sh[3] = x;
+    if (order < 2)
+        return;
+    const double s3 = sqrt(3.0);
+    sh[4] = s3 * x * y;
+    sh[5] = s3 * y * z;
+    sh[6] = 0.5 * (3.0 * z * z - 1.0);
+    sh[7] = s3 * x * z;
+    sh[8] = 0.5 * s3 * (x * x - y * y);
+    if (order < 3)
+        return;
+    const double s58 = sqrt(5.0 / 8.0), s38 = sqrt(3.0 / 8.0);
+    const double s15 = sqrt(15.0);
+    sh[9] = s58 * y * (3.0 * x * x - y * y);
+    sh[10] = s15 * x * y * z;
+    sh[11] = s38 * y * (5.0 * z * z - 1.0);
+    sh[12] = 0.5 * z * (5.0 * z * z - 3.0);
+    sh[13] = s38 * x * (5.0 * z * z - 1.0);
+    sh[14] = 0.5 * s15 * z * (x * x - y * y);
+    sh[15] = s58 * x * (x * x - 3.0 * y * y);
+}
+
+void ambi_sh(int order, float azi, float elev, float *sh) {
+    double d[AMBI_MAX_CHANNELS];
+    double c = cos(elev);
+    sh_eval(order, c * cos(azi), c * sin(azi), sin(elev), d);
+    for (int i = 0; i < AMBI_CHANNELS(order); i++)
+        sh[i] = (float)d[i];
+}
+
+int ambi_load_layout(const char *path, float *azi, float *elev, int max) {
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    char line[256];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        float a, e;
+        if (sscanf(line, "%f %f", &a, &e) != 2)
+            continue;
+        if (n == max) {
+            LOG_WARN("[ambi] %s: more than %d speakers, the rest ignored",
+                     path, max);
+            break;
+        }
+        azi[n] = a * (float)M_PI / 180.0f;
+        elev[n] = e * (float)M_PI / 180.0f;
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+// D = Y (Y'Y + lambda I)^-1 with Y [speaker][channel]. The Gram matrix is
+// at most 16 x 16, so a Cholesky solve in double is cheap enough to redo
+// whenever the listener turns.
+void ambi_decoder(float *matrix, int order, const float *azi,
+                  const float *elev, int speakers, float yaw, float pitch) {
+    const int ch = AMBI_CHANNELS(order);
+    double y[AMBI_MAX_SPEAKERS][AMBI_MAX_CHANNELS];
+    double a[AMBI_MAX_CHANNELS][AMBI_MAX_CHANNELS];
+    const double cy = cos(yaw), sy = sin(yaw);
+    const double cp = cos(pitch), sp = sin(pitch);
+
+    // Each speaker as the turned listener has it: tilt, then turn
+    for (int k = 0; k < speakers; k++) {
+        double ce = cos(elev[k]);
+        double x = ce * cos(azi[k]), v = ce * sin(azi[k]), z = sin(elev[k]);
+        double x1 = x * cp - z * sp;
+        double z1 = x * sp + z * cp;
+        sh_eval(order, x1 * cy - v * sy, x1 * sy + v * cy, z1, y[k]);
+    }
+
+    double trace = 0.0;
+    for (int i = 0; i < ch; i++) {
+        for (int j = 0; j <= i; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < speakers; k++)
+                sum += y[k][i] * y[k][j];
+            a[i][j] = sum;
+        }
+        trace += a[i][i];
+    }
+    // Small enough not to colour a layout that suits the order, large
+    // enough that directions it can't reproduce don't blow up the gains
+    double lambda = 1e-2 * trace / ch + 1e-12;
+    for (int i = 0; i < ch; i++)
+        a[i][i] += lambda;
+
+    // Lower Cholesky factor in place
+    for (int j = 0; j < ch; j++) {
+        double d = a[j][j];
+        for (int k = 0; k < j; k++)
+            d -= a[j][k] * a[j][k];
+        a[j][j] = sqrt(d);
+        for (int i = j + 1; i < ch; i++) {
+            double s = a[i][j];
+            for (int k = 0; k < j; k++)
+                s -= a[i][k] * a[j][k];
+            a[i][j] = s / a[j][j];
+        }
+    }
+
+    // Each row of D solves (L L') d = y_k
+    for (int k = 0; k < speakers; k++) {
+        double t[AMBI_MAX_CHANNELS];
+        for (int i = 0; i < ch; i++) {
+            double s = y[k][i];
+            for (int j = 0; j < i; j++)
+                s -= a[i][j] * t[j];
+            t[i] = s / a[i][i];
+        }
+        for (int i = ch - 1; i >= 0; i--) {
+            double s = t[i];
+            for (int j = i + 1; j < ch; j++)
+                s -= a[j][i] * t[j];
+            t[i] = s / a[i][i];
+        }
+        for (int i = 0; i < ch; i++)
+            matrix[k * ch + i] = (float)t[i];
+    }
+}
+
+// g_n = P_n(cos(137.9 deg / (order + 1.51))), the usual 3D approximation
+void ambi_max_re(int order, float *weights) {
+    double x = cos(137.9 * M_PI / 180.0 / (order + 1.51));
+    double p0 = 1.0, p1 = x;
+    weights[0] = 1.0f;
+    if (order >= 1)
+        weights[1] = (float)x;
+    for (int n = 1; n < order; n++) {
+        double p2 = ((2 * n + 1) * x * p1 - n * p0) / (n + 1);
+        weights[n + 1] = (float)p2;
+        p0 = p1;
+        p1 = p2;
+    }
+}
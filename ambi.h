@@ -0,0 +1,31 @@
+#ifndef AMBI_H
+#define AMBI_H
+
+// Higher-order ambisonics shared by the encoder and decoder: AmbiX
+// channel order (ACN) and normalisation (SN3D), up to third order.
+// Directions are in radians, azimuth counter-clockwise from the front and
+// elevation up from the horizon.
+
+#define AMBI_MAX_ORDER 3
+#define AMBI_MAX_CHANNELS 16 // (AMBI_MAX_ORDER + 1)^2
+#define AMBI_MAX_SPEAKERS 64
+#define AMBI_CHANNELS(order) (((order) + 1) * ((order) + 1))
+
+// The AMBI_CHANNELS(order) spherical harmonics for one direction
+void ambi_sh(int order, float azi, float elev, float *sh);
+
+// Speaker directions from a layout file: one speaker per line as
+// "azimuth elevation" in degrees, blank lines and # comments skipped.
+// Returns the count, or -1 when the file can't be read.
+int ambi_load_layout(const char *path, float *azi, float *elev, int max);
+
+// Mode-matching decoder, [speaker][channel], for speakers seen by a
+// listener turned by yaw and then tilted by pitch. The regularised
+// pseudo-inverse copes with layouts too small or too flat for the order.
+void ambi_decoder(float *matrix, int order, const float *azi,
+                  const float *elev, int speakers, float yaw, float pitch);
+
+// Per-order weights for max-rE decoding (energy focused toward the source)
+void ambi_max_re(int order, float *weights);
+
+#endif
@@ -0,0 +1,428 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp.h"
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4f_u __attribute__((vector_size(16), aligned(4)));
+
+typedef int v4i __attribute__((vector_size(16)));
+
+#define LOAD(p) (*(const v4f_u *)(p))
+#define STORE(p, v) (*(v4f_u *)(p) = (v))
+
+#ifdef __clang__
+#define SHUF(a, b, i, j, k, l) __builtin_shufflevector(a, b, i, j, k, l)
+#else
+#define SHUF(a, b, i, j, k, l) __builtin_shuffle(a, b, (v4i){i, j, k, l})
+#endif
+
+// Rows r0..r3 become columns in place
+#define TRANSPOSE4(r0, r1, r2, r3)                                             \
+    do {                                                                       \
+        v4f t0 = SHUF(r0, r1, 0, 4, 1, 5);                                     \
+        v4f t1 = SHUF(r0, r1, 2, 6, 3, 7);                                     \
+        v4f t2 = SHUF(r2, r3, 0, 4, 1, 5);                                     \
+        v4f t3 = SHUF(r2, r3, 2, 6, 3, 7);                                     \
+        r0 = SHUF(t0, t2, 0, 1, 4, 5);                                         \
+        r1 = SHUF(t0, t2, 2, 3, 6, 7);                                         \
+        r2 = SHUF(t1, t3, 0, 1, 4, 5);                                         \
+        r3 = SHUF(t1, t3, 2, 3, 6, 7);                                         \
+    } while (0)
+
+float *dsp_alloc(unsigned long count) {
+    void *p = NULL;
+    size_t bytes = (count ? count : 1) * sizeof(float);
+    bytes = (bytes + DSP_ALIGN - 1) & ~(size_t)(DSP_ALIGN - 1);
+    if (posix_memalign(&p, DSP_ALIGN, bytes) != 0)
+        return NULL;
+    memset(p, 0, bytes);
+    return (float *)p;
+}
+
+void dsp_zero(float *out, unsigned long frames) {
+    memset(out, 0, frames * sizeof(float));
+}
+
+void dsp_copy(float *out, const float *in, unsigned long frames) {
+    if (out != in)
+        memmove(out, in, frames * sizeof(float));
+}
+
+void dsp_scale(float *out, const float *in, float gain,
+               unsigned long frames) {
+    const v4f g = {gain, gain, gain, gain};
+    unsigned long i = 0;
+    for (; i + 4 <= frames; i += 4)
+        STORE(out + i, LOAD(in + i) * g);
+    for (; i < frames; i++)
+        out[i] = in[i] * gain;
+}
+
+void dsp_add(float *out, const float *in, unsigned long frames) {
+    unsigned long i = 0;
+    for (; i + 4 <= frames; i += 4)
+        STORE(out + i, LOAD(out + i) + LOAD(in + i));
+    for (; i < frames; i++)
+        out[i] += in[i];
+}
+
+// One pass over up to four sources. `accumulate` adds onto what an earlier
+// pass left in out; otherwise out is overwritten.
+#define MIX_PASS(vexpr, sexpr)                                                 \
+    do {                                                                       \
+        unsigned long i = 0;                                                   \
+        if (accumulate) {                                                      \
+            for (; i + 4 <= frames; i += 4)                                    \
+                STORE(out + i, LOAD(out + i) + (vexpr));                       \
+            for (; i < frames; i++)                                            \
+                out[i] += (sexpr);                                             \
+        } else {                                                               \
+            for (; i + 4 <= frames; i += 4)                                    \
+                STORE(out + i, (vexpr));                                       \
+            for (; i < frames; i++)                                            \
+                out[i] = (sexpr);                                              \
+        }                                                                      \
+    } while (0)
+
+static void mix_pass(float *out, const float **s, const float *g, int n,
+                     int accumulate, unsigned long frames) {
+    const v4f g0 = {g[0], g[0], g[0], g[0]};
+    const v4f g1 = {g[1], g[1], g[1], g[1]};
+    const v4f g2 = {g[2], g[2], g[2], g[2]};
+    const v4f g3 = {g[3], g[3], g[3], g[3]};
+
+    switch (n) {
+    case 1:
+        MIX_PASS(LOAD(s[0] + i) * g0, s[0][i] * g[0]);
+        break;
+    case 2:
+        MIX_PASS(LOAD(s[0] + i) * g0 + LOAD(s[1] + i) * g1,
+                 s[0][i] * g[0] + s[1][i] * g[1]);
+        break;
+    case 3:
+        MIX_PASS(LOAD(s[0] + i) * g0 + LOAD(s[1] + i) * g1 +
+                     LOAD(s[2] + i) * g2,
+                 s[0][i] * g[0] + s[1][i] * g[1] + s[2][i] * g[2]);
+        break;
+    case 4:
+        MIX_PASS((LOAD(s[0] + i) * g0 + LOAD(s[1] + i) * g1) +
+                     (LOAD(s[2] + i) * g2 + LOAD(s[3] + i) * g3),
+                 (s[0][i] * g[0] + s[1][i] * g[1]) +
+                     (s[2][i] * g[2] + s[3][i] * g[3]));
+        break;
+    }
+}
+
+void dsp_mix_gains(float *out, float *const *in, const float *gains,
+                   int count, unsigned long frames) {
+    const float *src[4];
+    float g[4];
+    int n = 0;
+    int accumulate = 0;
+
+    for (int j = 0; j < count; j++) {
+        if (!in[j])
+            continue;
+        src[n] = in[j];
+        g[n] = gains[j];
+        if (++n == 4) {
+            mix_pass(out, src, g, n, accumulate, frames);
+            accumulate = 1;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        for (int k = n; k < 4; k++)
+            g[k] = 0.0f;
+        mix_pass(out, src, g, n, accumulate, frames);
+        accumulate = 1;
+    }
+    if (!accumulate)
+        dsp_zero(out, frames);
+}
+
+// Uniform gain: sum first, scale once per pass
+static void mix_pass_uniform(float *out, const float **s, float gain, int n,
+                             int accumulate, unsigned long frames) {
+    const v4f g = {gain, gain, gain, gain};
+
+    switch (n) {
+    case 1:
+        MIX_PASS(LOAD(s[0] + i) * g, s[0][i] * gain);
+        break;
+    case 2:
+        MIX_PASS((LOAD(s[0] + i) + LOAD(s[1] + i)) * g,
+                 (s[0][i] + s[1][i]) * gain);
+        break;
+    case 3:
+        MIX_PASS((LOAD(s[0] + i) + LOAD(s[1] + i) + LOAD(s[2] + i)) * g,
+                 (s[0][i] + s[1][i] + s[2][i]) * gain);
+        break;
+    case 4:
+        MIX_PASS(((LOAD(s[0] + i) + LOAD(s[1] + i)) +
+                  (LOAD(s[2] + i) + LOAD(s[3] + i))) *
+                     g,
+                 ((s[0][i] + s[1][i]) + (s[2][i] + s[3][i])) * gain);
+        break;
+    }
+}
+
+void dsp_mix(float *out, float *const *in, int count, float gain,
+             unsigned long frames) {
+    const float *src[4];
+    int n = 0;
+    int accumulate = 0;
+
+    for (int j = 0; j < count; j++) {
+        if (!in[j])
+            continue;
+        src[n++] = in[j];
+        if (n == 4) {
+            mix_pass_uniform(out, src, gain, n, accumulate, frames);
+            accumulate = 1;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        mix_pass_uniform(out, src, gain, n, accumulate, frames);
+        accumulate = 1;
+    }
+    if (!accumulate)
+        dsp_zero(out, frames);
+}
+
+// --- Matrix ---
+
+// Four rows (or one) of out = m * in. Each input vector is loaded once for
+// all of them; with `from`, a second sum over the old gains makes the ramp.
+// Always inlined so `rows` and a NULL `from` are constants at each call.
+static inline __attribute__((always_inline)) void
+matrix_rows(float *const *out, const float **src, const int *col, int n,
+            const float *m, const float *from, int cols, const int rows,
+            unsigned long frames) {
+    const float inv = 1.0f / (float)frames;
+    const v4f step = {inv, 2.0f * inv, 3.0f * inv, 4.0f * inv};
+    unsigned long i = 0;
+
+    // Without a ramp there are registers for eight frames a pass, so each
+    // gain is broadcast once for two vectors
+    if (!from) {
+        for (; i + 8 <= frames; i += 8) {
+            v4f lo[4] = {{0}}, hi[4] = {{0}};
+            for (int j = 0; j < n; j++) {
+                v4f x0 = LOAD(src[j] + i), x1 = LOAD(src[j] + i + 4);
+                for (int r = 0; r < rows; r++) {
+                    float g = m[r * cols + col[j]];
+                    lo[r] += x0 * g;
+                    hi[r] += x1 * g;
+                }
+            }
+            for (int r = 0; r < rows; r++) {
+                STORE(out[r] + i, lo[r]);
+                STORE(out[r] + i + 4, hi[r]);
+            }
+        }
+    }
+    for (; i + 4 <= frames; i += 4) {
+        v4f acc[4] = {{0}}, old[4] = {{0}};
+        for (int j = 0; j < n; j++) {
+            v4f x = LOAD(src[j] + i);
+            for (int r = 0; r < rows; r++) {
+                acc[r] += x * m[r * cols + col[j]];
+                if (from)
+                    old[r] += x * from[r * cols + col[j]];
+            }
+        }
+        const v4f t = step + (float)i * inv;
+        for (int r = 0; r < rows; r++)
+            STORE(out[r] + i, from ? old[r] + t * (acc[r] - old[r]) : acc[r]);
+    }
+    for (; i < frames; i++) {
+        const float t = (float)(i + 1) * inv;
+        for (int r = 0; r < rows; r++) {
+            float acc = 0.0f, old = 0.0f;
+            for (int j = 0; j < n; j++) {
+                acc += src[j][i] * m[r * cols + col[j]];
+                if (from)
+                    old += src[j][i] * from[r * cols + col[j]];
+            }
+            out[r][i] = from ? old + t * (acc - old) : acc;
+        }
+    }
+}
+
+void dsp_matrix(float *const *out, int rows, float *const *in, int cols,
+                const float *m, const float *from, unsigned long frames) {
+    const float *src[cols];
+    int col[cols];
+    int n = 0;
+
+    if (frames == 0)
+        return;
+    for (int c = 0; c < cols; c++) {
+        if (!in[c])
+            continue;
+        src[n] = in[c];
+        col[n++] = c;
+    }
+    if (n == 0) {
+        for (int r = 0; r < rows; r++)
+            dsp_zero(out[r], frames);
+        return;
+    }
+
+    int r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float *mr = m + r * cols;
+        if (from)
+            matrix_rows(out + r, src, col, n, mr, from + r * cols, cols, 4,
+                        frames);
+        else
+            matrix_rows(out + r, src, col, n, mr, NULL, cols, 4, frames);
+    }
+    for (; r < rows; r++) {
+        const float *mr = m + r * cols;
+        if (from)
+            matrix_rows(out + r, src, col, n, mr, from + r * cols, cols, 1,
+                        frames);
+        else
+            matrix_rows(out + r, src, col, n, mr, NULL, cols, 1, frames);
+    }
+}
+
+// --- Channel layout ---
+
+void dsp_deinterleave(float *const *planar, const float *in, int channels,
+                      unsigned long frames) {
+    unsigned long k = 0;
+
+    if (channels == 2 && planar[0] && planar[1]) {
+        for (; k + 4 <= frames; k += 4) {
+            v4f a = LOAD(in + 2 * k), b = LOAD(in + 2 * k + 4);
+            STORE(planar[0] + k, SHUF(a, b, 0, 2, 4, 6));
+            STORE(planar[1] + k, SHUF(a, b, 1, 3, 5, 7));
+        }
+    } else if (channels % 4 == 0) {
+        for (; k + 4 <= frames; k += 4) {
+            const float *f = in + k * channels;
+            for (int c = 0; c < channels; c += 4) {
+                v4f r0 = LOAD(f + c), r1 = LOAD(f + channels + c);
+                v4f r2 = LOAD(f + 2 * channels + c);
+                v4f r3 = LOAD(f + 3 * channels + c);
+                TRANSPOSE4(r0, r1, r2, r3);
+                if (planar[c])
+                    STORE(planar[c] + k, r0);
+                if (planar[c + 1])
+                    STORE(planar[c + 1] + k, r1);
+                if (planar[c + 2])
+                    STORE(planar[c + 2] + k, r2);
+                if (planar[c + 3])
+                    STORE(planar[c + 3] + k, r3);
+            }
+        }
+    }
+
+    for (int c = 0; c < channels; c++) {
+        if (!planar[c])
+            continue;
+        for (unsigned long i = k; i < frames; i++)
+            planar[c][i] = in[i * channels + c];
+    }
+}
+
+void dsp_interleave(float *out, const float *const *planar, int channels,
+                    unsigned long frames) {
+    unsigned long k = 0;
+
+    if (channels == 2) {
+        for (; k + 4 <= frames; k += 4) {
+            v4f l = LOAD(planar[0] + k), r = LOAD(planar[1] + k);
+            STORE(out + 2 * k, SHUF(l, r, 0, 4, 1, 5));
+            STORE(out + 2 * k + 4, SHUF(l, r, 2, 6, 3, 7));
+        }
+    } else if (channels % 4 == 0) {
+        for (; k + 4 <= frames; k += 4) {
+            float *f = out + k * channels;
+            for (int c = 0; c < channels; c += 4) {
+                v4f r0 = LOAD(planar[c] + k), r1 = LOAD(planar[c + 1] + k);
+                v4f r2 = LOAD(planar[c + 2] + k);
+                v4f r3 = LOAD(planar[c + 3] + k);
+                TRANSPOSE4(r0, r1, r2, r3);
+                STORE(f + c, r0);
+                STORE(f + channels + c, r1);
+                STORE(f + 2 * channels + c, r2);
+                STORE(f + 3 * channels + c, r3);
+            }
+        }
+    }
+
+    for (unsigned long i = k; i < frames; i++)
+        for (int c = 0; c < channels; c++)
+            out[i * channels + c] = planar[c][i];
+}
+
+void dsp_gather(float *out, const float *in, int channels, int ch,
+                unsigned long frames) {
+    unsigned long k = 0;
+
+    if (channels == 1) {
+        dsp_copy(out, in, frames);
+        return;
+    }
+    if (channels == 2) {
+        for (; k + 4 <= frames; k += 4) {
+            v4f a = LOAD(in + 2 * k), b = LOAD(in + 2 * k + 4);
+            STORE(out + k, ch ? SHUF(a, b, 1, 3, 5, 7)
+                              : SHUF(a, b, 0, 2, 4, 6));
+        }
+    } else {
+        const unsigned long s = (unsigned long)channels;
+        for (; k + 4 <= frames; k += 4) {
+            const float *f = in + k * s + ch;
+            STORE(out + k, ((v4f){f[0], f[s], f[2 * s], f[3 * s]}));
+        }
+    }
+    for (; k < frames; k++)
+        out[k] = in[k * channels + ch];
+}
+
+void dsp_downmix(float *out, const float *in, int channels, float gain,
+                 unsigned long frames) {
+    const v4f g = {gain, gain, gain, gain};
+    unsigned long k = 0;
+
+    if (channels == 1) {
+        dsp_scale(out, in, gain, frames);
+        return;
+    }
+    if (channels == 2) {
+        for (; k + 4 <= frames; k += 4) {
+            v4f a = LOAD(in + 2 * k), b = LOAD(in + 2 * k + 4);
+            STORE(out + k,
+                  (SHUF(a, b, 0, 2, 4, 6) + SHUF(a, b, 1, 3, 5, 7)) * g);
+        }
+    } else if (channels % 4 == 0) {
+        // Per-frame partial sums in lanes, then a transpose adds across
+        for (; k + 4 <= frames; k += 4) {
+            const float *f = in + k * channels;
+            v4f s0 = LOAD(f), s1 = LOAD(f + channels);
+            v4f s2 = LOAD(f + 2 * channels), s3 = LOAD(f + 3 * channels);
+            for (int c = 4; c < channels; c += 4) {
+                s0 += LOAD(f + c);
+                s1 += LOAD(f + channels + c);
+                s2 += LOAD(f + 2 * channels + c);
+                s3 += LOAD(f + 3 * channels + c);
+            }
+            TRANSPOSE4(s0, s1, s2, s3);
+            STORE(out + k, ((s0 + s1) + (s2 + s3)) * g);
+        }
+    }
+
+    for (; k < frames; k++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++)
+            sum += in[k * channels + c];
+        out[k] = sum * gain;
+    }
+}
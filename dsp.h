@@ -0,0 +1,53 @@
+#ifndef DSP_H
+#define DSP_H
+
+// Block kernels shared by the engine and modules. Written with GCC/Clang
+// vector extensions so the same source becomes SSE on x86 and NEON on ARM.
+
+#define DSP_ALIGN 32
+#define DSP_ALIGNED __attribute__((aligned(DSP_ALIGN)))
+
+// Zeroed, DSP_ALIGN-aligned float buffer; release with free()
+float *dsp_alloc(unsigned long count);
+
+void dsp_zero(float *out, unsigned long frames);
+void dsp_copy(float *out, const float *in, unsigned long frames);
+void dsp_scale(float *out, const float *in, float gain, unsigned long frames);
+// out += in
+void dsp_add(float *out, const float *in, unsigned long frames);
+
+// out = gain * sum(in[0..count-1]); NULL inputs are skipped, and with no
+// live inputs out is cleared. Inputs are summed four at a time so out is
+// written once per four sources instead of once per source.
+void dsp_mix(float *out, float *const *in, int count, float gain,
+             unsigned long frames);
+
+// out = sum(gains[j] * in[j]), same NULL handling as dsp_mix
+void dsp_mix_gains(float *out, float *const *in, const float *gains,
+                   int count, unsigned long frames);
+
+// out[r] = sum over c of m[r * cols + c] * in[c], for `rows` outputs and
+// `cols` inputs; NULL inputs are skipped. With `from` (same layout) the
+// gains glide from it to m across the block, reaching m on the last frame.
+void dsp_matrix(float *const *out, int rows, float *const *in, int cols,
+                const float *m, const float *from, unsigned long frames);
+
+// Channel layout. Interleaved buffers hold `channels` floats per frame.
+// 2 channels and multiples of 4 (4, 8, 16...) move four frames at a time
+// through shuffles and 4x4 transposes; other counts fall back to a strided
+// loop.
+
+// planar[c][k] = in[k * channels + c]; NULL planes are skipped
+void dsp_deinterleave(float *const *planar, const float *in, int channels,
+                      unsigned long frames);
+// out[k * channels + c] = planar[c][k]
+void dsp_interleave(float *out, const float *const *planar, int channels,
+                    unsigned long frames);
+// out[k] = in[k * channels + ch]
+void dsp_gather(float *out, const float *in, int channels, int ch,
+                unsigned long frames);
+// out[k] = gain * sum over c of in[k * channels + c]; out may alias in
+void dsp_downmix(float *out, const float *in, int channels, float gain,
+                 unsigned long frames);
+
+#endif
@@ -6,11 +6,16 @@
 #include <string.h>
 
 #include "./modules/c_input/c_input.h"
+#include "./modules/ambi_decode/ambi_decode.h"
 #include "./modules/c_output/c_output.h"
 #include "./modules/input/input.h"
 #include "./modules/vca/vca.h"
+#include "dsp.h"
 #include "engine.h"
 #include "module_loader.h"
+#include "perf.h"
+#include "retro.h"
+#include "trace.h"
 #include "util.h"
 
 int ui_enabled = 1;
@@ -29,6 +34,18 @@ typedef struct {
 static DeferredPatchLine patch_lines[MAX_MODULES];
 static int patch_line_count = 0;
 
+// Scratch for fan-in mixing and the shared silent input. Blocks never exceed
+// MAX_BLOCK_SIZE: every module output buffer is sized to it.
+static float mix_scratch[MAX_BLOCK_SIZE] DSP_ALIGNED;
+static float silence[MAX_BLOCK_SIZE] DSP_ALIGNED;
+
+// Device channels, split into planes once per block. Channels past
+// ENGINE_MAX_CHANNELS read as silence on input and are left silent on
+// output.
+#define ENGINE_MAX_CHANNELS 64
+static float input_planes[ENGINE_MAX_CHANNELS][MAX_BLOCK_SIZE] DSP_ALIGNED;
+static float output_planes[ENGINE_MAX_CHANNELS][MAX_BLOCK_SIZE] DSP_ALIGNED;
+
 static NamedModule *find_module_by_name(const char *name) {
     for (int i = 0; i < module_count; i++) {
         if (strcmp(modules[i].name, name) == 0)
@@ -37,6 +54,30 @@ static NamedModule *find_module_by_name(const char *name) {
     return NULL;
 }
 
+// Audio output by name: "alias" is a module's main output, "alias.N" its
+// Nth extra one (from 1)
+static float *find_audio_output(const char *name) {
+    NamedModule *src = find_module_by_name(name);
+    if (src)
+        return src->module->output_buffer;
+
+    const char *dot = strrchr(name, '.');
+    if (!dot || !isdigit((unsigned char)dot[1]))
+        return NULL;
+    char base[sizeof(src->name)];
+    size_t len = (size_t)(dot - name);
+    if (len >= sizeof(base))
+        return NULL;
+    memcpy(base, name, len);
+    base[len] = '\0';
+
+    src = find_module_by_name(base);
+    int n = atoi(dot + 1);
+    if (!src || n < 1 || n > src->module->num_outputs)
+        return NULL;
+    return src->module->outputs[n - 1];
+}
+
 static void connect_module_inputs(Module *m, char **input_names,
                                   int input_count) {
     m->num_inputs = 0;
@@ -59,9 +100,10 @@ static void connect_module_inputs(Module *m, char **input_names,
                 } else {
                     fprintf(stderr, "Too many control inputs\n");
                 }
-            } else if (src && src->module->output_buffer) {
+            } else if (find_audio_output(source_name)) {
                 if (m->num_inputs < MAX_INPUTS) {
-                    m->inputs[m->num_inputs++] = src->module->output_buffer;
+                    m->inputs[m->num_inputs++] =
+                        find_audio_output(source_name);
                 } else {
                     fprintf(stderr, "Too many audio inputs\n");
                 }
@@ -70,10 +112,10 @@ static void connect_module_inputs(Module *m, char **input_names,
                         source_name);
             }
         } else {
-            NamedModule *src = find_module_by_name(name);
-            if (src && src->module->output_buffer) {
+            float *src = find_audio_output(name);
+            if (src) {
                 if (m->num_inputs < MAX_INPUTS) {
-                    m->inputs[m->num_inputs++] = src->module->output_buffer;
+                    m->inputs[m->num_inputs++] = src;
                 } else {
                     fprintf(stderr, "Too many audio inputs\n");
                 }
@@ -198,10 +240,12 @@ void initialize_engine(const char *patch_text) {
     while (line) {
         char *clean_line = trim_whitespace(line);
 
-        // --- Skip blank lines, comments, and directives like "no_ui"
+        // --- Skip blank lines, comments, and directives like "no_ui"/"rt"
         if (strlen(clean_line) == 0 || clean_line[0] == '#' ||
             strncmp(clean_line, "//", 2) == 0 ||
-            strncasecmp(clean_line, "no_ui", 5) == 0) {
+            strncasecmp(clean_line, "no_ui", 5) == 0 ||
+            strncmp(clean_line, "rt ", 3) == 0 ||
+            strncmp(clean_line, "retro ", 6) == 0) {
             line = strtok(NULL, "\r\n");
             continue;
         }
@@ -266,20 +310,28 @@ void shutdown_engine(void) {
 }
 
 void process_audio(float *input, float *output, unsigned long frames) {
+    uint64_t t_prev = perf_now_ns();
+
     // Control logic
     for (int i = 0; i < module_count; i++) {
         Module *m = modules[i].module;
         if (m->process_control) {
             m->process_control(m, frames);
+            uint64_t t = perf_now_ns();
+            perf_module_cost(i, t - t_prev);
+            if (trace_on())
+                trace_complete("control", modules[i].name, t_prev, t);
+            t_prev = t;
         }
     }
+    int inputs_split = 0;
     for (int i = 0; i < module_count; i++) {
         Module *m = modules[i].module;
 
         if (m->type && (strcmp(m->type, "input") == 0 ||
                         strcmp(m->type, "c_input") == 0)) {
             int ch;
-            unsigned long stride = g_num_input_channels;
+            int stride = g_num_input_channels > 0 ? g_num_input_channels : 1;
 
             // Correct struct per module type
             if (strcmp(m->type, "input") == 0) {
@@ -293,34 +345,42 @@ void process_audio(float *input, float *output, unsigned long frames) {
             if (ch < 1 || ch > stride)
                 ch = 1;
 
-            float tmp[frames];
-            for (unsigned long k = 0; k < frames; k++)
-                tmp[k] = input[k * stride + (ch - 1)];
-
-            m->process(m, tmp, frames);
-        } else {
-            float mixed_input[frames];
-            memset(mixed_input, 0, sizeof(float) * frames);
-
-            for (int j = 0; j < m->num_inputs; j++) {
-                float *in_buf = m->inputs[j];
-                if (!in_buf)
-                    continue;
-                for (unsigned long k = 0; k < frames; k++) {
-                    mixed_input[k] += in_buf[k];
-                }
+            // One pass for every input module this block
+            if (!inputs_split) {
+                float *planes[stride];
+                for (int c = 0; c < stride; c++)
+                    planes[c] = c < ENGINE_MAX_CHANNELS ? input_planes[c]
+                                                        : NULL;
+                dsp_deinterleave(planes, input, stride, frames);
+                inputs_split = 1;
             }
 
-            if (m->num_inputs > 0) {
-                float norm = 1.0f / (float)m->num_inputs;
-                for (unsigned long k = 0; k < frames; k++) {
-                    mixed_input[k] *= norm;
-                }
+            m->process(m, ch <= ENGINE_MAX_CHANNELS ? input_planes[ch - 1]
+                                                    : silence,
+                       frames);
+        } else {
+            // A single input is handed over by pointer; only true fan-in
+            // pays for a mix, with the 1/N normalisation folded in.
+            float *mixed_input;
+            if (m->num_inputs == 1 && m->inputs[0]) {
+                mixed_input = m->inputs[0];
+            } else if (m->num_inputs > 0) {
+                dsp_mix(mix_scratch, m->inputs, m->num_inputs,
+                        1.0f / (float)m->num_inputs, frames);
+                mixed_input = mix_scratch;
+            } else {
+                mixed_input = silence;
             }
             if (m->process) {
                 m->process(m, mixed_input, frames);
             }
         }
+
+        uint64_t t = perf_now_ns();
+        perf_module_cost(i, t - t_prev);
+        if (trace_on())
+            trace_complete("module", modules[i].name, t_prev, t);
+        t_prev = t;
     }
 
     // --- Final multi-channel mixdown ---
@@ -329,44 +389,45 @@ void process_audio(float *input, float *output, unsigned long frames) {
     if (info && info->maxOutputChannels > 2)
         num_channels = info->maxOutputChannels;
 
-    memset(output, 0, sizeof(float) * frames * num_channels);
+    // Summed per channel, interleaved once at the end
+    int planes_used = num_channels < ENGINE_MAX_CHANNELS ? num_channels
+                                                         : ENGINE_MAX_CHANNELS;
+    for (int c = 0; c < planes_used; c++)
+        dsp_zero(output_planes[c], frames);
 
     for (int i = 0; i < module_count; i++) {
         Module *m = modules[i].module;
 
-        if (strcmp(m->type, "vca") == 0) {
+        int mapped = strcmp(m->type, "vca") == 0;
+        int target = 0;
+        if (mapped) {
             // handle channel-mapped VCAs only
             VCAState *s = (VCAState *)m->state;
-            int ch = (s && s->target_channel > 0 &&
-                      s->target_channel <= num_channels)
-                         ? s->target_channel
-                         : -1;
-
-            for (unsigned long k = 0; k < frames; k++) {
-                if (ch > 0 && ch <= num_channels)
-                    output[k * num_channels + (ch - 1)] += m->output_bufferL[k];
-                else {
-                    output[k * num_channels] += m->output_bufferL[k];
-                    if (num_channels > 1)
-                        output[k * num_channels + 1] += m->output_bufferR[k];
-                }
-            }
+            target = s ? s->target_channel : 0;
         } else if (strcmp(m->type, "c_output") == 0) {
             // handle channel-mapped c_output modules
             COutputState *s = (COutputState *)m->state;
-            int ch = (s && s->target_channel > 0 &&
-                      s->target_channel <= num_channels)
-                         ? s->target_channel
-                         : -1;
-
-            for (unsigned long k = 0; k < frames; k++) {
-                if (ch > 0 && ch <= num_channels)
-                    output[k * num_channels + (ch - 1)] += m->output_bufferL[k];
-                else {
-                    output[k * num_channels] += m->output_bufferL[k];
-                    if (num_channels > 1)
-                        output[k * num_channels + 1] += m->output_bufferR[k];
-                }
+            target = s ? s->target_channel : 0;
+            mapped = 1;
+        }
+
+        if (mapped) {
+            if (target > 0 && target <= num_channels) {
+                if (target <= planes_used)
+                    dsp_add(output_planes[target - 1], m->output_bufferL,
+                            frames);
+            } else {
+                dsp_add(output_planes[0], m->output_bufferL, frames);
+                if (planes_used > 1)
+                    dsp_add(output_planes[1], m->output_bufferR, frames);
+            }
+        } else if (strcmp(m->type, "ambi_decode") == 0 &&
+                   ((AmbiDecode *)m->state)->target_channel > 0) {
+            // Speaker feeds on consecutive channels from the target
+            int first = ((AmbiDecode *)m->state)->target_channel - 1;
+            for (int k = 0; k < m->num_outputs; k++) {
+                if (first + k < planes_used)
+                    dsp_add(output_planes[first + k], m->outputs[k], frames);
             }
         } else if (strcmp(modules[i].name, "out") == 0) {
             // normal stereo master out
@@ -375,13 +436,17 @@ void process_audio(float *input, float *output, unsigned long frames) {
             float *outR =
                 m->output_bufferR ? m->output_bufferR : m->output_buffer;
 
-            for (unsigned long k = 0; k < frames; k++) {
-                output[k * num_channels] = outL[k];
-                if (num_channels > 1)
-                    output[k * num_channels + 1] = outR[k];
-            }
+            dsp_copy(output_planes[0], outL, frames);
+            if (planes_used > 1)
+                dsp_copy(output_planes[1], outR, frames);
         }
     }
+
+    const float *planes[num_channels];
+    for (int c = 0; c < num_channels; c++)
+        planes[c] = c < planes_used ? output_planes[c] : silence;
+    dsp_interleave(output, planes, num_channels, frames);
+
     // --- Normalize global output to prevent clipping ---
     float max_val = 0.0f;
     for (unsigned long i = 0; i < frames * num_channels; i++) {
@@ -393,6 +458,8 @@ void process_audio(float *input, float *output, unsigned long frames) {
         for (unsigned long i = 0; i < frames * num_channels; i++)
             output[i] *= norm;
     }
+
+    retro_capture(output, num_channels, frames);
 }
 
 Module *get_module(int index) {
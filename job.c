@@ -0,0 +1,497 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "job.h"
+#include "logger.h"
+#include "module_loader.h"
+#include "perf.h"
+
+#define JOB_LIVE_WORKERS 2
+#define JOB_LIVE_IO 1
+#define JOB_DEFAULT_IO 2
+#define JOB_STATUS_MS 250
+
+// Counting gate for I/O sections
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    int limit;
+    int in_use;
+} IoGate;
+
+struct JobCtx {
+    JobFn fn;
+    char path[PATH_MAX];
+    char args[512];
+    unsigned int index;
+    IoGate *gate;
+    int threads;
+
+    int state;
+    int progress; // per mille
+    int cancel;
+    int refs;
+    uint64_t start_ns;
+    uint64_t end_ns;
+
+    struct JobCtx *next;
+};
+
+// --- Job side ---
+
+void job_progress(JobCtx *ctx, float fraction) {
+    if (!ctx)
+        return;
+    int pm = (int)(fraction * 1000.0f);
+    pm = pm < 0 ? 0 : (pm > 1000 ? 1000 : pm);
+    __atomic_store_n(&ctx->progress, pm, __ATOMIC_RELAXED);
+}
+
+void job_io_begin(JobCtx *ctx) {
+    if (!ctx || !ctx->gate)
+        return;
+    IoGate *g = ctx->gate;
+    pthread_mutex_lock(&g->lock);
+    while (g->in_use >= g->limit)
+        pthread_cond_wait(&g->cv, &g->lock);
+    g->in_use++;
+    pthread_mutex_unlock(&g->lock);
+}
+
+void job_io_end(JobCtx *ctx) {
+    if (!ctx || !ctx->gate)
+        return;
+    IoGate *g = ctx->gate;
+    pthread_mutex_lock(&g->lock);
+    g->in_use--;
+    pthread_cond_signal(&g->cv);
+    pthread_mutex_unlock(&g->lock);
+}
+
+int job_cancelled(JobCtx *ctx) {
+    return ctx ? __atomic_load_n(&ctx->cancel, __ATOMIC_RELAXED) : 0;
+}
+
+static int online_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int job_threads(JobCtx *ctx) {
+    return ctx ? ctx->threads : online_cpus();
+}
+
+static void run_one(JobCtx *ctx) {
+    ctx->start_ns = perf_now_ns();
+    __atomic_store_n(&ctx->state, JOB_RUNNING, __ATOMIC_RELEASE);
+    int rc = ctx->fn(ctx, ctx->path, ctx->args, ctx->index);
+    ctx->end_ns = perf_now_ns();
+    if (rc == 0 && !job_cancelled(ctx))
+        job_progress(ctx, 1.0f);
+    __atomic_store_n(&ctx->state, rc == 0 ? JOB_DONE : JOB_FAILED,
+                     __ATOMIC_RELEASE);
+}
+
+// --- Patch side: background workers ---
+
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t live_queue_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t live_done_cv = PTHREAD_COND_INITIALIZER;
+static JobCtx *live_head = NULL;
+static JobCtx *live_tail = NULL;
+static int live_started = 0;
+static IoGate live_gate = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                           JOB_LIVE_IO, 0};
+
+static void put_locked(JobCtx *ctx) {
+    if (--ctx->refs == 0)
+        free(ctx);
+}
+
+static void *live_worker_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&live_lock);
+    for (;;) {
+        while (!live_head)
+            pthread_cond_wait(&live_queue_cv, &live_lock);
+        JobCtx *ctx = live_head;
+        live_head = ctx->next;
+        if (!live_head)
+            live_tail = NULL;
+
+        if (job_cancelled(ctx)) {
+            __atomic_store_n(&ctx->state, JOB_FAILED, __ATOMIC_RELEASE);
+        } else {
+            // Marked running before the lock drops, so job_release() can't
+            // see a claimed job as still queued and leave without waiting
+            __atomic_store_n(&ctx->state, JOB_RUNNING, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&live_lock);
+            run_one(ctx);
+            if (job_state(ctx, NULL) == JOB_FAILED)
+                LOG_ERROR("[job] failed: %s", ctx->path);
+            pthread_mutex_lock(&live_lock);
+        }
+        put_locked(ctx);
+        pthread_cond_broadcast(&live_done_cv);
+    }
+    return NULL;
+}
+
+JobCtx *job_submit(JobFn fn, const char *path, const char *args,
+                   unsigned int index) {
+    JobCtx *ctx = calloc(1, sizeof(JobCtx));
+    if (!ctx)
+        return NULL;
+    ctx->fn = fn;
+    snprintf(ctx->path, sizeof(ctx->path), "%s", path);
+    snprintf(ctx->args, sizeof(ctx->args), "%s", args ? args : "");
+    ctx->index = index;
+    ctx->gate = &live_gate;
+    // Leaves a core for audio and the UI
+    ctx->threads = online_cpus() > 1 ? online_cpus() - 1 : 1;
+    ctx->state = JOB_QUEUED;
+    ctx->refs = 2; // worker + module
+
+    pthread_mutex_lock(&live_lock);
+    if (!live_started) {
+        for (int i = 0; i < JOB_LIVE_WORKERS; i++) {
+            pthread_t t;
+            if (pthread_create(&t, NULL, live_worker_main, NULL) == 0) {
+                pthread_detach(t);
+                live_started++;
+            }
+        }
+    }
+    if (!live_started) {
+        pthread_mutex_unlock(&live_lock);
+        free(ctx);
+        return NULL;
+    }
+    if (live_tail)
+        live_tail->next = ctx;
+    else
+        live_head = ctx;
+    live_tail = ctx;
+    pthread_cond_signal(&live_queue_cv);
+    pthread_mutex_unlock(&live_lock);
+    return ctx;
+}
+
+JobState job_state(JobCtx *ctx, float *progress) {
+    if (!ctx) {
+        if (progress)
+            *progress = 0.0f;
+        return JOB_FAILED;
+    }
+    if (progress)
+        *progress = __atomic_load_n(&ctx->progress, __ATOMIC_RELAXED) / 1e3f;
+    return (JobState)__atomic_load_n(&ctx->state, __ATOMIC_ACQUIRE);
+}
+
+const char *job_describe(JobCtx *ctx, char *buf, int len) {
+    float p;
+    switch (job_state(ctx, &p)) {
+    case JOB_QUEUED:
+        snprintf(buf, (size_t)len, "queued");
+        break;
+    case JOB_RUNNING:
+        snprintf(buf, (size_t)len, "running %d%%", (int)(p * 100.0f));
+        break;
+    case JOB_DONE:
+        snprintf(buf, (size_t)len, "done (%.1f s)",
+                 (ctx->end_ns - ctx->start_ns) * 1e-9);
+        break;
+    default:
+        snprintf(buf, (size_t)len, "failed");
+        break;
+    }
+    return buf;
+}
+
+void job_release(JobCtx *ctx) {
+    if (!ctx)
+        return;
+    pthread_mutex_lock(&live_lock);
+    __atomic_store_n(&ctx->cancel, 1, __ATOMIC_RELAXED);
+    while (job_state(ctx, NULL) == JOB_RUNNING)
+        pthread_cond_wait(&live_done_cv, &live_lock);
+    put_locked(ctx);
+    pthread_mutex_unlock(&live_lock);
+}
+
+// --- Headless batch ---
+
+typedef struct {
+    JobCtx *jobs;
+    int count;
+    int next;       // claimed by workers
+    int *finished;  // job indices in completion order
+    int n_finished;
+} Batch;
+
+static void *batch_worker_main(void *arg) {
+    Batch *b = (Batch *)arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count)
+            break;
+        run_one(&b->jobs[i]);
+        int slot = __atomic_fetch_add(&b->n_finished, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->finished[slot], i + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static int is_audio_file(const char *name) {
+    static const char *exts[] = {"wav", "wave", "aif", "aiff", "aifc", "flac",
+                                 "w64", "rf64", "caf",  "ogg",  "bwf"};
+    const char *dot = strrchr(name, '.');
+    if (!dot || name[0] == '.')
+        return 0;
+    char ext[8];
+    size_t n = 0;
+    for (dot++; *dot && n < sizeof(ext) - 1; dot++)
+        ext[n++] = (char)tolower((unsigned char)*dot);
+    ext[n] = '\0';
+    for (size_t k = 0; k < sizeof(exts) / sizeof(exts[0]); k++)
+        if (!strcmp(ext, exts[k]))
+            return 1;
+    return 0;
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void free_inputs(char **list, int count) {
+    for (int i = 0; i < count; i++)
+        free(list[i]);
+    free(list);
+}
+
+// Audio files under `in` (a directory, not recursed, or a single file).
+// *count is -1 when memory ran out.
+static char **collect_inputs(const char *in, int *count) {
+    *count = 0;
+    struct stat st;
+    if (stat(in, &st) != 0)
+        return NULL;
+
+    char **list = NULL;
+    int cap = 0;
+    if (!S_ISDIR(st.st_mode)) {
+        list = malloc(sizeof(char *));
+        if (!list || !(list[0] = strdup(in))) {
+            free(list);
+            *count = -1;
+            return NULL;
+        }
+        *count = 1;
+        return list;
+    }
+
+    DIR *d = opendir(in);
+    if (!d)
+        return NULL;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (!is_audio_file(e->d_name))
+            continue;
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", in, e->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (*count == cap) {
+            int grown = cap ? cap * 2 : 64;
+            char **l = realloc(list, (size_t)grown * sizeof(char *));
+            if (!l)
+                break;
+            list = l;
+            cap = grown;
+        }
+        if (!(list[*count] = strdup(path)))
+            break;
+        (*count)++;
+    }
+    if (e) {
+        // Stopped early: out of memory
+        closedir(d);
+        free_inputs(list, *count);
+        *count = -1;
+        return NULL;
+    }
+    closedir(d);
+    if (*count > 1)
+        qsort(list, (size_t)*count, sizeof(char *), cmp_str);
+    return list;
+}
+
+static const char *base_name(const char *path) {
+    const char *s = strrchr(path, '/');
+    return s ? s + 1 : path;
+}
+
+static void print_status(const Batch *b, int tty) {
+    if (!tty)
+        return;
+    char line[512];
+    int pos = snprintf(line, sizeof(line), "[%d/%d]",
+                       __atomic_load_n(&b->n_finished, __ATOMIC_RELAXED),
+                       b->count);
+    for (int i = 0; i < b->count && pos < (int)sizeof(line) - 40; i++) {
+        JobCtx *ctx = &b->jobs[i];
+        float p;
+        if (job_state(ctx, &p) != JOB_RUNNING)
+            continue;
+        pos += snprintf(line + pos, sizeof(line) - (size_t)pos, " %.24s %d%%",
+                        base_name(ctx->path), (int)(p * 100.0f));
+    }
+    printf("\r\033[K%s", line);
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: signalcrate --job <name> --in <dir|file> [-j N] "
+                    "[--io N] [--args \"key=value,...\"]\n"
+                    "  name: normalize, mono_mix, polywav_split, "
+                    "ambi_a_to_b (or any e_* module)\n");
+}
+
+int job_main(int argc, char **argv) {
+    const char *name = NULL, *in = NULL, *args = "";
+    long threads = online_cpus();
+    int io = JOB_DEFAULT_IO;
+
+    for (int i = 1; i < argc; i++) {
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(argv[i], "--job") && v)
+            name = argv[++i];
+        else if (!strcmp(argv[i], "--in") && v)
+            in = argv[++i];
+        else if (!strcmp(argv[i], "-j") && v)
+            threads = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--io") && v)
+            io = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--args") && v)
+            args = argv[++i];
+        else if (!strncmp(argv[i], "-j", 2) &&
+                 isdigit((unsigned char)argv[i][2]))
+            threads = atol(argv[i] + 2);
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (!name || !in) {
+        usage();
+        return 2;
+    }
+    if (threads < 1)
+        threads = 1;
+    if (io < 1)
+        io = 1;
+
+    char module[128];
+    snprintf(module, sizeof(module), "%s%s", strncmp(name, "e_", 2) ? "e_" : "",
+             name);
+    void *handle = module_open(module);
+    JobFn fn = handle ? (JobFn)dlsym(handle, "module_job") : NULL;
+    if (!fn) {
+        fprintf(stderr, "%s has no batch job\n", module);
+        return 2;
+    }
+
+    int count;
+    char **files = collect_inputs(in, &count);
+    if (count < 0) {
+        fprintf(stderr, "Out of memory listing '%s'\n", in);
+        return 2;
+    }
+    if (count == 0) {
+        fprintf(stderr, "No audio files in '%s'\n", in);
+        return 2;
+    }
+    if (threads > count)
+        threads = count;
+
+    IoGate gate = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, io, 0};
+    Batch b = {0};
+    b.count = count;
+    b.jobs = calloc((size_t)count, sizeof(JobCtx));
+    b.finished = calloc((size_t)count, sizeof(int));
+    pthread_t *pool = calloc((size_t)threads, sizeof(pthread_t));
+    if (!b.jobs || !b.finished || !pool) {
+        fprintf(stderr, "Out of memory for %d jobs\n", count);
+        free(b.jobs);
+        free(b.finished);
+        free(pool);
+        free_inputs(files, count);
+        return 2;
+    }
+    for (int i = 0; i < count; i++) {
+        JobCtx *ctx = &b.jobs[i];
+        ctx->fn = fn;
+        snprintf(ctx->path, sizeof(ctx->path), "%s", files[i]);
+        snprintf(ctx->args, sizeof(ctx->args), "%s", args);
+        ctx->index = (unsigned int)i;
+        ctx->gate = &gate;
+        ctx->threads = online_cpus() / (int)threads;
+        if (ctx->threads < 1)
+            ctx->threads = 1;
+        ctx->state = JOB_QUEUED;
+    }
+
+    printf("%s: %d file%s, %ld thread%s, io %d\n", module, count,
+           count == 1 ? "" : "s", threads, threads == 1 ? "" : "s", io);
+
+    uint64_t t0 = perf_now_ns();
+    for (long t = 0; t < threads; t++)
+        pthread_create(&pool[t], NULL, batch_worker_main, &b);
+
+    int tty = isatty(STDOUT_FILENO);
+    int printed = 0, failed = 0;
+    while (printed < count) {
+        while (printed < count) {
+            int i = __atomic_load_n(&b.finished[printed], __ATOMIC_ACQUIRE);
+            if (!i)
+                break;
+            JobCtx *ctx = &b.jobs[i - 1];
+            int ok = ctx->state == JOB_DONE;
+            failed += !ok;
+            printf("%s%-4s %s (%.2f s)\n", tty ? "\r\033[K" : "",
+                   ok ? "ok" : "FAIL", ctx->path,
+                   (ctx->end_ns - ctx->start_ns) * 1e-9);
+            printed++;
+        }
+        if (printed < count) {
+            print_status(&b, tty);
+            usleep(JOB_STATUS_MS * 1000);
+        }
+    }
+    for (long t = 0; t < threads; t++)
+        pthread_join(pool[t], NULL);
+
+    double wall = (perf_now_ns() - t0) * 1e-9;
+    printf("%s%s: %d ok, %d failed, %.2f s (%.2f files/s)\n",
+           tty ? "\r\033[K" : "", module, count - failed, failed, wall,
+           wall > 0.0 ? count / wall : 0.0);
+    if (failed) {
+        for (int i = 0; i < count; i++)
+            if (b.jobs[i].state != JOB_DONE)
+                printf("  failed: %s\n", b.jobs[i].path);
+    }
+
+    free_inputs(files, count);
+    free(b.jobs);
+    free(b.finished);
+    free(pool);
+    return failed ? 1 : 0;
+}
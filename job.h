@@ -0,0 +1,49 @@
+#ifndef JOB_H
+#define JOB_H
+
+// File jobs for the environment (e_*) modules. Each such module exports
+//
+//   int module_job(JobCtx *ctx, const char *path, const char *args,
+//                  unsigned int index);
+//
+// which processes one file and returns 0 on success. In a patch,
+// create_module() hands it to job_submit() and returns at once; the job
+// runs on a background worker while audio and UI carry on. Headless,
+//
+//   SignalCrate --job normalize --in dir/ [-j 8] [--io 2] [--args "..."]
+//
+// runs it over every audio file in dir/ on a pool of -j threads, with at
+// most --io of them inside job_io_begin/end at a time, and prints progress
+// and a summary. `index` numbers the files of a batch (0 in a patch).
+//
+// The job-side calls accept a NULL ctx.
+
+typedef struct JobCtx JobCtx;
+
+typedef int (*JobFn)(JobCtx *ctx, const char *path, const char *args,
+                     unsigned int index);
+
+typedef enum { JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED } JobState;
+
+// Job side
+void job_progress(JobCtx *ctx, float fraction);
+void job_io_begin(JobCtx *ctx); // around reads and writes
+void job_io_end(JobCtx *ctx);
+int job_cancelled(JobCtx *ctx);
+// Threads a job may start for itself: the CPUs left over by the other
+// workers (one per CPU with a NULL ctx)
+int job_threads(JobCtx *ctx);
+
+// Patch side: copies path and args; the module keeps the handle for its UI
+JobCtx *job_submit(JobFn fn, const char *path, const char *args,
+                   unsigned int index);
+JobState job_state(JobCtx *ctx, float *progress);
+const char *job_describe(JobCtx *ctx, char *buf, int len);
+// Drops the module's handle: a queued job is skipped, a running one is
+// asked to stop and waited for
+void job_release(JobCtx *ctx);
+
+// Headless entry point, from main() when argv holds --job
+int job_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,531 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "perf.h"
+
+#define DIAG_DIR "e_output_files/diagnostics"
+#define LOG_MAX_THREADS 32
+#define LOG_RING_SIZE 64 // entries per thread, power of two
+#define LOG_DRAIN_MS 50
+
+typedef union {
+    long long i;
+    double d;
+    void *p;
+    uint16_t str; // offset into LogEntry.strings
+} LogArg;
+
+typedef struct {
+    const char *fmt;
+    uint64_t time_ns;
+    uint8_t level;
+    uint8_t nargs;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STR_BYTES];
+} LogEntry;
+
+// A ring goes back to the pool once its thread has exited and the drain
+// thread has emptied it
+enum { RING_FREE, RING_OWNED, RING_RETIRED };
+
+// Single producer (the owning thread), single consumer (the drain thread)
+typedef struct {
+    LogEntry entries[LOG_RING_SIZE];
+    uint32_t write;
+    uint32_t read;
+    uint32_t dropped;
+    int state;
+} LogRing;
+
+static LogRing rings[LOG_MAX_THREADS];
+static __thread LogRing *tls_ring = NULL;
+static uint32_t unclaimed_dropped = 0;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t drain_thread;
+static int drain_running = 0;
+static FILE *log_file = NULL;
+static int log_file_failed = 0;
+static int echo = 1;
+static uint64_t origin_ns = 0;
+
+// Formatted lines for the UI pane
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+static char history[LOG_HISTORY][LOG_LINE_BYTES];
+static LogLevel history_level[LOG_HISTORY];
+static int history_count = 0;
+static int history_head = 0;
+
+// Walks one conversion spec starting after '%'. Returns a pointer past it
+// and sets *conv to the conversion character (0 if malformed) and *stars to
+// the number of '*' width/precision arguments it consumes.
+static const char *scan_spec(const char *p, char *conv, int *stars) {
+    *stars = 0;
+    while (*p && strchr("-+ #0'", *p))
+        p++;
+    if (*p == '*') {
+        (*stars)++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            (*stars)++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    while (*p && strchr("hlLqjzt", *p))
+        p++;
+    *conv = *p;
+    return *p ? p + 1 : p;
+}
+
+typedef enum {
+    LEN_INT, // none, h, hh: promoted to int
+    LEN_LONG,
+    LEN_LLONG, // ll, q
+    LEN_SIZE,
+    LEN_PTRDIFF,
+    LEN_INTMAX,
+    LEN_LDOUBLE // L on a floating conversion
+} LenMod;
+
+// The length modifier of the spec between start and end, so each argument
+// is fetched as the type the caller passed (long is 4 bytes on ILP32)
+static LenMod spec_length(const char *start, const char *end) {
+    int l = 0;
+    for (const char *q = start; q < end; q++) {
+        switch (*q) {
+        case 'l':
+            l++;
+            break;
+        case 'q':
+            return LEN_LLONG;
+        case 'z':
+            return LEN_SIZE;
+        case 't':
+            return LEN_PTRDIFF;
+        case 'j':
+            return LEN_INTMAX;
+        case 'L':
+            return LEN_LDOUBLE;
+        }
+    }
+    return l >= 2 ? LEN_LLONG : (l == 1 ? LEN_LONG : LEN_INT);
+}
+
+static long long arg_signed(va_list *ap, LenMod len) {
+    switch (len) {
+    case LEN_LONG:
+        return va_arg(*ap, long);
+    case LEN_LLONG:
+        return va_arg(*ap, long long);
+    case LEN_SIZE:
+        return (long long)va_arg(*ap, size_t);
+    case LEN_PTRDIFF:
+        return va_arg(*ap, ptrdiff_t);
+    case LEN_INTMAX:
+        return (long long)va_arg(*ap, intmax_t);
+    default:
+        return va_arg(*ap, int);
+    }
+}
+
+static long long arg_unsigned(va_list *ap, LenMod len) {
+    switch (len) {
+    case LEN_LONG:
+        return (long long)va_arg(*ap, unsigned long);
+    case LEN_LLONG:
+        return (long long)va_arg(*ap, unsigned long long);
+    case LEN_SIZE:
+        return (long long)va_arg(*ap, size_t);
+    case LEN_PTRDIFF:
+        return (long long)va_arg(*ap, ptrdiff_t);
+    case LEN_INTMAX:
+        return (long long)va_arg(*ap, uintmax_t);
+    default:
+        return (long long)va_arg(*ap, unsigned int);
+    }
+}
+
+// Runs as the owning thread exits; drain() frees the ring once empty
+static void release_ring(void *ring) {
+    __atomic_store_n(&((LogRing *)ring)->state, RING_RETIRED,
+                     __ATOMIC_RELEASE);
+}
+
+static void make_ring_key(void) { pthread_key_create(&ring_key, release_ring); }
+
+static LogRing *claim_ring(void) {
+    pthread_once(&ring_key_once, make_ring_key);
+    for (int t = 0; t < LOG_MAX_THREADS; t++) {
+        int expected = RING_FREE;
+        if (__atomic_compare_exchange_n(&rings[t].state, &expected,
+                                        RING_OWNED, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            pthread_setspecific(ring_key, &rings[t]);
+            return &rings[t];
+        }
+    }
+    return NULL;
+}
+
+void log_msg(LogLevel level, const char *fmt, ...) {
+    LogRing *r = tls_ring;
+    if (!r) {
+        r = tls_ring = claim_ring();
+        if (!r) {
+            __atomic_fetch_add(&unclaimed_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    uint32_t w = r->write;
+    if (w - __atomic_load_n(&r->read, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+        __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    LogEntry *e = &r->entries[w & (LOG_RING_SIZE - 1)];
+    e->fmt = fmt;
+    e->time_ns = perf_now_ns();
+    e->level = (uint8_t)level;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = 0;
+    size_t str_used = 0;
+    for (const char *p = fmt; *p && n < LOG_MAX_ARGS;) {
+        if (*p++ != '%')
+            continue;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        const char *start = p;
+        char conv;
+        int stars;
+        p = scan_spec(p, &conv, &stars);
+        for (int s = 0; s < stars && n < LOG_MAX_ARGS; s++)
+            e->args[n++].i = va_arg(ap, int);
+        if (n >= LOG_MAX_ARGS)
+            break;
+
+        switch (conv) {
+        case 'c':
+            e->args[n++].i = va_arg(ap, int);
+            break;
+        case 'd':
+        case 'i':
+            e->args[n++].i = arg_signed(&ap, spec_length(start, p));
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            e->args[n++].i = arg_unsigned(&ap, spec_length(start, p));
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            e->args[n++].d = spec_length(start, p) == LEN_LDOUBLE
+                                 ? (double)va_arg(ap, long double)
+                                 : va_arg(ap, double);
+            break;
+        case 'p':
+            e->args[n++].p = va_arg(ap, void *);
+            break;
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            if (!s)
+                s = "(null)";
+            e->args[n++].str = (uint16_t)str_used;
+            while (*s && str_used < LOG_STR_BYTES - 1)
+                e->strings[str_used++] = *s++;
+            e->strings[str_used++] = '\0';
+            if (str_used >= LOG_STR_BYTES)
+                str_used = LOG_STR_BYTES - 1;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    va_end(ap);
+    e->nargs = (uint8_t)n;
+
+    __atomic_store_n(&r->write, w + 1, __ATOMIC_RELEASE);
+}
+
+// --- Drain side: everything below runs off the audio thread ---
+
+static void format_entry(const LogEntry *e, char *out, size_t len) {
+    size_t pos = 0;
+    int n = 0;
+    const char *p = e->fmt;
+
+    while (*p && pos + 1 < len) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+
+        const char *start = p++;
+        char conv;
+        int stars;
+        p = scan_spec(p, &conv, &stars);
+
+        // Rebuild the spec with '*' resolved and lengths normalized
+        char spec[32];
+        size_t sp = 0;
+        int star_vals[2] = {0, 0};
+        for (int s = 0; s < stars && s < 2; s++)
+            star_vals[s] = (n < e->nargs) ? (int)e->args[n++].i : 0;
+        int si = 0;
+        for (const char *q = start; q < p - 1 && sp < sizeof(spec) - 8; q++) {
+            if (*q == '*')
+                sp += (size_t)snprintf(spec + sp, sizeof(spec) - sp, "%d",
+                                       star_vals[si++]);
+            else if (!strchr("hlLqjzt", *q))
+                spec[sp++] = *q;
+        }
+
+        const LogArg *a = (n < e->nargs) ? &e->args[n++] : NULL;
+        int w = 0;
+        switch (conv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec[sp++] = 'l';
+            spec[sp++] = 'l';
+            spec[sp++] = conv;
+            spec[sp] = '\0';
+            w = snprintf(out + pos, len - pos, spec, a ? a->i : 0LL);
+            break;
+        case 'c':
+            spec[sp++] = 'c';
+            spec[sp] = '\0';
+            w = snprintf(out + pos, len - pos, spec, a ? (int)a->i : '?');
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec[sp++] = conv;
+            spec[sp] = '\0';
+            w = snprintf(out + pos, len - pos, spec, a ? a->d : 0.0);
+            break;
+        case 'p':
+            spec[sp++] = 'p';
+            spec[sp] = '\0';
+            w = snprintf(out + pos, len - pos, spec, a ? a->p : NULL);
+            break;
+        case 's':
+            spec[sp++] = 's';
+            spec[sp] = '\0';
+            w = snprintf(out + pos, len - pos, spec,
+                         a ? e->strings + a->str : "");
+            break;
+        default:
+            break;
+        }
+        if (w > 0)
+            pos += (size_t)w;
+        if (pos >= len)
+            pos = len - 1;
+    }
+    out[pos] = '\0';
+
+    // Lines are stored without their trailing newline
+    while (pos > 0 && out[pos - 1] == '\n')
+        out[--pos] = '\0';
+}
+
+static void open_log_file(void) {
+    if (log_file || log_file_failed)
+        return;
+
+    mkdir("e_output_files", 0755);
+    mkdir(DIAG_DIR, 0755);
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32], path[256];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+    snprintf(path, sizeof(path), DIAG_DIR "/log_%s.txt", stamp);
+
+    log_file = fopen(path, "w");
+    if (!log_file)
+        log_file_failed = 1;
+}
+
+static void emit_line(LogLevel level, uint64_t time_ns, const char *text) {
+    static const char *level_names[] = {"INFO ", "WARN ", "ERROR"};
+    double t =
+        (time_ns > origin_ns) ? (double)(time_ns - origin_ns) * 1e-9 : 0.0;
+
+    open_log_file();
+    if (log_file) {
+        fprintf(log_file, "%10.3f %s %s\n", t, level_names[level], text);
+        fflush(log_file);
+    }
+    if (__atomic_load_n(&echo, __ATOMIC_RELAXED))
+        fprintf(stderr, "%s\n", text);
+
+    pthread_mutex_lock(&history_lock);
+    int slot = (history_head + history_count) % LOG_HISTORY;
+    if (history_count == LOG_HISTORY)
+        history_head = (history_head + 1) % LOG_HISTORY;
+    else
+        history_count++;
+    snprintf(history[slot], LOG_LINE_BYTES, "%9.3f %s", t, text);
+    history_level[slot] = level;
+    pthread_mutex_unlock(&history_lock);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const LogEntry *ea = *(const LogEntry *const *)a;
+    const LogEntry *eb = *(const LogEntry *const *)b;
+    return (ea->time_ns > eb->time_ns) - (ea->time_ns < eb->time_ns);
+}
+
+// Emits everything pending across all threads in timestamp order
+static void drain(void) {
+    static const LogEntry *pending[LOG_MAX_THREADS * LOG_RING_SIZE];
+    static uint32_t reported_dropped[LOG_MAX_THREADS];
+    static uint32_t reported_unclaimed = 0;
+    uint32_t ends[LOG_MAX_THREADS];
+    int retired[LOG_MAX_THREADS];
+    int count = 0;
+
+    for (int t = 0; t < LOG_MAX_THREADS; t++) {
+        LogRing *r = &rings[t];
+        // Read before the write index, so a retired ring's last entries
+        // are among those taken here
+        retired[t] =
+            __atomic_load_n(&r->state, __ATOMIC_ACQUIRE) == RING_RETIRED;
+        ends[t] = __atomic_load_n(&r->write, __ATOMIC_ACQUIRE);
+        for (uint32_t i = r->read; i != ends[t]; i++)
+            pending[count++] = &r->entries[i & (LOG_RING_SIZE - 1)];
+    }
+
+    qsort(pending, (size_t)count, sizeof(pending[0]), compare_entries);
+
+    char line[LOG_LINE_BYTES];
+    for (int i = 0; i < count; i++) {
+        format_entry(pending[i], line, sizeof(line));
+        emit_line((LogLevel)pending[i]->level, pending[i]->time_ns, line);
+    }
+
+    uint32_t dropped = 0;
+    for (int t = 0; t < LOG_MAX_THREADS; t++) {
+        __atomic_store_n(&rings[t].read, ends[t], __ATOMIC_RELEASE);
+        uint32_t d = __atomic_load_n(&rings[t].dropped, __ATOMIC_RELAXED);
+        dropped += d - reported_dropped[t];
+        reported_dropped[t] = d;
+        if (retired[t])
+            __atomic_store_n(&rings[t].state, RING_FREE, __ATOMIC_RELEASE);
+    }
+    uint32_t u = __atomic_load_n(&unclaimed_dropped, __ATOMIC_RELAXED);
+    dropped += u - reported_unclaimed;
+    reported_unclaimed = u;
+
+    if (dropped) {
+        snprintf(line, sizeof(line), "[log] %u messages dropped (ring full)",
+                 dropped);
+        emit_line(LOG_LEVEL_WARN, perf_now_ns(), line);
+    }
+}
+
+static void *drain_main(void *arg) {
+    (void)arg;
+    while (__atomic_load_n(&drain_running, __ATOMIC_ACQUIRE)) {
+        usleep(LOG_DRAIN_MS * 1000);
+        pthread_mutex_lock(&drain_lock);
+        drain();
+        pthread_mutex_unlock(&drain_lock);
+    }
+    return NULL;
+}
+
+// exit() from a module's fatal path must still get its message out
+static void log_at_exit(void) {
+    log_set_echo(1);
+    log_shutdown();
+}
+
+void log_init(void) {
+    if (drain_running)
+        return;
+    origin_ns = perf_now_ns();
+    drain_running = 1;
+    if (pthread_create(&drain_thread, NULL, drain_main, NULL) != 0)
+        drain_running = 0;
+    atexit(log_at_exit);
+}
+
+void log_shutdown(void) {
+    if (__atomic_exchange_n(&drain_running, 0, __ATOMIC_ACQ_REL))
+        pthread_join(drain_thread, NULL);
+
+    pthread_mutex_lock(&drain_lock);
+    drain();
+    if (log_file)
+        fflush(log_file);
+    pthread_mutex_unlock(&drain_lock);
+}
+
+void log_set_echo(int on) { __atomic_store_n(&echo, on, __ATOMIC_RELAXED); }
+
+int log_get_lines(char (*out)[LOG_LINE_BYTES], LogLevel *levels, int max,
+                  int skip, int *total) {
+    pthread_mutex_lock(&history_lock);
+    int avail = history_count - skip;
+    if (avail < 0)
+        avail = 0;
+    int n = avail < max ? avail : max;
+    int first = avail - n; // index from oldest
+    for (int i = 0; i < n; i++) {
+        int slot = (history_head + first + i) % LOG_HISTORY;
+        memcpy(out[i], history[slot], LOG_LINE_BYTES);
+        if (levels)
+            levels[i] = history_level[slot];
+    }
+    if (total)
+        *total = history_count;
+    pthread_mutex_unlock(&history_lock);
+    return n;
+}
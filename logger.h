@@ -0,0 +1,40 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+
+// Real-time safe logging. log_msg() never formats or blocks: it copies the
+// format pointer (the message ID) and its arguments into the calling
+// thread's preallocated ring. A background thread formats them into
+// e_output_files/diagnostics/log_<time>.txt, the UI log pane and, while
+// ncurses is not running, stderr.
+//
+// The format must be a string literal. Supported conversions are the
+// integer, floating point, %c, %s and %p families; %s arguments are copied,
+// up to LOG_STR_BYTES per message in total.
+
+#define LOG_MAX_ARGS 8
+#define LOG_STR_BYTES 128
+#define LOG_LINE_BYTES 256
+#define LOG_HISTORY 256 // formatted lines kept for the UI pane
+
+typedef enum { LOG_LEVEL_INFO, LOG_LEVEL_WARN, LOG_LEVEL_ERROR } LogLevel;
+
+void log_msg(LogLevel level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#define LOG_INFO(...) log_msg(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) log_msg(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) log_msg(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Host side
+void log_init(void);
+void log_shutdown(void); // final drain; safe to call more than once
+void log_set_echo(int on); // mirror to stderr (off while ncurses owns it)
+
+// Copies up to `max` lines, `skip` lines back from the newest, oldest first.
+// Returns the count; `total` receives the number of lines held.
+int log_get_lines(char (*out)[LOG_LINE_BYTES], LogLevel *levels, int max,
+                  int skip, int *total);
+
+#endif
@@ -7,8 +7,14 @@
 #include <string.h>
 
 #include "engine.h"
+#include "job.h"
+#include "logger.h"
 #include "midi.h"
 #include "osc.h"
+#include "perf.h"
+#include "retro.h"
+#include "rt.h"
+#include "trace.h"
 #include "ui.h"
 #include "util.h"
 
@@ -20,23 +26,71 @@ static int audio_callback(const void *input, void *output,
                           unsigned long framesPerBuffer,
                           const PaStreamCallbackTimeInfo *timeInfo,
                           PaStreamCallbackFlags statusFlags, void *userData) {
+    static int rt_configured = 0;
+    if (!rt_configured) {
+        rt_thread_setup(RT_THREAD_AUDIO);
+        trace_set_thread_name("audio");
+        rt_configured = 1;
+    }
+
+    uint64_t start_ns = perf_now_ns();
+    perf_block_begin();
+
     float *out = (float *)output;
     float *in = (float *)input;
     int allocated_input = 0;
 
+    // No input device: read from a silent block rather than allocating
+    static float silent_input[MAX_BLOCK_SIZE];
     if (in == NULL) {
-        in = calloc(framesPerBuffer, sizeof(float));
-        allocated_input = 1;
+        if (framesPerBuffer <= MAX_BLOCK_SIZE) {
+            in = silent_input;
+        } else {
+            in = calloc(framesPerBuffer, sizeof(float));
+            allocated_input = 1;
+        }
     }
 
     process_audio(in, out, framesPerBuffer);
 
     if (allocated_input)
         free(in);
+
+    perf_block_end(start_ns, framesPerBuffer, sample_rate,
+                   timeInfo ? timeInfo->currentTime : 0.0, statusFlags);
+    if (trace_on())
+        trace_complete("audio", "callback", start_ns, perf_now_ns());
     return paContinue;
 }
 
+static void report_perf(void) {
+    if (trace_on()) {
+        trace_stop();
+        fprintf(stderr, "[trace] written to %s\n", trace_last_path());
+    }
+
+    char path[256];
+    PerfStats s;
+    perf_get_stats(&s);
+    if (s.callbacks == 0)
+        return;
+    if (perf_dump_json(path, sizeof(path)) == 0)
+        fprintf(stderr, "[perf] %llu xruns, report written to %s\n",
+                (unsigned long long)s.xruns, path);
+}
+
+static volatile sig_atomic_t in_ui_loop = 0;
+static volatile sig_atomic_t quit_signals = 0;
+
+// Nothing here may lock or touch stdio buffers another thread could hold:
+// while the UI runs, SIGINT/SIGTERM only ask it to return, and main()
+// writes the trace and perf report on its normal shutdown path. A second
+// signal, or one outside the UI loop, exits at once.
 void handle_signal(int sig) {
+    if (sig != SIGSEGV && in_ui_loop && quit_signals++ == 0) {
+        ui_request_quit();
+        return;
+    }
     endwin(); // restore terminal if UI is active
     fprintf(stderr, "\n[main] Caught signal %d — clean exit.\n", sig);
     exit(1);
@@ -46,6 +100,35 @@ int main(int argc, char **argv) {
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
     signal(SIGSEGV, handle_signal);
+    log_init();
+
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--job") == 0)
+            return job_main(argc, argv);
+
+    // Pull out --rt/--retro/--trace; what remains is <patch.txt> [midi-device]
+    const char *rt_cli[16];
+    int rt_cli_count = 0;
+    const char *retro_cli[16];
+    int retro_cli_count = 0;
+    int start_trace = 0;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            start_trace = 1;
+        } else if (strcmp(argv[i], "--rt") == 0 && i + 1 < argc) {
+            if (rt_cli_count < 16)
+                rt_cli[rt_cli_count++] = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--retro") == 0 && i + 1 < argc) {
+            if (retro_cli_count < 16)
+                retro_cli[retro_cli_count++] = argv[i + 1];
+            i++;
+        } else {
+            argv[nargs++] = argv[i];
+        }
+    }
+    argc = nargs;
 
     Pa_Initialize();
     PaStream *stream;
@@ -71,7 +154,8 @@ int main(int argc, char **argv) {
         FILE *f = fopen(argv[1], "r");
         if (!f) {
             fprintf(stderr,
-                    "Usage: signalcrate <patch.txt> [midi-device]\n"
+                    "Usage: signalcrate [--rt settings] [--trace] "
+                    "<patch.txt> [midi-device]\n"
                     "[main] Failed to open patch file: %s\n",
                     argv[1]);
             Pa_Terminate();
@@ -125,6 +209,19 @@ int main(int argc, char **argv) {
         }
     }
 
+    // --- Real-time settings, before any thread is spawned ---
+    rt_config_from_patch(patch);
+    for (int i = 0; i < rt_cli_count; i++)
+        rt_config_parse(rt_cli[i]);
+    rt_init();
+    retro_config_from_patch(patch);
+    for (int i = 0; i < retro_cli_count; i++)
+        retro_config_parse(retro_cli[i]);
+
+    trace_set_thread_name("main/ui");
+    if (start_trace && trace_start() == 0)
+        fprintf(stderr, "[trace] recording to %s\n", trace_last_path());
+
     // --- Initialize engine ---
     initialize_engine(patch);
     free(patch);
@@ -197,6 +294,9 @@ int main(int argc, char **argv) {
     g_num_output_channels = outputParams.channelCount;
     fprintf(stderr, "[main] using %d output channels\n", g_num_output_channels);
 
+    // Allocated and touched here, after rt_init() has locked memory
+    retro_init(sample_rate);
+
     err = Pa_StartStream(stream);
     if (err != paNoError) {
         fprintf(stderr, "Failed to start stream: %s\n", Pa_GetErrorText(err));
@@ -210,17 +310,23 @@ int main(int argc, char **argv) {
         sample_rate = info->sampleRate;
         printf("Actual stream sample rate: %.2f Hz\n", sample_rate);
     }
+    rt_report();
 
     // --- Run UI (blocking) ---
+    in_ui_loop = 1;
     ui_loop();
+    in_ui_loop = 0;
 
     // --- Cleanup ---
     Pa_StopStream(stream);
     Pa_CloseStream(stream);
+    retro_shutdown();
+    report_perf();
     midi_stop();
     Pa_Terminate();
 
     shutdown_engine();
+    log_shutdown();
     printf("Clean exit.\n");
     return EXIT_SUCCESS;
 }
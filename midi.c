@@ -7,6 +7,9 @@
 
 #include <portmidi.h>
 
+#include "logger.h"
+#include "trace.h"
+
 static PmStream *g_in = NULL;
 static pthread_t g_thread;
 static int g_running = 0;
@@ -90,7 +93,7 @@ static void handle_event(PmEvent ev) {
     if (data1 < 0 || data1 > 127)
         return;
 
-    pthread_mutex_lock(&g_lock);
+    trace_mutex_lock(&g_lock, "midi cc");
     g_cc[data1] = data2;
 
     if (data1 < 32) {
@@ -107,6 +110,7 @@ static void handle_event(PmEvent ev) {
 static void *midi_thread_main(void *_) {
     (void)_;
     PmEvent buf[64];
+    trace_set_thread_name("midi");
 
     while (g_running) {
         if (!g_in) {
@@ -115,12 +119,14 @@ static void *midi_thread_main(void *_) {
         }
 
         if (Pm_Poll(g_in) == TRUE) {
+            TRACE_BEGIN(t0);
             int nread = Pm_Read(g_in, buf, 64);
             if (nread > 0) {
                 for (int i = 0; i < nread; i++)
                     handle_event(buf[i]);
+                TRACE_END(t0, "midi", "midi read");
             } else if (nread < 0) {
-                fprintf(stderr, "[midi] Pm_Read error: %d\n", nread);
+                LOG_ERROR("[midi] Pm_Read error: %d", nread);
                 usleep(5000);
             }
         } else {
@@ -208,7 +214,7 @@ void midi_stop(void) {
 int midi_cc_raw(int cc) {
     if (cc < 0 || cc > 127)
         return 0;
-    pthread_mutex_lock(&g_lock);
+    trace_mutex_lock(&g_lock, "midi cc");
     int v = g_cc[cc];
     pthread_mutex_unlock(&g_lock);
     if (v < 0)
@@ -223,7 +229,7 @@ float midi_cc_norm(int cc) { return (float)midi_cc_raw(cc) / 127.0f; }
 int midi_cc14_raw(int channel, int cc) {
     if (cc < 0 || cc > 31)
         return 0;
-    pthread_mutex_lock(&g_lock);
+    trace_mutex_lock(&g_lock, "midi cc");
     int v = (g_cc_msb[channel - 1][cc] << 7) | g_cc_lsb[channel - 1][cc];
     pthread_mutex_unlock(&g_lock);
     return v;
@@ -232,7 +238,7 @@ int midi_cc14_raw(int channel, int cc) {
 float midi_cc14_norm(int channel, int cc) {
     if (cc < 0 || cc > 31)
         return 0.0f;
-    pthread_mutex_lock(&g_lock);
+    trace_mutex_lock(&g_lock, "midi cc");
     int msb = g_cc_msb[channel - 1][cc];
     int lsb = g_cc_lsb[channel - 1][cc];
     pthread_mutex_unlock(&g_lock);
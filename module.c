@@ -17,6 +17,9 @@ void destroy_base_module(Module *m) {
     free(m->output_buffer);
     free(m->output_bufferL);
     free(m->output_bufferR);
+    for (int i = 0; i < m->num_outputs; i++)
+        free(m->outputs[i]);
+    free(m->outputs);
     free(m->control_output);
     free(m->state);
     free((void *)m->name);
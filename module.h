@@ -8,6 +8,7 @@
 typedef struct Module {
     const char *name; // Module name for aliases
     const char *type; // Module type
+    // input is read-only: it may be another module's output buffer
     void (*process)(struct Module *, float *input, unsigned long frames);
     void (*process_control)(struct Module *, unsigned long frames);
     void (*draw_ui)(struct Module *, int y, int x);
@@ -23,6 +24,10 @@ typedef struct Module {
     float *output_bufferL;
     float *output_bufferR;
     float *output_buffer;
+    // Modules with more outputs than these list them here, each its own
+    // MAX_BLOCK_SIZE buffer; patches name them alias.1 to alias.N
+    float **outputs;
+    int num_outputs;
 
     // Control routing
     float *control_inputs[MAX_CONTROL_INPUTS];
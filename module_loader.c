@@ -10,15 +10,20 @@
 #define MODULE_EXT "so"
 #endif
 
-Module *load_module(const char *name, float sample_rate, const char *args) {
+void *module_open(const char *name) {
     char path[256];
     snprintf(path, sizeof(path), "./modules/%s/%s.%s", name, name, MODULE_EXT);
 
     void *handle = dlopen(path, RTLD_NOW);
-    if (!handle) {
+    if (!handle)
         fprintf(stderr, "Failed to load module %s: %s\n", name, dlerror());
+    return handle;
+}
+
+Module *load_module(const char *name, float sample_rate, const char *args) {
+    void *handle = module_open(name);
+    if (!handle)
         return NULL;
-    }
 
     Module *(*create)(const char *, float) = dlsym(handle, "create_module");
     if (!create) {
@@ -4,5 +4,7 @@
 #include "module.h"
 
 Module *load_module(const char *name, float sample_rate, const char *args);
+// dlopen()s ./modules/<name>/<name>.<ext>; NULL (and a message) on failure
+void *module_open(const char *name);
 
 #endif
@@ -5,12 +5,11 @@
 #include <string.h>
 
 #include "ambi_decode.h"
+#include "dsp.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
-#ifndef M_PI
-#endif
-
 static inline void clamp_params(AmbiDecode *s) {
     clampf(&s->azimuth, 0.0f, 360.0f);
     clampf(&s->elevation, -90.0f, 90.0f);
@@ -18,19 +17,121 @@ static inline void clamp_params(AmbiDecode *s) {
     clampf(&s->width, 0.0f, 1.0f);
 }
 
+// Decode matrix for the current parameters. The stereo pair is a virtual
+// microphone per side,
+//     out = gain * (w + width * (x cos(azi) +/- y sin(azi) + z sin(elev)))
+// with the sign of y picking left or right. A layout gets the mode-matching
+// decoder for the turned listener, with width scaling every order above 0.
+static void build_matrix(AmbiDecode *s, float azimuth, float elevation,
+                         float gain, float width) {
+    float az_rad = azimuth * M_PI / 180.0f;
+    float el_rad = elevation * M_PI / 180.0f;
+
+    if (!s->layout) {
+        // AmbiX input order: W, Y, Z, X
+        float side = gain * width * sinf(az_rad);
+        float up = gain * width * sinf(el_rad);
+        float front = gain * width * cosf(az_rad);
+        const float rows[2][4] = {{gain, side, up, front},
+                                  {gain, -side, up, front}};
+        memcpy(s->matrix, rows, sizeof(rows));
+        return;
+    }
+
+    const int ch = AMBI_CHANNELS(s->order);
+    float scale[AMBI_MAX_CHANNELS];
+    ambi_decoder(s->matrix, s->order, s->speaker_azi, s->speaker_elev,
+                 s->speakers, az_rad, el_rad);
+    for (int c = 0; c < ch; c++) {
+        int n = (int)sqrtf((float)c);
+        scale[c] = gain * s->order_weight[n] * (n > 0 ? width : 1.0f);
+    }
+    for (int k = 0; k < s->speakers; k++)
+        for (int c = 0; c < ch; c++)
+            s->matrix[k * ch + c] *= scale[c];
+}
+
+// Adds the control inputs at frame i to the smoothed parameters
+static void apply_controls(Module *m, unsigned long i, float *azimuth,
+                           float *elevation, float *gain, float *width) {
+    for (int j = 0; j < m->num_control_inputs; j++) {
+        if (!m->control_inputs[j] || !m->control_input_params[j])
+            continue;
+
+        const char *param = m->control_input_params[j];
+        float control = m->control_inputs[j][i];
+        control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+        if (strcmp(param, "azi") == 0) {
+            *azimuth += control * 180.0f;
+        } else if (strcmp(param, "elev") == 0) {
+            *elevation += control * 90.0f;
+        } else if (strcmp(param, "gain") == 0) {
+            *gain += control;
+        } else if (strcmp(param, "width") == 0) {
+            *width += control * 0.5f;
+        }
+    }
+
+    clampf(azimuth, 0.0f, 360.0f);
+    clampf(elevation, -90.0f, 90.0f);
+    clampf(gain, 0.0f, 2.0f);
+    clampf(width, 0.0f, 1.0f);
+}
+
+static bool has_controls(const Module *m) {
+    for (int j = 0; j < m->num_control_inputs; j++)
+        if (m->control_inputs[j] && m->control_input_params[j])
+            return true;
+    return false;
+}
+
+// The stereo pair with CV patched: parameters follow the control inputs
+// every sample, so audio-rate modulation of azi works as it always has.
+// Leaves the last sample's values in the parameters, for the display.
+static void decode_stereo_cv(Module *m, float *const *inputs,
+                             unsigned long frames, float *azimuth,
+                             float *elevation, float *gain, float *width) {
+    const float azimuth_s = *azimuth, elevation_s = *elevation;
+    const float gain_s = *gain, width_s = *width;
+
+    for (unsigned long i = 0; i < frames; i++) {
+        *azimuth = azimuth_s;
+        *elevation = elevation_s;
+        *gain = gain_s;
+        *width = width_s;
+        apply_controls(m, i, azimuth, elevation, gain, width);
+
+        float az_rad = *azimuth * M_PI / 180.0f;
+        float el_rad = *elevation * M_PI / 180.0f;
+
+        // AmbiX input order: W, Y, Z, X
+        float w = inputs[0][i];
+        float y = inputs[1] ? inputs[1][i] : 0.0f;
+        float z = inputs[2] ? inputs[2][i] : 0.0f;
+        float x = inputs[3] ? inputs[3][i] : 0.0f;
+
+        float front = x * cosf(az_rad), side = y * sinf(az_rad);
+        float up = z * sinf(el_rad);
+        m->outputs[0][i] = (w + *width * (front + side + up)) * *gain;
+        m->outputs[1][i] = (w + *width * (front - side + up)) * *gain;
+    }
+}
+
 static void ambi_decode_process(Module *m, float *in, unsigned long frames) {
     (void)in;
     AmbiDecode *s = (AmbiDecode *)m->state;
-    float *out = m->output_buffer;
+    const int ch = AMBI_CHANNELS(s->order);
 
-    // AmbiX input order from e_ambi_a_to_b: W, Y, Z, X
-    float *w_ch = (m->num_inputs > 0) ? m->inputs[0] : NULL;
-    float *y_ch = (m->num_inputs > 1) ? m->inputs[1] : NULL;
-    float *z_ch = (m->num_inputs > 2) ? m->inputs[2] : NULL;
-    float *x_ch = (m->num_inputs > 3) ? m->inputs[3] : NULL;
+    // ACN order, as from e_ambi_a_to_b or ambi_encode: W, Y, Z, X, ...
+    float *inputs[AMBI_MAX_CHANNELS];
+    for (int c = 0; c < ch; c++)
+        inputs[c] = (c < m->num_inputs) ? m->inputs[c] : NULL;
 
-    if (!w_ch) {
-        memset(out, 0, frames * sizeof(float));
+    if (!inputs[0]) {
+        for (int k = 0; k < m->num_outputs; k++)
+            memset(m->outputs[k], 0, frames * sizeof(float));
+        memset(m->output_buffer, 0, frames * sizeof(float));
         return;
     }
 
@@ -42,78 +143,54 @@ static void ambi_decode_process(Module *m, float *in, unsigned long frames) {
     AmbiChannel channel = s->channel;
     pthread_mutex_unlock(&s->lock);
 
-    float azimuth_s = process_smoother(&s->smooth_azimuth, base_azimuth);
-    float elevation_s = process_smoother(&s->smooth_elevation, base_elevation);
-    float gain_s = process_smoother(&s->smooth_gain, base_gain);
-    float width_s = process_smoother(&s->smooth_width, base_width);
+    float azimuth = process_smoother(&s->smooth_azimuth, base_azimuth);
+    float elevation = process_smoother(&s->smooth_elevation, base_elevation);
+    float gain = process_smoother(&s->smooth_gain, base_gain);
+    float width = process_smoother(&s->smooth_width, base_width);
 
-    float disp_azimuth = azimuth_s;
-    float disp_elevation = elevation_s;
-    float disp_gain = gain_s;
-    float disp_width = width_s;
-
-    for (unsigned long i = 0; i < frames; i++) {
-        float azimuth = azimuth_s;
-        float elevation = elevation_s;
-        float gain = gain_s;
-        float width = width_s;
-
-        // Process control inputs
-        for (int j = 0; j < m->num_control_inputs; j++) {
-            if (!m->control_inputs[j] || !m->control_input_params[j])
-                continue;
-
-            const char *param = m->control_input_params[j];
-            float control = m->control_inputs[j][i];
-            control = fminf(fmaxf(control, -1.0f), 1.0f);
-
-            if (strcmp(param, "azi") == 0) {
-                azimuth += control * 180.0f;
-            } else if (strcmp(param, "elev") == 0) {
-                elevation += control * 90.0f;
-            } else if (strcmp(param, "gain") == 0) {
-                gain += control;
-            } else if (strcmp(param, "width") == 0) {
-                width += control * 0.5f;
-            }
+    if (!s->layout && has_controls(m)) {
+        decode_stereo_cv(m, inputs, frames, &azimuth, &elevation, &gain,
+                         &width);
+        s->built = false; // rebuilt without a ramp once CV is unpatched
+    } else {
+        // Any control inputs here feed a layout decoder: they move the
+        // matrix once per block, and the ramp keeps that from stepping.
+        // The engine has no connect hook, so the first block with CV is
+        // where that gets reported.
+        if (!s->cv_warned && has_controls(m)) {
+            LOG_WARN("[ambi_decode] %s: CV on a layout decoder is read once "
+                     "per block, not per sample",
+                     m->name);
+            s->cv_warned = true;
         }
-
-        clampf(&azimuth, 0.0f, 360.0f);
-        clampf(&elevation, -90.0f, 90.0f);
-        clampf(&gain, 0.0f, 2.0f);
-        clampf(&width, 0.0f, 1.0f);
-
-        disp_azimuth = azimuth;
-        disp_elevation = elevation;
-        disp_gain = gain;
-        disp_width = width;
-
-        // Convert to radians
-        float az_rad = azimuth * M_PI / 180.0f;
-        float el_rad = elevation * M_PI / 180.0f;
-
-        // Get input samples
-        float w = w_ch ? w_ch[i] : 0.0f;
-        float x = x_ch ? x_ch[i] : 0.0f;
-        float y = y_ch ? y_ch[i] : 0.0f;
-        float z = z_ch ? z_ch[i] : 0.0f;
-
-        float decoded;
-        if (channel == CHANNEL_LEFT) {
-            decoded = w + width * (x * cosf(az_rad) + y * sinf(az_rad) +
-                                   z * sinf(el_rad));
-        } else {
-            decoded = w + width * (x * cosf(az_rad) - y * sinf(az_rad) +
-                                   z * sinf(el_rad));
+        apply_controls(m, frames - 1, &azimuth, &elevation, &gain, &width);
+
+        bool ramp = false;
+        if (!s->built || azimuth != s->built_for[0] ||
+            elevation != s->built_for[1] || gain != s->built_for[2] ||
+            width != s->built_for[3]) {
+            memcpy(s->prev_matrix, s->matrix,
+                   (size_t)(s->speakers * ch) * sizeof(float));
+            build_matrix(s, azimuth, elevation, gain, width);
+            ramp = s->built;
+            s->built = true;
+            s->built_for[0] = azimuth;
+            s->built_for[1] = elevation;
+            s->built_for[2] = gain;
+            s->built_for[3] = width;
         }
-        out[i] = decoded * gain;
+
+        dsp_matrix(m->outputs, s->speakers, inputs, ch, s->matrix,
+                   ramp ? s->prev_matrix : NULL, frames);
     }
+    int main_out = (!s->layout && channel == CHANNEL_RIGHT) ? 1 : 0;
+    dsp_copy(m->output_buffer, m->outputs[main_out], frames);
 
     pthread_mutex_lock(&s->lock);
-    s->display_azimuth = disp_azimuth;
-    s->display_elevation = disp_elevation;
-    s->display_gain = disp_gain;
-    s->display_width = disp_width;
+    s->display_azimuth = azimuth;
+    s->display_elevation = elevation;
+    s->display_gain = gain;
+    s->display_width = width;
     pthread_mutex_unlock(&s->lock);
 }
 
@@ -129,8 +206,11 @@ static void ambi_decode_draw_ui(Module *m, int y, int x) {
     pthread_mutex_unlock(&s->lock);
 
     BLUE();
-    mvprintw(y, x, "[AmbiDecode%s:%s] ", (channel == CHANNEL_LEFT) ? "L" : "R",
-             m->name);
+    if (s->layout)
+        mvprintw(y, x, "[AmbiDecode:%s] ", m->name);
+    else
+        mvprintw(y, x, "[AmbiDecode%s:%s] ",
+                 (channel == CHANNEL_LEFT) ? "L" : "R", m->name);
     CLR();
 
     LABEL(2, "azi:");
@@ -153,6 +233,18 @@ static void ambi_decode_draw_ui(Module *m, int y, int x) {
     printw(" %.2f", width);
     CLR();
 
+    if (s->layout) {
+        LABEL(2, " order:");
+        ORANGE();
+        printw(" %d", s->order);
+        CLR();
+
+        LABEL(2, " spk:");
+        ORANGE();
+        printw(" %d", s->speakers);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x,
              "Real-time keys: -/= (azi), _/+ (elev), [/] (gain), ;/' (width)");
@@ -260,7 +352,7 @@ static void ambi_decode_set_osc_param(Module *m, const char *param,
     } else if (strcmp(param, "width") == 0) {
         s->width = value;
     } else {
-        fprintf(stderr, "[ambi_decode] Unknown OSC param: %s\n", param);
+        LOG_WARN("[ambi_decode] Unknown OSC param: %s", param);
     }
 
     clamp_params(s);
@@ -280,6 +372,10 @@ Module *create_module(const char *args, float sample_rate) {
     float gain = 1.0f;
     float width = 1.0f;
     AmbiChannel channel = CHANNEL_LEFT; // Default to left
+    int target_channel = 0;
+    char layout[256] = "";
+    int order = 1;
+    char weights[16] = "maxre";
 
     if (args && strstr(args, "azi=")) {
         sscanf(strstr(args, "azi="), "azi=%f", &azimuth);
@@ -299,8 +395,19 @@ Module *create_module(const char *args, float sample_rate) {
             channel = CHANNEL_LEFT;
         } else if (strncmp(ch_str, "right", 5) == 0) {
             channel = CHANNEL_RIGHT;
+        } else {
+            sscanf(ch_str, "%d", &target_channel);
         }
     }
+    if (args && strstr(args, "layout=")) {
+        sscanf(strstr(args, "layout="), "layout=%255[^, ]", layout);
+    }
+    if (args && strstr(args, "order=")) {
+        sscanf(strstr(args, "order="), "order=%d", &order);
+    }
+    if (args && strstr(args, "weights=")) {
+        sscanf(strstr(args, "weights="), "weights=%15[^, ]", weights);
+    }
 
     AmbiDecode *s = calloc(1, sizeof(AmbiDecode));
     s->azimuth = azimuth;
@@ -309,6 +416,39 @@ Module *create_module(const char *args, float sample_rate) {
     s->width = width;
     s->channel = channel;
     s->sample_rate = sample_rate;
+    s->target_channel = target_channel > 0 ? target_channel : 0;
+
+    // Without a layout (or with one that can't be read) this is the
+    // first-order stereo pair
+    s->order = 1;
+    s->speakers = 2;
+    if (layout[0]) {
+        int n = ambi_load_layout(layout, s->speaker_azi, s->speaker_elev,
+                                 AMBI_MAX_SPEAKERS);
+        if (n < 1) {
+            LOG_ERROR("[ambi_decode] No speakers in layout '%s', decoding "
+                      "to stereo",
+                      layout);
+        } else {
+            clampi(&order, 1, AMBI_MAX_ORDER);
+            s->layout = true;
+            s->order = order;
+            s->speakers = n;
+            if (n < AMBI_CHANNELS(order))
+                LOG_WARN("[ambi_decode] Order %d wants %d or more speakers, "
+                         "'%s' has %d",
+                         order, AMBI_CHANNELS(order), layout, n);
+        }
+    }
+    if (strcmp(weights, "basic") == 0) {
+        for (int n = 0; n <= AMBI_MAX_ORDER; n++)
+            s->order_weight[n] = 1.0f;
+    } else {
+        if (strcmp(weights, "maxre") != 0)
+            LOG_WARN("[ambi_decode] Unknown weights '%s', using maxre",
+                     weights);
+        ambi_max_re(s->order, s->order_weight);
+    }
 
     pthread_mutex_init(&s->lock, NULL);
     init_smoother(&s->smooth_azimuth, 0.75f);
@@ -327,6 +467,10 @@ Module *create_module(const char *args, float sample_rate) {
     m->state = s;
 
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->num_outputs = s->speakers;
+    m->outputs = calloc(s->speakers, sizeof(float *));
+    for (int k = 0; k < s->speakers; k++)
+        m->outputs[k] = calloc(MAX_BLOCK_SIZE, sizeof(float));
     m->process = ambi_decode_process;
     m->draw_ui = ambi_decode_draw_ui;
     m->handle_input = ambi_decode_handle_input;
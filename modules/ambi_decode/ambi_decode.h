@@ -1,6 +1,7 @@
 #ifndef AMBI_DECODE_H
 #define AMBI_DECODE_H
 
+#include "ambi.h"
 #include "util.h"
 #include <pthread.h>
 #include <stdbool.h>
@@ -16,9 +17,27 @@ typedef struct {
     float gain;      // Output gain
     float width;     // Stereo width (0=mono, 1=full width)
 
-    // Channel selection
+    // Channel selection, without a layout: the feed on the main output
     AmbiChannel channel;
 
+    // Speaker layout. Without one the decoder is the first-order stereo
+    // pair (speakers == 2, order 1).
+    bool layout;
+    int order; // AMBI_CHANNELS(order) inputs, ACN/SN3D
+    int speakers;
+    float speaker_azi[AMBI_MAX_SPEAKERS]; // radians
+    float speaker_elev[AMBI_MAX_SPEAKERS];
+    float order_weight[AMBI_MAX_ORDER + 1]; // max-rE, or flat
+    int target_channel; // device channel of the first feed, 0 for none
+
+    // Decode matrix [speaker][channel], rebuilt only when a parameter
+    // moves; the old one is kept for the ramp across the block
+    float matrix[AMBI_MAX_SPEAKERS * AMBI_MAX_CHANNELS];
+    float prev_matrix[AMBI_MAX_SPEAKERS * AMBI_MAX_CHANNELS];
+    float built_for[4]; // azimuth, elevation, gain, width
+    bool built;
+    bool cv_warned; // CV on a layout decoder is reported once
+
     // Display parameters
     float display_azimuth;
     float display_elevation;
@@ -0,0 +1,281 @@
+#include <math.h>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ambi_encode.h"
+#include "dsp.h"
+#include "logger.h"
+#include "module.h"
+#include "util.h"
+
+static inline void clamp_params(AmbiEncode *s) {
+    clampf(&s->azimuth, 0.0f, 360.0f);
+    clampf(&s->elevation, -90.0f, 90.0f);
+    clampf(&s->gain, 0.0f, 1.0f);
+}
+
+static void ambi_encode_process(Module *m, float *in, unsigned long frames) {
+    AmbiEncode *s = (AmbiEncode *)m->state;
+    float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
+    const int ch = AMBI_CHANNELS(s->order);
+
+    pthread_mutex_lock(&s->lock);
+    float base_azimuth = s->azimuth;
+    float base_elevation = s->elevation;
+    float base_gain = s->gain;
+    pthread_mutex_unlock(&s->lock);
+
+    float azimuth = process_smoother(&s->smooth_azimuth, base_azimuth);
+    float elevation = process_smoother(&s->smooth_elevation, base_elevation);
+    float gain = process_smoother(&s->smooth_gain, base_gain);
+
+    // Control inputs move the gains once per block; the ramp across the
+    // block keeps that from stepping
+    for (int j = 0; j < m->num_control_inputs; j++) {
+        if (!m->control_inputs[j] || !m->control_input_params[j])
+            continue;
+
+        const char *param = m->control_input_params[j];
+        float control = m->control_inputs[j][frames - 1];
+        control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+        if (strcmp(param, "azi") == 0) {
+            azimuth += control * 180.0f;
+        } else if (strcmp(param, "elev") == 0) {
+            elevation += control * 90.0f;
+        } else if (strcmp(param, "gain") == 0) {
+            gain += control;
+        }
+    }
+
+    // Azimuth wraps so CV can sweep a full circle
+    azimuth = fmodf(azimuth, 360.0f);
+    if (azimuth < 0.0f)
+        azimuth += 360.0f;
+    clampf(&elevation, -90.0f, 90.0f);
+    clampf(&gain, 0.0f, 2.0f);
+
+    bool ramp = false;
+    if (!s->built || azimuth != s->built_for[0] ||
+        elevation != s->built_for[1] || gain != s->built_for[2]) {
+        memcpy(s->prev_gains, s->gains, sizeof(s->gains));
+        ambi_sh(s->order, azimuth * M_PI / 180.0f, elevation * M_PI / 180.0f,
+                s->gains);
+        for (int c = 0; c < ch; c++)
+            s->gains[c] *= gain;
+        ramp = s->built;
+        s->built = true;
+        s->built_for[0] = azimuth;
+        s->built_for[1] = elevation;
+        s->built_for[2] = gain;
+    }
+
+    // A one-column matrix: every output is the input times its gain
+    dsp_matrix(m->outputs, ch, &input, 1, s->gains,
+               ramp ? s->prev_gains : NULL, frames);
+    dsp_copy(m->output_buffer, m->outputs[0], frames);
+
+    pthread_mutex_lock(&s->lock);
+    s->display_azimuth = azimuth;
+    s->display_elevation = elevation;
+    s->display_gain = gain;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void ambi_encode_draw_ui(Module *m, int y, int x) {
+    AmbiEncode *s = (AmbiEncode *)m->state;
+
+    pthread_mutex_lock(&s->lock);
+    float azimuth = s->display_azimuth;
+    float elevation = s->display_elevation;
+    float gain = s->display_gain;
+    pthread_mutex_unlock(&s->lock);
+
+    BLUE();
+    mvprintw(y, x, "[AmbiEncode:%s] ", m->name);
+    CLR();
+
+    LABEL(2, "azi:");
+    ORANGE();
+    printw(" %d", (int)azimuth);
+    CLR();
+
+    LABEL(2, " elev:");
+    ORANGE();
+    printw(" %d", (int)elevation);
+    CLR();
+
+    LABEL(2, " gain:");
+    ORANGE();
+    printw(" %.2f", gain);
+    CLR();
+
+    LABEL(2, " order:");
+    ORANGE();
+    printw(" %d", s->order);
+    CLR();
+
+    YELLOW();
+    mvprintw(y + 1, x, "Real-time keys: -/= (azi), _/+ (elev), [/] (gain)");
+    mvprintw(y + 2, x,
+             "Command mode: :1 [azimuth], :2 [elevation], :3 [gain]");
+    BLACK();
+}
+
+static void ambi_encode_handle_input(Module *m, int key) {
+    AmbiEncode *s = (AmbiEncode *)m->state;
+    int handled = 0;
+
+    pthread_mutex_lock(&s->lock);
+
+    if (!s->entering_command) {
+        switch (key) {
+        case '-':
+            s->azimuth -= 1.0f;
+            handled = 1;
+            break;
+        case '=':
+            s->azimuth += 1.0f;
+            handled = 1;
+            break;
+        case '_':
+            s->elevation -= 1.0f;
+            handled = 1;
+            break;
+        case '+':
+            s->elevation += 1.0f;
+            handled = 1;
+            break;
+        case '[':
+            s->gain -= 0.01f;
+            handled = 1;
+            break;
+        case ']':
+            s->gain += 0.01f;
+            handled = 1;
+            break;
+        case ':':
+            s->entering_command = true;
+            memset(s->command_buffer, 0, sizeof(s->command_buffer));
+            s->command_index = 0;
+            handled = 1;
+            break;
+        }
+    } else {
+        if (key == '\n') {
+            s->entering_command = false;
+            char type;
+            float val;
+            if (sscanf(s->command_buffer, "%c %f", &type, &val) == 2) {
+                if (type == '1')
+                    s->azimuth = val;
+                else if (type == '2')
+                    s->elevation = val;
+                else if (type == '3')
+                    s->gain = val;
+            }
+            handled = 1;
+        } else if (key == 27) {
+            s->entering_command = false;
+            handled = 1;
+        } else if ((key == KEY_BACKSPACE || key == 127) &&
+                   s->command_index > 0) {
+            s->command_index--;
+            s->command_buffer[s->command_index] = '\0';
+            handled = 1;
+        } else if (key >= 32 && key < 127 &&
+                   s->command_index < (int)sizeof(s->command_buffer) - 1) {
+            s->command_buffer[s->command_index++] = (char)key;
+            s->command_buffer[s->command_index] = '\0';
+            handled = 1;
+        }
+    }
+
+    if (handled)
+        clamp_params(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void ambi_encode_set_osc_param(Module *m, const char *param,
+                                      float value) {
+    AmbiEncode *s = (AmbiEncode *)m->state;
+    pthread_mutex_lock(&s->lock);
+
+    if (strcmp(param, "azi") == 0) {
+        s->azimuth = value * 360.0f;
+    } else if (strcmp(param, "elev") == 0) {
+        s->elevation = (value - 0.5f) * 180.0f;
+    } else if (strcmp(param, "gain") == 0) {
+        s->gain = value;
+    } else {
+        LOG_WARN("[ambi_encode] Unknown OSC param: %s", param);
+    }
+
+    clamp_params(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void ambi_encode_destroy(Module *m) {
+    AmbiEncode *s = (AmbiEncode *)m->state;
+    if (s)
+        pthread_mutex_destroy(&s->lock);
+    destroy_base_module(m);
+}
+
+Module *create_module(const char *args, float sample_rate) {
+    float azimuth = 0.0f;
+    float elevation = 0.0f;
+    float gain = 1.0f;
+    int order = 1;
+
+    if (args && strstr(args, "azi=")) {
+        sscanf(strstr(args, "azi="), "azi=%f", &azimuth);
+    }
+    if (args && strstr(args, "elev=")) {
+        sscanf(strstr(args, "elev="), "elev=%f", &elevation);
+    }
+    if (args && strstr(args, "gain=")) {
+        sscanf(strstr(args, "gain="), "gain=%f", &gain);
+    }
+    if (args && strstr(args, "order=")) {
+        sscanf(strstr(args, "order="), "order=%d", &order);
+    }
+    clampi(&order, 1, AMBI_MAX_ORDER);
+
+    AmbiEncode *s = calloc(1, sizeof(AmbiEncode));
+    s->azimuth = azimuth;
+    s->elevation = elevation;
+    s->gain = gain;
+    s->order = order;
+    s->sample_rate = sample_rate;
+
+    pthread_mutex_init(&s->lock, NULL);
+    init_smoother(&s->smooth_azimuth, 0.75f);
+    init_smoother(&s->smooth_elevation, 0.75f);
+    init_smoother(&s->smooth_gain, 0.75f);
+    clamp_params(s);
+
+    s->display_azimuth = s->azimuth;
+    s->display_elevation = s->elevation;
+    s->display_gain = s->gain;
+
+    // One output per channel in ACN order; the main output is W
+    Module *m = calloc(1, sizeof(Module));
+    m->name = "ambi_encode";
+    m->state = s;
+
+    m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->num_outputs = AMBI_CHANNELS(order);
+    m->outputs = calloc(m->num_outputs, sizeof(float *));
+    for (int c = 0; c < m->num_outputs; c++)
+        m->outputs[c] = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->process = ambi_encode_process;
+    m->draw_ui = ambi_encode_draw_ui;
+    m->handle_input = ambi_encode_handle_input;
+    m->set_param = ambi_encode_set_osc_param;
+    m->destroy = ambi_encode_destroy;
+
+    return m;
+}
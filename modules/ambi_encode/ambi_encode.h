@@ -0,0 +1,40 @@
+#ifndef AMBI_ENCODE_H
+#define AMBI_ENCODE_H
+
+#include "ambi.h"
+#include "util.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef struct {
+    float sample_rate;
+
+    float azimuth;   // Source direction in degrees (0-360)
+    float elevation; // Degrees (-90 to +90)
+    float gain;
+
+    int order; // AMBI_CHANNELS(order) outputs, ACN/SN3D
+
+    // Encoding gains, one per output, rebuilt only when the direction or
+    // gain moves; the old set is kept for the ramp across the block
+    float gains[AMBI_MAX_CHANNELS];
+    float prev_gains[AMBI_MAX_CHANNELS];
+    float built_for[3]; // azimuth, elevation, gain
+    bool built;
+
+    float display_azimuth;
+    float display_elevation;
+    float display_gain;
+
+    CParamSmooth smooth_azimuth;
+    CParamSmooth smooth_elevation;
+    CParamSmooth smooth_gain;
+
+    bool entering_command;
+    char command_buffer[64];
+    int command_index;
+
+    pthread_mutex_t lock;
+} AmbiEncode;
+
+#endif
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "amp_mod.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -15,8 +16,9 @@ static void ampmod_process(Module *m, float *in, unsigned long frames) {
     float *out = m->output_buffer;
 
     if (!in_car || !in_mod) {
-        if (!in_mod) {
-            printf("[amp_mod] WARNING: missing 2nd audio input\n");
+        if (!in_mod && !state->warned_no_mod) {
+            LOG_WARN("[amp_mod] missing 2nd audio input");
+            state->warned_no_mod = 1;
         }
         memset(out, 0, frames * sizeof(float));
         return;
@@ -214,7 +216,7 @@ static void amp_mod_set_osc_param(Module *m, const char *param, float value) {
     else if (strcmp(param, "depth") == 0)
         state->depth = fminf(fmaxf(value, 0.0f), 1.0f);
     else
-        fprintf(stderr, "[amp_mod] Unknown OSC param: %s\n", param);
+        LOG_WARN("[amp_mod] Unknown OSC param: %s", param);
 
     clamp_params(state);
     pthread_mutex_unlock(&state->lock);
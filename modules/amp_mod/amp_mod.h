@@ -19,6 +19,7 @@ typedef struct {
     CParamSmooth smooth_depth;
 
     pthread_mutex_t lock;
+    int warned_no_mod; // logged once, not every block
 
     // For UI display
     float display_car_amp;
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "bit_crush.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -27,6 +28,9 @@ static void bit_crush_process(Module *m, float *in, unsigned long frames) {
     float phs = s->phase;
     float held = s->last_sample;
 
+    const int factor = s->os.factor;
+    os_up(&s->os, input, s->up, frames);
+
     for (unsigned long i = 0; i < frames; i++) {
         float bits = bits_s;
         float rate = rate_s;
@@ -52,21 +56,24 @@ static void bit_crush_process(Module *m, float *in, unsigned long frames) {
         disp_bits = bits;
         disp_rate = rate;
 
-        float step = rate / s->sample_rate;
+        float step = rate / (s->sample_rate * factor);
         if (step <= 0.0f)
             step = 1.0f;
 
         float bits_q = roundf(bits);
         float bit_levels = powf(2.0f, bits_q) - 1.0f;
 
-        phs += step;
-        if (phs >= 1.0f) {
-            phs -= 1.0f;
-            float inp = input ? input[i] : 0.0f;
-            held = roundf(inp * bit_levels) / bit_levels;
+        float *x = s->up + i * factor;
+        for (int n = 0; n < factor; n++) {
+            phs += step;
+            if (phs >= 1.0f) {
+                phs -= 1.0f;
+                held = roundf(x[n] * bit_levels) / bit_levels;
+            }
+            x[n] = held;
         }
-        out[i] = held;
     }
+    os_down(&s->os, s->up, out, frames);
 
     pthread_mutex_lock(&s->lock);
     s->phase = phs;
@@ -97,6 +104,14 @@ static void bit_crush_draw_ui(Module *m, int y, int x) {
     printw(" %.1f Hz", rate);
     CLR();
 
+    if (s->os.factor > 1) {
+        printw(" | ");
+        LABEL(2, "os:");
+        ORANGE();
+        printw(" %dx", s->os.factor);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x, "Keys: -/= bits, _/+ rate");
     mvprintw(y + 2, x, "Command: :1 [bits], :2 [rate]");
@@ -196,7 +211,7 @@ static void bit_crush_set_osc_param(Module *m, const char *param, float value) {
         s->bits = min_bits + (max_bits - min_bits) * norm;
 
     } else {
-        fprintf(stderr, "[bit_crush] Unknown OSC param: %s\n", param);
+        LOG_WARN("[bit_crush] Unknown OSC param: %s", param);
     }
 
     pthread_mutex_unlock(&s->lock);
@@ -224,6 +239,7 @@ Module *create_module(const char *args, float sample_rate) {
     s->phase = 0.0f;
     s->last_sample = 0.0f;
     s->sample_rate = sample_rate;
+    os_init(&s->os, os_factor_from_args(args));
 
     pthread_mutex_init(&s->lock, NULL);
     init_smoother(&s->smooth_bits, 0.75f);
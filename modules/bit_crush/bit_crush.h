@@ -1,6 +1,7 @@
 #ifndef BIT_CRUSH_H
 #define BIT_CRUSH_H
 
+#include "oversample.h"
 #include "util.h"
 #include <pthread.h>
 #include <stdbool.h>
@@ -15,6 +16,11 @@ typedef struct {
     float phase;
     float sample_rate;
 
+    // Hold and quantize run at os.factor times the rate, over `up`, so
+    // the hold edges land on a finer grid
+    Oversampler os;
+    float up[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+
     CParamSmooth smooth_bits;
     CParamSmooth smooth_rate;
 
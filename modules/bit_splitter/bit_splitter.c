@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "bit_splitter.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -151,7 +152,7 @@ static void bit_splitter_set_osc_param(Module *m, const char *param, float value
     } else if (strcmp(param, "bit") == 0) {
         s->bit = (int)fminf(fmaxf(value * 7.0f, 0.0f), 7.0f);
     } else {
-        fprintf(stderr, "[bit_splitter] Unknown OSC param: %s\n", param);
+        LOG_WARN("[bit_splitter] Unknown OSC param: %s", param);
     }
 
     clamp_params(s);
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "c_cv_monitor.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -186,7 +187,7 @@ static void cv_monitor_set_osc_param(Module *m, const char *param,
     else if (strcmp(param, "offset") == 0)
         s->offset = fminf(fmaxf(value, -1.0f), 1.0f);
     else
-        fprintf(stderr, "[c_cv_monitor] Unknown param: %s\n", param);
+        LOG_WARN("[c_cv_monitor] Unknown param: %s", param);
     clamp_params(s);
     pthread_mutex_unlock(&s->lock);
 }
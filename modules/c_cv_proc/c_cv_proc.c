@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "c_cv_proc.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -217,7 +218,7 @@ static void c_cv_proc_set_osc_param(Module *m, const char *param, float value) {
         float mapped = (value * 2.0f) - 1.0f;
         s->offset = fminf(fmaxf(mapped, -1.0f), 1.0f); // Output bias
     } else {
-        fprintf(stderr, "[c_cv_proc] Unknown OSC param: %s\n", param);
+        LOG_WARN("[c_cv_proc] Unknown OSC param: %s", param);
     }
     clamp_params(s);
     pthread_mutex_unlock(&s->lock);
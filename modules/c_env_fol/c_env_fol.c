@@ -5,13 +5,14 @@
 #include <string.h>
 
 #include "c_env_fol.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
 static void c_env_fol_process_control(Module *m, unsigned long frames) {
     if (!m->inputs[0]) {
         endwin();
-        fprintf(stderr, "[c_env_fol] Error: No audio input connected.\n");
+        LOG_ERROR("[c_env_fol] Error: No audio input connected.");
         exit(1);
     }
 
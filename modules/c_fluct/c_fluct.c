@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "c_fluct.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -230,7 +231,7 @@ Module *create_module(const char *args, float sample_rate) {
         else if (strcmp(mode_str, "walk") == 0)
             mode = FLUCT_WALK;
         else
-            fprintf(stderr, "[c_fluct] Unknown mode type: '%s'\n", mode_str);
+            LOG_WARN("[c_fluct] Unknown mode type: '%s'", mode_str);
     }
 
     CFluct *s = calloc(1, sizeof(CFluct));
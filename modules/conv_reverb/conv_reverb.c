@@ -0,0 +1,703 @@
+#include <fftw3.h>
+#include <math.h>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "conv_reverb.h"
+#include "logger.h"
+#include "module.h"
+#include "rt.h"
+#include "sample_pool.h"
+#include "util.h"
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4f_u __attribute__((vector_size(16), aligned(4)));
+
+#define CONV_IDLE_WAIT_MS 5
+
+// Partition layout. Each stage starts where the last one ends; a stage of
+// block P run in the callback can start at P, one on a helper thread at 2P
+// so the helper has a whole block to deliver. Everything past the head
+// therefore lines up with no latency.
+static const struct {
+    int part;
+    int offset;
+    bool threaded;
+} conv_layout[] = {
+    {64, CONV_HEAD, false}, // to 2048
+    {1024, 2048, true},     // to 16384
+    {8192, 16384, true},    // the rest
+};
+#define CONV_LAYOUT_STAGES \
+    ((int)(sizeof(conv_layout) / sizeof(conv_layout[0])))
+
+// --- Stages ---
+
+// acc += x * h over one partition, split complex
+static void cmac(float *acc_re, float *acc_im, const float *x_re,
+                 const float *x_im, const float *h_re, const float *h_im,
+                 int stride) {
+    for (int k = 0; k < stride; k += 4) {
+        v4f xr = *(const v4f *)(x_re + k);
+        v4f xi = *(const v4f *)(x_im + k);
+        v4f hr = *(const v4f *)(h_re + k);
+        v4f hi = *(const v4f *)(h_im + k);
+        *(v4f *)(acc_re + k) += xr * hr - xi * hi;
+        *(v4f *)(acc_im + k) += xr * hi + xi * hr;
+    }
+}
+
+// Transforms input block `blk`, pushes it onto the delay line and writes
+// the stage's output block for it. Runs in the callback or on the helper.
+static void stage_run_block(ConvStage *st, int64_t blk) {
+    const int p = st->part;
+    const float *in = st->in_ring + (blk % CONV_RING) * p;
+
+    memcpy(st->time, st->prev, p * sizeof(float));
+    memcpy(st->time + p, in, p * sizeof(float));
+    memcpy(st->prev, in, p * sizeof(float));
+    fftwf_execute(st->fwd);
+
+    st->fdl_pos = st->fdl_pos ? st->fdl_pos - 1 : st->count - 1;
+    float *xr = st->x_re + st->fdl_pos * st->stride;
+    float *xi = st->x_im + st->fdl_pos * st->stride;
+    for (int k = 0; k < st->bins; k++) {
+        xr[k] = st->spec[k][0];
+        xi[k] = st->spec[k][1];
+    }
+
+    for (int c = 0; c < st->channels; c++) {
+        memset(st->acc_re, 0, st->stride * sizeof(float));
+        memset(st->acc_im, 0, st->stride * sizeof(float));
+        // Partition j meets the input from j blocks ago
+        int slot = st->fdl_pos;
+        for (int j = 0; j < st->count; j++) {
+            size_t x_off = (size_t)slot * st->stride;
+            size_t h_off = (size_t)j * st->stride;
+            cmac(st->acc_re, st->acc_im, st->x_re + x_off, st->x_im + x_off,
+                 st->h_re[c] + h_off, st->h_im[c] + h_off, st->stride);
+            if (++slot == st->count)
+                slot = 0;
+        }
+        for (int k = 0; k < st->bins; k++) {
+            st->spec[k][0] = st->acc_re[k];
+            st->spec[k][1] = st->acc_im[k];
+        }
+        fftwf_execute(st->inv);
+        // Overlap-save: the second half is the block's output
+        memcpy(st->out_ring[c] + (blk % CONV_RING) * p, st->time + p,
+               p * sizeof(float));
+    }
+}
+
+static void *stage_main(void *arg) {
+    ConvStage *st = arg;
+    rt_thread_setup(RT_THREAD_WORKER);
+
+    for (;;) {
+        pthread_mutex_lock(&st->lock);
+        while (!__atomic_load_n(&st->stop, __ATOMIC_ACQUIRE) &&
+               __atomic_load_n(&st->posted, __ATOMIC_ACQUIRE) == st->done) {
+            // The audio thread only signals when it gets the lock without
+            // waiting, so a missed wakeup costs at most this long
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += CONV_IDLE_WAIT_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&st->cond, &st->lock, &until);
+        }
+        pthread_mutex_unlock(&st->lock);
+        if (__atomic_load_n(&st->stop, __ATOMIC_ACQUIRE))
+            break;
+
+        int64_t posted = __atomic_load_n(&st->posted, __ATOMIC_ACQUIRE);
+        int64_t blk = st->done;
+        // So far behind that the ring has wrapped: those blocks are gone,
+        // and the tail stays smeared until the delay line refills
+        if (posted - blk > CONV_RING - 1)
+            blk = posted - 1;
+        stage_run_block(st, blk);
+        __atomic_store_n(&st->done, blk + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// Block boundary on the audio thread: hand over the input block just
+// filled and move the read head to the next output block
+static void stage_boundary(ConvStage *st) {
+    st->pos = 0;
+    if (!st->threaded) {
+        stage_run_block(st, st->posted);
+        st->posted++;
+        st->done = st->posted;
+    } else {
+        __atomic_store_n(&st->posted, st->posted + 1, __ATOMIC_RELEASE);
+        if (pthread_mutex_trylock(&st->lock) == 0) {
+            pthread_cond_signal(&st->cond);
+            pthread_mutex_unlock(&st->lock);
+        }
+    }
+
+    st->read++;
+    if (st->read >= 0) {
+        st->missing =
+            __atomic_load_n(&st->done, __ATOMIC_ACQUIRE) <= st->read;
+        if (st->missing)
+            __atomic_fetch_add(&st->late, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static int stage_init(ConvStage *st, int part, int offset, int count,
+                      bool threaded, const float *const *ir, int channels,
+                      int ir_frames) {
+    const int n = 2 * part;
+    st->part = part;
+    st->offset = offset;
+    st->count = count;
+    st->bins = part + 1;
+    st->stride = (st->bins + 3) & ~3;
+    st->channels = channels;
+    st->threaded = threaded;
+    st->read = -(offset / part);
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->cond, NULL);
+
+    size_t fdl = (size_t)count * st->stride;
+    st->x_re = fftwf_alloc_real(fdl);
+    st->x_im = fftwf_alloc_real(fdl);
+    st->prev = fftwf_alloc_real(part);
+    st->time = fftwf_alloc_real(n);
+    st->spec = fftwf_alloc_complex(st->bins);
+    st->acc_re = fftwf_alloc_real(st->stride);
+    st->acc_im = fftwf_alloc_real(st->stride);
+    st->in_ring = fftwf_alloc_real((size_t)CONV_RING * part);
+    if (!st->x_re || !st->x_im || !st->prev || !st->time || !st->spec ||
+        !st->acc_re || !st->acc_im || !st->in_ring)
+        return -1;
+    for (int c = 0; c < channels; c++) {
+        st->h_re[c] = fftwf_alloc_real(fdl);
+        st->h_im[c] = fftwf_alloc_real(fdl);
+        st->out_ring[c] = fftwf_alloc_real((size_t)CONV_RING * part);
+        if (!st->h_re[c] || !st->h_im[c] || !st->out_ring[c])
+            return -1;
+        memset(st->out_ring[c], 0, (size_t)CONV_RING * part * sizeof(float));
+    }
+    // Touch everything now rather than on the audio thread
+    memset(st->x_re, 0, fdl * sizeof(float));
+    memset(st->x_im, 0, fdl * sizeof(float));
+    memset(st->prev, 0, part * sizeof(float));
+    memset(st->acc_re, 0, st->stride * sizeof(float));
+    memset(st->acc_im, 0, st->stride * sizeof(float));
+    memset(st->in_ring, 0, (size_t)CONV_RING * part * sizeof(float));
+
+    st->fwd = fftwf_plan_dft_r2c_1d(n, st->time, st->spec, FFTW_ESTIMATE);
+    st->inv = fftwf_plan_dft_c2r_1d(n, st->spec, st->time, FFTW_ESTIMATE);
+
+    // Partition spectra, with the inverse transform's 1/n folded in
+    const float scale = 1.0f / n;
+    for (int c = 0; c < channels; c++) {
+        for (int j = 0; j < count; j++) {
+            int start = offset + j * part;
+            memset(st->time, 0, n * sizeof(float));
+            for (int i = 0; i < part && start + i < ir_frames; i++)
+                st->time[i] = ir[c][start + i] * scale;
+            fftwf_execute(st->fwd);
+            float *hr = st->h_re[c] + (size_t)j * st->stride;
+            float *hi = st->h_im[c] + (size_t)j * st->stride;
+            for (int k = 0; k < st->stride; k++) {
+                hr[k] = k < st->bins ? st->spec[k][0] : 0.0f;
+                hi[k] = k < st->bins ? st->spec[k][1] : 0.0f;
+            }
+        }
+    }
+
+    if (threaded) {
+        st->thread_started =
+            pthread_create(&st->thread, NULL, stage_main, st) == 0;
+        if (!st->thread_started) {
+            LOG_WARN("[conv_reverb] no helper thread, running %d-sample "
+                     "partitions in the callback",
+                     part);
+            st->threaded = false;
+        }
+    }
+    return 0;
+}
+
+static void stage_free(ConvStage *st) {
+    if (st->thread_started) {
+        __atomic_store_n(&st->stop, 1, __ATOMIC_RELEASE);
+        pthread_mutex_lock(&st->lock);
+        pthread_cond_signal(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        pthread_join(st->thread, NULL);
+    }
+    if (st->part) {
+        pthread_mutex_destroy(&st->lock);
+        pthread_cond_destroy(&st->cond);
+    }
+    if (st->fwd)
+        fftwf_destroy_plan(st->fwd);
+    if (st->inv)
+        fftwf_destroy_plan(st->inv);
+    for (int c = 0; c < CONV_MAX_CHANNELS; c++) {
+        fftwf_free(st->h_re[c]);
+        fftwf_free(st->h_im[c]);
+        fftwf_free(st->out_ring[c]);
+    }
+    fftwf_free(st->x_re);
+    fftwf_free(st->x_im);
+    fftwf_free(st->prev);
+    fftwf_free(st->time);
+    fftwf_free(st->spec);
+    fftwf_free(st->acc_re);
+    fftwf_free(st->acc_im);
+    fftwf_free(st->in_ring);
+}
+
+// --- Convolution ---
+
+// Direct-form head over the block in head_hist, which holds the previous
+// CONV_HEAD - 1 inputs followed by this block's
+static void head_process(ConvReverb *s, unsigned long frames) {
+    for (int c = 0; c < s->channels; c++) {
+        const float *h = s->head[c];
+        float *y = s->wet_block[c];
+        for (unsigned long i = 0; i < frames; i++) {
+            const float *x = s->head_hist + i;
+            v4f acc = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int k = 0; k < CONV_HEAD; k += 4)
+                acc += *(const v4f_u *)(h + k) * *(const v4f_u *)(x + k);
+            y[i] = acc[0] + acc[1] + acc[2] + acc[3];
+        }
+    }
+    memmove(s->head_hist, s->head_hist + frames,
+            (CONV_HEAD - 1) * sizeof(float));
+}
+
+// Adds every stage's output and feeds the block in, in runs that stop at
+// the smallest partition's boundaries
+static void stages_process(ConvReverb *s, const float *input,
+                           unsigned long frames) {
+    for (unsigned long i = 0; i < frames;) {
+        unsigned long run = frames - i;
+        for (int k = 0; k < s->num_stages; k++) {
+            ConvStage *st = &s->stages[k];
+            if ((unsigned long)(st->part - st->pos) < run)
+                run = st->part - st->pos;
+        }
+
+        for (int k = 0; k < s->num_stages; k++) {
+            ConvStage *st = &s->stages[k];
+            if (st->read >= 0 && !st->missing) {
+                size_t off = (st->read % CONV_RING) * st->part + st->pos;
+                for (int c = 0; c < s->channels; c++) {
+                    const float *o = st->out_ring[c] + off;
+                    float *y = s->wet_block[c] + i;
+                    for (unsigned long j = 0; j < run; j++)
+                        y[j] += o[j];
+                }
+            }
+            float *dst =
+                st->in_ring + (st->posted % CONV_RING) * st->part + st->pos;
+            if (input)
+                memcpy(dst, input + i, run * sizeof(float));
+            else
+                memset(dst, 0, run * sizeof(float));
+            st->pos += (int)run;
+            if (st->pos == st->part)
+                stage_boundary(st);
+        }
+        i += run;
+    }
+}
+
+static void conv_reverb_process(Module *m, float *in, unsigned long frames) {
+    ConvReverb *s = (ConvReverb *)m->state;
+    float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
+
+    pthread_mutex_lock(&s->lock);
+    float base_wet = s->wet;
+    float base_gain = s->gain;
+    pthread_mutex_unlock(&s->lock);
+
+    float wet_s = process_smoother(&s->smooth_wet, base_wet);
+    float gain_s = process_smoother(&s->smooth_gain, base_gain);
+
+    float *hist = s->head_hist + CONV_HEAD - 1;
+    if (input)
+        memcpy(hist, input, frames * sizeof(float));
+    else
+        memset(hist, 0, frames * sizeof(float));
+    head_process(s, frames);
+    stages_process(s, input, frames);
+
+    float disp_wet = wet_s;
+    float disp_gain = gain_s;
+    const float *wl = s->wet_block[0];
+    const float *wr = s->wet_block[s->channels - 1];
+
+    for (unsigned long i = 0; i < frames; i++) {
+        float wet = wet_s;
+        float gain = gain_s;
+
+        for (int j = 0; j < m->num_control_inputs; j++) {
+            if (!m->control_inputs[j] || !m->control_input_params[j])
+                continue;
+
+            const char *param = m->control_input_params[j];
+            float control = m->control_inputs[j][i];
+            control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+            if (strcmp(param, "wet") == 0) {
+                wet += control;
+            } else if (strcmp(param, "gain") == 0) {
+                gain += control * 12.0f;
+            }
+        }
+
+        clampf(&wet, 0.0f, 1.0f);
+        clampf(&gain, -24.0f, 24.0f);
+        disp_wet = wet;
+        disp_gain = gain;
+
+        float in_s = input ? input[i] : 0.0f;
+        float dry = (1.0f - wet) * in_s;
+        float g = wet * powf(10.0f, gain / 20.0f);
+        float l = dry + g * wl[i];
+        float r = dry + g * wr[i];
+        m->output_bufferL[i] = l;
+        m->output_bufferR[i] = r;
+        m->output_buffer[i] = 0.5f * (l + r);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->display_wet = disp_wet;
+    s->display_gain = disp_gain;
+    pthread_mutex_unlock(&s->lock);
+}
+
+// --- UI / control ---
+
+static void clamp_params(ConvReverb *s) {
+    clampf(&s->wet, 0.0f, 1.0f);
+    clampf(&s->gain, -24.0f, 24.0f);
+}
+
+static void conv_reverb_draw_ui(Module *m, int y, int x) {
+    ConvReverb *s = (ConvReverb *)m->state;
+    float wet, gain;
+    char cmd[72] = "";
+
+    pthread_mutex_lock(&s->lock);
+    wet = s->display_wet;
+    gain = s->display_gain;
+    if (s->entering_command)
+        snprintf(cmd, sizeof(cmd), ":%s", s->command_buffer);
+    pthread_mutex_unlock(&s->lock);
+
+    uint32_t late = 0;
+    for (int k = 0; k < s->num_stages; k++)
+        late += __atomic_load_n(&s->stages[k].late, __ATOMIC_RELAXED);
+
+    BLUE();
+    mvprintw(y, x, "[ConvReverb:%s] ", m->name);
+    CLR();
+
+    LABEL(2, "wet:");
+    ORANGE();
+    printw(" %.2f | ", wet);
+    CLR();
+
+    LABEL(2, "gain:");
+    ORANGE();
+    printw(" %.1f dB | ", gain);
+    CLR();
+
+    LABEL(2, "ir:");
+    ORANGE();
+    printw(" %s %.2fs %s", s->ir_name, s->ir_frames / s->sample_rate,
+           s->channels == 2 ? "stereo" : "mono");
+    if (late)
+        printw(" | late: %u", late);
+    CLR();
+
+    YELLOW();
+    mvprintw(y + 1, x, "Keys: [/] wet, -/= gain");
+    mvprintw(y + 2, x, "Cmd: :1 [wet], :2 [gain] %s", cmd);
+    BLACK();
+}
+
+static void conv_reverb_handle_input(Module *m, int key) {
+    ConvReverb *s = (ConvReverb *)m->state;
+    int handled = 0;
+
+    pthread_mutex_lock(&s->lock);
+
+    if (!s->entering_command) {
+        switch (key) {
+        case '[':
+            s->wet -= 0.01f;
+            handled = 1;
+            break;
+        case ']':
+            s->wet += 0.01f;
+            handled = 1;
+            break;
+        case '-':
+            s->gain -= 0.5f;
+            handled = 1;
+            break;
+        case '=':
+            s->gain += 0.5f;
+            handled = 1;
+            break;
+        case ':':
+            s->entering_command = true;
+            memset(s->command_buffer, 0, sizeof(s->command_buffer));
+            s->command_index = 0;
+            handled = 1;
+            break;
+        }
+    } else {
+        if (key == '\n') {
+            s->entering_command = false;
+            char type;
+            float val;
+            if (sscanf(s->command_buffer, "%c %f", &type, &val) == 2) {
+                if (type == '1')
+                    s->wet = val;
+                else if (type == '2')
+                    s->gain = val;
+            }
+            handled = 1;
+        } else if (key == 27) {
+            s->entering_command = false;
+            handled = 1;
+        } else if ((key == KEY_BACKSPACE || key == 127) &&
+                   s->command_index > 0) {
+            s->command_index--;
+            s->command_buffer[s->command_index] = '\0';
+            handled = 1;
+        } else if (key >= 32 && key < 127 &&
+                   s->command_index < sizeof(s->command_buffer) - 1) {
+            s->command_buffer[s->command_index++] = (char)key;
+            s->command_buffer[s->command_index] = '\0';
+            handled = 1;
+        }
+    }
+
+    if (handled)
+        clamp_params(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void conv_reverb_set_osc_param(Module *m, const char *param,
+                                      float value) {
+    ConvReverb *s = (ConvReverb *)m->state;
+    pthread_mutex_lock(&s->lock);
+
+    if (strcmp(param, "wet") == 0)
+        s->wet = value;
+    else if (strcmp(param, "gain") == 0)
+        s->gain = value;
+    else
+        LOG_WARN("[conv_reverb] Unknown OSC param: %s", param);
+
+    clamp_params(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void conv_reverb_free(ConvReverb *s) {
+    for (int k = 0; k < CONV_MAX_STAGES; k++)
+        stage_free(&s->stages[k]);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+static void conv_reverb_destroy(Module *m) {
+    if (!m)
+        return;
+    conv_reverb_free((ConvReverb *)m->state);
+    m->state = NULL;
+    destroy_base_module(m);
+}
+
+// --- Setup ---
+
+// One channel of the IR at the engine rate, gain-matched so the response
+// to DC is unchanged
+static float *load_channel(const Sample *smp, int ch, float sample_rate,
+                           int *out_frames) {
+    const int nch = smp->channels;
+    const int64_t frames = (int64_t)smp->frames;
+    const float step = (float)smp->samplerate / sample_rate;
+    int64_t n = (int64_t)floor((double)frames / step);
+    if (n > (int64_t)(CONV_MAX_SECONDS * sample_rate))
+        n = (int64_t)(CONV_MAX_SECONDS * sample_rate);
+    if (n < 1)
+        n = 1;
+
+    float *out = malloc(n * sizeof(float));
+    if (!out)
+        return NULL;
+    *out_frames = (int)n;
+
+    if (smp->samplerate == (int)sample_rate) {
+        for (int64_t i = 0; i < n; i++)
+            out[i] = smp->data[i * nch + ch];
+        return out;
+    }
+
+    Resampler rs;
+    if (!resampler_init(&rs, RESAMPLE_BEST)) {
+        free(out);
+        return NULL;
+    }
+    resampler_set_step(&rs, step);
+    float x[RESAMPLE_MAX_TAPS];
+    for (int64_t i = 0; i < n; i++) {
+        double pos = (double)i * step;
+        int64_t i0 = (int64_t)pos - (rs.taps / 2 - 1);
+        for (int t = 0; t < rs.taps; t++) {
+            int64_t idx = i0 + t;
+            x[t] = (idx >= 0 && idx < frames) ? smp->data[idx * nch + ch]
+                                               : 0.0f;
+        }
+        out[i] = step * resampler_interp(&rs, x, (float)(pos - floor(pos)));
+    }
+    return out;
+}
+
+Module *create_module(const char *args, float sample_rate) {
+    char ir_path[512] = "";
+    float wet = 0.3f, gain = 0.0f;
+    bool normalize = true;
+
+    if (args && strstr(args, "ir="))
+        sscanf(strstr(args, "ir="), "ir=%511[^ ,]", ir_path);
+    if (args && strstr(args, "wet="))
+        sscanf(strstr(args, "wet="), "wet=%f", &wet);
+    if (args && strstr(args, "gain="))
+        sscanf(strstr(args, "gain="), "gain=%f", &gain);
+    // norm=off keeps the file's own level instead of unit energy
+    if (args && strstr(args, "norm=")) {
+        char v[8] = {0};
+        sscanf(strstr(args, "norm="), "norm=%7[^, ]", v);
+        normalize = !strcmp(v, "1") || !strcmp(v, "on") ||
+                    !strcmp(v, "yes") || !strcmp(v, "true");
+    }
+
+    if (!ir_path[0]) {
+        LOG_ERROR("[conv_reverb] needs an impulse response: ir=file.wav");
+        return NULL;
+    }
+    const Sample *smp = sample_pool_acquire(ir_path, SAMPLE_INTERLEAVED,
+                                            false);
+    if (!smp || smp->frames == 0) {
+        LOG_ERROR("[conv_reverb] failed to load IR '%s'", ir_path);
+        if (smp)
+            sample_pool_release(smp);
+        return NULL;
+    }
+    if (smp->channels > CONV_MAX_CHANNELS)
+        LOG_WARN("[conv_reverb] '%s' has %d channels, using the first two",
+                 ir_path, smp->channels);
+    if ((float)smp->frames / smp->samplerate > CONV_MAX_SECONDS)
+        LOG_WARN("[conv_reverb] IR cut to %.0f seconds", CONV_MAX_SECONDS);
+
+    ConvReverb *s = calloc(1, sizeof(ConvReverb));
+    if (!s) {
+        sample_pool_release(smp);
+        return NULL;
+    }
+    s->sample_rate = sample_rate;
+    s->channels = smp->channels >= 2 ? 2 : 1;
+    s->wet = wet;
+    s->gain = gain;
+    const char *base = strrchr(ir_path, '/');
+    snprintf(s->ir_name, sizeof(s->ir_name), "%s", base ? base + 1 : ir_path);
+    pthread_mutex_init(&s->lock, NULL);
+
+    float *ir[CONV_MAX_CHANNELS] = {NULL, NULL};
+    int ir_frames = 0;
+    bool ok = true;
+    for (int c = 0; c < s->channels && ok; c++)
+        ok = (ir[c] = load_channel(smp, c, sample_rate, &ir_frames)) != NULL;
+    sample_pool_release(smp);
+    s->ir_frames = ir_frames;
+
+    // Unit energy in the louder channel: noise in, noise out at the same
+    // level
+    if (ok && normalize) {
+        double peak_energy = 0.0;
+        for (int c = 0; c < s->channels; c++) {
+            double e = 0.0;
+            for (int i = 0; i < ir_frames; i++)
+                e += (double)ir[c][i] * ir[c][i];
+            if (e > peak_energy)
+                peak_energy = e;
+        }
+        if (peak_energy > 0.0) {
+            float g = (float)(1.0 / sqrt(peak_energy));
+            for (int c = 0; c < s->channels; c++)
+                for (int i = 0; i < ir_frames; i++)
+                    ir[c][i] *= g;
+        }
+    }
+
+    for (int c = 0; ok && c < s->channels; c++)
+        for (int k = 0; k < CONV_HEAD && k < ir_frames; k++)
+            s->head[c][CONV_HEAD - 1 - k] = ir[c][k];
+
+    for (int k = 0; ok && k < CONV_LAYOUT_STAGES; k++) {
+        int offset = conv_layout[k].offset;
+        int part = conv_layout[k].part;
+        if (ir_frames <= offset)
+            break;
+        int end = k + 1 < CONV_LAYOUT_STAGES ? conv_layout[k + 1].offset
+                                             : ir_frames;
+        if (end > ir_frames)
+            end = ir_frames;
+        int count = (end - offset + part - 1) / part;
+        ok = stage_init(&s->stages[k], part, offset, count,
+                        conv_layout[k].threaded, (const float *const *)ir,
+                        s->channels, ir_frames) == 0;
+        s->num_stages = k + 1;
+    }
+    for (int c = 0; c < CONV_MAX_CHANNELS; c++)
+        free(ir[c]);
+
+    if (!ok) {
+        LOG_ERROR("[conv_reverb] out of memory for '%s'", ir_path);
+        conv_reverb_free(s);
+        return NULL;
+    }
+
+    init_smoother(&s->smooth_wet, 0.5f);
+    init_smoother(&s->smooth_gain, 0.5f);
+    clamp_params(s);
+    LOG_INFO("[conv_reverb] '%s': %d frames, %d ch, %d stages", s->ir_name,
+             ir_frames, s->channels, s->num_stages);
+
+    Module *m = calloc(1, sizeof(Module));
+    m->name = "conv_reverb";
+    m->state = s;
+    m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->output_bufferL = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->output_bufferR = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->process = conv_reverb_process;
+    m->draw_ui = conv_reverb_draw_ui;
+    m->handle_input = conv_reverb_handle_input;
+    m->set_param = conv_reverb_set_osc_param;
+    m->destroy = conv_reverb_destroy;
+    return m;
+}
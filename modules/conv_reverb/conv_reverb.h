@@ -0,0 +1,93 @@
+#ifndef CONV_REVERB_H
+#define CONV_REVERB_H
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "module.h"
+#include "util.h"
+
+#define CONV_MAX_CHANNELS 2
+#define CONV_MAX_STAGES 4
+#define CONV_HEAD 64      // taps run direct-form in the callback
+#define CONV_RING 4       // blocks in flight between a stage and its helper
+#define CONV_MAX_SECONDS 20.0f
+
+// One uniformly partitioned stage: blocks of `part` input samples, each
+// transformed once into a frequency-domain delay line and multiplied with
+// `count` IR partitions per channel (overlap-save, FFT of 2 * part). It
+// covers taps [offset, offset + count * part).
+typedef struct {
+    int part;
+    int offset;
+    int count;
+    int bins;   // part + 1
+    int stride; // bins rounded up to SIMD width
+    int channels;
+    bool threaded;
+
+    // IR partition spectra, split re/im: [channel][count][stride]
+    float *h_re[CONV_MAX_CHANNELS];
+    float *h_im[CONV_MAX_CHANNELS];
+    // Input spectra, newest at fdl_pos: [count][stride]
+    float *x_re;
+    float *x_im;
+    int fdl_pos;
+
+    float *prev;            // previous input block
+    float *time;            // 2 * part
+    fftwf_complex *spec;    // bins
+    float *acc_re, *acc_im; // stride
+    fftwf_plan fwd, inv;
+
+    // Audio thread writes input blocks, the stage writes output blocks
+    float *in_ring;                    // [CONV_RING][part]
+    float *out_ring[CONV_MAX_CHANNELS]; // [CONV_RING][part]
+    int pos;      // samples into the current block, in and out alike
+    int64_t read; // output block being read, < 0 before the first
+    bool missing; // read block was not ready in time: silent
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool thread_started;
+    int64_t posted; // input blocks handed over
+    int64_t done;   // blocks transformed and summed
+    int stop;
+    uint32_t late;
+} ConvStage;
+
+typedef struct {
+    float sample_rate;
+    int channels; // of the IR, 1 or 2
+    int ir_frames;
+    char ir_name[64];
+
+    float wet;  // 0.0 to 1.0
+    float gain; // dB on the wet signal
+
+    // Direct-form head: taps reversed, and the input they run over
+    float head[CONV_MAX_CHANNELS][CONV_HEAD];
+    float head_hist[CONV_HEAD - 1 + MAX_BLOCK_SIZE];
+
+    ConvStage stages[CONV_MAX_STAGES];
+    int num_stages;
+
+    float wet_block[CONV_MAX_CHANNELS][MAX_BLOCK_SIZE];
+
+    CParamSmooth smooth_wet;
+    CParamSmooth smooth_gain;
+
+    pthread_mutex_t lock;
+
+    float display_wet;
+    float display_gain;
+
+    bool entering_command;
+    char command_buffer[64];
+    int command_index;
+} ConvReverb;
+
+#endif
@@ -1,14 +1,208 @@
 #include <math.h>
 #include <ncurses.h>
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "delay.h"
+#include "dsp.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
-#define MAX_DELAY_MS 2000
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4f_u __attribute__((vector_size(16), aligned(4)));
+
+#define DEFAULT_MAX_MS 120000.0f
+#define DELAY_CV_RANGE_MS 2000.0f // a time CV of +/-1 moves a tap this far
+#define DELAY_MIN_MS 1.0f
+#define DELAY_GLIDE 0.001f // per-sample glide toward a new time
+
+// --- Paged ring ---
+
+static unsigned pow2_at_least(unsigned n) {
+    unsigned size = DELAY_PAGE;
+    while (size < n)
+        size <<= 1;
+    return size;
+}
+
+static float ms_to_samples(const Delay *s, float ms) {
+    return ms / 1000.0f * s->sample_rate;
+}
+
+// Control side: makes sure pages exist for a ring of `need` samples and
+// publishes the new size. Allocation (zeroed, so touched) happens here,
+// never on the audio thread.
+static void ring_reserve(Delay *s, unsigned need) {
+    pthread_mutex_lock(&s->grow_lock);
+    unsigned target = pow2_at_least(need);
+    if (target > s->table_pages * DELAY_PAGE)
+        target = s->table_pages * DELAY_PAGE;
+    if (target <= __atomic_load_n(&s->grow_to, __ATOMIC_RELAXED)) {
+        pthread_mutex_unlock(&s->grow_lock);
+        return;
+    }
+
+    unsigned want = target >> DELAY_PAGE_BITS;
+    while (s->reserved < want) {
+        float *page = dsp_alloc(DELAY_PAGE);
+        if (!page)
+            break;
+        s->pages[s->reserved++] = page;
+    }
+    // Short of memory: grow as far as the pages go
+    while (target > DELAY_PAGE && (target >> DELAY_PAGE_BITS) > s->reserved)
+        target >>= 1;
+    if (target < (want << DELAY_PAGE_BITS))
+        LOG_ERROR("[delay] out of memory, ring held at %.1f s",
+                  target / s->sample_rate);
+    if (s->reserved > 0 &&
+        target > __atomic_load_n(&s->grow_to, __ATOMIC_RELAXED))
+        __atomic_store_n(&s->grow_to, target, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&s->grow_lock);
+}
+
+// Room for the longest time the taps can reach, including CV
+static void delay_reserve(Delay *s) {
+    pthread_mutex_lock(&s->lock);
+    float longest = 0.0f;
+    for (int k = 0; k < s->num_taps; k++)
+        longest = fmaxf(longest, s->taps[k].time_ms);
+    float reach = fminf(longest + DELAY_CV_RANGE_MS, s->max_ms);
+    unsigned need = (unsigned)ms_to_samples(s, reach) + MAX_BLOCK_SIZE + 4;
+    pthread_mutex_unlock(&s->lock);
+    ring_reserve(s, need);
+}
+
+// Audio thread: size -> new_size by moving page pointers. The last `size`
+// samples keep their absolute positions; the one page holding both the
+// newest and the oldest of them is split with a copy of at most a page.
+static void ring_regrow(Delay *s, unsigned new_size) {
+    const unsigned size = s->size;
+    const unsigned np = size >> DELAY_PAGE_BITS;
+    const unsigned new_np = new_size >> DELAY_PAGE_BITS;
+    const unsigned k = new_size / size;
+    const unsigned w = s->write_pos;
+    const unsigned c = w & (size - 1);
+    const unsigned split = c >> DELAY_PAGE_BITS;
+    const unsigned co = c & (DELAY_PAGE - 1);
+
+    // Which copy of the old ring each part now lands in: samples before
+    // the write index are this lap's, the rest the previous lap's
+    const unsigned lap = w / size;
+    const unsigned h_new = lap & (k - 1);
+    const unsigned h_old = (lap - 1) & (k - 1);
+
+    float **fresh = s->pages + np;
+    unsigned f = 0;
+    memset(s->spare, 0, new_np * sizeof(float *));
+    for (unsigned j = 0; j < np; j++) {
+        float *page = s->pages[j];
+        if (j < split) {
+            s->spare[j + h_new * np] = page;
+        } else if (j > split || co == 0) {
+            s->spare[j + h_old * np] = page;
+        } else {
+            float *older = fresh[f++];
+            memcpy(older + co, page + co, (DELAY_PAGE - co) * sizeof(float));
+            memset(page + co, 0, (DELAY_PAGE - co) * sizeof(float));
+            s->spare[j + h_new * np] = page;
+            s->spare[j + h_old * np] = older;
+        }
+    }
+    for (unsigned j = 0; j < new_np; j++)
+        if (!s->spare[j])
+            s->spare[j] = fresh[f++];
+    memcpy(s->pages, s->spare, new_np * sizeof(float *));
+
+    s->size = new_size;
+    s->mask = new_size - 1;
+}
+
+static inline float ring_at(const Delay *s, unsigned t) {
+    unsigned i = t & s->mask;
+    return s->pages[i >> DELAY_PAGE_BITS][i & (DELAY_PAGE - 1)];
+}
+
+static inline void ring_put(Delay *s, unsigned t, float v) {
+    unsigned i = t & s->mask;
+    s->pages[i >> DELAY_PAGE_BITS][i & (DELAY_PAGE - 1)] = v;
+}
+
+// n samples from absolute position t, a page at a time
+static void ring_span(const Delay *s, unsigned t, unsigned n, float *dst) {
+    while (n) {
+        unsigned i = t & s->mask;
+        unsigned off = i & (DELAY_PAGE - 1);
+        unsigned run = DELAY_PAGE - off < n ? DELAY_PAGE - off : n;
+        memcpy(dst, s->pages[i >> DELAY_PAGE_BITS] + off, run * sizeof(float));
+        dst += run;
+        t += run;
+        n -= run;
+    }
+}
+
+// --- Taps ---
+
+// Catmull-Rom between x1 and x2
+static inline float hermite(float x0, float x1, float x2, float x3,
+                            float f) {
+    float c1 = 0.5f * (x2 - x0);
+    float c2 = x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+    float c3 = 0.5f * (x3 - x0) + 1.5f * (x1 - x2);
+    return ((c3 * f + c2) * f + c1) * f + x1;
+}
+
+// The sample `d` (>= 2) before absolute position w
+static inline float tap_read(const Delay *s, unsigned w, float d) {
+    unsigned di = (unsigned)d;
+    float f = 1.0f - (d - (float)di);
+    unsigned base = w - di - 1;
+    return hermite(ring_at(s, base - 1), ring_at(s, base),
+                   ring_at(s, base + 1), ring_at(s, base + 2), f);
+}
+
+// A whole block of one tap at a fixed time, from one contiguous span.
+// Only valid when the tap reads nothing this block writes (d > frames).
+static void tap_read_block(Delay *s, unsigned w, float d, float *out,
+                           unsigned long frames) {
+    unsigned di = (unsigned)d;
+    float f = 1.0f - (d - (float)di);
+    ring_span(s, w - di - 2, (unsigned)frames + 3, s->span);
+
+    // The interpolator as a four-tap FIR, the same for every sample
+    float c0 = f * (-0.5f + f * (1.0f - 0.5f * f));
+    float c1 = 1.0f + f * f * (-2.5f + 1.5f * f);
+    float c2 = f * (0.5f + f * (2.0f - 1.5f * f));
+    float c3 = f * f * (-0.5f + 0.5f * f);
+    const float *x = s->span;
+    unsigned long i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        v4f y = c0 * *(const v4f_u *)(x + i) +
+                c1 * *(const v4f_u *)(x + i + 1) +
+                c2 * *(const v4f_u *)(x + i + 2) +
+                c3 * *(const v4f_u *)(x + i + 3);
+        *(v4f_u *)(out + i) = y;
+    }
+    for (; i < frames; i++)
+        out[i] = c0 * x[i] + c1 * x[i + 1] + c2 * x[i + 2] + c3 * x[i + 3];
+}
+
+// "time"/"level" name tap 1, "time2"/"level2"... the others; -1 otherwise
+static int tap_param(const char *param, const char *name, int num_taps) {
+    size_t len = strlen(name);
+    if (strncmp(param, name, len) != 0)
+        return -1;
+    if (param[len] == '\0')
+        return 0;
+    char *end;
+    long n = strtol(param + len, &end, 10);
+    if (*end || n < 1 || n > num_taps)
+        return -1;
+    return (int)n - 1;
+}
 
 static void delay_process(Module *m, float *in, unsigned long frames) {
     Delay *state = (Delay *)m->state;
@@ -18,26 +212,63 @@ static void delay_process(Module *m, float *in, unsigned long frames) {
     pthread_mutex_lock(&state->lock);
     float base_mix = state->mix;
     float base_fb = state->feedback;
-    float base_delay_ms = state->delay_ms;
-    float *buffer = state->buffer;
-    unsigned int buffer_size = state->buffer_size;
-    unsigned int write_index = state->write_index;
-    float delay_samples = state->last_delay_samples;
-    float sample_rate = state->sample_rate;
+    float max_ms = state->max_ms;
+    int num_taps = state->num_taps;
+    float base_time[DELAY_MAX_TAPS], base_level[DELAY_MAX_TAPS];
+    for (int k = 0; k < num_taps; k++) {
+        base_time[k] = state->taps[k].time_ms;
+        base_level[k] = state->taps[k].level;
+    }
     pthread_mutex_unlock(&state->lock);
 
+    unsigned grow_to = __atomic_load_n(&state->grow_to, __ATOMIC_ACQUIRE);
+    if (grow_to > state->size)
+        ring_regrow(state, grow_to);
+
     float mix_s = process_smoother(&state->smooth_mix, base_mix);
     float fb_s = process_smoother(&state->smooth_feedback, base_fb);
-    float delay_ms_s = process_smoother(&state->smooth_delay, base_delay_ms);
 
     float disp_mix = mix_s;
     float disp_fb = fb_s;
-    float disp_delay_ms = delay_ms_s;
+
+    // Longest readable time with this block's writes still ahead of it
+    const float max_d = (float)(state->size - MAX_BLOCK_SIZE - 4);
+    const unsigned w0 = state->write_pos;
+
+    // Taps whose time holds still this block are read up front in one span
+    bool modulated[DELAY_MAX_TAPS] = {false};
+    for (int j = 0; j < m->num_control_inputs; j++) {
+        if (!m->control_inputs[j] || !m->control_input_params[j])
+            continue;
+        int k = tap_param(m->control_input_params[j], "time", num_taps);
+        if (k >= 0)
+            modulated[k] = true;
+    }
+    float time_s[DELAY_MAX_TAPS];
+    bool block_read[DELAY_MAX_TAPS];
+    for (int k = 0; k < num_taps; k++) {
+        DelayTap *tap = &state->taps[k];
+        time_s[k] = process_smoother(&tap->smooth_time, base_time[k]);
+        clampf(&time_s[k], DELAY_MIN_MS, max_ms);
+        float target = ms_to_samples(state, time_s[k]);
+        target = fminf(fmaxf(target, 2.0f), max_d);
+        block_read[k] = false;
+        if (!modulated[k] && fabsf(tap->delay_samples - target) < 1e-3f &&
+            target > (float)(frames + 1)) {
+            tap->delay_samples = target;
+            tap_read_block(state, w0, target, state->tap_out[k], frames);
+            block_read[k] = true;
+        }
+    }
 
     for (unsigned long i = 0; i < frames; i++) {
         float mix = mix_s;
         float fb = fb_s;
-        float delay_ms = delay_ms_s;
+        float time[DELAY_MAX_TAPS], level[DELAY_MAX_TAPS];
+        for (int k = 0; k < num_taps; k++) {
+            time[k] = time_s[k];
+            level[k] = base_level[k];
+        }
 
         for (int j = 0; j < m->num_control_inputs; j++) {
             if (!m->control_inputs[j] || !m->control_input_params[j])
@@ -47,78 +278,81 @@ static void delay_process(Module *m, float *in, unsigned long frames) {
             float control = m->control_inputs[j][i];
             control = fminf(fmaxf(control, -1.0f), 1.0f);
 
-            if (strcmp(param, "time") == 0) {
-                delay_ms += control * MAX_DELAY_MS;
-            } else if (strcmp(param, "mix") == 0) {
+            int k;
+            if (strcmp(param, "mix") == 0) {
                 mix += control;
             } else if (strcmp(param, "fb") == 0) {
                 fb += control;
+            } else if ((k = tap_param(param, "time", num_taps)) >= 0) {
+                time[k] += control * DELAY_CV_RANGE_MS;
+            } else if ((k = tap_param(param, "level", num_taps)) >= 0) {
+                level[k] += control;
             }
         }
 
         clampf(&mix, 0.0f, 1.0f);
         clampf(&fb, 0.0f, 0.99f);
-        clampf(&delay_ms, 1.0f, MAX_DELAY_MS);
 
         disp_mix = mix;
         disp_fb = fb;
-        disp_delay_ms = delay_ms;
-
-        // Smooth delay time per sample
-        float target_delay_samples = (delay_ms / 1000.0f) * sample_rate;
-        if (target_delay_samples > (float)(buffer_size - 1))
-            target_delay_samples = (float)(buffer_size - 1);
-        if (target_delay_samples < 1.0f)
-            target_delay_samples = 1.0f;
 
-        float smoothing =
-            0.001f; // smaller is smoother; increase if too sluggish
-
-        // Smooth toward target
-        delay_samples += smoothing * (target_delay_samples - delay_samples);
-
-        float read_pos = (float)write_index - delay_samples;
-        if (read_pos < 0.0f)
-            read_pos += buffer_size;
-
-        unsigned int base = (unsigned int)read_pos;
-        float frac = read_pos - base;
-        float s1 = buffer[base % buffer_size];
-        float s2 = buffer[(base + 1) % buffer_size];
-        float delayed = (1.0f - frac) * s1 + frac * s2;
+        unsigned w = w0 + (unsigned)i;
+        float wet = 0.0f;
+        float fb_tap = 0.0f;
+        for (int k = 0; k < num_taps; k++) {
+            DelayTap *tap = &state->taps[k];
+            float y;
+            if (block_read[k]) {
+                y = state->tap_out[k][i];
+            } else {
+                clampf(&time[k], DELAY_MIN_MS, max_ms);
+                float target = ms_to_samples(state, time[k]);
+                target = fminf(fmaxf(target, 2.0f), max_d);
+                tap->delay_samples +=
+                    DELAY_GLIDE * (target - tap->delay_samples);
+                y = tap_read(state, w, tap->delay_samples);
+            }
+            if (k == 0)
+                fb_tap = y;
+            clampf(&level[k], 0.0f, 1.0f);
+            wet += level[k] * y;
+        }
 
         float dry = input ? input[i] : 0.0f;
-        float val = dry * (1.0f - mix) + delayed * mix;
-        out[i] = val;
-
-        buffer[write_index] = dry + delayed * fb;
-
-        write_index = (write_index + 1) % buffer_size;
+        out[i] = dry * (1.0f - mix) + wet * mix;
+        ring_put(state, w, dry + fb_tap * fb);
     }
+    state->write_pos = w0 + (unsigned)frames;
 
     pthread_mutex_lock(&state->lock);
-    state->write_index = write_index;
-    state->last_delay_samples = delay_samples;
+    for (int k = 0; k < num_taps; k++)
+        state->taps[k].display_time =
+            state->taps[k].delay_samples * 1000.0f / state->sample_rate;
     state->display_mix = disp_mix;
     state->display_feedback = disp_fb;
-    state->display_delay = disp_delay_ms;
     pthread_mutex_unlock(&state->lock);
 }
 
 static void clamp_params(Delay *state) {
     clampf(&state->mix, 0.0f, 1.0f);
     clampf(&state->feedback, 0.0f, 0.99f);
-    clampf(&state->delay_ms, 1.0f, MAX_DELAY_MS);
+    for (int k = 0; k < state->num_taps; k++) {
+        clampf(&state->taps[k].time_ms, DELAY_MIN_MS, state->max_ms);
+        clampf(&state->taps[k].level, 0.0f, 1.0f);
+    }
 }
 
 static void delay_draw_ui(Module *m, int y, int x) {
     Delay *state = (Delay *)m->state;
-    char cmd[64] = "";
+    char cmd[72] = "";
+    float times[DELAY_MAX_TAPS];
 
     pthread_mutex_lock(&state->lock);
     float mix = state->display_mix;
     float fb = state->display_feedback;
-    float ms = state->display_delay;
+    int num_taps = state->num_taps;
+    for (int k = 0; k < num_taps; k++)
+        times[k] = state->taps[k].display_time;
     if (state->entering_command)
         snprintf(cmd, sizeof(cmd), ":%s", state->command_buffer);
     pthread_mutex_unlock(&state->lock);
@@ -129,7 +363,7 @@ static void delay_draw_ui(Module *m, int y, int x) {
 
     LABEL(2, "time:");
     ORANGE();
-    printw(" %.1f ms | ", ms);
+    printw(" %.1f ms | ", times[0]);
     CLR();
 
     LABEL(2, "mix:");
@@ -142,25 +376,40 @@ static void delay_draw_ui(Module *m, int y, int x) {
     printw(" %.2f", fb);
     CLR();
 
+    if (num_taps > 1) {
+        printw(" | ");
+        LABEL(2, "taps:");
+        ORANGE();
+        for (int k = 1; k < num_taps; k++)
+            printw(" %.0f", times[k]);
+        printw(" ms");
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x, "Real-time keys: -/= (time), _/+ (mix), [/] (fb)");
-    mvprintw(y + 2, x, "Command mode: :1 [time], :2 [mix], :3 [fb]");
+    mvprintw(y + 2, x,
+             "Command mode: :1 [time], :2 [mix], :3 [fb], :t [tap] [ms], "
+             ":l [tap] [level] %s",
+             cmd);
     BLACK();
 }
 
 static void delay_handle_input(Module *m, int key) {
     Delay *state = (Delay *)m->state;
     int handled = 0;
+    bool times_changed = false;
 
     pthread_mutex_lock(&state->lock);
     if (!state->entering_command) {
         switch (key) {
         case '=':
-            state->delay_ms += 10.0f;
+            state->taps[0].time_ms += 10.0f;
+            times_changed = true;
             handled = 1;
             break;
         case '-':
-            state->delay_ms -= 10.0f;
+            state->taps[0].time_ms -= 10.0f;
             handled = 1;
             break;
         case '+':
@@ -190,11 +439,25 @@ static void delay_handle_input(Module *m, int key) {
         if (key == '\n') {
             state->entering_command = false;
             char type;
+            int tap;
             float val;
-            if (sscanf(state->command_buffer, "%c %f", &type, &val) == 2) {
-                if (type == '1')
-                    state->delay_ms = val;
-                else if (type == '2')
+            if (sscanf(state->command_buffer, "%c %d %f", &type, &tap,
+                       &val) == 3 &&
+                (type == 't' || type == 'l')) {
+                if (tap >= 1 && tap <= state->num_taps) {
+                    if (type == 't') {
+                        state->taps[tap - 1].time_ms = val;
+                        times_changed = true;
+                    } else {
+                        state->taps[tap - 1].level = val;
+                    }
+                }
+            } else if (sscanf(state->command_buffer, "%c %f", &type, &val) ==
+                       2) {
+                if (type == '1') {
+                    state->taps[0].time_ms = val;
+                    times_changed = true;
+                } else if (type == '2')
                     state->mix = val;
                 else if (type == '3')
                     state->feedback = val;
@@ -219,30 +482,50 @@ static void delay_handle_input(Module *m, int key) {
     if (handled)
         clamp_params(state);
     pthread_mutex_unlock(&state->lock);
+
+    if (times_changed)
+        delay_reserve(state);
 }
 
 static void delay_set_osc_param(Module *m, const char *param, float value) {
     Delay *state = (Delay *)m->state;
+    bool times_changed = false;
     pthread_mutex_lock(&state->lock);
 
-    if (strcmp(param, "time") == 0) {
-        state->delay_ms = fmaxf(1.0f, fminf(value, 2000.0f));
-    } else if (strcmp(param, "mix") == 0) {
-        state->mix = fmaxf(0.0f, fminf(value, 1.0f));
+    int k;
+    if (strcmp(param, "mix") == 0) {
+        state->mix = value;
     } else if (strcmp(param, "fb") == 0) {
-        state->feedback = fmaxf(0.0f, fminf(value, 0.99f));
+        state->feedback = value;
+    } else if ((k = tap_param(param, "time", state->num_taps)) >= 0) {
+        state->taps[k].time_ms = value;
+        times_changed = true;
+    } else if ((k = tap_param(param, "level", state->num_taps)) >= 0) {
+        state->taps[k].level = value;
     } else {
-        fprintf(stderr, "[delay] Unknown OSC param: %s\n", param);
+        LOG_WARN("[delay] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
     pthread_mutex_unlock(&state->lock);
+
+    if (times_changed)
+        delay_reserve(state);
+}
+
+static void delay_free(Delay *state) {
+    for (unsigned p = 0; p < state->reserved; p++)
+        free(state->pages[p]);
+    free(state->pages);
+    free(state->spare);
+    pthread_mutex_destroy(&state->grow_lock);
+    pthread_mutex_destroy(&state->lock);
 }
 
 static void delay_destroy(Module *m) {
     Delay *state = (Delay *)m->state;
     if (state)
-        pthread_mutex_destroy(&state->lock);
+        delay_free(state);
     destroy_base_module(m);
 }
 
@@ -250,6 +533,8 @@ Module *create_module(const char *args, float sample_rate) {
     float delay_ms = 500.0f;
     float mix = 0.5f;
     float feedback = 0.3f;
+    float max_s = DEFAULT_MAX_MS / 1000.0f;
+    int num_taps = 1;
     if (args && strstr(args, "time=")) {
         sscanf(strstr(args, "time="), "time=%f", &delay_ms);
     }
@@ -259,20 +544,75 @@ Module *create_module(const char *args, float sample_rate) {
     if (args && strstr(args, "fb=")) {
         sscanf(strstr(args, "fb="), "fb=%f", &feedback);
     }
+    // max= caps the longest time in seconds; memory follows the times in
+    // use, not this
+    if (args && strstr(args, "max=")) {
+        sscanf(strstr(args, "max="), "max=%f", &max_s);
+    }
+    if (args && strstr(args, "taps=")) {
+        sscanf(strstr(args, "taps="), "taps=%d", &num_taps);
+    }
+    clampf(&max_s, 0.1f, DEFAULT_MAX_MS / 1000.0f);
+    clampi(&num_taps, 1, DELAY_MAX_TAPS);
 
     Delay *state = calloc(1, sizeof(Delay));
     state->sample_rate = sample_rate;
-    state->delay_ms = delay_ms;
     state->mix = mix;
     state->feedback = feedback;
-    state->buffer_size = (unsigned int)((MAX_DELAY_MS / 1000.0f) * sample_rate);
-    state->buffer = calloc(state->buffer_size, sizeof(float));
-    state->last_delay_samples = (state->delay_ms / 1000.0f) * sample_rate;
+    state->max_ms = max_s * 1000.0f;
+    state->num_taps = num_taps;
+
+    // Extra taps default to multiples of the first at half level
+    for (int k = 0; k < num_taps; k++) {
+        DelayTap *tap = &state->taps[k];
+        tap->time_ms = delay_ms * (k + 1);
+        tap->level = k == 0 ? 1.0f : 0.5f;
+        if (k > 0 && args) {
+            char key[16];
+            snprintf(key, sizeof(key), "time%d=", k + 1);
+            if (strstr(args, key))
+                sscanf(strstr(args, key) + strlen(key), "%f", &tap->time_ms);
+            snprintf(key, sizeof(key), "level%d=", k + 1);
+            if (strstr(args, key))
+                sscanf(strstr(args, key) + strlen(key), "%f", &tap->level);
+        }
+        if (k == 0 && args && strstr(args, "level="))
+            sscanf(strstr(args, "level="), "level=%f", &tap->level);
+    }
+    clamp_params(state);
+    for (int k = 0; k < num_taps; k++) {
+        DelayTap *tap = &state->taps[k];
+        tap->delay_samples = ms_to_samples(state, tap->time_ms);
+        tap->display_time = tap->time_ms;
+        init_smoother(&tap->smooth_time, 0.75f);
+        tap->smooth_time.z = tap->time_ms;
+    }
+
+    unsigned longest = pow2_at_least(
+        (unsigned)ms_to_samples(state, state->max_ms) + MAX_BLOCK_SIZE + 4);
+    state->table_pages = longest >> DELAY_PAGE_BITS;
+    state->pages = calloc(state->table_pages, sizeof(float *));
+    state->spare = calloc(state->table_pages, sizeof(float *));
     pthread_mutex_init(&state->lock, NULL);
-    init_smoother(&state->smooth_delay, 0.75f);
+    pthread_mutex_init(&state->grow_lock, NULL);
+    if (!state->pages || !state->spare) {
+        LOG_ERROR("[delay] out of memory");
+        delay_free(state);
+        free(state);
+        return NULL;
+    }
+    delay_reserve(state);
+    if (state->reserved == 0) {
+        LOG_ERROR("[delay] out of memory");
+        delay_free(state);
+        free(state);
+        return NULL;
+    }
+    state->size = state->grow_to;
+    state->mask = state->size - 1;
+
     init_smoother(&state->smooth_mix, 0.75f);
     init_smoother(&state->smooth_feedback, 0.75f);
-    clamp_params(state);
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "delay";
@@ -5,27 +5,53 @@
 #include "util.h"
 #include <pthread.h>
 
+#define DELAY_MAX_TAPS 8
+#define DELAY_PAGE_BITS 13 // 8192 samples a page
+#define DELAY_PAGE (1u << DELAY_PAGE_BITS)
+
+typedef struct {
+    float time_ms;
+    float level;
+    float delay_samples; // glides toward the target per sample
+    CParamSmooth smooth_time;
+    float display_time;
+} DelayTap;
+
 typedef struct {
-    float delay_ms;
     float mix;
     float feedback;
+    float max_ms;
+
+    DelayTap taps[DELAY_MAX_TAPS]; // the first one feeds back
+    int num_taps;
 
     float sample_rate;
-    float *buffer;
-    unsigned int buffer_size;
-    unsigned int write_index;
-    unsigned int read_index;
-    float last_delay_samples;
+
+    // The ring is a power-of-two size the taps need, made of pages. The
+    // page table is long enough for max_ms; pages past the live size are
+    // allocated and touched by whoever raises a time (never the audio
+    // thread), which then publishes grow_to. The audio thread grows the
+    // ring at the start of its next block by moving page pointers.
+    float **pages;
+    float **spare; // scratch table for the regrow
+    unsigned table_pages;
+    unsigned size; // live, audio thread
+    unsigned mask;
+    unsigned write_pos;
+    unsigned grow_to;  // published by the control side
+    unsigned reserved; // pages allocated, under grow_lock
+    pthread_mutex_t grow_lock;
+
+    float tap_out[DELAY_MAX_TAPS][MAX_BLOCK_SIZE];
+    float span[MAX_BLOCK_SIZE + 4];
 
     // Smoothing
-    CParamSmooth smooth_delay;
     CParamSmooth smooth_mix;
     CParamSmooth smooth_feedback;
 
     pthread_mutex_t lock;
 
     // UI display
-    float display_delay;
     float display_mix;
     float display_feedback;
 
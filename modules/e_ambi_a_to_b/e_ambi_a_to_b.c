@@ -1,10 +1,14 @@
+#include <ncurses.h>
 #include <sndfile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#include "dsp.h"
 #include "e_ambi_a_to_b.h"
+#include "job.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -17,33 +21,45 @@ static void ensure_a_to_b_dir(void) {
     mkdir(A_TO_B_DIR, 0755);
 }
 
-static void convert_a_to_b(const char *filepath, unsigned int convert_id,
-                           int ch[4]) {
+// Batch files get consecutive ids from id=
+int module_job(JobCtx *ctx, const char *filepath, const char *args,
+               unsigned int index) {
+    unsigned int convert_id = 0;
+    int ch[4] = {0, 1, 2, 3}; // Default to first 4 channels
+
+    if (args && strstr(args, "id=")) {
+        sscanf(strstr(args, "id="), "id=%u", &convert_id);
+    }
+
+    if (args && strstr(args, "channels=")) {
+        sscanf(strstr(args, "channels="), "channels=%d,%d,%d,%d", &ch[0],
+               &ch[1], &ch[2], &ch[3]);
+    }
+    convert_id += index;
+    ensure_a_to_b_dir();
+
     SF_INFO in_info = (SF_INFO){0};
     SNDFILE *infile = sf_open(filepath, SFM_READ, &in_info);
     if (!infile) {
-        fprintf(stderr, "[e_ambi_a_to_b] failed to open '%s'\n", filepath);
-        return;
+        LOG_ERROR("[e_ambi_a_to_b] failed to open '%s'", filepath);
+        return -1;
     }
 
     if (in_info.channels < 4) {
-        fprintf(stderr,
-                "[e_ambi_a_to_b] input must have at least 4 channels, got %d\n",
-                in_info.channels);
+        LOG_ERROR("[e_ambi_a_to_b] input must have at least 4 channels, got %d",
+                  in_info.channels);
         sf_close(infile);
-        return;
+        return -1;
     }
 
     // Validate channel indices
     for (int i = 0; i < 4; i++) {
         if (ch[i] < 0 || ch[i] >= in_info.channels) {
-            fprintf(
-                stderr,
-                "[e_ambi_a_to_b] channel index %d out of range (file has %d "
-                "channels)\n",
-                ch[i], in_info.channels);
+            LOG_ERROR("[e_ambi_a_to_b] channel index %d out of range (file "
+                      "has %d channels)",
+                      ch[i], in_info.channels);
             sf_close(infile);
-            return;
+            return -1;
         }
     }
 
@@ -57,58 +73,98 @@ static void convert_a_to_b(const char *filepath, unsigned int convert_id,
 
     SNDFILE *outfile = sf_open(out_path, SFM_WRITE, &out_info);
     if (!outfile) {
-        fprintf(stderr, "[e_ambi_a_to_b] failed to create output file\n");
+        LOG_ERROR("[e_ambi_a_to_b] failed to create output file");
         sf_close(infile);
-        return;
+        return -1;
     }
 
     float *a_frame = malloc(sizeof(float) * BLOCK_FRAMES * in_info.channels);
     float *b_frame = malloc(sizeof(float) * BLOCK_FRAMES * 4);
-    if (!a_frame || !b_frame) {
+    float *planar = dsp_alloc(BLOCK_FRAMES * 8); // 4 capsules, then W Y Z X
+    if (!a_frame || !b_frame || !planar) {
         sf_close(infile);
         sf_close(outfile);
         free(a_frame);
         free(b_frame);
-        return;
+        free(planar);
+        return -1;
+    }
+    float *caps[4], *bfmt[4];
+    for (int c = 0; c < 4; c++) {
+        caps[c] = planar + c * BLOCK_FRAMES;
+        bfmt[c] = planar + (4 + c) * BLOCK_FRAMES;
     }
 
-    printf("[e_ambi_a_to_b] Converting A-format to B-format: %s -> %s\n",
-           filepath, out_path);
-    printf("[e_ambi_a_to_b] Using channels: %d, %d, %d, %d (of %d total)\n",
-           ch[0], ch[1], ch[2], ch[3], in_info.channels);
-
-    sf_count_t frames;
-    while ((frames = sf_readf_float(infile, a_frame, BLOCK_FRAMES)) > 0) {
+    LOG_INFO("[e_ambi_a_to_b] Converting A-format to B-format: %s -> %s",
+             filepath, out_path);
+    LOG_INFO("[e_ambi_a_to_b] Using channels: %d, %d, %d, %d (of %d total)",
+             ch[0], ch[1], ch[2], ch[3], in_info.channels);
+
+    double total = in_info.frames > 0 ? (double)in_info.frames : 1.0;
+    double done = 0.0;
+    int rc = 0;
+    for (;;) {
+        job_io_begin(ctx);
+        sf_count_t frames = sf_readf_float(infile, a_frame, BLOCK_FRAMES);
+        job_io_end(ctx);
+        if (frames <= 0)
+            break;
+        if (job_cancelled(ctx)) {
+            rc = -1;
+            break;
+        }
+        // A-format input channels (tetrahedral microphone capsules)
+        for (int c = 0; c < 4; c++)
+            dsp_gather(caps[c], a_frame, in_info.channels, ch[c],
+                       (unsigned long)frames);
+        const float *lfu = caps[0]; // Left Front Up
+        const float *rfd = caps[1]; // Right Front Down
+        const float *lbd = caps[2]; // Left Back Down
+        const float *rbu = caps[3]; // Right Back Up
+
+        // A-to-B conversion: AmbiX / SN3D, in AmbiX order W, Y, Z, X
         for (sf_count_t i = 0; i < frames; i++) {
-            // A-format input channels (tetrahedral microphone capsules)
-            float lfu = a_frame[i * in_info.channels + ch[0]]; // Left Front Up
-            float rfd =
-                a_frame[i * in_info.channels + ch[1]]; // Right Front Down
-            float lbd = a_frame[i * in_info.channels + ch[2]]; // Left Back Down
-            float rbu = a_frame[i * in_info.channels + ch[3]]; // Right Back Up
-
-            // A-to-B conversion: AmbiX / SN3D
-            float w = 0.5f * (lfu + rfd + lbd + rbu);
-            float x = 0.5f * (lfu + rfd - lbd - rbu);
-            float y = 0.5f * (lfu - rfd + lbd - rbu);
-            float z = 0.5f * (lfu - rfd - lbd + rbu);
-
-            // AmbiX channel order: W, Y, Z, X
-            b_frame[i * 4 + 0] = w;
-            b_frame[i * 4 + 1] = y;
-            b_frame[i * 4 + 2] = z;
-            b_frame[i * 4 + 3] = x;
+            bfmt[0][i] = 0.5f * (lfu[i] + rfd[i] + lbd[i] + rbu[i]);
+            bfmt[1][i] = 0.5f * (lfu[i] - rfd[i] + lbd[i] - rbu[i]);
+            bfmt[2][i] = 0.5f * (lfu[i] - rfd[i] - lbd[i] + rbu[i]);
+            bfmt[3][i] = 0.5f * (lfu[i] + rfd[i] - lbd[i] - rbu[i]);
         }
-        sf_writef_float(outfile, b_frame, frames);
+        dsp_interleave(b_frame, (const float *const *)bfmt, 4,
+                       (unsigned long)frames);
+        job_io_begin(ctx);
+        if (sf_writef_float(outfile, b_frame, frames) != frames)
+            rc = -1;
+        job_io_end(ctx);
+        if (rc)
+            break;
+        done += (double)frames;
+        job_progress(ctx, (float)(done / total));
     }
 
     sf_close(infile);
     sf_close(outfile);
     free(a_frame);
     free(b_frame);
+    free(planar);
+
+    if (rc == 0)
+        LOG_INFO("[e_ambi_a_to_b] Conversion complete. B-format file: %s",
+                 out_path);
+    return rc;
+}
+
+static void a_to_b_draw_ui(Module *m, int y, int x) {
+    EAmbiAToB *s = (EAmbiAToB *)m->state;
+    char desc[32];
+
+    BLUE();
+    mvprintw(y, x, "[e_ambi_a_to_b] ");
+    CLR();
 
-    printf("[e_ambi_a_to_b] Conversion complete. B-format file: %s\n",
-           out_path);
+    LABEL(2, "job:");
+    ORANGE();
+    printw(" %s", job_describe(s->job, desc, sizeof(desc)));
+    CLR();
 }
 
 static void a_to_b_process(Module *m, float *in, unsigned long frames) {
@@ -116,14 +172,17 @@ static void a_to_b_process(Module *m, float *in, unsigned long frames) {
     memset(m->output_buffer, 0, sizeof(float) * frames);
 }
 
-static void a_to_b_destroy(Module *m) { destroy_base_module(m); }
+static void a_to_b_destroy(Module *m) {
+    EAmbiAToB *s = (EAmbiAToB *)m->state;
+    if (s)
+        job_release(s->job);
+    destroy_base_module(m);
+}
 
 Module *create_module(const char *args, float sample_rate) {
     (void)sample_rate;
 
     char filepath[512] = "ambisonic_a_format.wav";
-    unsigned int convert_id = 0;
-    int ch[4] = {0, 1, 2, 3}; // Default to first 4 channels
 
     if (args && strstr(args, "file=")) {
         const char *p = strstr(args, "file=") + 5;
@@ -134,24 +193,15 @@ Module *create_module(const char *args, float sample_rate) {
         filepath[i] = '\0';
     }
 
-    if (args && strstr(args, "id=")) {
-        sscanf(strstr(args, "id="), "id=%u", &convert_id);
-    }
-
-    if (args && strstr(args, "channels=")) {
-        sscanf(strstr(args, "channels="), "channels=%d,%d,%d,%d", &ch[0],
-               &ch[1], &ch[2], &ch[3]);
-    }
-
-    ensure_a_to_b_dir();
-    convert_a_to_b(filepath, convert_id, ch);
-
+    // Runs on a job worker; the module only reports its progress
     EAmbiAToB *s = calloc(1, sizeof(EAmbiAToB));
+    s->job = job_submit(module_job, filepath, args, 0);
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "e_ambi_a_to_b";
     m->state = s;
     m->process = a_to_b_process;
+    m->draw_ui = a_to_b_draw_ui;
     m->destroy = a_to_b_destroy;
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
 
@@ -4,9 +4,10 @@
 #include <pthread.h>
 #include <stdbool.h>
 
+#include "job.h"
+
 typedef struct {
-    // No runtime state needed for this environment module
-    char placeholder;
+    JobCtx *job; // the conversion, run on a job worker
 } EAmbiAToB;
 
 #endif
@@ -1,11 +1,15 @@
 #include <math.h>
+#include <ncurses.h>
 #include <sndfile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#include "dsp.h"
 #include "e_mono_mix.h"
+#include "job.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -18,18 +22,23 @@ static void ensure_mono_dir(void) {
     mkdir(MONO_DIR, 0755);
 }
 
-static void mono_file(const char *filepath) {
+int module_job(JobCtx *ctx, const char *filepath, const char *args,
+               unsigned int index) {
+    (void)args;
+    (void)index;
+    ensure_mono_dir();
+
     SF_INFO info = (SF_INFO){0};
     SNDFILE *in = sf_open(filepath, SFM_READ, &info);
     if (!in) {
-        fprintf(stderr, "[e_mono] failed to open '%s'\n", filepath);
-        return;
+        LOG_ERROR("[e_mono] failed to open '%s'", filepath);
+        return -1;
     }
 
     int channels = info.channels;
     if (channels < 1) {
         sf_close(in);
-        return;
+        return -1;
     }
 
     float *inter = malloc(sizeof(float) * BLOCK_FRAMES * channels);
@@ -54,28 +63,57 @@ static void mono_file(const char *filepath) {
 
     SNDFILE *out = sf_open(outpath, SFM_WRITE, &out_info);
     if (!out) {
+        LOG_ERROR("[e_mono] failed to create '%s'", outpath);
         sf_close(in);
         free(inter);
         free(mono);
-        return;
+        return -1;
     }
 
-    sf_count_t frames;
-    while ((frames = sf_readf_float(in, inter, BLOCK_FRAMES)) > 0) {
-        for (sf_count_t i = 0; i < frames; i++) {
-            float sum = 0.0f;
-            for (int ch = 0; ch < channels; ch++) {
-                sum += inter[i * channels + ch];
-            }
-            mono[i] = sum / (float)channels;
+    double total = info.frames > 0 ? (double)info.frames : 1.0;
+    double done = 0.0;
+    int rc = 0;
+    for (;;) {
+        job_io_begin(ctx);
+        sf_count_t frames = sf_readf_float(in, inter, BLOCK_FRAMES);
+        job_io_end(ctx);
+        if (frames <= 0)
+            break;
+        if (job_cancelled(ctx)) {
+            rc = -1;
+            break;
         }
-        sf_writef_float(out, mono, frames);
+        dsp_downmix(mono, inter, channels, 1.0f / (float)channels,
+                    (unsigned long)frames);
+        job_io_begin(ctx);
+        if (sf_writef_float(out, mono, frames) != frames)
+            rc = -1;
+        job_io_end(ctx);
+        if (rc)
+            break;
+        done += (double)frames;
+        job_progress(ctx, (float)(done / total));
     }
 
     sf_close(in);
     sf_close(out);
     free(inter);
     free(mono);
+    return rc;
+}
+
+static void mono_draw_ui(Module *m, int y, int x) {
+    EMonoMix *s = (EMonoMix *)m->state;
+    char desc[32];
+
+    BLUE();
+    mvprintw(y, x, "[e_mono_mix] ");
+    CLR();
+
+    LABEL(2, "job:");
+    ORANGE();
+    printw(" %s", job_describe(s->job, desc, sizeof(desc)));
+    CLR();
 }
 
 static void mono_process(Module *m, float *in, unsigned long frames) {
@@ -83,7 +121,12 @@ static void mono_process(Module *m, float *in, unsigned long frames) {
     memset(m->output_buffer, 0, sizeof(float) * frames);
 }
 
-static void mono_destroy(Module *m) { destroy_base_module(m); }
+static void mono_destroy(Module *m) {
+    EMonoMix *s = (EMonoMix *)m->state;
+    if (s)
+        job_release(s->job);
+    destroy_base_module(m);
+}
 
 Module *create_module(const char *args, float sample_rate) {
     (void)sample_rate;
@@ -100,20 +143,19 @@ Module *create_module(const char *args, float sample_rate) {
     }
 
     if (filepath[0] == '\0') {
-        fprintf(stderr, "[e_mono] missing file=\n");
+        LOG_ERROR("[e_mono] missing file=");
         return NULL;
     }
 
-    ensure_mono_dir();
-    mono_file(filepath);
-
+    // Runs on a job worker; the module only reports its progress
     EMonoMix *s = calloc(1, sizeof(EMonoMix));
-    s->executed = 1;
+    s->job = job_submit(module_job, filepath, args, 0);
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "e_mono_mix";
     m->state = s;
     m->process = mono_process;
+    m->draw_ui = mono_draw_ui;
     m->destroy = mono_destroy;
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
 
@@ -1,10 +1,11 @@
 #ifndef E_MONO_MIX_H
 #define E_MONO_MIX_H
 
+#include "job.h"
 #include "module.h"
 
 typedef struct {
-    int executed;
+    JobCtx *job;
 } EMonoMix;
 
 Module *create_module(const char *args, float sample_rate);
@@ -1,83 +1,541 @@
+#include <fcntl.h>
 #include <math.h>
+#include <ncurses.h>
 #include <sndfile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include "dsp.h"
 #include "e_normalize.h"
+#include "job.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
 #define E_FILES_DIR "e_output_files"
 #define NORM_DIR "e_output_files/normalize"
-#define BLOCK_FRAMES 4096
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4f_u __attribute__((vector_size(16), aligned(4)));
+typedef int v4i __attribute__((vector_size(16)));
 
 static void ensure_norm_dir(void) {
     mkdir(E_FILES_DIR, 0755);
     mkdir(NORM_DIR, 0755);
 }
 
-static void normalize_file(const char *filepath) {
-    SF_INFO info = (SF_INFO){0};
-    SNDFILE *in = sf_open(filepath, SFM_READ, &info);
-    if (!in) {
-        fprintf(stderr, "[e_normalize] failed to open '%s'\n", filepath);
-        return;
+// --- Virtual I/O over the mapped input ---
+
+static sf_count_t map_filelen(void *user) {
+    return ((MapCursor *)user)->len;
+}
+
+static sf_count_t map_seek(sf_count_t offset, int whence, void *user) {
+    MapCursor *c = (MapCursor *)user;
+    sf_count_t pos = offset;
+    if (whence == SEEK_CUR)
+        pos += c->pos;
+    else if (whence == SEEK_END)
+        pos += c->len;
+    if (pos < 0 || pos > c->len)
+        return -1;
+    c->pos = pos;
+    return pos;
+}
+
+static sf_count_t map_read(void *ptr, sf_count_t count, void *user) {
+    MapCursor *c = (MapCursor *)user;
+    if (count > c->len - c->pos)
+        count = c->len - c->pos;
+    memcpy(ptr, c->data + c->pos, (size_t)count);
+    c->pos += count;
+    return count;
+}
+
+static sf_count_t map_write(const void *ptr, sf_count_t count, void *user) {
+    (void)ptr;
+    (void)count;
+    (void)user;
+    return 0;
+}
+
+static sf_count_t map_tell(void *user) { return ((MapCursor *)user)->pos; }
+
+static SF_VIRTUAL_IO map_vio = {map_filelen, map_seek, map_read, map_write,
+                                map_tell};
+
+static SNDFILE *map_open(const NormScan *sc, MapCursor *cur, SF_INFO *info) {
+    *cur = (MapCursor){sc->map, sc->map_len, 0};
+    *info = (SF_INFO){0};
+    return sf_open_virtual(&map_vio, SFM_READ, info, cur);
+}
+
+// --- Kernels ---
+
+static float abs_max(const float *x, sf_count_t n) {
+    const v4i mask = {0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff};
+    v4f m = {0.0f, 0.0f, 0.0f, 0.0f};
+    sf_count_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4f a = (v4f)((v4i)(*(const v4f_u *)(x + i)) & mask);
+        v4i gt = a > m;
+        m = (v4f)((gt & (v4i)a) | (~gt & (v4i)m));
     }
+    float r = fmaxf(fmaxf(m[0], m[1]), fmaxf(m[2], m[3]));
+    for (; i < n; i++)
+        r = fmaxf(r, fabsf(x[i]));
+    return r;
+}
 
-    float *buf = malloc(sizeof(float) * BLOCK_FRAMES * info.channels);
-    float peak = 0.0f;
+static double sum_squares(const float *x, sf_count_t n) {
+    v4f acc = {0.0f, 0.0f, 0.0f, 0.0f};
+    sf_count_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        v4f a = *(const v4f_u *)(x + i);
+        acc += a * a;
+    }
+    double r = (double)acc[0] + acc[1] + acc[2] + acc[3];
+    for (; i < n; i++)
+        r += (double)x[i] * x[i];
+    return r;
+}
+
+// BS.1770 pre-filter for any rate; at 48 kHz this gives the table values
+static void k_weight_design(NormBiquad kw[2], double rate) {
+    double k = tan(M_PI * 1681.974450955533 / rate);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    kw[0] = (NormBiquad){(vh + vb * k / q + k * k) / a0,
+                         2.0 * (k * k - vh) / a0,
+                         (vh - vb * k / q + k * k) / a0,
+                         2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    k = tan(M_PI * 38.13547087602444 / rate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    kw[1] = (NormBiquad){1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0,
+                         (1.0 - k / q + k * k) / a0};
+}
 
-    sf_count_t frames;
-    while ((frames = sf_readf_float(in, buf, BLOCK_FRAMES)) > 0) {
-        for (sf_count_t i = 0; i < frames * info.channels; i++) {
-            float a = fabsf(buf[i]);
-            if (a > peak)
-                peak = a;
+// state: two transposed direct form II registers per stage
+static void k_weight(const NormBiquad kw[2], double *state, const float *in,
+                     float *out, sf_count_t n) {
+    for (sf_count_t i = 0; i < n; i++) {
+        double x = in[i];
+        for (int s = 0; s < 2; s++) {
+            const NormBiquad *b = &kw[s];
+            double *z = state + 2 * s;
+            double y = b->b0 * x + z[0];
+            z[0] = b->b1 * x - b->a1 * y + z[1];
+            z[1] = b->b2 * x - b->a2 * y;
+            x = y;
         }
+        out[i] = (float)x;
     }
+}
 
-    if (peak <= 0.0f) {
-        sf_close(in);
-        free(buf);
-        return;
+// Peak of the three points between each centre and the next. h holds one
+// channel with the centre for absolute frame `first` at h[NORM_TP_TAPS/2].
+static float true_peak_scan(const Resampler *r, const float *h, int count,
+                            sf_count_t first, sf_count_t start,
+                            sf_count_t end) {
+    float peak = 0.0f;
+    for (int c = 0; c < count; c++) {
+        sf_count_t m = first + c;
+        if (m < start || m >= end)
+            continue;
+        const float *x = h + c + 1; // x[taps/2 - 1] is frame m
+        for (int q = 1; q < 4; q++)
+            peak = fmaxf(peak, fabsf(resampler_interp(r, x, 0.25f * q)));
+    }
+    return peak;
+}
+
+// --- Analysis ---
+
+static void *scan_slice(void *arg) {
+    NormSlice *sl = (NormSlice *)arg;
+    NormScan *sc = sl->scan;
+    const int ch = sc->info.channels;
+    const sf_count_t frames = sc->info.frames;
+    const int half = NORM_TP_TAPS / 2;
+    const int stride = NORM_TP_TAPS + NORM_BLOCK_FRAMES + half;
+
+    MapCursor cur;
+    SF_INFO info;
+    SNDFILE *f = map_open(sc, &cur, &info);
+    if (!f) {
+        sl->rc = -1;
+        return NULL;
+    }
+
+    sf_count_t preroll = sc->info.samplerate / NORM_PREROLL_DIV;
+    sf_count_t pos = sl->start > preroll ? sl->start - preroll : 0;
+    sf_count_t stop = sl->end + half < frames ? sl->end + half : frames;
+    if (pos > 0 && sf_seek(f, pos, SEEK_SET) != pos) {
+        sf_close(f);
+        sl->rc = -1;
+        return NULL;
+    }
+
+    float *inter = dsp_alloc((unsigned long)NORM_BLOCK_FRAMES * ch);
+    float *hist = dsp_alloc((unsigned long)stride * ch);
+    float *kw = dsp_alloc(NORM_BLOCK_FRAMES);
+    double *state = calloc((size_t)ch * 4, sizeof(double));
+    if (!inter || !hist || !kw || !state)
+        sl->rc = -1;
+    float *planes[NORM_MAX_CHANNELS]; // new frames land after the history
+    for (int c = 0; c < ch && hist; c++)
+        planes[c] = hist + (size_t)c * stride + NORM_TP_TAPS;
+
+    while (sl->rc == 0 && pos < stop) {
+        if (job_cancelled(sc->ctx)) {
+            sl->rc = -1;
+            break;
+        }
+        sf_count_t want = stop - pos;
+        if (want > NORM_BLOCK_FRAMES)
+            want = NORM_BLOCK_FRAMES;
+        job_io_begin(sc->ctx);
+        sf_count_t got = sf_readf_float(f, inter, want);
+        job_io_end(sc->ctx);
+        if (got <= 0)
+            break;
+
+        // Part of this block the slice accounts for
+        sf_count_t a = (sl->start > pos ? sl->start : pos) - pos;
+        sf_count_t b = (sl->end < pos + got ? sl->end : pos + got) - pos;
+        if (b > a)
+            sl->peak = fmaxf(sl->peak, abs_max(inter + a * ch, (b - a) * ch));
+
+        int pad = (pos + got == frames) ? half : 0; // flush at end of file
+        dsp_deinterleave(planes, inter, ch, (unsigned long)got);
+        for (int c = 0; c < ch; c++) {
+            float *h = hist + (size_t)c * stride;
+            memset(h + NORM_TP_TAPS + got, 0, (size_t)pad * sizeof(float));
+
+            sf_count_t kn = b > 0 ? b : 0;
+            k_weight(sc->kw, state + 4 * c, h + NORM_TP_TAPS, kw, kn);
+            for (sf_count_t j = a; j < kn && sc->weights[c] > 0.0f;) {
+                sf_count_t s = (pos + j) / sc->step;
+                if (s >= sc->num_steps)
+                    break;
+                sf_count_t e = (s + 1) * sc->step - pos;
+                if (e > kn)
+                    e = kn;
+                sc->energy[s] += sc->weights[c] * sum_squares(kw + j, e - j);
+                j = e;
+            }
+
+            sl->true_peak = fmaxf(
+                sl->true_peak,
+                true_peak_scan(&sc->tp, h, (int)got + pad,
+                               pos - half, sl->start, sl->end));
+            memmove(h, h + got, NORM_TP_TAPS * sizeof(float));
+        }
+
+        pos += got;
+        sf_count_t done = __atomic_add_fetch(&sc->scanned, got,
+                                             __ATOMIC_RELAXED);
+        job_progress(sc->ctx, 0.5f * (float)done / (float)frames);
     }
 
-    float gain = 1.0f / peak;
-    sf_seek(in, 0, SEEK_SET);
+    sf_close(f);
+    free(inter);
+    free(hist);
+    free(kw);
+    free(state);
+    return NULL;
+}
+
+// Gated integrated loudness from 100 ms steps: 400 ms blocks with 75%
+// overlap, -70 LUFS absolute gate, then -10 LU relative gate
+static double integrated_lufs(const NormScan *sc) {
+    if (sc->num_steps < 4)
+        return -INFINITY;
+    sf_count_t blocks = sc->num_steps - 3;
+    double norm = 1.0 / (4.0 * (double)sc->step);
+    double abs_gate = pow(10.0, (-70.0 + 0.691) / 10.0);
+
+    double sum = 0.0;
+    sf_count_t n = 0;
+    for (sf_count_t j = 0; j < blocks; j++) {
+        const double *e = sc->energy + j;
+        double z = (e[0] + e[1] + e[2] + e[3]) * norm;
+        if (z > abs_gate) {
+            sum += z;
+            n++;
+        }
+    }
+    if (n == 0)
+        return -INFINITY;
 
-    const char *fname = strrchr(filepath, '/');
-    fname = fname ? fname + 1 : filepath; // strip path if present
+    double rel_gate = sum / (double)n * pow(10.0, -10.0 / 10.0);
+    sum = 0.0;
+    n = 0;
+    for (sf_count_t j = 0; j < blocks; j++) {
+        const double *e = sc->energy + j;
+        double z = (e[0] + e[1] + e[2] + e[3]) * norm;
+        if (z > abs_gate && z > rel_gate) {
+            sum += z;
+            n++;
+        }
+    }
+    return -0.691 + 10.0 * log10(sum / (double)n);
+}
 
-    char stem[512];
-    strncpy(stem, fname, sizeof(stem));
-    stem[sizeof(stem) - 1] = '\0';
+// L, R, C, (LFE), Ls, Rs for 5.0 and 5.1; every channel at 1 otherwise
+static void channel_weights(float *w, int channels) {
+    for (int c = 0; c < channels; c++)
+        w[c] = 1.0f;
+    if (channels == 5) {
+        w[3] = w[4] = 1.41f;
+    } else if (channels == 6) {
+        w[3] = 0.0f;
+        w[4] = w[5] = 1.41f;
+    }
+}
 
-    char *dot = strrchr(stem, '.');
-    if (dot)
-        *dot = '\0';
+// --- Write pass ---
 
-    char outpath[1024];
-    snprintf(outpath, sizeof(outpath), NORM_DIR "/%s_norm.wav", stem);
+static int write_scaled(NormScan *sc, const char *outpath, float gain) {
+    MapCursor cur;
+    SF_INFO info;
+    SNDFILE *in = map_open(sc, &cur, &info);
+    if (!in)
+        return -1;
 
     SNDFILE *out = sf_open(outpath, SFM_WRITE, &info);
     if (!out) {
+        LOG_ERROR("[e_normalize] failed to create '%s'", outpath);
         sf_close(in);
-        free(buf);
-        return;
+        return -1;
     }
+    sf_command(out, SFC_SET_CLIPPING, NULL, SF_TRUE);
+    madvise((void *)sc->map, (size_t)sc->map_len, MADV_SEQUENTIAL);
 
-    while ((frames = sf_readf_float(in, buf, BLOCK_FRAMES)) > 0) {
-        for (sf_count_t i = 0; i < frames * info.channels; i++) {
-            buf[i] *= gain;
+    const int ch = info.channels;
+    float *buf = dsp_alloc((unsigned long)NORM_BLOCK_FRAMES * ch);
+    double total = info.frames > 0 ? (double)info.frames : 1.0;
+    double done = 0.0;
+    int rc = buf ? 0 : -1;
+    while (rc == 0) {
+        job_io_begin(sc->ctx);
+        sf_count_t frames = sf_readf_float(in, buf, NORM_BLOCK_FRAMES);
+        job_io_end(sc->ctx);
+        if (frames <= 0)
+            break;
+        if (job_cancelled(sc->ctx)) {
+            rc = -1;
+            break;
         }
-        sf_writef_float(out, buf, frames);
+        dsp_scale(buf, buf, gain, (unsigned long)(frames * ch));
+        job_io_begin(sc->ctx);
+        if (sf_writef_float(out, buf, frames) != frames)
+            rc = -1;
+        job_io_end(sc->ctx);
+        done += (double)frames;
+        job_progress(sc->ctx, 0.5f + 0.5f * (float)(done / total));
     }
 
     sf_close(in);
     sf_close(out);
     free(buf);
+    return rc;
+}
+
+// --- Job ---
+
+static NormTarget parse_target(const char *args, float *level) {
+    NormTarget t = NORM_PEAK;
+    const char *p = args ? strstr(args, "target=") : NULL;
+    if (p) {
+        p += 7;
+        if (strncmp(p, "lufs", 4) == 0)
+            t = NORM_LUFS;
+        else if (strncmp(p, "tp", 2) == 0 || strncmp(p, "true", 4) == 0)
+            t = NORM_TRUE_PEAK;
+    }
+
+    static const float defaults[] = {[NORM_PEAK] = 0.0f,
+                                     [NORM_LUFS] = -23.0f,
+                                     [NORM_TRUE_PEAK] = -1.0f};
+    *level = defaults[t];
+    if (args && strstr(args, "level="))
+        sscanf(strstr(args, "level="), "level=%f", level);
+    return t;
+}
+
+static int map_input(NormScan *sc, const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    sc->map = map;
+    sc->map_len = (sf_count_t)st.st_size;
+    return 0;
+}
+
+int module_job(JobCtx *ctx, const char *filepath, const char *args,
+               unsigned int index) {
+    (void)index;
+    ensure_norm_dir();
+
+    float level;
+    NormTarget target = parse_target(args, &level);
+
+    NormScan sc = {0};
+    sc.ctx = ctx;
+    MapCursor cur;
+    SNDFILE *probe = NULL;
+    if (map_input(&sc, filepath) == 0)
+        probe = map_open(&sc, &cur, &sc.info);
+    if (!probe) {
+        LOG_ERROR("[e_normalize] failed to open '%s'", filepath);
+        if (sc.map)
+            munmap((void *)sc.map, (size_t)sc.map_len);
+        return -1;
+    }
+    sf_close(probe);
+
+    const int ch = sc.info.channels;
+    if (ch < 1 || ch > NORM_MAX_CHANNELS || sc.info.frames <= 0) {
+        LOG_ERROR("[e_normalize] unsupported file '%s'", filepath);
+        munmap((void *)sc.map, (size_t)sc.map_len);
+        return -1;
+    }
+
+    k_weight_design(sc.kw, (double)sc.info.samplerate);
+    channel_weights(sc.weights, ch);
+    if (!resampler_init(&sc.tp, RESAMPLE_BEST)) {
+        LOG_ERROR("[e_normalize] out of memory for the resampler");
+        munmap((void *)sc.map, (size_t)sc.map_len);
+        return -1;
+    }
+    sc.step = sc.info.samplerate / NORM_STEP_DIV;
+    if (sc.step < 1)
+        sc.step = 1;
+    sc.num_steps = sc.info.frames / sc.step;
+    sc.energy = calloc((size_t)sc.num_steps + 1, sizeof(double));
+
+    // Slices of whole steps, at least NORM_MIN_SLICE_STEPS each
+    int threads = job_threads(ctx);
+    if (args && strstr(args, "threads="))
+        sscanf(strstr(args, "threads="), "threads=%d", &threads);
+    sf_count_t max_slices = sc.num_steps / NORM_MIN_SLICE_STEPS;
+    if (threads > max_slices)
+        threads = (int)max_slices;
+    if (threads < 1 || !sc.info.seekable)
+        threads = 1;
+
+    NormSlice *slices = calloc((size_t)threads, sizeof(NormSlice));
+    if (!sc.energy || !slices) {
+        LOG_ERROR("[e_normalize] out of memory scanning '%s'", filepath);
+        free(slices);
+        free(sc.energy);
+        munmap((void *)sc.map, (size_t)sc.map_len);
+        return -1;
+    }
+    for (int t = 0; t < threads; t++) {
+        NormSlice *sl = &slices[t];
+        sl->scan = &sc;
+        sl->start = sc.num_steps * t / threads * sc.step;
+        sl->end = sc.num_steps * (t + 1) / threads * sc.step;
+        if (t == threads - 1)
+            sl->end = sc.info.frames;
+    }
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&slices[t].thread, NULL, scan_slice, &slices[t]))
+            slices[t].rc = -2; // not started: run it here instead
+    }
+    scan_slice(&slices[0]);
+
+    float peak = 0.0f, true_peak = 0.0f;
+    int rc = 0;
+    for (int t = 0; t < threads; t++) {
+        if (t > 0 && slices[t].rc == -2) {
+            slices[t].rc = 0;
+            scan_slice(&slices[t]);
+        } else if (t > 0) {
+            pthread_join(slices[t].thread, NULL);
+        }
+        rc |= slices[t].rc;
+        peak = fmaxf(peak, slices[t].peak);
+        true_peak = fmaxf(true_peak, slices[t].true_peak);
+    }
+    true_peak = fmaxf(true_peak, peak);
+    double lufs = integrated_lufs(&sc);
+    free(slices);
+    free(sc.energy);
+
+    float gain = 0.0f;
+    float lin = powf(10.0f, level / 20.0f);
+    if (target == NORM_PEAK && peak > 0.0f)
+        gain = lin / peak;
+    else if (target == NORM_TRUE_PEAK && true_peak > 0.0f)
+        gain = lin / true_peak;
+    else if (target == NORM_LUFS && isfinite(lufs))
+        gain = powf(10.0f, (level - (float)lufs) / 20.0f);
+
+    if (rc == 0 && gain <= 0.0f) {
+        LOG_WARN("[e_normalize] '%s' is silent or too short for loudness",
+                 filepath);
+        rc = -1;
+    }
+
+    if (rc == 0) {
+        LOG_INFO("[e_normalize] %s: peak %.2f dBFS, true peak %.2f dBTP, "
+                 "%.1f LUFS, gain %+.2f dB",
+                 filepath, 20.0f * log10f(peak), 20.0f * log10f(true_peak),
+                 lufs, 20.0f * log10f(gain));
+        if (true_peak * gain > 1.0f)
+            LOG_WARN("[e_normalize] %s: true peak after gain is %+.2f dBTP",
+                     filepath, 20.0f * log10f(true_peak * gain));
+
+        const char *fname = strrchr(filepath, '/');
+        fname = fname ? fname + 1 : filepath; // strip path if present
+
+        char stem[512];
+        strncpy(stem, fname, sizeof(stem));
+        stem[sizeof(stem) - 1] = '\0';
+
+        char *dot = strrchr(stem, '.');
+        if (dot)
+            *dot = '\0';
+
+        char outpath[1024];
+        snprintf(outpath, sizeof(outpath), NORM_DIR "/%s_norm.wav", stem);
+        rc = write_scaled(&sc, outpath, gain);
+    }
+
+    munmap((void *)sc.map, (size_t)sc.map_len);
+    return rc;
+}
+
+static void normalize_draw_ui(Module *m, int y, int x) {
+    ENormalize *s = (ENormalize *)m->state;
+    char desc[32];
+
+    BLUE();
+    mvprintw(y, x, "[e_normalize] ");
+    CLR();
+
+    LABEL(2, "job:");
+    ORANGE();
+    printw(" %s", job_describe(s->job, desc, sizeof(desc)));
+    CLR();
 }
 
 static void normalize_process(Module *m, float *in, unsigned long frames) {
@@ -85,7 +543,12 @@ static void normalize_process(Module *m, float *in, unsigned long frames) {
     memset(m->output_buffer, 0, sizeof(float) * frames);
 }
 
-static void normalize_destroy(Module *m) { destroy_base_module(m); }
+static void normalize_destroy(Module *m) {
+    ENormalize *s = (ENormalize *)m->state;
+    if (s)
+        job_release(s->job);
+    destroy_base_module(m);
+}
 
 Module *create_module(const char *args, float sample_rate) {
     (void)sample_rate;
@@ -102,20 +565,19 @@ Module *create_module(const char *args, float sample_rate) {
     }
 
     if (filepath[0] == '\0') {
-        fprintf(stderr, "[e_normalize] missing file=\n");
+        LOG_ERROR("[e_normalize] missing file=");
         return NULL;
     }
 
-    ensure_norm_dir();
-    normalize_file(filepath);
-
+    // Runs on a job worker; the module only reports its progress
     ENormalize *s = calloc(1, sizeof(ENormalize));
-    s->executed = 1;
+    s->job = job_submit(module_job, filepath, args, 0);
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "e_normalize";
     m->state = s;
     m->process = normalize_process;
+    m->draw_ui = normalize_draw_ui;
     m->destroy = normalize_destroy;
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
 
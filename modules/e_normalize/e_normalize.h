@@ -1,10 +1,70 @@
 #ifndef E_NORMALIZE_H
 #define E_NORMALIZE_H
 
+#include <pthread.h>
+#include <sndfile.h>
+
+#include "job.h"
 #include "module.h"
+#include "util.h"
+
+// The input is mapped once and decoded through libsndfile's virtual I/O,
+// so every analysis thread runs its own decoder over the same pages. The
+// file is cut into slices of whole 100 ms steps; each slice measures the
+// sample peak, the 4x oversampled true peak and the K-weighted energy of
+// its steps (BS.1770), starting a quarter second early so the filters
+// have settled when it reaches its first frame. The steps are gated into
+// integrated loudness once every slice is done, then a single streaming
+// pass writes the file with the gain for the chosen target.
+
+#define NORM_BLOCK_FRAMES 4096
+#define NORM_PREROLL_DIV 4        // pre-roll, 1/N second
+#define NORM_STEP_DIV 10          // loudness step, 1/N second (100 ms)
+#define NORM_MIN_SLICE_STEPS 100  // 10 s: shorter files use fewer threads
+#define NORM_TP_TAPS 32           // RESAMPLE_BEST
+#define NORM_MAX_CHANNELS 64
+
+typedef enum { NORM_PEAK, NORM_LUFS, NORM_TRUE_PEAK } NormTarget;
+
+typedef struct {
+    const unsigned char *data;
+    sf_count_t len;
+    sf_count_t pos;
+} MapCursor;
+
+// K-weighting stages: high shelf, then high pass
+typedef struct {
+    double b0, b1, b2, a1, a2;
+} NormBiquad;
+
+typedef struct {
+    JobCtx *ctx;
+    const unsigned char *map;
+    sf_count_t map_len;
+    SF_INFO info;
+
+    NormBiquad kw[2];
+    float weights[NORM_MAX_CHANNELS]; // BS.1770 channel weights
+    Resampler tp;
+
+    sf_count_t step;
+    sf_count_t num_steps;
+    double *energy; // per step: weighted K-filtered sum of squares
+
+    sf_count_t scanned; // frames, all slices (progress)
+} NormScan;
+
+typedef struct {
+    NormScan *scan;
+    sf_count_t start, end;
+    float peak;
+    float true_peak;
+    int rc;
+    pthread_t thread;
+} NormSlice;
 
 typedef struct {
-    int executed;
+    JobCtx *job;
 } ENormalize;
 
 Module *create_module(const char *args, float sample_rate);
@@ -1,10 +1,14 @@
+#include <ncurses.h>
 #include <sndfile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#include "dsp.h"
 #include "e_polywav_split.h"
+#include "job.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -17,12 +21,21 @@ static void ensure_split_dir(void) {
     mkdir(SPLIT_DIR, 0755);
 }
 
-static void split_polywav(const char *filepath, unsigned int split_id) {
+// Batch files get consecutive ids from id=
+int module_job(JobCtx *ctx, const char *filepath, const char *args,
+               unsigned int index) {
+    unsigned int split_id = 0;
+    if (args && strstr(args, "id=")) {
+        sscanf(strstr(args, "id="), "id=%u", &split_id);
+    }
+    split_id += index;
+    ensure_split_dir();
+
     SF_INFO in_info = (SF_INFO){0};
     SNDFILE *infile = sf_open(filepath, SFM_READ, &in_info);
     if (!infile) {
-        fprintf(stderr, "[e_polywav_splitter] failed to open '%s'\n", filepath);
-        return;
+        LOG_ERROR("[e_polywav_splitter] failed to open '%s'", filepath);
+        return -1;
     }
 
     int channels = in_info.channels;
@@ -33,7 +46,7 @@ static void split_polywav(const char *filepath, unsigned int split_id) {
     SNDFILE **outs = calloc((size_t)channels, sizeof(SNDFILE *));
     if (!outs) {
         sf_close(infile);
-        return;
+        return -1;
     }
 
     for (int ch = 0; ch < channels; ch++) {
@@ -43,37 +56,57 @@ static void split_polywav(const char *filepath, unsigned int split_id) {
 
         outs[ch] = sf_open(path, SFM_WRITE, &out_info);
         if (!outs[ch]) {
-            fprintf(stderr, "[e_polywav_splitter] failed output ch %d\n", ch);
+            LOG_ERROR("[e_polywav_splitter] failed output ch %d", ch);
             for (int k = 0; k < channels; k++)
                 if (outs[k])
                     sf_close(outs[k]);
             free(outs);
             sf_close(infile);
-            return;
+            return -1;
         }
     }
 
     float *inter = malloc(sizeof(float) * BLOCK_FRAMES * (size_t)channels);
-    float *mono = malloc(sizeof(float) * BLOCK_FRAMES);
-    if (!inter || !mono) {
+    float *planar = dsp_alloc((unsigned long)BLOCK_FRAMES * channels);
+    float **planes = calloc((size_t)channels, sizeof(float *));
+    if (!inter || !planar || !planes) {
         for (int k = 0; k < channels; k++)
             if (outs[k])
                 sf_close(outs[k]);
         free(outs);
         sf_close(infile);
         free(inter);
-        free(mono);
-        return;
+        free(planar);
+        free(planes);
+        return -1;
     }
-
-    sf_count_t frames;
-    while ((frames = sf_readf_float(infile, inter, BLOCK_FRAMES)) > 0) {
-        for (int ch = 0; ch < channels; ch++) {
-            for (sf_count_t i = 0; i < frames; i++) {
-                mono[i] = inter[i * channels + ch];
-            }
-            sf_writef_float(outs[ch], mono, frames);
+    for (int ch = 0; ch < channels; ch++)
+        planes[ch] = planar + (size_t)ch * BLOCK_FRAMES;
+
+    double total = in_info.frames > 0 ? (double)in_info.frames : 1.0;
+    double done = 0.0;
+    int rc = 0;
+    for (;;) {
+        job_io_begin(ctx);
+        sf_count_t frames = sf_readf_float(infile, inter, BLOCK_FRAMES);
+        job_io_end(ctx);
+        if (frames <= 0)
+            break;
+        if (job_cancelled(ctx)) {
+            rc = -1;
+            break;
+        }
+        dsp_deinterleave(planes, inter, channels, (unsigned long)frames);
+        for (int ch = 0; ch < channels && !rc; ch++) {
+            job_io_begin(ctx);
+            if (sf_writef_float(outs[ch], planes[ch], frames) != frames)
+                rc = -1;
+            job_io_end(ctx);
         }
+        if (rc)
+            break;
+        done += (double)frames;
+        job_progress(ctx, (float)(done / total));
     }
 
     for (int ch = 0; ch < channels; ch++)
@@ -82,7 +115,23 @@ static void split_polywav(const char *filepath, unsigned int split_id) {
 
     free(outs);
     free(inter);
-    free(mono);
+    free(planar);
+    free(planes);
+    return rc;
+}
+
+static void splitter_draw_ui(Module *m, int y, int x) {
+    EPolywavSplit *s = (EPolywavSplit *)m->state;
+    char desc[32];
+
+    BLUE();
+    mvprintw(y, x, "[e_polywav_split] ");
+    CLR();
+
+    LABEL(2, "job:");
+    ORANGE();
+    printw(" %s", job_describe(s->job, desc, sizeof(desc)));
+    CLR();
 }
 
 static void splitter_process(Module *m, float *in, unsigned long frames) {
@@ -90,13 +139,17 @@ static void splitter_process(Module *m, float *in, unsigned long frames) {
     memset(m->output_buffer, 0, sizeof(float) * frames);
 }
 
-static void splitter_destroy(Module *m) { destroy_base_module(m); }
+static void splitter_destroy(Module *m) {
+    EPolywavSplit *s = (EPolywavSplit *)m->state;
+    if (s)
+        job_release(s->job);
+    destroy_base_module(m);
+}
 
 Module *create_module(const char *args, float sample_rate) {
     (void)sample_rate;
 
     char filepath[512] = "polywav.wav";
-    unsigned int split_id = 0;
 
     if (args && strstr(args, "file=")) {
         const char *p = strstr(args, "file=") + 5;
@@ -107,19 +160,15 @@ Module *create_module(const char *args, float sample_rate) {
         filepath[i] = '\0';
     }
 
-    if (args && strstr(args, "id=")) {
-        sscanf(strstr(args, "id="), "id=%u", &split_id);
-    }
-
-    ensure_split_dir();
-    split_polywav(filepath, split_id);
-
+    // Runs on a job worker; the module only reports its progress
     EPolywavSplit *s = calloc(1, sizeof(EPolywavSplit));
+    s->job = job_submit(module_job, filepath, args, 0);
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "e_polywav_split";
     m->state = s;
     m->process = splitter_process;
+    m->draw_ui = splitter_draw_ui;
     m->destroy = splitter_destroy;
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
 
@@ -1,10 +1,11 @@
 #ifndef E_POLYWAV_SPLIT_H
 #define E_POLYWAV_SPLIT_H
 
+#include "job.h"
 #include "module.h"
 
 typedef struct {
-    int executed;
+    JobCtx *job;
 } EPolywavSplit;
 
 Module *create_module(const char *args, float sample_rate);
@@ -5,12 +5,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include "dsp.h"
 #include "e_recorder.h"
+#include "logger.h"
 #include "module.h"
+#include "trace.h"
 #include "util.h"
 
-#define INITIAL_SECONDS 1.0
 #define E_FILES_DIR "e_output_files"
 #define RECORD_DIR "e_output_files/recordings"
 #define REC_FADE_SAMPLES 256
@@ -20,131 +23,352 @@ static void ensure_record_dir(void) {
     mkdir(RECORD_DIR, 0755);
 }
 
-static void submit_job_locked(ERecorder *s);
+// --- Chunk ring (audio thread side) ---
+
+// The chunk being filled, opening the next free one if needed; NULL when
+// the writer has fallen a full queue behind
+static RecChunk *rec_current(ERecorder *s) {
+    if (!s->chunks)
+        return NULL;
+    RecChunk *c = &s->chunks[s->chunk_write % s->num_chunks];
+    if (s->chunk_open)
+        return c;
+
+    uint32_t rd = __atomic_load_n(&s->chunk_read, __ATOMIC_ACQUIRE);
+    if (s->chunk_write - rd >= s->num_chunks)
+        return NULL;
+
+    c->take_id = s->take_id;
+    c->flags = s->pending_flags;
+    c->frames = 0;
+    c->gap = s->gap_frames;
+    s->pending_flags = 0;
+    s->gap_frames = 0;
+    s->chunk_open = true;
+    return c;
+}
+
+static void rec_publish(ERecorder *s) {
+    s->chunk_open = false;
+    __atomic_store_n(&s->chunk_write, s->chunk_write + 1, __ATOMIC_RELEASE);
+}
 
-static void grow_buffers(ERecorder *s, uint64_t needed) {
-    if (needed <= s->buffer_capacity)
+// Hands a pending end-of-take to the writer, with whatever is buffered
+static void rec_flush_end(ERecorder *s) {
+    if (!(s->pending_flags & REC_CHUNK_END))
         return;
+    RecChunk *c = rec_current(s);
+    if (!c)
+        return; // queue full; retried next block
+    c->flags |= s->pending_flags;
+    s->pending_flags = 0;
+    rec_publish(s);
+}
 
-    uint64_t newcap = s->buffer_capacity;
-    if (newcap == 0)
-        newcap = 1;
-    while (newcap < needed)
-        newcap *= 2;
+static void rec_drop(ERecorder *s, unsigned long frames) {
+    if (!s->dropping) {
+        s->dropping = true;
+        s->dropouts++;
+    }
+    s->dropped_frames += frames;
+    s->gap_frames += frames;
+}
 
-    for (int ch = 0; ch < s->num_inputs; ch++) {
-        float *p = realloc(s->buffers[ch], newcap * sizeof(float));
-        if (!p)
+// Appends n frames of every stem (scaled by `gain` when fading) and the mix
+static void rec_capture(ERecorder *s, Module *m, const float *mix,
+                        const float *gain, unsigned long n) {
+    int stems = s->queue_stems;
+    unsigned long off = 0;
+
+    while (off < n) {
+        RecChunk *c = rec_current(s);
+        if (!c) {
+            rec_drop(s, n - off);
             return;
-        s->buffers[ch] = p;
+        }
+        s->dropping = false;
+
+        unsigned long k = REC_CHUNK_FRAMES - c->frames;
+        if (k > n - off)
+            k = n - off;
+
+        for (int ch = 0; ch < stems; ch++) {
+            float *dst = c->data + (size_t)ch * REC_CHUNK_FRAMES + c->frames;
+            const float *src = (ch < m->num_inputs) ? m->inputs[ch] : NULL;
+            if (!src) {
+                dsp_zero(dst, k);
+            } else if (!gain) {
+                dsp_copy(dst, src + off, k);
+            } else {
+                for (unsigned long j = 0; j < k; j++)
+                    dst[j] = src[off + j] * gain[off + j];
+            }
+        }
+        dsp_copy(c->data + (size_t)stems * REC_CHUNK_FRAMES + c->frames,
+                 mix + off, k);
+
+        c->frames += (uint32_t)k;
+        off += k;
+        if (c->frames == REC_CHUNK_FRAMES)
+            rec_publish(s);
     }
+}
 
-    float *mixp = realloc(s->mix_buffer, newcap * sizeof(float));
-    if (!mixp)
-        return;
-    s->mix_buffer = mixp;
+// Sizes the ring for `stems` inputs. Called without s->lock from the UI/OSC
+// side before a take starts: the new ring is allocated and faulted in
+// first, and the lock is held only to swap it in, so process() never waits
+// on the allocation. The ring is only replaced while the writer has
+// drained it.
+static bool ensure_queue(ERecorder *s, int stems) {
+    if (stems <= 0)
+        return false;
+
+    pthread_mutex_lock(&s->lock);
+    bool ready = s->chunks && s->queue_stems == stems;
+    pthread_mutex_unlock(&s->lock);
+    if (ready)
+        return true;
+
+    uint32_t n = (uint32_t)((REC_QUEUE_SECONDS * s->sample_rate +
+                             REC_CHUNK_FRAMES - 1) /
+                            REC_CHUNK_FRAMES);
+    if (n < 2)
+        n = 2;
+    size_t per_chunk = (size_t)(stems + 1) * REC_CHUNK_FRAMES;
+
+    RecChunk *chunks = calloc(n, sizeof(RecChunk));
+    float *data = malloc((size_t)n * per_chunk * sizeof(float));
+    if (!chunks || !data) {
+        free(chunks);
+        free(data);
+        return false;
+    }
+    // Touch every page now so the audio thread never faults them in
+    memset(data, 0, (size_t)n * per_chunk * sizeof(float));
+    for (uint32_t i = 0; i < n; i++)
+        chunks[i].data = data + (size_t)i * per_chunk;
+
+    pthread_mutex_lock(&s->lock);
+    ready = s->chunks && s->queue_stems == stems;
+    uint32_t rd = __atomic_load_n(&s->chunk_read, __ATOMIC_ACQUIRE);
+    bool drained = !s->chunk_open && rd == s->chunk_write;
+    if (!ready && drained) {
+        RecChunk *old_chunks = s->chunks;
+        float *old_data = s->chunk_data;
+        s->chunks = chunks;
+        s->chunk_data = data;
+        s->num_chunks = n;
+        s->queue_stems = stems;
+        chunks = old_chunks;
+        data = old_data;
+        ready = true;
+    }
+    pthread_mutex_unlock(&s->lock);
 
-    s->buffer_capacity = newcap;
-    s->mix_capacity = newcap;
+    // Whichever ring lost, freed outside the lock
+    free(chunks);
+    free(data);
+    return ready;
 }
 
-static void ensure_buffers(ERecorder *s, int num_inputs) {
-    if (num_inputs <= 0)
-        return;
-    if (s->num_inputs == num_inputs && s->buffers && s->buffer_sizes &&
-        s->mix_buffer)
-        return;
+// --- Writer thread ---
 
-    if (s->buffers) {
-        for (int ch = 0; ch < s->num_inputs; ch++)
-            free(s->buffers[ch]);
-        free(s->buffers);
-        s->buffers = NULL;
+static const char *format_ext(RecFormat f) {
+    switch (f) {
+    case REC_FORMAT_W64:
+        return "w64";
+    case REC_FORMAT_FLAC:
+        return "flac";
+    default:
+        return "wav";
     }
-    if (s->buffer_sizes) {
-        free(s->buffer_sizes);
-        s->buffer_sizes = NULL;
+}
+
+static SNDFILE *open_take_file(const ERecorder *s, const char *path,
+                               int channels) {
+    SF_INFO info = (SF_INFO){0};
+    info.samplerate = (int)s->sample_rate;
+    info.channels = channels;
+
+    switch (s->format) {
+    case REC_FORMAT_W64:
+        info.format = SF_FORMAT_W64 | SF_FORMAT_FLOAT;
+        break;
+    case REC_FORMAT_FLAC:
+        info.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_24;
+        break;
+    default: // WAV and RF64 both write RF64; "wav" downgrades under 4 GB
+        info.format = SF_FORMAT_RF64 | SF_FORMAT_FLOAT;
+        break;
     }
-    if (s->mix_buffer) {
-        free(s->mix_buffer);
-        s->mix_buffer = NULL;
+
+    SNDFILE *sf = sf_open(path, SFM_WRITE, &info);
+    if (!sf) {
+        LOG_ERROR("[e_recorder] cannot create '%s': %s", path,
+                  sf_strerror(NULL));
+        return NULL;
     }
+    if (s->format == REC_FORMAT_WAV)
+        sf_command(sf, SFC_RF64_AUTO_DOWNGRADE, NULL, SF_TRUE);
+    if (s->format == REC_FORMAT_FLAC)
+        sf_command(sf, SFC_SET_CLIPPING, NULL, SF_TRUE);
+    return sf;
+}
 
-    s->num_inputs = num_inputs;
-    s->buffers = calloc((size_t)s->num_inputs, sizeof(float *));
-    s->buffer_sizes = calloc((size_t)s->num_inputs, sizeof(uint64_t));
+static void take_close(RecWriter *w) {
+    if (!w->open)
+        return;
+    for (int i = 0; i < w->num_files; i++) {
+        if (w->files[i])
+            sf_close(w->files[i]);
+    }
+    free(w->files);
+    free(w->inter);
+    w->files = NULL;
+    w->inter = NULL;
+    w->num_files = 0;
+    w->open = false;
+}
 
-    for (int ch = 0; ch < s->num_inputs; ch++) {
-        s->buffers[ch] = calloc((size_t)s->buffer_capacity, sizeof(float));
-        s->buffer_sizes[ch] = 0;
+// Mono files: one per stem, then the mix. Poly: the stems interleaved in
+// file 0, the mix in file 1.
+static void take_open(ERecorder *s, RecWriter *w, unsigned int take_id) {
+    int stems = s->queue_stems;
+    const char *ext = format_ext(s->format);
+
+    w->stems = stems;
+    w->poly = s->poly && stems > 1;
+    if (w->poly && s->format == REC_FORMAT_FLAC && stems > 8) {
+        LOG_WARN("[e_recorder] FLAC holds at most 8 channels; "
+                 "writing %d mono stems",
+                 stems);
+        w->poly = false;
     }
 
-    s->mix_capacity = s->buffer_capacity;
-    s->mix_buffer = calloc((size_t)s->mix_capacity, sizeof(float));
-    s->mix_size = 0;
-}
+    w->num_files = w->poly ? 2 : stems + 1;
+    w->files = calloc((size_t)w->num_files, sizeof(SNDFILE *));
+    if (w->poly)
+        w->inter = malloc((size_t)stems * REC_CHUNK_FRAMES * sizeof(float));
+    w->take_id = take_id;
+    w->since_sync = 0;
+    w->open = true;
+    if (!w->files || (w->poly && !w->inter)) {
+        free(w->files);
+        w->files = NULL;
+        w->num_files = 0;
+        return;
+    }
 
-static void write_wavs_job(float sample_rate, unsigned int take_id,
-                           int num_files, float **buffers, uint64_t *sizes) {
-    for (int i = 0; i < num_files; i++) {
+    for (int i = 0; i < w->num_files; i++) {
         char path[1024];
 
-        if (i == num_files - 1) {
-            snprintf(path, sizeof(path), RECORD_DIR "/sc_take_%03u_mix.wav",
-                     take_id);
+        if (i == w->num_files - 1) {
+            snprintf(path, sizeof(path), RECORD_DIR "/sc_take_%03u_mix.%s",
+                     take_id, ext);
+        } else if (w->poly) {
+            snprintf(path, sizeof(path), RECORD_DIR "/sc_take_%03u.%s",
+                     take_id, ext);
         } else {
-            snprintf(path, sizeof(path), RECORD_DIR "/sc_take_%03u_ch_%02d.wav",
-                     take_id, i);
+            snprintf(path, sizeof(path), RECORD_DIR "/sc_take_%03u_ch_%02d.%s",
+                     take_id, i, ext);
         }
 
-        SF_INFO info = (SF_INFO){0};
-        info.samplerate = (int)sample_rate;
-        info.channels = 1;
-        info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
-
-        SNDFILE *sf = sf_open(path, SFM_WRITE, &info);
-        if (!sf)
-            continue;
-
-        sf_write_float(sf, buffers[i], (sf_count_t)sizes[i]);
-        sf_close(sf);
+        w->files[i] = open_take_file(s, path, (w->poly && i == 0) ? stems : 1);
     }
 }
 
-static void *writer_main(void *arg) {
-    ERecorder *s = (ERecorder *)arg;
+static void take_write(RecWriter *w, int file, const float *data,
+                       uint64_t frames) {
+    SNDFILE *sf = w->files[file];
+    if (sf)
+        sf_writef_float(sf, data, (sf_count_t)frames);
+}
 
-    pthread_mutex_lock(&s->writer_lock);
-    while (s->writer_running) {
-        while (s->writer_running && !s->job_pending) {
-            pthread_cond_wait(&s->writer_cv, &s->writer_lock);
-        }
-        if (!s->writer_running)
-            break;
+// Writes `frames` of planar chunk data, or silence when `data` is NULL;
+// encoding (FLAC, interleaving) happens here on the writer thread
+static void take_write_block(RecWriter *w, const float *data,
+                             uint64_t frames) {
+    if (!w->poly) {
+        for (int i = 0; i < w->num_files; i++)
+            take_write(w, i,
+                       data ? data + (size_t)i * REC_CHUNK_FRAMES : w->zeros,
+                       frames);
+        return;
+    }
 
-        unsigned int take_id = s->job_take_id;
-        int num_files = s->job_num_inputs;
-        float **buffers = s->job_buffers;
-        uint64_t *sizes = s->job_sizes;
-        float sr = s->sample_rate;
+    int stems = w->stems;
+    if (data) {
+        const float *planes[stems];
+        for (int ch = 0; ch < stems; ch++)
+            planes[ch] = data + (size_t)ch * REC_CHUNK_FRAMES;
+        dsp_interleave(w->inter, planes, stems, (unsigned long)frames);
+    } else {
+        memset(w->inter, 0, (size_t)frames * stems * sizeof(float));
+    }
+    take_write(w, 0, w->inter, frames);
+    take_write(w, 1,
+               data ? data + (size_t)stems * REC_CHUNK_FRAMES : w->zeros,
+               frames);
+}
 
-        s->job_pending = false;
-        s->job_buffers = NULL;
-        s->job_sizes = NULL;
-        s->job_num_inputs = 0;
+static void write_chunk(ERecorder *s, RecWriter *w, const RecChunk *c) {
+    if (c->flags & REC_CHUNK_START) {
+        take_close(w);
+        take_open(s, w, c->take_id);
+    }
+    if (!w->open)
+        return;
 
-        pthread_mutex_unlock(&s->writer_lock);
+    // Silence in place of dropped chunks keeps every file the same length
+    for (uint64_t gap = c->gap; gap > 0;) {
+        uint64_t k = gap < REC_CHUNK_FRAMES ? gap : REC_CHUNK_FRAMES;
+        take_write_block(w, NULL, k);
+        gap -= k;
+    }
+    take_write_block(w, c->data, c->frames);
+
+    // Periodic header update and fsync, so a crash loses seconds, not takes
+    w->since_sync += c->gap + c->frames;
+    if (w->since_sync >= (uint64_t)(REC_SYNC_SECONDS * s->sample_rate)) {
+        for (int i = 0; i < w->num_files; i++) {
+            if (!w->files[i])
+                continue;
+            sf_command(w->files[i], SFC_UPDATE_HEADER_NOW, NULL, 0);
+            sf_write_sync(w->files[i]);
+        }
+        w->since_sync = 0;
+    }
 
-        write_wavs_job(sr, take_id, num_files, buffers, sizes);
+    if (c->flags & REC_CHUNK_END)
+        take_close(w);
+}
 
-        for (int i = 0; i < num_files; i++)
-            free(buffers[i]);
-        free(buffers);
-        free(sizes);
+static void *writer_main(void *arg) {
+    ERecorder *s = (ERecorder *)arg;
+    RecWriter *w = &s->writer;
+    trace_set_thread_name("e_recorder writer");
+
+    for (;;) {
+        int running = __atomic_load_n(&s->writer_running, __ATOMIC_ACQUIRE);
+        uint32_t rd = s->chunk_read;
+        uint32_t wr = __atomic_load_n(&s->chunk_write, __ATOMIC_ACQUIRE);
+
+        if (rd == wr) {
+            if (!running)
+                break; // drained
+            usleep(REC_POLL_US);
+            continue;
+        }
 
-        pthread_mutex_lock(&s->writer_lock);
+        TRACE_BEGIN(t0);
+        for (; rd != wr; rd++) {
+            write_chunk(s, w, &s->chunks[rd % s->num_chunks]);
+            __atomic_store_n(&s->chunk_read, rd + 1, __ATOMIC_RELEASE);
+        }
+        TRACE_END(t0, "io", "write_chunks");
     }
-    pthread_mutex_unlock(&s->writer_lock);
+
+    take_close(w);
     return NULL;
 }
 
@@ -156,83 +380,59 @@ static void multirec_process(Module *m, float *in, unsigned long frames) {
 
     float mix_gain = (m->num_inputs > 1) ? (1.0f / (float)m->num_inputs) : 1.0f;
 
-    pthread_mutex_lock(&s->lock);
+    trace_mutex_lock(&s->lock, "e_recorder");
 
-    ensure_buffers(s, m->num_inputs);
+    dsp_mix(out, m->inputs, m->num_inputs, mix_gain, frames);
+    rec_flush_end(s);
 
     if (s->state == EREC_RECORDING) {
-        uint64_t sc = s->sample_counter;
-        uint64_t needed = sc + frames;
-
-        grow_buffers(s, needed);
-
-        unsigned long written = 0;
+        float gain[MAX_BLOCK_SIZE];
+        unsigned long written = frames;
         int stop_now = 0;
-
-        for (unsigned long i = 0; i < frames; i++) {
-            float g = 1.0f;
-
-            if (s->fading_in) {
-                g = (float)s->fade_count / (float)REC_FADE_SAMPLES;
-                s->fade_count++;
-                if (s->fade_count >= REC_FADE_SAMPLES) {
-                    s->fading_in = 0;
-                    g = 1.0f;
+        bool fading = s->fading_in || s->fading_out;
+
+        if (fading) {
+            for (unsigned long i = 0; i < frames; i++) {
+                float g = 1.0f;
+
+                if (s->fading_in) {
+                    g = (float)s->fade_count / (float)REC_FADE_SAMPLES;
+                    s->fade_count++;
+                    if (s->fade_count >= REC_FADE_SAMPLES) {
+                        s->fading_in = 0;
+                        g = 1.0f;
+                    }
+                } else if (s->fading_out) {
+                    g = 1.0f - ((float)s->fade_count / (float)REC_FADE_SAMPLES);
+                    s->fade_count++;
+                    if (s->fade_count >= REC_FADE_SAMPLES) {
+                        s->fading_out = 0;
+                        stop_now = 1;
+                        written = i;
+                        break;
+                    }
                 }
-            } else if (s->fading_out) {
-                g = 1.0f - ((float)s->fade_count / (float)REC_FADE_SAMPLES);
-                s->fade_count++;
-                if (s->fade_count >= REC_FADE_SAMPLES) {
-                    s->fading_out = 0;
-                    stop_now = 1;
-                    break;
-                }
-            }
 
-            float sum = 0.0f;
-
-            for (int ch = 0; ch < m->num_inputs; ch++) {
-                float v = m->inputs[ch] ? m->inputs[ch][i] : 0.0f;
-                if (s->buffers && s->buffers[ch])
-                    s->buffers[ch][sc + written] = v * g;
-                sum += v;
+                gain[i] = g;
+                out[i] *= g;
             }
-
-            float mix = sum * mix_gain * g;
-            out[i] = mix;
-            if (s->mix_buffer)
-                s->mix_buffer[sc + written] = mix;
-
-            written++;
         }
 
         for (unsigned long k = written; k < frames; k++)
             out[k] = 0.0f;
 
-        s->sample_counter += written;
+        rec_capture(s, m, out, fading ? gain : NULL, written);
 
-        for (int ch = 0; ch < s->num_inputs; ch++) {
-            s->buffer_sizes[ch] = s->sample_counter;
-        }
-        s->mix_size = s->sample_counter;
+        s->sample_counter += written;
         s->display_seconds = (double)s->sample_counter / s->sample_rate;
 
         if (stop_now) {
             s->state = EREC_IDLE;
-            submit_job_locked(s);
+            s->pending_flags |= REC_CHUNK_END;
+            rec_flush_end(s);
+            s->take_id++;
             s->sample_counter = 0;
             s->display_seconds = 0.0;
-            for (int ch = 0; ch < s->num_inputs; ch++)
-                s->buffer_sizes[ch] = 0;
-            s->mix_size = 0;
-        }
-    } else {
-        for (unsigned long i = 0; i < frames; i++) {
-            float sum = 0.0f;
-            for (int ch = 0; ch < m->num_inputs; ch++) {
-                sum += m->inputs[ch] ? m->inputs[ch][i] : 0.0f;
-            }
-            out[i] = sum * mix_gain;
         }
     }
 
@@ -246,6 +446,11 @@ static void multirec_draw_ui(Module *m, int y, int x) {
     ERecState st = s->state;
     double sec = s->display_seconds;
     unsigned int take = s->take_id;
+    unsigned int dropouts = s->dropouts;
+    double dropped_sec = (double)s->dropped_frames / s->sample_rate;
+    uint32_t queued = s->chunk_write -
+                      __atomic_load_n(&s->chunk_read, __ATOMIC_RELAXED);
+    uint32_t num_chunks = s->num_chunks;
     pthread_mutex_unlock(&s->lock);
 
     BLUE();
@@ -267,70 +472,59 @@ static void multirec_draw_ui(Module *m, int y, int x) {
     printw(" %03u", take);
     CLR();
 
+    if (num_chunks) {
+        LABEL(2, " | q:");
+        ORANGE();
+        printw(" %u%%", 100u * queued / num_chunks);
+        CLR();
+    }
+    if (dropouts) {
+        LABEL(2, " | drop:");
+        ORANGE();
+        printw(" %u (%.2f s)", dropouts, dropped_sec);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x, "SPACE = rec / stop");
     BLACK();
 }
 
-static void submit_job_locked(ERecorder *s) {
-    uint64_t frames = s->sample_counter;
-    if (frames == 0)
+// Takes s->lock itself, after ensure_queue() has done any allocation
+static void rec_start(ERecorder *s, Module *m) {
+    if (!ensure_queue(s, m->num_inputs)) {
+        LOG_WARN("[e_recorder] cannot start: no inputs or writer busy");
         return;
-
-    int stems = s->num_inputs;
-    int files = stems + 1;
-
-    float **jb = calloc((size_t)files, sizeof(float *));
-    uint64_t *js = calloc((size_t)files, sizeof(uint64_t));
-    if (!jb || !js) {
-        free(jb);
-        free(js);
-        return;
-    }
-
-    for (int ch = 0; ch < stems; ch++) {
-        jb[ch] = malloc((size_t)frames * sizeof(float));
-        if (!jb[ch]) {
-            for (int k = 0; k < ch; k++)
-                free(jb[k]);
-            free(jb);
-            free(js);
-            return;
-        }
-        memcpy(jb[ch], s->buffers[ch], (size_t)frames * sizeof(float));
-        js[ch] = frames;
     }
 
-    jb[stems] = malloc((size_t)frames * sizeof(float));
-    if (!jb[stems]) {
-        for (int k = 0; k < stems; k++)
-            free(jb[k]);
-        free(jb);
-        free(js);
+    pthread_mutex_lock(&s->lock);
+    if (s->state != EREC_IDLE || s->queue_stems != m->num_inputs) {
+        pthread_mutex_unlock(&s->lock);
         return;
     }
-    memcpy(jb[stems], s->mix_buffer, (size_t)frames * sizeof(float));
-    js[stems] = frames;
 
-    pthread_mutex_lock(&s->writer_lock);
-
-    if (s->job_pending) {
-        for (int i = 0; i < s->job_num_inputs; i++)
-            free(s->job_buffers[i]);
-        free(s->job_buffers);
-        free(s->job_sizes);
-    }
-
-    s->job_take_id = s->take_id;
-    s->job_num_inputs = files;
-    s->job_buffers = jb;
-    s->job_sizes = js;
-    s->job_pending = true;
+    s->state = EREC_RECORDING;
+    s->sample_counter = 0;
+    s->display_seconds = 0.0;
+    s->pending_flags = REC_CHUNK_START; // also closes an unfinished take
+    s->gap_frames = 0;
+    s->dropping = false;
+    s->dropouts = 0;
+    s->dropped_frames = 0;
 
-    pthread_cond_signal(&s->writer_cv);
-    pthread_mutex_unlock(&s->writer_lock);
+    s->fade_count = 0;
+    s->fading_in = 1;
+    s->fading_out = 0;
+    pthread_mutex_unlock(&s->lock);
+}
 
-    s->take_id++;
+// With s->lock held
+static void rec_stop(ERecorder *s) {
+    if (s->state == EREC_RECORDING && !s->fading_out) {
+        s->fade_count = 0;
+        s->fading_out = 1;
+        s->fading_in = 0;
+    }
 }
 
 static void multirec_handle_input(Module *m, int key) {
@@ -340,60 +534,27 @@ static void multirec_handle_input(Module *m, int key) {
     ERecorder *s = (ERecorder *)m->state;
 
     pthread_mutex_lock(&s->lock);
-    ensure_buffers(s, m->num_inputs);
-
-    if (s->state == EREC_IDLE) {
-        s->state = EREC_RECORDING;
-        s->sample_counter = 0;
-        s->display_seconds = 0.0;
-        for (int ch = 0; ch < s->num_inputs; ch++)
-            s->buffer_sizes[ch] = 0;
-        s->mix_size = 0;
-
-        s->fade_count = 0;
-        s->fading_in = 1;
-        s->fading_out = 0;
-    } else {
-        if (!s->fading_out) {
-            s->fade_count = 0;
-            s->fading_out = 1;
-            s->fading_in = 0;
-        }
-    }
-
+    bool idle = s->state == EREC_IDLE;
+    if (!idle)
+        rec_stop(s);
     pthread_mutex_unlock(&s->lock);
+
+    if (idle)
+        rec_start(s, m);
 }
 
 static void erecorder_set_osc_param(Module *m, const char *param, float value) {
     ERecorder *s = (ERecorder *)m->state;
-    pthread_mutex_lock(&s->lock);
 
     if (strcmp(param, "rec") == 0) {
         if (value >= 0.5f) {
-            if (s->state == EREC_IDLE) {
-                ensure_buffers(s, m->num_inputs);
-
-                s->state = EREC_RECORDING;
-                s->sample_counter = 0;
-                s->display_seconds = 0.0;
-                for (int ch = 0; ch < s->num_inputs; ch++)
-                    s->buffer_sizes[ch] = 0;
-                s->mix_size = 0;
-
-                s->fade_count = 0;
-                s->fading_in = 1;
-                s->fading_out = 0;
-            }
+            rec_start(s, m);
         } else {
-            if (s->state == EREC_RECORDING && !s->fading_out) {
-                s->fade_count = 0;
-                s->fading_out = 1;
-                s->fading_in = 0;
-            }
+            pthread_mutex_lock(&s->lock);
+            rec_stop(s);
+            pthread_mutex_unlock(&s->lock);
         }
     }
-
-    pthread_mutex_unlock(&s->lock);
 }
 
 static void multirec_destroy(Module *m) {
@@ -401,72 +562,74 @@ static void multirec_destroy(Module *m) {
     if (!s)
         return;
 
-    pthread_mutex_lock(&s->writer_lock);
-    s->writer_running = false;
-    pthread_cond_signal(&s->writer_cv);
-    pthread_mutex_unlock(&s->writer_lock);
-    pthread_join(s->writer_thread, NULL);
+    // Audio has stopped: close out a take still in progress
+    pthread_mutex_lock(&s->lock);
+    if (s->state == EREC_RECORDING) {
+        s->state = EREC_IDLE;
+        s->pending_flags |= REC_CHUNK_END;
+    }
+    pthread_mutex_unlock(&s->lock);
 
-    pthread_mutex_lock(&s->writer_lock);
-    if (s->job_pending) {
-        for (int i = 0; i < s->job_num_inputs; i++)
-            free(s->job_buffers[i]);
-        free(s->job_buffers);
-        free(s->job_sizes);
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        rec_flush_end(s);
+        bool done = !(s->pending_flags & REC_CHUNK_END);
+        pthread_mutex_unlock(&s->lock);
+        if (done)
+            break;
+        usleep(REC_POLL_US);
     }
-    pthread_mutex_unlock(&s->writer_lock);
 
-    pthread_mutex_destroy(&s->writer_lock);
-    pthread_cond_destroy(&s->writer_cv);
+    __atomic_store_n(&s->writer_running, 0, __ATOMIC_RELEASE);
+    pthread_join(s->writer_thread, NULL);
 
-    if (s->buffers) {
-        for (int ch = 0; ch < s->num_inputs; ch++)
-            free(s->buffers[ch]);
-        free(s->buffers);
-    }
-    free(s->buffer_sizes);
-    free(s->mix_buffer);
+    free(s->writer.zeros);
+    free(s->chunks);
+    free(s->chunk_data);
 
     pthread_mutex_destroy(&s->lock);
     destroy_base_module(m);
 }
 
 Module *create_module(const char *args, float sample_rate) {
-    (void)args;
-
     ensure_record_dir();
 
     ERecorder *s = calloc(1, sizeof(ERecorder));
     s->sample_rate = sample_rate;
+
+    // format=wav|rf64|w64|flac, poly=on: one interleaved file for the stems
+    s->format = REC_FORMAT_WAV;
+    if (args && strstr(args, "format=")) {
+        char v[8] = {0};
+        sscanf(strstr(args, "format="), "format=%7[^, ]", v);
+        if (!strcmp(v, "rf64"))
+            s->format = REC_FORMAT_RF64;
+        else if (!strcmp(v, "w64"))
+            s->format = REC_FORMAT_W64;
+        else if (!strcmp(v, "flac"))
+            s->format = REC_FORMAT_FLAC;
+        else if (strcmp(v, "wav") != 0)
+            LOG_WARN("[e_recorder] unknown format '%s', using wav", v);
+    }
+    if (args && strstr(args, "poly=")) {
+        char v[8] = {0};
+        sscanf(strstr(args, "poly="), "poly=%7[^, ]", v);
+        s->poly = !strcmp(v, "1") || !strcmp(v, "on") || !strcmp(v, "yes") ||
+                  !strcmp(v, "true");
+    }
     s->state = EREC_IDLE;
     s->take_id = 0;
     s->sample_counter = 0;
     s->display_seconds = 0.0;
 
-    s->buffer_capacity = (uint64_t)(s->sample_rate * INITIAL_SECONDS);
-
-    s->num_inputs = 0;
-    s->buffers = NULL;
-    s->buffer_sizes = NULL;
-
-    s->mix_capacity = 0;
-    s->mix_buffer = NULL;
-    s->mix_size = 0;
-
     s->fade_count = 0;
     s->fading_in = 0;
     s->fading_out = 0;
 
     pthread_mutex_init(&s->lock, NULL);
 
-    pthread_mutex_init(&s->writer_lock, NULL);
-    pthread_cond_init(&s->writer_cv, NULL);
-    s->writer_running = true;
-    s->job_pending = false;
-    s->job_buffers = NULL;
-    s->job_sizes = NULL;
-    s->job_num_inputs = 0;
-
+    s->writer.zeros = calloc(REC_CHUNK_FRAMES, sizeof(float));
+    s->writer_running = 1;
     pthread_create(&s->writer_thread, NULL, writer_main, s);
 
     Module *m = calloc(1, sizeof(Module));
@@ -477,7 +640,7 @@ Module *create_module(const char *args, float sample_rate) {
     m->handle_input = multirec_handle_input;
     m->set_param = erecorder_set_osc_param;
     m->destroy = multirec_destroy;
-    m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->output_buffer = dsp_alloc(MAX_BLOCK_SIZE);
 
     return m;
 }
@@ -3,32 +3,86 @@
 
 #include "module.h"
 #include <pthread.h>
+#include <sndfile.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+// Takes stream to disk while recording: the audio thread fills fixed-size
+// chunks (every stem plus the mix, planar) from a preallocated ring and the
+// writer thread appends them to the take's files. Memory stays constant
+// however long the take. If the writer falls more than REC_QUEUE_SECONDS
+// behind, chunks are dropped and the gap is written as silence so the
+// stems stay in time; the UI shows how many dropouts the take had.
+
+#define REC_CHUNK_FRAMES 4096
+#define REC_QUEUE_SECONDS 4
+#define REC_SYNC_SECONDS 5 // fsync period, in recorded audio
+#define REC_POLL_US 5000
+
 typedef enum { EREC_IDLE = 0, EREC_RECORDING } ERecState;
 
+// WAV is written as RF64 that downgrades to plain WAV below 4 GB; FLAC is
+// 24-bit, encoded on the writer thread
+typedef enum {
+    REC_FORMAT_WAV = 0,
+    REC_FORMAT_RF64,
+    REC_FORMAT_W64,
+    REC_FORMAT_FLAC
+} RecFormat;
+
+enum { REC_CHUNK_START = 1, REC_CHUNK_END = 2 };
+
+typedef struct {
+    unsigned int take_id;
+    uint32_t flags;
+    uint32_t frames;
+    uint64_t gap; // frames dropped just before this chunk
+    float *data;  // (stems + 1) * REC_CHUNK_FRAMES, mix last
+} RecChunk;
+
+// Writer thread only
+typedef struct {
+    bool open;
+    unsigned int take_id;
+    SNDFILE **files;
+    int num_files;
+    int stems;
+    bool poly;
+    float *inter; // interleave scratch for poly takes
+    uint64_t since_sync;
+    float *zeros;
+} RecWriter;
+
 typedef struct {
     float sample_rate;
+    RecFormat format;
+    bool poly;
 
     ERecState state;
     uint64_t sample_counter;
     unsigned int take_id;
 
-    float **buffers;
-    uint64_t *buffer_sizes;
-    uint64_t buffer_capacity;
-
-    int num_inputs;
-
-    float *mix_buffer;
-    uint64_t mix_capacity;
-    uint64_t mix_size;
-
     int fading_in;
     int fading_out;
     uint32_t fade_count;
 
+    /* chunk ring: `chunk_write` advanced by the audio thread,
+       `chunk_read` by the writer */
+    RecChunk *chunks;
+    float *chunk_data;
+    uint32_t num_chunks;
+    int queue_stems;
+    uint32_t chunk_write;
+    uint32_t chunk_read;
+    bool chunk_open; // chunks[chunk_write % num_chunks] is being filled
+    uint32_t pending_flags;
+    uint64_t gap_frames;
+
+    /* dropout accounting for the current (or last) take */
+    bool dropping;
+    unsigned int dropouts;
+    uint64_t dropped_frames;
+
     /* UI */
     double display_seconds;
 
@@ -37,16 +91,8 @@ typedef struct {
 
     /* writer thread */
     pthread_t writer_thread;
-    pthread_mutex_t writer_lock;
-    pthread_cond_t writer_cv;
-    bool writer_running;
-
-    /* job */
-    bool job_pending;
-    unsigned int job_take_id;
-    int job_num_inputs;
-    float **job_buffers;
-    uint64_t *job_sizes;
+    int writer_running;
+    RecWriter writer;
 } ERecorder;
 
 #endif
@@ -10,6 +10,7 @@
 #include <sys/stat.h>
 
 #include "e_splicer.h"
+#include "logger.h"
 #include "util.h"
 
 #define E_AUDIO_DIR "e_output_files"
@@ -51,33 +52,94 @@ static void normalize_cuts(const ESplicer *s, uint64_t *start, uint64_t *end) {
     }
 }
 
-static int write_wav_interleaved_double(const char *outpath,
-                                        const double *inter, uint64_t frames,
-                                        int channels, int sr) {
+// Streaming output: splices are written SPLICE_CHUNK_FRAMES at a time from
+// the mapped source, so no save allocates more than one chunk
+typedef struct {
+    SNDFILE *sf;
+    const float *src;
+    int channels;
+    float *chunk;
+    bool ok;
+} SpliceOut;
+
+static bool splice_open(SpliceOut *o, const char *outpath, const float *src,
+                        int channels, int sr) {
     SF_INFO info = (SF_INFO){0};
     info.samplerate = sr;
     info.channels = channels;
     info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
 
-    SNDFILE *out = sf_open(outpath, SFM_WRITE, &info);
-    if (!out)
-        return 0;
-
-    const sf_count_t total = (sf_count_t)frames;
-    sf_count_t written = 0;
-    while (written < total) {
-        sf_count_t chunk = total - written;
-        if (chunk > 8192)
-            chunk = 8192;
-        sf_count_t w = sf_writef_double(
-            out, inter + (size_t)written * (size_t)channels, chunk);
-        if (w <= 0)
-            break;
-        written += w;
+    o->src = src;
+    o->channels = channels;
+    o->chunk = malloc((size_t)SPLICE_CHUNK_FRAMES * channels * sizeof(float));
+    o->sf = o->chunk ? sf_open(outpath, SFM_WRITE, &info) : NULL;
+    o->ok = o->sf != NULL;
+    return o->ok;
+}
+
+static bool splice_close(SpliceOut *o) {
+    if (o->sf)
+        sf_close(o->sf);
+    free(o->chunk);
+    return o->ok;
+}
+
+static void splice_flush(SpliceOut *o, uint64_t n) {
+    if (o->ok && sf_writef_float(o->sf, o->chunk, (sf_count_t)n) !=
+                     (sf_count_t)n)
+        o->ok = false;
+}
+
+// n frames from `from` with a linear gain ramp g0 -> g1 (g0 == g1: plain
+// copy); `from` == UINT64_MAX writes silence
+static void splice_span(SpliceOut *o, uint64_t from, uint64_t n, double g0,
+                        double g1) {
+    const int chs = o->channels;
+    for (uint64_t done = 0; done < n && o->ok;) {
+        uint64_t k = n - done;
+        if (k > SPLICE_CHUNK_FRAMES)
+            k = SPLICE_CHUNK_FRAMES;
+        size_t len = (size_t)k * chs;
+
+        if (from == UINT64_MAX) {
+            memset(o->chunk, 0, len * sizeof(float));
+        } else if (g0 == g1 && g0 == 1.0) {
+            memcpy(o->chunk, o->src + (size_t)(from + done) * chs,
+                   len * sizeof(float));
+        } else {
+            const float *src = o->src + (size_t)(from + done) * chs;
+            for (uint64_t i = 0; i < k; i++) {
+                double g = g0 + (g1 - g0) * (double)(done + i) / (double)n;
+                for (int ch = 0; ch < chs; ch++)
+                    o->chunk[i * chs + ch] = (float)(src[i * chs + ch] * g);
+            }
+        }
+        splice_flush(o, k);
+        done += k;
     }
+}
 
-    sf_close(out);
-    return written == total;
+// Equal-power crossfade from the frames at `a` into those at `b`
+static void splice_crossfade(SpliceOut *o, uint64_t a, uint64_t b,
+                             uint64_t n) {
+    const int chs = o->channels;
+    for (uint64_t done = 0; done < n && o->ok;) {
+        uint64_t k = n - done;
+        if (k > SPLICE_CHUNK_FRAMES)
+            k = SPLICE_CHUNK_FRAMES;
+
+        for (uint64_t i = 0; i < k; i++) {
+            double t = (n > 1) ? (double)(done + i) / (double)(n - 1) : 1.0;
+            double ga = cos(t * M_PI * 0.5);
+            double gb = sin(t * M_PI * 0.5);
+            const float *p1 = o->src + (size_t)(a + done + i) * chs;
+            const float *p2 = o->src + (size_t)(b + done + i) * chs;
+            for (int ch = 0; ch < chs; ch++)
+                o->chunk[i * chs + ch] = (float)(p1[ch] * ga + p2[ch] * gb);
+        }
+        splice_flush(o, k);
+        done += k;
+    }
 }
 
 static void derive_stem(const char *filepath, char *stem_out, size_t stem_sz) {
@@ -115,34 +177,21 @@ static void save_inside(ESplicer *s) {
     if (fade == 0)
         fade = 1;
 
-    double *out =
-        (double *)calloc((size_t)frames * (size_t)s->channels, sizeof(double));
-    if (!out) {
-        set_status(s, "oom");
-        return;
-    }
-
-    for (uint64_t i = 0; i < frames; i++) {
-        double g = 1.0;
-        if (i < fade)
-            g = (double)i / (double)fade;
-        else if (i >= frames - fade)
-            g = (double)(frames - i) / (double)fade;
-
-        const double *src = s->data + (size_t)(start + i) * (size_t)s->channels;
-        double *dst = out + (size_t)i * (size_t)s->channels;
-
-        for (int ch = 0; ch < s->channels; ch++)
-            dst[ch] = src[ch] * g;
-    }
-
     char outpath[1024];
     snprintf(outpath, sizeof(outpath), "%s/%s_splice_%llu_%llu.wav", SPLICE_DIR,
              s->stem, (unsigned long long)start, (unsigned long long)end);
 
-    int ok = write_wav_interleaved_double(outpath, out, frames, s->channels,
-                                          s->file_sr);
-    free(out);
+    SpliceOut o;
+    if (splice_open(&o, outpath, s->data, s->channels, s->file_sr)) {
+        if (frames < 2 * fade) { // a single frame
+            splice_span(&o, start, frames, 0.0, 0.0);
+        } else {
+            splice_span(&o, start, fade, 0.0, 1.0);
+            splice_span(&o, start + fade, frames - 2 * fade, 1.0, 1.0);
+            splice_span(&o, end - fade, fade, 1.0, 0.0);
+        }
+    }
+    int ok = splice_close(&o);
     set_status(s, ok ? "saved inside" : "save failed");
 }
 
@@ -174,63 +223,23 @@ static void save_outside(ESplicer *s) {
     if (seg1_frames == 0 || seg2_frames == 0)
         fade = 0;
 
-    uint64_t out_frames = seg1_frames + seg2_frames;
-    if (fade > 0)
-        out_frames -= fade;
-
-    double *out = (double *)calloc((size_t)out_frames * (size_t)s->channels,
-                                   sizeof(double));
-    if (!out) {
-        set_status(s, "oom");
-        return;
-    }
-
-    uint64_t wpos = 0;
     uint64_t pre1 = (fade > 0) ? (seg1_frames - fade) : seg1_frames;
-
-    if (pre1 > 0) {
-        memcpy(out, s->data,
-               (size_t)pre1 * (size_t)s->channels * sizeof(double));
-        wpos += pre1;
-    }
-
-    if (fade > 0) {
-        for (uint64_t i = 0; i < fade; i++) {
-            double t = (double)i / (double)(fade - 1);
-            double a = cos(t * M_PI * 0.5);
-            double b = sin(t * M_PI * 0.5);
-
-            const double *p1 =
-                s->data + (size_t)(pre1 + i) * (size_t)s->channels;
-            const double *p2 =
-                s->data + (size_t)(end + i) * (size_t)s->channels;
-            double *dst = out + (size_t)wpos * (size_t)s->channels;
-
-            for (int ch = 0; ch < s->channels; ch++)
-                dst[ch] = p1[ch] * a + p2[ch] * b;
-
-            wpos++;
-        }
-    }
-
     uint64_t post2_start = end + fade;
     uint64_t post2_frames =
         (s->frames > post2_start) ? (s->frames - post2_start) : 0;
 
-    if (post2_frames > 0) {
-        memcpy(out + (size_t)wpos * (size_t)s->channels,
-               s->data + (size_t)post2_start * (size_t)s->channels,
-               (size_t)post2_frames * (size_t)s->channels * sizeof(double));
-    }
-
     char outpath[1024];
     snprintf(outpath, sizeof(outpath), "%s/%s_outside_%llu_%llu.wav",
              SPLICE_DIR, s->stem, (unsigned long long)start,
              (unsigned long long)end);
 
-    int ok = write_wav_interleaved_double(outpath, out, out_frames, s->channels,
-                                          s->file_sr);
-    free(out);
+    SpliceOut o;
+    if (splice_open(&o, outpath, s->data, s->channels, s->file_sr)) {
+        splice_span(&o, 0, pre1, 1.0, 1.0);
+        splice_crossfade(&o, pre1, end, fade);
+        splice_span(&o, post2_start, post2_frames, 1.0, 1.0);
+    }
+    int ok = splice_close(&o);
     set_status(s, ok ? "saved outside" : "save failed");
 }
 
@@ -249,19 +258,6 @@ static void save_outside_with_silence(ESplicer *s) {
     if (end > s->frames)
         end = s->frames;
 
-    uint64_t out_frames = s->frames;
-
-    double *out = (double *)malloc((size_t)out_frames * (size_t)s->channels *
-                                   sizeof(double));
-    if (!out) {
-        set_status(s, "oom");
-        return;
-    }
-
-    /* copy full file */
-    memcpy(out, s->data,
-           (size_t)out_frames * (size_t)s->channels * sizeof(double));
-
     /* fade length: 10 ms */
     uint64_t fade = (uint64_t)(s->file_sr * 0.010);
     if (fade < 8)
@@ -271,39 +267,47 @@ static void save_outside_with_silence(ESplicer *s) {
     if (fade > (s->frames - end))
         fade = s->frames - end;
 
-    /* fade out BEFORE cut */
-    for (uint64_t i = 0; i < fade; i++) {
-        double g = 1.0 - ((double)i / (double)fade);
-        double *dst = out + (size_t)(start - fade + i) * s->channels;
-        for (int ch = 0; ch < s->channels; ch++)
-            dst[ch] *= g;
-    }
-
-    /* silence region */
-    memset(out + (size_t)start * s->channels, 0,
-           (size_t)(end - start) * s->channels * sizeof(double));
-
-    /* fade in AFTER cut */
-    for (uint64_t i = 0; i < fade; i++) {
-        double g = (double)i / (double)fade;
-        const double *src = s->data + (size_t)(end + i) * s->channels;
-        double *dst = out + (size_t)(end + i) * s->channels;
-        for (int ch = 0; ch < s->channels; ch++)
-            dst[ch] = src[ch] * g;
-    }
-
     char outpath[1024];
     snprintf(outpath, sizeof(outpath), "%s/%s_outside_silence_%llu_%llu.wav",
              SPLICE_DIR, s->stem, (unsigned long long)start,
              (unsigned long long)end);
 
-    int ok = write_wav_interleaved_double(outpath, out, out_frames, s->channels,
-                                          s->file_sr);
-
-    free(out);
+    /* file length retained: fade out, silence, fade in */
+    SpliceOut o;
+    if (splice_open(&o, outpath, s->data, s->channels, s->file_sr)) {
+        splice_span(&o, 0, start - fade, 1.0, 1.0);
+        splice_span(&o, start - fade, fade, 1.0, 0.0);
+        splice_span(&o, UINT64_MAX, end - start, 0.0, 0.0);
+        splice_span(&o, end, fade, 0.0, 1.0);
+        splice_span(&o, end + fade, s->frames - end - fade, 1.0, 1.0);
+    }
+    int ok = splice_close(&o);
     set_status(s, ok ? "saved outside+silence" : "save failed");
 }
 
+// Downmixed, band-limited preview sample at playhead + speed_accum
+static float preview_read(ESplicer *s) {
+    int n = s->rs.taps;
+    int64_t i0 = (int64_t)s->playhead - (n / 2 - 1);
+    float x[RESAMPLE_MAX_TAPS];
+
+    for (int j = 0; j < n; j++) {
+        int64_t idx = i0 + j;
+        if (idx < 0 || idx >= (int64_t)s->frames) {
+            x[j] = 0.0f;
+            continue;
+        }
+        const float *f = s->data + (size_t)idx * (size_t)s->channels;
+        float sum = 0.0f;
+        for (int ch = 0; ch < s->channels; ch++)
+            sum += f[ch];
+        x[j] = sum / (float)s->channels;
+    }
+
+    resampler_set_step(&s->rs, s->playback_speed);
+    return resampler_interp(&s->rs, x, s->speed_accum);
+}
+
 static void splicer_process(Module *m, float *in, unsigned long frames) {
     (void)in;
     ESplicer *s = (ESplicer *)m->state;
@@ -315,14 +319,8 @@ static void splicer_process(Module *m, float *in, unsigned long frames) {
         float y = 0.0f;
 
         if (s->playing && s->frames > 0) {
-            if (s->playhead < s->frames) {
-                const double *f =
-                    s->data + (size_t)s->playhead * (size_t)s->channels;
-                double sum = 0.0;
-                for (int ch = 0; ch < s->channels; ch++)
-                    sum += f[ch];
-                y = (float)(sum / (double)s->channels);
-            }
+            if (s->playhead < s->frames)
+                y = preview_read(s);
 
             s->speed_accum += s->playback_speed;
             uint64_t step = (uint64_t)s->speed_accum;
@@ -341,6 +339,141 @@ static void splicer_process(Module *m, float *in, unsigned long frames) {
     pthread_mutex_unlock(&s->lock);
 }
 
+// --- Overview pyramid ---
+
+static void *pyr_main(void *arg) {
+    ESplicer *s = (ESplicer *)arg;
+    const int chs = s->channels;
+
+    // Level 0 from the mapped source, one pass
+    for (uint64_t b = 0; b < s->pyr_len[0]; b++) {
+        if (__atomic_load_n(&s->pyr_cancel, __ATOMIC_RELAXED))
+            return NULL;
+        uint64_t i0 = b * PYR_BASE;
+        uint64_t i1 = i0 + PYR_BASE;
+        if (i1 > s->frames)
+            i1 = s->frames;
+
+        float mn = 0.0f, mx = 0.0f;
+        double sq = 0.0;
+        for (uint64_t i = i0; i < i1; i++) {
+            const float *f = s->data + (size_t)i * chs;
+            float v = 0.0f;
+            for (int ch = 0; ch < chs; ch++)
+                v += f[ch];
+            v /= (float)chs;
+            if (i == i0 || v < mn)
+                mn = v;
+            if (i == i0 || v > mx)
+                mx = v;
+            sq += (double)v * v;
+        }
+        s->pyr[0][b] = (PyrBucket){mn, mx, (float)sqrt(sq / (double)(i1 - i0))};
+        __atomic_store_n(&s->pyr_progress, i1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&s->pyr_ready, 1, __ATOMIC_RELEASE);
+
+    // Each coarser level folds 4 buckets of the one below
+    for (int l = 1; l < PYR_LEVELS; l++) {
+        const PyrBucket *src = s->pyr[l - 1];
+        uint64_t n_src = s->pyr_len[l - 1];
+        for (uint64_t b = 0; b < s->pyr_len[l]; b++) {
+            uint64_t j1 = b * 4 + 4;
+            if (j1 > n_src)
+                j1 = n_src;
+            PyrBucket o = src[b * 4];
+            float sq = o.rms * o.rms;
+            for (uint64_t j = b * 4 + 1; j < j1; j++) {
+                if (src[j].min < o.min)
+                    o.min = src[j].min;
+                if (src[j].max > o.max)
+                    o.max = src[j].max;
+                sq += src[j].rms * src[j].rms;
+            }
+            o.rms = sqrtf(sq / (float)(j1 - b * 4));
+            s->pyr[l][b] = o;
+        }
+        __atomic_store_n(&s->pyr_ready, l + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// Peak and RMS of frames [lo, hi) from the coarsest ready level whose
+// buckets fit the span, so each call touches a handful of buckets
+static void pyr_query(const ESplicer *s, int ready, uint64_t lo, uint64_t hi,
+                      float *peak, float *rms) {
+    *peak = 0.0f;
+    *rms = 0.0f;
+    if (hi <= lo || ready == 0)
+        return;
+
+    int l = 0;
+    while (l + 1 < ready && ((uint64_t)PYR_BASE << (2 * (l + 1))) <= hi - lo)
+        l++;
+    uint64_t size = (uint64_t)PYR_BASE << (2 * l);
+    uint64_t b0 = lo / size;
+    uint64_t b1 = (hi + size - 1) / size;
+    if (b1 > s->pyr_len[l])
+        b1 = s->pyr_len[l];
+
+    float sq = 0.0f;
+    for (uint64_t b = b0; b < b1; b++) {
+        const PyrBucket *p = &s->pyr[l][b];
+        float a = fmaxf(fabsf(p->min), fabsf(p->max));
+        if (a > *peak)
+            *peak = a;
+        sq += p->rms * p->rms;
+    }
+    if (b1 > b0)
+        *rms = sqrtf(sq / (float)(b1 - b0));
+}
+
+// One row of SPLICE_VIEW_COLS columns over frames [lo, hi), with the
+// playhead and cut markers
+static void draw_wave_row(const ESplicer *s, int ready, int y, int x,
+                          const char *label, uint64_t lo, uint64_t hi,
+                          uint64_t ph, bool a_set, uint64_t a, bool b_set,
+                          uint64_t b) {
+    static const char ramp[] = " .:-=+*#%@";
+    const int steps = (int)sizeof(ramp) - 2;
+    char row[SPLICE_VIEW_COLS + 1];
+    double span = (double)(hi - lo) / SPLICE_VIEW_COLS;
+
+    for (int c = 0; c < SPLICE_VIEW_COLS; c++) {
+        uint64_t c0 = lo + (uint64_t)(c * span);
+        uint64_t c1 = lo + (uint64_t)((c + 1) * span);
+        if (c1 <= c0)
+            c1 = c0 + 1;
+        float peak, rms;
+        pyr_query(s, ready, c0, c1, &peak, &rms);
+        int k = (int)(sqrtf(fminf(peak, 1.0f)) * steps + 0.5f);
+        row[c] = ramp[k];
+    }
+    row[SPLICE_VIEW_COLS] = '\0';
+
+    mvprintw(y, x, "%-5s", label);
+    printw("[%s]", row);
+
+    int x0 = x + 6;
+    if (hi > lo) {
+        if (a_set && a >= lo && a < hi) {
+            ORANGE();
+            mvprintw(y, x0 + (int)((a - lo) / span), "A");
+            CLR();
+        }
+        if (b_set && b >= lo && b < hi) {
+            ORANGE();
+            mvprintw(y, x0 + (int)((b - lo) / span), "B");
+            CLR();
+        }
+        if (ph >= lo && ph < hi) {
+            YELLOW();
+            mvprintw(y, x0 + (int)((ph - lo) / span), "|");
+            CLR();
+        }
+    }
+}
+
 static void splicer_draw_ui(Module *m, int y, int x) {
     ESplicer *s = (ESplicer *)m->state;
 
@@ -406,22 +539,42 @@ static void splicer_draw_ui(Module *m, int y, int x) {
         printw("B=--");
     }
 
+    int ready = __atomic_load_n(&s->pyr_ready, __ATOMIC_ACQUIRE);
+    if (ready > 0) {
+        uint64_t zoom = (uint64_t)(SPLICE_ZOOM_SECONDS * sr);
+        uint64_t zlo = ph > zoom / 2 ? ph - zoom / 2 : 0;
+        uint64_t zhi = zlo + zoom;
+        if (zhi > frames) {
+            zhi = frames;
+            zlo = zhi > zoom ? zhi - zoom : 0;
+        }
+        draw_wave_row(s, ready, y + 2, x, "all", 0, frames, ph, a_set, a,
+                      b_set, b);
+        draw_wave_row(s, ready, y + 3, x, "zoom", zlo, zhi, ph, a_set, a,
+                      b_set, b);
+    } else {
+        uint64_t done = __atomic_load_n(&s->pyr_progress, __ATOMIC_RELAXED);
+        mvprintw(y + 2, x, "building overview %d%%",
+                 frames ? (int)(100 * done / frames) : 0);
+    }
+
     YELLOW();
-    mvprintw(y + 2, x,
+    mvprintw(y + 4, x,
              "keys: -/= scrub | _/+ fast | [/] speed | SPACE play | c cut");
-    mvprintw(y + 3, x, "s save-in | S save-out | x cut-out | R reset | : cmd");
-    mvprintw(y + 4, x, "cmd: 1 <sec> | 2 <sample> | 3 <speed>");
+    mvprintw(y + 5, x, "s save-in | S save-out | x cut-out | R reset | : cmd");
+    mvprintw(y + 6, x, "cmd: 1 <sec> | 2 <sample> | 3 <speed>");
     BLACK();
 
     if (cmd)
-        mvprintw(y + 5, x, ": %s", cmdline);
+        mvprintw(y + 7, x, ": %s", cmdline);
     else
-        mvprintw(y + 5, x, "status: %s", status);
+        mvprintw(y + 7, x, "status: %s", status);
 }
 
 static void splicer_handle_input(Module *m, int key) {
     ESplicer *s = (ESplicer *)m->state;
     int handled = 0;
+    int save = 0;
 
     pthread_mutex_lock(&s->lock);
 
@@ -488,17 +641,13 @@ static void splicer_handle_input(Module *m, int key) {
             break;
 
         case 's':
-            save_inside(s);
-            handled = 1;
-            break;
-
         case 'S':
-            save_outside(s);
+            save = key;
             handled = 1;
             break;
 
         case 'X':
-            save_outside_with_silence(s);
+            save = key;
             s->playing = false;
             s->speed_accum = 0.0f;
             clamp_params(s);
@@ -568,12 +717,27 @@ static void splicer_handle_input(Module *m, int key) {
     if (handled)
         clamp_params(s);
     pthread_mutex_unlock(&s->lock);
+
+    // Saves stream from the read-only map and only touch UI-thread state,
+    // so playback carries on while they run
+    if (save == 's')
+        save_inside(s);
+    else if (save == 'S')
+        save_outside(s);
+    else if (save == 'X')
+        save_outside_with_silence(s);
 }
 
 static void splicer_destroy(Module *m) {
     ESplicer *s = (ESplicer *)m->state;
+    if (s->pyr_started) {
+        __atomic_store_n(&s->pyr_cancel, 1, __ATOMIC_RELAXED);
+        pthread_join(s->pyr_thread, NULL);
+    }
+    for (int l = 0; l < PYR_LEVELS; l++)
+        free(s->pyr[l]);
     pthread_mutex_destroy(&s->lock);
-    free(s->data);
+    sample_pool_release(s->sample);
     destroy_base_module(m);
 }
 
@@ -589,49 +753,30 @@ Module *create_module(const char *args, float sample_rate) {
     }
 
     if (!filepath[0]) {
-        fprintf(stderr, "[e_splicer] missing file=\n");
+        LOG_ERROR("[e_splicer] missing file=");
         return NULL;
     }
 
-    SF_INFO info = (SF_INFO){0};
-    SNDFILE *in = sf_open(filepath, SFM_READ, &info);
-    if (!in) {
-        fprintf(
-            stderr,
-            "[e_splicer] failed to open wav file '%s' or file is not mono.\n",
+    const Sample *sample =
+        sample_pool_acquire(filepath, SAMPLE_INTERLEAVED, true);
+    if (!sample) {
+        LOG_ERROR(
+            "[e_splicer] failed to open wav file '%s' or file is not mono.",
             filepath);
-        if (in)
-            sf_close(in);
         exit(1);
     }
 
-    if (info.frames <= 0 || info.channels <= 0 || info.samplerate <= 0) {
-        fprintf(stderr, "[e_splicer] bad file\n");
-        sf_close(in);
-        return NULL;
-    }
-
-    if (info.samplerate != (int)sample_rate) {
-        fprintf(stderr,
-                "[e_splicer] sample-rate mismatch: engine=%.0f file=%d\n",
-                sample_rate, info.samplerate);
-        sf_close(in);
-        return NULL;
-    }
-
-    double *data = (double *)malloc((size_t)info.frames *
-                                    (size_t)info.channels * sizeof(double));
-    if (!data) {
-        fprintf(stderr, "[e_splicer] out of memory\n");
-        sf_close(in);
+    if (sample->frames == 0 || sample->channels <= 0 ||
+        sample->samplerate <= 0) {
+        LOG_ERROR("[e_splicer] bad file");
+        sample_pool_release(sample);
         return NULL;
     }
 
-    sf_count_t got = sf_readf_double(in, data, info.frames);
-    sf_close(in);
-    if (got != info.frames) {
-        fprintf(stderr, "[e_splicer] read failed\n");
-        free(data);
+    if (sample->samplerate != (int)sample_rate) {
+        LOG_ERROR("[e_splicer] sample-rate mismatch: engine=%.0f file=%d",
+                  sample_rate, sample->samplerate);
+        sample_pool_release(sample);
         return NULL;
     }
 
@@ -640,16 +785,23 @@ Module *create_module(const char *args, float sample_rate) {
     ESplicer *s = (ESplicer *)calloc(1, sizeof(ESplicer));
     pthread_mutex_init(&s->lock, NULL);
 
-    s->data = data;
-    s->frames = (uint64_t)info.frames;
-    s->channels = info.channels;
-    s->file_sr = info.samplerate;
-    s->format = info.format;
+    s->sample = sample;
+    s->data = sample->data;
+    s->frames = sample->frames;
+    s->channels = sample->channels;
+    s->file_sr = sample->samplerate;
 
     s->playhead = 0;
     s->playing = false;
     s->playback_speed = 1.0f;
     s->speed_accum = 0.0f;
+    if (!resampler_init(&s->rs, resampler_parse_quality(args))) {
+        LOG_ERROR("[e_splicer] out of memory for the resampler");
+        pthread_mutex_destroy(&s->lock);
+        sample_pool_release(sample);
+        free(s);
+        return NULL;
+    }
 
     s->cut_a_set = false;
     s->cut_b_set = false;
@@ -664,6 +816,18 @@ Module *create_module(const char *args, float sample_rate) {
 
     set_status(s, "ready");
 
+    uint64_t buckets = (s->frames + PYR_BASE - 1) / PYR_BASE;
+    bool pyr_ok = true;
+    for (int l = 0; l < PYR_LEVELS; l++) {
+        s->pyr_len[l] = buckets;
+        s->pyr[l] = malloc((size_t)buckets * sizeof(PyrBucket));
+        pyr_ok = pyr_ok && s->pyr[l];
+        buckets = (buckets + 3) / 4;
+    }
+    if (pyr_ok)
+        s->pyr_started =
+            pthread_create(&s->pyr_thread, NULL, pyr_main, s) == 0;
+
     Module *m = (Module *)calloc(1, sizeof(Module));
     m->name = "e_splicer";
     m->state = s;
@@ -6,15 +6,36 @@
 #include <stdint.h>
 
 #include "module.h"
+#include "sample_pool.h"
+#include "util.h"
+
+// The source is read from the sample pool's memory-mapped float cache
+// (interleaved, e_output_files/sample_cache/), so loading a long recording
+// costs page faults rather than a full decode into RAM. A background thread
+// folds the downmix into a min/max/RMS pyramid, PYR_BASE frames per bucket
+// at level 0 and 4x coarser per level, which the overview and zoom rows
+// read at O(screen width) whatever the file length.
+
+#define PYR_LEVELS 5 // 256 .. 65536 frames per bucket
+#define PYR_BASE 256
+#define SPLICE_VIEW_COLS 64
+#define SPLICE_ZOOM_SECONDS 4.0
+#define SPLICE_CHUNK_FRAMES 8192 // save granularity
+
+typedef struct {
+    float min;
+    float max;
+    float rms;
+} PyrBucket;
 
 typedef struct {
     pthread_mutex_t lock;
 
-    double *data;
+    const Sample *sample;
+    const float *data; // interleaved, read-only
     uint64_t frames;
     int channels;
     int file_sr;
-    int format;
     int valid;
     char error[128];
 
@@ -22,6 +43,7 @@ typedef struct {
     bool playing;
     float playback_speed;
     float speed_accum;
+    Resampler rs;
 
     bool cut_a_set;
     bool cut_b_set;
@@ -37,6 +59,15 @@ typedef struct {
 
     char status[128];
 
+    /* overview pyramid, written by pyr_thread then read-only */
+    PyrBucket *pyr[PYR_LEVELS];
+    uint64_t pyr_len[PYR_LEVELS];
+    int pyr_ready;         // levels complete, 0..PYR_LEVELS
+    uint64_t pyr_progress; // frames scanned into level 0
+    int pyr_cancel;
+    pthread_t pyr_thread;
+    bool pyr_started;
+
 } ESplicer;
 
 Module *create_module(const char *args, float sample_rate);
@@ -0,0 +1,422 @@
+#include <math.h>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp.h"
+#include "fdn_reverb.h"
+#include "logger.h"
+#include "module.h"
+#include "util.h"
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef int v4i __attribute__((vector_size(16)));
+
+#ifdef __clang__
+#define SHUF(a, i, j, k, l) __builtin_shufflevector(a, a, i, j, k, l)
+#else
+#define SHUF(a, i, j, k, l) __builtin_shuffle(a, (v4i){i, j, k, l})
+#endif
+
+#define FDN_TUNING_RATE 48000.0f // rate the delay lengths are for
+#define FDN_MOD_MS 0.2f          // modulation depth either way
+
+// Mutually prime lengths at FDN_TUNING_RATE, 15 to 57 ms; eight lines
+// take every other one
+static const int fdn_lengths[FDN_MAX_LINES] = {
+    743,  827,  919,  1031, 1153, 1277, 1399, 1523,
+    1667, 1801, 1949, 2099, 2251, 2399, 2557, 2729};
+
+// Input and output sign patterns; the outputs' are orthogonal, so left and
+// right are decorrelated taps on the same tank
+static const float in_sign[FDN_MAX_LINES] = {1, -1, 1, 1,  -1, 1, -1, -1,
+                                             1, 1,  -1, 1, 1,  -1, -1, 1};
+static const float out_sign[2][FDN_MAX_LINES] = {
+    {1, 1, -1, 1, -1, -1, 1, -1, 1, -1, -1, -1, 1, 1, 1, -1},
+    {1, -1, 1, 1, 1, -1, -1, -1, -1, 1, -1, 1, -1, 1, 1, 1}};
+
+static int pow2_above(int n) {
+    int size = 1;
+    while (size <= n)
+        size <<= 1;
+    return size;
+}
+
+// Unnormalized Hadamard transform over 4 * vecs lanes: two butterfly
+// stages inside each vector, then whole vectors against each other
+static inline void fwht(v4f *x, int vecs) {
+    const v4f odd = {1.0f, -1.0f, 1.0f, -1.0f};
+    const v4f high = {1.0f, 1.0f, -1.0f, -1.0f};
+    for (int v = 0; v < vecs; v++) {
+        v4f t = x[v];
+        t = SHUF(t, 0, 0, 2, 2) + SHUF(t, 1, 1, 3, 3) * odd;
+        x[v] = SHUF(t, 0, 1, 0, 1) + SHUF(t, 2, 3, 2, 3) * high;
+    }
+    for (int h = 1; h < vecs; h <<= 1) {
+        for (int v = 0; v < vecs; v += 2 * h) {
+            for (int k = v; k < v + h; k++) {
+                v4f a = x[k], b = x[k + h];
+                x[k] = a + b;
+                x[k + h] = a - b;
+            }
+        }
+    }
+}
+
+static void fdn_reverb_process(Module *m, float *in, unsigned long frames) {
+    FdnReverb *s = (FdnReverb *)m->state;
+    float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
+    float *input_r = (m->num_inputs > 1) ? m->inputs[1] : input;
+
+    pthread_mutex_lock(&s->lock);
+    float base_fb = s->feedback;
+    float base_damp = s->damping;
+    float base_wet = s->wet;
+    pthread_mutex_unlock(&s->lock);
+
+    float fb_s = process_smoother(&s->smooth_feedback, base_fb);
+    float damp_s = process_smoother(&s->smooth_damping, base_damp);
+    float wet_s = process_smoother(&s->smooth_wet, base_wet);
+
+    float disp_fb = fb_s;
+    float disp_damp = damp_s;
+    float disp_wet = wet_s;
+
+    // Four lines per vector; lane state lives in registers for the block
+    const int vecs = s->lines / 4;
+    const int lines = s->lines;
+    const int mask = s->mask;
+    const size_t bytes = sizeof(float) * lines;
+    float *ring = s->ring;
+    v4f lp[FDN_MAX_LINES / 4], mc[FDN_MAX_LINES / 4], ms[FDN_MAX_LINES / 4];
+    v4f rc[FDN_MAX_LINES / 4], rs[FDN_MAX_LINES / 4];
+    v4f centre[FDN_MAX_LINES / 4], sgn[FDN_MAX_LINES / 4];
+    v4f osl[FDN_MAX_LINES / 4], osr[FDN_MAX_LINES / 4];
+    memcpy(lp, s->lowpass, bytes);
+    memcpy(mc, s->mod_cos, bytes);
+    memcpy(ms, s->mod_sin, bytes);
+    memcpy(rc, s->rot_cos, bytes);
+    memcpy(rs, s->rot_sin, bytes);
+    memcpy(centre, s->delay, bytes);
+    memcpy(sgn, in_sign, bytes);
+    memcpy(osl, out_sign[0], bytes);
+    memcpy(osr, out_sign[1], bytes);
+    const float depth = s->depth;
+    // Hadamard scaled to be orthonormal; the output gain keeps the wet
+    // level of eight lines at freeverb's and independent of the line count
+    const float norm = 1.0f / sqrtf((float)lines);
+    const float out_gain = 1.0f / sqrtf(8.0f * lines);
+
+    for (unsigned long i = 0; i < frames; i++) {
+        float fb = fb_s;
+        float damp = damp_s;
+        float wet = wet_s;
+
+        for (int j = 0; j < m->num_control_inputs; j++) {
+
+            if (!m->control_inputs[j] || !m->control_input_params[j])
+                continue;
+
+            const char *param = m->control_input_params[j];
+            float control = m->control_inputs[j][i];
+            control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+            if (strcmp(param, "fb") == 0) {
+                fb += control;
+            } else if (strcmp(param, "damp") == 0) {
+                damp += control;
+            } else if (strcmp(param, "wet") == 0) {
+                wet += control;
+            }
+        }
+
+        clampf(&fb, 0.0f, 0.99f);
+        clampf(&damp, 0.0f, 1.0f);
+        clampf(&wet, 0.0f, 1.0f);
+
+        disp_fb = fb;
+        disp_damp = damp;
+        disp_wet = wet;
+
+        float in_l = input ? input[i] : 0.0f;
+        float in_r = input_r ? input_r[i] : 0.0f;
+
+        // Read each line a modulated distance back with linear
+        // interpolation, damp, and tap the outputs
+        unsigned pos = s->pos++;
+        v4f y[FDN_MAX_LINES / 4];
+        v4f acc_l = {0.0f, 0.0f, 0.0f, 0.0f};
+        v4f acc_r = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int v = 0; v < vecs; v++) {
+            v4f c = mc[v], sn = ms[v];
+            mc[v] = c * rc[v] - sn * rs[v];
+            ms[v] = sn * rc[v] + c * rs[v];
+
+            // Whole and fractional delays in vector, then gather the two
+            // neighbouring rows of each lane
+            v4f d = centre[v] + depth * sn;
+            v4i n = __builtin_convertvector(d, v4i);
+            v4f frac = d - __builtin_convertvector(n, v4f);
+            v4i back = (int)pos - n;
+            v4i lane = 4 * v + (v4i){0, 1, 2, 3};
+            v4i at = (back & mask) * lines + lane;
+            v4i prev = ((back - 1) & mask) * lines + lane;
+            v4f a = {ring[at[0]], ring[at[1]], ring[at[2]], ring[at[3]]};
+            v4f b = {ring[prev[0]], ring[prev[1]], ring[prev[2]],
+                     ring[prev[3]]};
+            v4f out = a + frac * (b - a);
+
+            lp[v] = out * (1.0f - damp) + lp[v] * damp;
+            y[v] = lp[v];
+            acc_l += lp[v] * osl[v];
+            acc_r += lp[v] * osr[v];
+        }
+
+        // Mix through the matrix and feed back; even lines take the left
+        // input, odd the right
+        fwht(y, vecs);
+        const v4f feed = {in_l, in_r, in_l, in_r};
+        float *row = ring + (size_t)(pos & mask) * lines;
+        for (int v = 0; v < vecs; v++)
+            *(v4f *)(row + 4 * v) = feed * sgn[v] + y[v] * (fb * norm);
+
+        float dry = 1.0f - wet;
+        float out_l = dry * in_l + wet * out_gain *
+                                       (acc_l[0] + acc_l[1] + acc_l[2] +
+                                        acc_l[3]);
+        float out_r = dry * in_r + wet * out_gain *
+                                       (acc_r[0] + acc_r[1] + acc_r[2] +
+                                        acc_r[3]);
+        m->output_bufferL[i] = out_l;
+        m->output_bufferR[i] = out_r;
+        m->output_buffer[i] = 0.5f * (out_l + out_r);
+    }
+
+    // Keep the phasors on the unit circle against rounding drift
+    for (int v = 0; v < vecs; v++) {
+        v4f g = 1.5f - 0.5f * (mc[v] * mc[v] + ms[v] * ms[v]);
+        mc[v] *= g;
+        ms[v] *= g;
+    }
+    memcpy(s->lowpass, lp, bytes);
+    memcpy(s->mod_cos, mc, bytes);
+    memcpy(s->mod_sin, ms, bytes);
+
+    pthread_mutex_lock(&s->lock);
+    s->display_feedback = disp_fb;
+    s->display_damping = disp_damp;
+    s->display_wet = disp_wet;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void clamp_params(FdnReverb *s) {
+    clampf(&s->feedback, 0.0f, 0.99f);
+    clampf(&s->damping, 0.0f, 1.0f);
+    clampf(&s->wet, 0.0f, 1.0f);
+}
+
+static void fdn_reverb_draw_ui(Module *m, int y, int x) {
+    FdnReverb *s = (FdnReverb *)m->state;
+    float fb, damp, wet;
+
+    pthread_mutex_lock(&s->lock);
+    fb = s->display_feedback;
+    damp = s->display_damping;
+    wet = s->display_wet;
+    pthread_mutex_unlock(&s->lock);
+
+    BLUE();
+    mvprintw(y, x, "[FDN Reverb:%s] ", m->name);
+    CLR();
+
+    LABEL(2, "fb:");
+    ORANGE();
+    printw(" %.2f | ", fb);
+    CLR();
+
+    LABEL(2, "damp:");
+    ORANGE();
+    printw(" %.2f | ", damp);
+    CLR();
+
+    LABEL(2, "wet:");
+    ORANGE();
+    printw(" %.2f | %d lines", wet, s->lines);
+    CLR();
+
+    YELLOW();
+    mvprintw(y + 1, x, "Keys: -/= fb, _/+ damp, [/] wet");
+    mvprintw(y + 2, x, "Cmd: :1 [fb], :2 [damp], :3 [wet]");
+    BLACK();
+}
+
+static void fdn_reverb_handle_input(Module *m, int key) {
+    FdnReverb *s = (FdnReverb *)m->state;
+    int handled = 0;
+
+    pthread_mutex_lock(&s->lock);
+
+    if (!s->entering_command) {
+        switch (key) {
+        case '-':
+            s->feedback -= 0.01f;
+            handled = 1;
+            break;
+        case '=':
+            s->feedback += 0.01f;
+            handled = 1;
+            break;
+        case '_':
+            s->damping -= 0.01f;
+            handled = 1;
+            break;
+        case '+':
+            s->damping += 0.01f;
+            handled = 1;
+            break;
+        case '[':
+            s->wet -= 0.01f;
+            handled = 1;
+            break;
+        case ']':
+            s->wet += 0.01f;
+            handled = 1;
+            break;
+        case ':':
+            s->entering_command = true;
+            memset(s->command_buffer, 0, sizeof(s->command_buffer));
+            s->command_index = 0;
+            handled = 1;
+            break;
+        }
+    } else {
+        if (key == '\n') {
+            s->entering_command = false;
+            char type;
+            float val;
+            if (sscanf(s->command_buffer, "%c %f", &type, &val) == 2) {
+                if (type == '1')
+                    s->feedback = val;
+                else if (type == '2')
+                    s->damping = val;
+                else if (type == '3')
+                    s->wet = val;
+            }
+            handled = 1;
+        } else if (key == 27) {
+            s->entering_command = false;
+            handled = 1;
+        } else if ((key == KEY_BACKSPACE || key == 127) &&
+                   s->command_index > 0) {
+            s->command_index--;
+            s->command_buffer[s->command_index] = '\0';
+            handled = 1;
+        } else if (key >= 32 && key < 127 &&
+                   s->command_index < sizeof(s->command_buffer) - 1) {
+            s->command_buffer[s->command_index++] = (char)key;
+            s->command_buffer[s->command_index] = '\0';
+            handled = 1;
+        }
+    }
+
+    if (handled)
+        clamp_params(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void fdn_reverb_set_osc_param(Module *m, const char *param,
+                                     float value) {
+    FdnReverb *s = (FdnReverb *)m->state;
+    pthread_mutex_lock(&s->lock);
+
+    if (strcmp(param, "fb") == 0)
+        s->feedback = value;
+    else if (strcmp(param, "damp") == 0)
+        s->damping = value;
+    else if (strcmp(param, "wet") == 0)
+        s->wet = value;
+    else
+        LOG_WARN("[fdn_reverb] Unknown OSC param: %s", param);
+
+    clamp_params(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void fdn_reverb_destroy(Module *m) {
+    if (!m)
+        return;
+    FdnReverb *s = (FdnReverb *)m->state;
+    free(s->ring);
+    pthread_mutex_destroy(&s->lock);
+    destroy_base_module(m);
+}
+
+Module *create_module(const char *args, float sample_rate) {
+    float fb = 0.8f, damp = 0.3f, wet = 0.33f;
+    int lines = 8;
+
+    if (args && strstr(args, "fb="))
+        sscanf(strstr(args, "fb="), "fb=%f", &fb);
+    if (args && strstr(args, "damp="))
+        sscanf(strstr(args, "damp="), "damp=%f", &damp);
+    if (args && strstr(args, "wet="))
+        sscanf(strstr(args, "wet="), "wet=%f", &wet);
+    if (args && strstr(args, "lines="))
+        sscanf(strstr(args, "lines="), "lines=%d", &lines);
+    if (lines != 8 && lines != 16) {
+        LOG_WARN("[fdn_reverb] lines=%d unsupported, using 8", lines);
+        lines = 8;
+    }
+
+    FdnReverb *s = calloc(1, sizeof(FdnReverb));
+    s->sample_rate = sample_rate;
+    s->lines = lines;
+    s->feedback = fb;
+    s->damping = damp;
+    s->wet = wet;
+
+    float scale = sample_rate / FDN_TUNING_RATE;
+    s->depth = FDN_MOD_MS * 0.001f * sample_rate;
+    int stride = FDN_MAX_LINES / lines;
+    float longest = 0.0f;
+    for (int k = 0; k < lines; k++) {
+        int base = fdn_lengths[k * stride + stride - 1];
+        // Keep the nearest tap at least a sample behind the write
+        s->delay[k] = fmaxf(base * scale, s->depth + 2.0f);
+        if (s->delay[k] > longest)
+            longest = s->delay[k];
+
+        // Slow LFOs, 0.15 Hz up, spread so no two lines beat together
+        float w = 2.0f * (float)M_PI * (0.15f + 0.09f * k * stride) /
+                  sample_rate;
+        float phase = 2.0f * (float)M_PI * k / lines;
+        s->rot_cos[k] = cosf(w);
+        s->rot_sin[k] = sinf(w);
+        s->mod_cos[k] = cosf(phase);
+        s->mod_sin[k] = sinf(phase);
+    }
+    int rows = pow2_above((int)ceilf(longest + s->depth) + 2);
+    s->mask = rows - 1;
+    s->ring = dsp_alloc((unsigned long)rows * lines);
+
+    init_smoother(&s->smooth_feedback, 0.5f);
+    init_smoother(&s->smooth_damping, 0.5f);
+    init_smoother(&s->smooth_wet, 0.5f);
+
+    pthread_mutex_init(&s->lock, NULL);
+    clamp_params(s);
+
+    Module *m = calloc(1, sizeof(Module));
+    m->name = "fdn_reverb";
+    m->state = s;
+    m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->output_bufferL = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->output_bufferR = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->process = fdn_reverb_process;
+    m->draw_ui = fdn_reverb_draw_ui;
+    m->handle_input = fdn_reverb_handle_input;
+    m->set_param = fdn_reverb_set_osc_param;
+    m->destroy = fdn_reverb_destroy;
+    return m;
+}
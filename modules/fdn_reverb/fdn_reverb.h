@@ -0,0 +1,48 @@
+#ifndef FDN_REVERB_H
+#define FDN_REVERB_H
+
+#include "module.h"
+#include "util.h"
+#include <pthread.h>
+
+#define FDN_MAX_LINES 16
+
+typedef struct {
+    float sample_rate;
+    int lines; // 8 or 16
+
+    float feedback; // 0.0 to <1.0
+    float damping;  // 0.0 to 1.0
+    float wet;      // 0.0 to 1.0
+
+    // Delay lines, one lane each, interleaved: [row][lines]. They share a
+    // write position and are read a modulated distance behind it.
+    float *ring;
+    int mask;
+    unsigned pos;
+    float delay[FDN_MAX_LINES]; // centre of each line's modulation
+    float depth;                // modulation, in samples either way
+
+    float lowpass[FDN_MAX_LINES]; // per-line damping state
+    // Per-line LFOs as rotating phasors
+    float mod_cos[FDN_MAX_LINES];
+    float mod_sin[FDN_MAX_LINES];
+    float rot_cos[FDN_MAX_LINES];
+    float rot_sin[FDN_MAX_LINES];
+
+    CParamSmooth smooth_feedback;
+    CParamSmooth smooth_damping;
+    CParamSmooth smooth_wet;
+
+    pthread_mutex_t lock;
+
+    float display_feedback;
+    float display_damping;
+    float display_wet;
+
+    bool entering_command;
+    char command_buffer[64];
+    int command_index;
+} FdnReverb;
+
+#endif
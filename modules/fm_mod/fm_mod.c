@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "fm_mod.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -42,6 +43,30 @@ static void fm_mod_process(Module *m, float *in, unsigned long frames) {
     float disp_mod_amp = mod_amp_s;
     float disp_idx = idx_s;
 
+    for (unsigned long i = 0; i < frames; i++) {
+        state->hilbert_delay[state->hilbert_pos] = input ? input[i] : 0.0f;
+
+        float imag = 0.0f;
+        int p = state->hilbert_pos;
+        for (int k = 0; k < HILBERT_LEN; k++) {
+            imag += hilbert_taps[k] * state->hilbert_delay[p];
+            if (--p < 0)
+                p = HILBERT_LEN - 1;
+        }
+
+        state->re[i] =
+            state->hilbert_delay[(state->hilbert_pos + HILBERT_LEN / 2) %
+                                 HILBERT_LEN];
+        state->im[i] = imag;
+
+        if (++state->hilbert_pos >= HILBERT_LEN)
+            state->hilbert_pos = 0;
+    }
+
+    const int factor = state->os_re.factor;
+    os_up(&state->os_re, state->re, state->up_re, frames);
+    os_up(&state->os_im, state->im, state->up_im, frames);
+
     for (unsigned long i = 0; i < frames; i++) {
         float mod_freq = mod_freq_s;
         float car_amp = car_amp_s;
@@ -77,33 +102,21 @@ static void fm_mod_process(Module *m, float *in, unsigned long frames) {
         disp_mod_amp = mod_amp;
         disp_idx = idx;
 
-        state->hilbert_delay[state->hilbert_pos] = input[i];
-
-        float imag = 0.0f;
-        int p = state->hilbert_pos;
-        for (int k = 0; k < HILBERT_LEN; k++) {
-            imag += hilbert_taps[k] * state->hilbert_delay[p];
-            if (--p < 0)
-                p = HILBERT_LEN - 1;
+        float *re = state->up_re + i * factor;
+        float *im = state->up_im + i * factor;
+        for (int n = 0; n < factor; n++) {
+            /* carrier instantaneous phase */
+            float carrier_phase = atan2f(im[n], re[n]);
+            float mod = sinf(TWO_PI * state->modulator_phase);
+            float phase = carrier_phase + idx * mod_amp * mod;
+            re[n] = car_amp * cosf(phase);
+
+            state->modulator_phase += mod_freq / (sr * factor);
+            if (state->modulator_phase >= 1.0f)
+                state->modulator_phase -= 1.0f;
         }
-
-        float real =
-            state->hilbert_delay[(state->hilbert_pos + HILBERT_LEN / 2) %
-                                 HILBERT_LEN];
-
-        if (++state->hilbert_pos >= HILBERT_LEN)
-            state->hilbert_pos = 0;
-
-        /* carrier instantaneous phase */
-        float carrier_phase = atan2f(imag, real);
-        float mod = sinf(TWO_PI * state->modulator_phase);
-        float phase = carrier_phase + idx * mod_amp * mod;
-        out[i] = car_amp * cosf(phase);
-
-        state->modulator_phase += mod_freq / sr;
-        if (state->modulator_phase >= 1.0f)
-            state->modulator_phase -= 1.0f;
     }
+    os_down(&state->os_re, state->up_re, out, frames);
 
     pthread_mutex_lock(&state->lock);
     state->display_freq = disp_mod_freq;
@@ -155,6 +168,14 @@ static void fm_mod_draw_ui(Module *m, int y, int x) {
     printw(" %.2f", idx);
     CLR();
 
+    if (state->os_re.factor > 1) {
+        printw(" | ");
+        LABEL(2, "os:");
+        ORANGE();
+        printw(" %dx", state->os_re.factor);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x,
              "Real-time keys: -/= (mod freq), _/+ (car_amp), {/} (mod_amp), "
@@ -267,7 +288,7 @@ static void fm_mod_set_osc_param(Module *m, const char *param, float value) {
         float norm = fminf(fmaxf(value, 0.0f), 1.0f);
         state->index = norm * FM_MOD_MAX_INDEX;
     } else {
-        fprintf(stderr, "[fm_mod] Unknown OSC param: %s\n", param);
+        LOG_WARN("[fm_mod] Unknown OSC param: %s", param);
     }
     clamp_params(state);
     pthread_mutex_unlock(&state->lock);
@@ -303,6 +324,9 @@ Module *create_module(const char *args, float sample_rate) {
     state->mod_amp = mod_amp;
     state->index = index;
     state->sample_rate = sample_rate;
+    int factor = os_factor_from_args(args);
+    os_init(&state->os_re, factor);
+    os_init(&state->os_im, factor);
     pthread_mutex_init(&state->lock, NULL);
     init_smoother(&state->smooth_freq, 0.75f);
     init_smoother(&state->smooth_car_amp, 0.75f);
@@ -1,6 +1,7 @@
 #ifndef FM_MOD_H
 #define FM_MOD_H
 
+#include "oversample.h"
 #include "util.h"
 #include <pthread.h>
 
@@ -13,6 +14,15 @@ typedef struct {
     float hilbert_delay[HILBERT_LEN];
     int hilbert_pos;
 
+    // The Hilbert pair is taken at the base rate and both halves brought
+    // up to os.factor times it, where the phase is modulated
+    Oversampler os_re;
+    Oversampler os_im;
+    float re[MAX_BLOCK_SIZE];
+    float im[MAX_BLOCK_SIZE];
+    float up_re[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+    float up_im[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+
     float carrier_phase;
     float modulator_phase;
     float mod_freq;
@@ -4,42 +4,44 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "dsp.h"
 #include "freeverb.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
-// Delay lengths (prime-ish for decorrelation), must be < MAX_DELAY
+typedef float v4f __attribute__((vector_size(16)));
+
+// Delay lengths at FREEVERB_TUNING_RATE (prime-ish for decorrelation),
+// scaled to the running rate so the room keeps its size
 static const int comb_lengths[NUM_COMBS] = {1116, 1188, 1277, 1356,
                                             1422, 1491, 1557, 1617};
 static const int allpass_lengths[NUM_ALLPASS] = {556, 441, 341, 225};
 
-static void delayline_init(DelayLine *d, int size) {
-    d->size = size;
-    d->index = 0;
-    memset(d->buffer, 0, sizeof(float) * MAX_DELAY);
-}
-
-static float delayline_process(DelayLine *d, float input) {
-    float out = d->buffer[d->index];
-    d->buffer[d->index] = input;
-    d->index = (d->index + 1) % d->size;
-    return out;
+static int pow2_above(int n) {
+    int size = 1;
+    while (size <= n)
+        size <<= 1;
+    return size;
 }
 
-static float allpass_process(DelayLine *d, float input) {
-    int idx = d->index;
-    float bufout = d->buffer[idx];
-    float output = -input + bufout;
-    d->buffer[idx] =
-        input + (bufout * 0.5f); // 0.5 is the standard Freeverb allpass gain
-    d->index = (idx + 1) % d->size;
-    return output;
+// One side's allpass chain; 0.5 is the standard Freeverb allpass gain
+static float allpass_chain(Freeverb *s, int side, float x) {
+    unsigned pos = s->allpass_pos;
+    int mask = s->allpass_mask;
+    for (int k = 0; k < NUM_ALLPASS; k++) {
+        AllpassLine *a = &s->allpasses[side][k];
+        float bufout = a->buffer[(pos - a->delay) & mask];
+        a->buffer[pos & mask] = x + bufout * 0.5f;
+        x = bufout - x;
+    }
+    return x;
 }
 
 static void freeverb_process(Module *m, float *in, unsigned long frames) {
     Freeverb *s = (Freeverb *)m->state;
     float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
-    float *out = m->output_buffer;
+    float *input_r = (m->num_inputs > 1) ? m->inputs[1] : input;
 
     pthread_mutex_lock(&s->lock);
     float base_fb = s->feedback;
@@ -55,6 +57,14 @@ static void freeverb_process(Module *m, float *in, unsigned long frames) {
     float disp_damp = damp_s;
     float disp_wet = wet_s;
 
+    // Four combs per vector; in stereo the first half are the left side's
+    const int vecs = s->lanes / 4;
+    const int lanes = s->lanes;
+    const int mask = s->comb_mask;
+    float *ring = s->combs;
+    v4f store[FREEVERB_MAX_LANES / 4];
+    memcpy(store, s->comb_filterstore, sizeof(float) * lanes);
+
     for (unsigned long i = 0; i < frames; i++) {
         float fb = fb_s;
         float damp = damp_s;
@@ -86,26 +96,45 @@ static void freeverb_process(Module *m, float *in, unsigned long frames) {
         disp_damp = damp;
         disp_wet = wet;
 
-        float in_s = input ? input[i] : 0.0f;
-        float acc = 0.0f;
-
-        for (int k = 0; k < NUM_COMBS; k++) {
-            float comb_out = delayline_process(
-                &s->combs[k], in_s + s->comb_filterstore[k] * fb);
-            s->comb_filterstore[k] =
-                damp * s->comb_filterstore[k] + (1 - damp) * comb_out;
-            acc += comb_out;
-        }
-
-        float allpass_out = acc;
-        for (int k = 0; k < NUM_ALLPASS; k++) {
-            allpass_out = allpass_process(&s->allpasses[k], allpass_out);
+        float in_l = input ? input[i] : 0.0f;
+        float in_r = input_r ? input_r[i] : 0.0f;
+
+        // All combs in lockstep: gather each lane's tap, filter, write the
+        // row at the shared position
+        unsigned pos = s->comb_pos++;
+        float *row = ring + (size_t)(pos & mask) * lanes;
+        v4f acc[2] = {{0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}};
+        for (int v = 0; v < vecs; v++) {
+            const int *d = s->comb_delay + 4 * v;
+            v4f out = {ring[((pos - d[0]) & mask) * lanes + 4 * v],
+                       ring[((pos - d[1]) & mask) * lanes + 4 * v + 1],
+                       ring[((pos - d[2]) & mask) * lanes + 4 * v + 2],
+                       ring[((pos - d[3]) & mask) * lanes + 4 * v + 3]};
+            int side = v >= NUM_COMBS / 4;
+            store[v] = out * (1.0f - damp) + store[v] * damp;
+            *(v4f *)(row + 4 * v) = (side ? in_r : in_l) + store[v] * fb;
+            acc[side] += out;
         }
 
         float dry = 1.0f - wet;
-        out[i] = dry * in_s + wet * (allpass_out / NUM_COMBS);
+        float sum_l = acc[0][0] + acc[0][1] + acc[0][2] + acc[0][3];
+        float out_l = dry * in_l +
+                      wet * (allpass_chain(s, 0, sum_l) / NUM_COMBS);
+        if (s->stereo) {
+            float sum_r = acc[1][0] + acc[1][1] + acc[1][2] + acc[1][3];
+            float out_r = dry * in_r +
+                          wet * (allpass_chain(s, 1, sum_r) / NUM_COMBS);
+            m->output_bufferL[i] = out_l;
+            m->output_bufferR[i] = out_r;
+            m->output_buffer[i] = 0.5f * (out_l + out_r);
+        } else {
+            m->output_buffer[i] = out_l;
+        }
+        s->allpass_pos++;
     }
 
+    memcpy(s->comb_filterstore, store, sizeof(float) * lanes);
+
     pthread_mutex_lock(&s->lock);
     s->display_feedback = disp_fb;
     s->display_damping = disp_damp;
@@ -145,7 +174,7 @@ static void freeverb_draw_ui(Module *m, int y, int x) {
 
     LABEL(2, "wet:");
     ORANGE();
-    printw(" %.2f", wet);
+    printw(" %.2f%s", wet, s->stereo ? " | stereo" : "");
     CLR();
 
     YELLOW();
@@ -239,7 +268,7 @@ static void freeverb_set_osc_param(Module *m, const char *param, float value) {
     else if (strcmp(param, "wet") == 0)
         s->wet = value;
     else
-        fprintf(stderr, "[freeverb] Unknown OSC param: %s\n", param);
+        LOG_WARN("[freeverb] Unknown OSC param: %s", param);
 
     clamp_params(s);
     pthread_mutex_unlock(&s->lock);
@@ -249,12 +278,17 @@ static void freeverb_destroy(Module *m) {
     if (!m)
         return;
     Freeverb *s = (Freeverb *)m->state;
+    free(s->combs);
+    for (int side = 0; side < 2; side++)
+        for (int k = 0; k < NUM_ALLPASS; k++)
+            free(s->allpasses[side][k].buffer);
     pthread_mutex_destroy(&s->lock);
     destroy_base_module(m);
 }
 
 Module *create_module(const char *args, float sample_rate) {
     float fb = 0.5f, damp = 0.5f, wet = 0.33f;
+    bool stereo = false;
 
     if (args && strstr(args, "fb="))
         sscanf(strstr(args, "fb="), "fb=%f", &fb);
@@ -262,18 +296,50 @@ Module *create_module(const char *args, float sample_rate) {
         sscanf(strstr(args, "damp="), "damp=%f", &damp);
     if (args && strstr(args, "wet="))
         sscanf(strstr(args, "wet="), "wet=%f", &wet);
+    // stereo=on: a left and a right tank, the right one's delays spread
+    if (args && strstr(args, "stereo=")) {
+        char v[8] = {0};
+        sscanf(strstr(args, "stereo="), "stereo=%7[^, ]", v);
+        stereo = !strcmp(v, "1") || !strcmp(v, "on") ||
+                 !strcmp(v, "yes") || !strcmp(v, "true");
+    }
 
     Freeverb *s = calloc(1, sizeof(Freeverb));
-    memset(s->comb_filterstore, 0, sizeof(float) * NUM_COMBS);
     s->sample_rate = sample_rate;
+    s->stereo = stereo;
+    s->lanes = stereo ? FREEVERB_MAX_LANES : NUM_COMBS;
     s->feedback = fb;
     s->damping = damp;
     s->wet = wet;
 
-    for (int i = 0; i < NUM_COMBS; i++)
-        delayline_init(&s->combs[i], comb_lengths[i]);
-    for (int i = 0; i < NUM_ALLPASS; i++)
-        delayline_init(&s->allpasses[i], allpass_lengths[i]);
+    float scale = sample_rate / FREEVERB_TUNING_RATE;
+    int longest = 1;
+    for (int k = 0; k < s->lanes; k++) {
+        int spread = k >= NUM_COMBS ? FREEVERB_SPREAD : 0;
+        int d = (int)lroundf((comb_lengths[k % NUM_COMBS] + spread) * scale);
+        s->comb_delay[k] = d > 1 ? d : 1;
+        if (s->comb_delay[k] > longest)
+            longest = s->comb_delay[k];
+    }
+    int rows = pow2_above(longest);
+    s->comb_mask = rows - 1;
+    s->combs = dsp_alloc((unsigned long)rows * s->lanes);
+
+    longest = 1;
+    for (int side = 0; side < (stereo ? 2 : 1); side++) {
+        for (int k = 0; k < NUM_ALLPASS; k++) {
+            int spread = side ? FREEVERB_SPREAD : 0;
+            int d = (int)lroundf((allpass_lengths[k] + spread) * scale);
+            s->allpasses[side][k].delay = d > 1 ? d : 1;
+            if (s->allpasses[side][k].delay > longest)
+                longest = s->allpasses[side][k].delay;
+        }
+    }
+    int ap_size = pow2_above(longest);
+    s->allpass_mask = ap_size - 1;
+    for (int side = 0; side < (stereo ? 2 : 1); side++)
+        for (int k = 0; k < NUM_ALLPASS; k++)
+            s->allpasses[side][k].buffer = dsp_alloc(ap_size);
 
     init_smoother(&s->smooth_feedback, 0.5f);
     init_smoother(&s->smooth_damping, 0.5f);
@@ -286,6 +352,10 @@ Module *create_module(const char *args, float sample_rate) {
     m->name = "freeverb";
     m->state = s;
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    if (stereo) {
+        m->output_bufferL = calloc(MAX_BLOCK_SIZE, sizeof(float));
+        m->output_bufferR = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    }
     m->process = freeverb_process;
     m->draw_ui = freeverb_draw_ui;
     m->handle_input = freeverb_handle_input;
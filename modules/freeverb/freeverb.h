@@ -7,27 +7,36 @@
 
 #define NUM_COMBS 8
 #define NUM_ALLPASS 4
-#define MAX_DELAY 2048
+#define FREEVERB_MAX_LANES (2 * NUM_COMBS) // combs of both sides in stereo
+#define FREEVERB_TUNING_RATE 44100.0f     // rate the delay lengths are for
+#define FREEVERB_SPREAD 23                 // right side offset, in samples
 
+// Delays are rings of a power-of-two size sharing one write position, read
+// `delay` samples behind it with a mask
 typedef struct {
-    float buffer[MAX_DELAY];
-    int size;
-    int index;
-} DelayLine;
+    float *buffer;
+    int delay;
+} AllpassLine;
 
 typedef struct {
     float sample_rate;
+    bool stereo;
+    int lanes; // NUM_COMBS, or both sides' in stereo
 
     float feedback; // 0.0 to <1.0
     float damping;  // 0.0 to 1.0
     float wet;      // 0.0 to 1.0
 
-    DelayLine combs[NUM_COMBS];
-    float comb_filterstore[NUM_COMBS];
+    // Comb bank, one lane per comb, interleaved: [row][lanes]
+    float *combs;
+    int comb_delay[FREEVERB_MAX_LANES];
+    float comb_filterstore[FREEVERB_MAX_LANES];
+    int comb_mask;
+    unsigned comb_pos;
 
-    DelayLine allpasses[NUM_ALLPASS];
-
-    float last_damp[NUM_COMBS];
+    AllpassLine allpasses[2][NUM_ALLPASS]; // [side][stage]
+    int allpass_mask;
+    unsigned allpass_pos;
 
     CParamSmooth smooth_feedback;
     CParamSmooth smooth_damping;
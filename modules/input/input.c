@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "input.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -119,7 +120,7 @@ static void input_set_osc_param(Module *m, const char *param, float value) {
     if (strcmp(param, "gain") == 0) {
         state->gain = fminf(fmaxf(value, 0.0f), 1.0f);
     } else {
-        fprintf(stderr, "[input] Unknown OSC param: %s\n", param);
+        LOG_WARN("[input] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
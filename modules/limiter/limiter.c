@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "limiter.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 
@@ -12,15 +13,42 @@
 #define MIN_RELEASE_MS 1.0f
 #define MAX_RELEASE_MS 1000.0f
 
+// Detector value for one new input: its magnitude, or with true peak the
+// largest of a sample and the three 4x points after it, `taps / 2` inputs
+// late
+static float detect(LimiterState *s, int c, float x) {
+    if (!s->true_peak)
+        return fabsf(x);
+    const int taps = s->tp.taps;
+    float *h = s->tp_hist[c];
+    unsigned k = s->pos & (taps - 1);
+    h[k] = h[k + taps] = x;
+    const float *win = h + k + 1; // oldest first; win[taps/2 - 1] is centre
+    float peak = fabsf(win[taps / 2 - 1]);
+    for (int q = 1; q < 4; q++)
+        peak = fmaxf(peak, fabsf(resampler_interp(&s->tp, win, 0.25f * q)));
+    return peak;
+}
+
 static void limiter_process(Module *m, float *in, unsigned long frames) {
     LimiterState *state = (LimiterState *)m->state;
     float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
-    float *out = m->output_buffer;
+    float *input_r = (m->num_inputs > 1) ? m->inputs[1] : input;
+    const int channels = state->channels;
+    float *outs[2] = {m->output_buffer, NULL};
+    if (channels == 2) {
+        outs[0] = m->output_bufferL;
+        outs[1] = m->output_bufferR;
+    }
 
     if (!input) {
-        memset(out, 0, frames * sizeof(float));
+        for (int c = 0; c < channels; c++)
+            memset(outs[c], 0, frames * sizeof(float));
+        if (channels == 2)
+            memset(m->output_buffer, 0, frames * sizeof(float));
         return;
     }
+    const float *ins[2] = {input, input_r};
 
     pthread_mutex_lock(&state->lock);
     float base_threshold = state->threshold;
@@ -34,10 +62,11 @@ static void limiter_process(Module *m, float *in, unsigned long frames) {
 
     float disp_threshold = threshold_s;
     float disp_release = release_s;
-    float max_reduction = 0.0f;
+    float min_gain = 1.0f; // deepest reduction, for display
 
     // Convert release time to coefficient
     float release_coeff = expf(-1.0f / (release_s * 0.001f * sample_rate));
+    const int detectors = (channels == 2 && !state->link) ? 2 : 1;
 
     for (unsigned long i = 0; i < frames; i++) {
         float threshold = threshold_s;
@@ -66,62 +95,58 @@ static void limiter_process(Module *m, float *in, unsigned long frames) {
         disp_threshold = threshold;
         disp_release = release;
 
-        float in_sample = input[i];
-
-        // Store input in delay buffer for lookahead
-        state->delay_buffer[state->delay_index] = in_sample;
-
-        // Get delayed sample for output
-        int output_index =
-            (state->delay_index - state->delay_samples + 1024) % 1024;
-        float delayed_sample = state->delay_buffer[output_index];
-
-        // Peak detection with lookahead
-        float peak = 0.0f;
-        for (int k = 0; k < state->delay_samples; k++) {
-            int idx = (state->delay_index - k + 1024) % 1024;
-            float sample_abs = fabsf(state->delay_buffer[idx]);
-            if (sample_abs > peak) {
-                peak = sample_abs;
-            }
-        }
-
-        // Calculate required gain reduction
-        float target_gain = 1.0f;
-        if (peak > threshold) {
-            target_gain = threshold / peak;
+        // Feed the lookahead delay and the detectors; a linked pair shares
+        // one detector on the louder channel
+        const unsigned pos = state->pos;
+        float level[2] = {0.0f, 0.0f};
+        for (int c = 0; c < channels; c++) {
+            float x = ins[c][i];
+            state->delay_buffer[c][pos & state->delay_mask] = x;
+            float d = detect(state, c, x);
+            int k = detectors == 2 ? c : 0;
+            level[k] = fmaxf(level[k], d);
         }
 
-        // Smooth gain reduction with release
-        if (target_gain < state->envelope) {
-            // Attack: instant
-            state->envelope = target_gain;
-        } else {
-            // Release: smooth
-            state->envelope =
-                target_gain + (state->envelope - target_gain) * release_coeff;
-        }
+        float gain[2];
+        for (int k = 0; k < detectors; k++) {
+            peak_push(&state->peaks[k], level[k], pos);
+            float peak = peak_max(&state->peaks[k], pos - state->window);
 
-        // Apply limiting
-        float limited_sample = delayed_sample * state->envelope;
+            // Calculate required gain reduction
+            float target_gain = 1.0f;
+            if (peak > threshold) {
+                target_gain = threshold / peak;
+            }
 
-        // Track maximum reduction for display
-        float reduction_db = 20.0f * log10f(fmaxf(state->envelope, 0.001f));
-        if (reduction_db < max_reduction) {
-            max_reduction = reduction_db;
+            // Smooth gain reduction with release
+            float *env = &state->envelope[k];
+            if (target_gain < *env) {
+                // Attack: instant
+                *env = target_gain;
+            } else {
+                // Release: smooth
+                *env = target_gain + (*env - target_gain) * release_coeff;
+            }
+            gain[k] = *env;
+            min_gain = fminf(min_gain, *env);
         }
 
-        out[i] = limited_sample;
+        // Apply limiting to the sample the window is centred ahead of
+        unsigned out_pos = (pos - state->latency) & state->delay_mask;
+        for (int c = 0; c < channels; c++)
+            outs[c][i] = state->delay_buffer[c][out_pos] *
+                         gain[detectors == 2 ? c : 0];
+        if (channels == 2)
+            m->output_buffer[i] = 0.5f * (outs[0][i] + outs[1][i]);
 
-        // Advance delay buffer index
-        state->delay_index = (state->delay_index + 1) % 1024;
+        state->pos = pos + 1;
     }
 
     // Update display values
     pthread_mutex_lock(&state->lock);
     state->display_threshold = disp_threshold;
     state->display_release = disp_release;
-    state->display_reduction = max_reduction;
+    state->display_reduction = 20.0f * log10f(fmaxf(min_gain, 0.001f));
     pthread_mutex_unlock(&state->lock);
 }
 
@@ -166,6 +191,10 @@ static void limiter_draw_ui(Module *m, int y, int x) {
         printw(" %.1f dB", reduction);
         CLR();
     }
+    if (state->true_peak || state->channels == 2)
+        printw(" |%s%s", state->true_peak ? " tp" : "",
+               state->channels == 2 ? (state->link ? " linked" : " dual")
+                                    : "");
 
     YELLOW();
     mvprintw(y + 1, x, "Real-time keys: -/= (thresh), [/] (rel)");
@@ -248,23 +277,46 @@ static void limiter_set_osc_param(Module *m, const char *param, float value) {
         state->release =
             MIN_RELEASE_MS + norm * (MAX_RELEASE_MS - MIN_RELEASE_MS);
     } else {
-        fprintf(stderr, "[Limiter] Unknown OSC param: %s\n", param);
+        LOG_WARN("[Limiter] Unknown OSC param: %s", param);
     }
     clamp_params(state);
     pthread_mutex_unlock(&state->lock);
 }
 
+static void limiter_free(LimiterState *s) {
+    for (int c = 0; c < 2; c++) {
+        free(s->delay_buffer[c]);
+        free(s->peaks[c].value);
+        free(s->peaks[c].at);
+        free(s->tp_hist[c]);
+    }
+    pthread_mutex_destroy(&s->lock);
+}
+
 static void limiter_destroy(Module *m) {
     LimiterState *state = (LimiterState *)m->state;
-    if (state) {
-        if (state->delay_buffer) {
-            free(state->delay_buffer);
-        }
-        pthread_mutex_destroy(&state->lock);
-    }
+    if (state)
+        limiter_free(state);
     destroy_base_module(m);
 }
 
+static unsigned pow2_above(unsigned n) {
+    unsigned size = 1;
+    while (size <= n)
+        size <<= 1;
+    return size;
+}
+
+static bool parse_flag(const char *args, const char *key, bool fallback) {
+    const char *p = args ? strstr(args, key) : NULL;
+    if (!p)
+        return fallback;
+    char v[8] = {0};
+    sscanf(p + strlen(key), "%7[^, ]", v);
+    return !strcmp(v, "1") || !strcmp(v, "on") || !strcmp(v, "yes") ||
+           !strcmp(v, "true");
+}
+
 Module *create_module(const char *args, float sample_rate) {
     float threshold = 0.95f;   // Default threshold just below clipping
     float release = 50.0f;     // Default 50ms release
@@ -283,26 +335,63 @@ Module *create_module(const char *args, float sample_rate) {
         sscanf(strstr(args, "look="), "look=%f", &lookahead_ms);
     }
 
+    // stereo=on limits inputs 1 and 2 as a pair, linked unless link=off;
+    // tp=on detects inter-sample peaks
+    bool stereo = parse_flag(args, "stereo=", false);
+    bool link = parse_flag(args, "link=", true);
+    bool true_peak = parse_flag(args, "tp=", false);
+
+    clampf(&lookahead_ms, 0.0f, MAX_LOOKAHEAD_MS);
+
     LimiterState *s = calloc(1, sizeof(LimiterState));
     s->threshold = threshold;
     s->release = release;
     s->lookahead_ms = lookahead_ms;
     s->sample_rate = sample_rate;
-    s->envelope = 1.0f;
+    s->channels = stereo ? 2 : 1;
+    s->link = link;
+    s->true_peak = true_peak;
+    s->envelope[0] = s->envelope[1] = 1.0f;
 
     // Calculate delay buffer size for lookahead
     s->delay_samples = (int)(lookahead_ms * 0.001f * sample_rate);
-    if (s->delay_samples > 1024)
-        s->delay_samples = 1024;
     if (s->delay_samples < 1)
         s->delay_samples = 1;
+    s->latency = s->delay_samples;
+    s->window = s->delay_samples + 1;
+    bool tp_ok = true;
+    if (true_peak) {
+        // The interpolator needs taps / 2 inputs past each point, and the
+        // gain for a sample covers the intervals either side of it
+        tp_ok = resampler_init(&s->tp, RESAMPLE_GOOD);
+        s->latency += s->tp.taps / 2;
+        s->window += 1;
+    }
 
-    // Allocate delay buffer
-    s->delay_buffer = calloc(1024, sizeof(float));
-    s->delay_index = 0;
+    unsigned delay_size = pow2_above((unsigned)s->latency);
+    unsigned peak_size = pow2_above((unsigned)s->window);
+    s->delay_mask = delay_size - 1;
+    bool ok = tp_ok;
+    for (int c = 0; c < s->channels; c++) {
+        s->delay_buffer[c] = calloc(delay_size, sizeof(float));
+        s->peaks[c].value = calloc(peak_size, sizeof(float));
+        s->peaks[c].at = calloc(peak_size, sizeof(unsigned));
+        s->peaks[c].mask = peak_size - 1;
+        ok = ok && s->delay_buffer[c] && s->peaks[c].value && s->peaks[c].at;
+        if (true_peak) {
+            s->tp_hist[c] = calloc(2 * s->tp.taps, sizeof(float));
+            ok = ok && s->tp_hist[c];
+        }
+    }
 
     // Initialize mutex and smoothers
     pthread_mutex_init(&s->lock, NULL);
+    if (!ok) {
+        LOG_ERROR("[Limiter] out of memory");
+        limiter_free(s);
+        free(s);
+        return NULL;
+    }
     init_smoother(&s->smooth_threshold, 0.9f);
     init_smoother(&s->smooth_release, 0.9f);
     clamp_params(s);
@@ -312,6 +401,10 @@ Module *create_module(const char *args, float sample_rate) {
     m->state = s;
 
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    if (stereo) {
+        m->output_bufferL = calloc(MAX_BLOCK_SIZE, sizeof(float));
+        m->output_bufferR = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    }
     m->process = limiter_process;
     m->draw_ui = limiter_draw_ui;
     m->handle_input = limiter_handle_input;
@@ -5,18 +5,56 @@
 #include <pthread.h>
 #include <stdbool.h>
 
+// Running maximum over a sliding window: a deque of (value, position)
+// kept decreasing, so each sample is pushed and popped at most once
+typedef struct {
+    float *value;
+    unsigned *at;
+    unsigned head, tail; // free-running, masked on access
+    unsigned mask;
+} PeakWindow;
+
+// Inline here so limiter_bench.c times the same code the module runs
+static inline void peak_push(PeakWindow *w, float v, unsigned at) {
+    while (w->tail != w->head && w->value[(w->tail - 1) & w->mask] <= v)
+        w->tail--;
+    w->value[w->tail & w->mask] = v;
+    w->at[w->tail & w->mask] = at;
+    w->tail++;
+}
+
+// Largest value pushed at positions after `oldest_gone`
+static inline float peak_max(PeakWindow *w, unsigned oldest_gone) {
+    while ((int)(w->at[w->head & w->mask] - oldest_gone) <= 0)
+        w->head++;
+    return w->value[w->head & w->mask];
+}
+
 typedef struct {
     float threshold;
     float release;
     float lookahead_ms;
     float sample_rate;
 
+    int channels;   // 2 with stereo=on
+    bool link;      // stereo: one gain from both channels' peaks
+    bool true_peak; // detect 4x oversampled inter-sample peaks
+
     // Internal state for limiting
-    float envelope;
-    float *delay_buffer;
-    int delay_samples;
-    int delay_index;
+    float envelope[2];
+    float *delay_buffer[2];
+    unsigned delay_mask;
+    int delay_samples; // lookahead
+    int latency;       // lookahead plus the true-peak filter's
+    int window;        // detector positions each gain looks at
+    unsigned pos;      // samples processed
+
+    PeakWindow peaks[2];
 
+    // True peak: the last taps inputs, stored twice so any window of
+    // them is contiguous
+    Resampler tp;
+    float *tp_hist[2];
     // UI display params
     float display_threshold;
     float display_release;
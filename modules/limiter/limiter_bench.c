@@ -0,0 +1,100 @@
+// Times the limiter's lookahead peak detector: the window scan it used to
+// run for every sample against the running maximum in limiter.h, over the
+// same noise. Build and run with `make bench`; arguments are the sample
+// rate, the lookahead in ms and the seconds of audio (96000 10 20).
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "limiter.h"
+
+#define OLD_RING 1024 // the scan's fixed delay buffer
+
+static double now_s(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+// The detector as it was: rescan the last `window` samples each sample
+static void scan_old(const float *in, float *peak, long n, int window) {
+    float ring[OLD_RING] = {0};
+    int index = 0;
+    for (long i = 0; i < n; i++) {
+        ring[index] = in[i];
+        float p = 0.0f;
+        for (int k = 0; k < window; k++) {
+            float a = fabsf(ring[(index - k + OLD_RING) % OLD_RING]);
+            if (a > p)
+                p = a;
+        }
+        peak[i] = p;
+        index = (index + 1) % OLD_RING;
+    }
+}
+
+static void scan_new(const float *in, float *peak, long n, int window) {
+    unsigned size = 1;
+    while (size <= (unsigned)window)
+        size <<= 1;
+    PeakWindow w = {.value = calloc(size, sizeof(float)),
+                    .at = calloc(size, sizeof(unsigned)),
+                    .mask = size - 1};
+    for (long i = 0; i < n; i++) {
+        peak_push(&w, fabsf(in[i]), (unsigned)i);
+        peak[i] = peak_max(&w, (unsigned)i - window);
+    }
+    free(w.value);
+    free(w.at);
+}
+
+int main(int argc, char **argv) {
+    float rate = argc > 1 ? (float)atof(argv[1]) : 96000.0f;
+    float look_ms = argc > 2 ? (float)atof(argv[2]) : 10.0f;
+    float seconds = argc > 3 ? (float)atof(argv[3]) : 20.0f;
+    int window = (int)(look_ms * 0.001f * rate);
+    long n = (long)(seconds * rate);
+    if (window < 1 || window > OLD_RING || n < 1) {
+        fprintf(stderr, "lookahead must be 1-%d samples\n", OLD_RING);
+        return 1;
+    }
+
+    float *in = malloc(n * sizeof(float));
+    float *old_peak = malloc(n * sizeof(float));
+    float *new_peak = malloc(n * sizeof(float));
+    if (!in || !old_peak || !new_peak) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    uint32_t x = 0x12345678u;
+    for (long i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        in[i] = (float)x / 2147483648.0f - 1.0f;
+    }
+
+    double t0 = now_s();
+    scan_old(in, old_peak, n, window);
+    double t1 = now_s();
+    scan_new(in, new_peak, n, window);
+    double t2 = now_s();
+
+    long mismatches = 0;
+    for (long i = 0; i < n; i++)
+        mismatches += old_peak[i] != new_peak[i];
+
+    printf("%.0f Hz, look=%.1f ms (%d samples), %.1f s\n", rate, look_ms,
+           window, seconds);
+    printf("  window scan    %8.2f ns/sample\n", (t1 - t0) * 1e9 / n);
+    printf("  running max    %8.2f ns/sample\n", (t2 - t1) * 1e9 / n);
+    printf("  %ld of %ld peaks differ\n", mismatches, n);
+
+    free(in);
+    free(old_peak);
+    free(new_peak);
+    return mismatches != 0;
+}
@@ -4,10 +4,38 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "looper.h"
 #include "module.h"
 #include "util.h"
 
+// Band-limited read at a fractional position, wrapping the taps around
+// the loop so the seam interpolates across it
+static double loop_read(Looper *s, const float *buffer,
+                        unsigned long loop_start, unsigned long le,
+                        double read_pos, float speed) {
+    unsigned long i1 = (unsigned long)read_pos;
+    if (i1 >= le || i1 < loop_start)
+        i1 = loop_start;
+    float frac = (float)(read_pos - (double)i1);
+    if (frac < 0.0f || frac >= 1.0f)
+        frac = 0.0f;
+
+    int n = s->rs.taps;
+    unsigned long len = le - loop_start;
+    unsigned long back = (unsigned long)(n / 2 - 1) % len;
+    unsigned long k = (i1 - loop_start + len - back) % len;
+    float x[RESAMPLE_MAX_TAPS];
+    for (int j = 0; j < n; j++) {
+        x[j] = buffer[loop_start + k];
+        if (++k == len)
+            k = 0;
+    }
+
+    resampler_set_step(&s->rs, speed);
+    return (double)resampler_interp(&s->rs, x, frac);
+}
+
 static void looper_process(Module *m, float *in, unsigned long frames) {
     Looper *s = (Looper *)m->state;
     float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
@@ -128,17 +156,8 @@ static void looper_process(Module *m, float *in, unsigned long frames) {
         }
 
         case PLAYING: {
-            unsigned long i1 = (unsigned long)read_pos;
-            if (i1 >= le)
-                i1 = loop_start;
-
-            unsigned long i2 = i1 + 1;
-            if (i2 >= le)
-                i2 = loop_start;
-
-            double frac = read_pos - (double)i1;
-            double play =
-                (1.0 - frac) * (double)buffer[i1] + frac * (double)buffer[i2];
+            double play = loop_read(s, buffer, loop_start, le, read_pos,
+                                    playback_speed);
 
             /* crossfade at both loop edges to prevent click */
             const double xf = LOOP_FADE_SAMPLES;
@@ -180,17 +199,8 @@ static void looper_process(Module *m, float *in, unsigned long frames) {
 
             buffer[widx] += in_s; // overdub
 
-            unsigned long i1 = (unsigned long)read_pos;
-            if (i1 >= le)
-                i1 = loop_start;
-
-            unsigned long i2 = i1 + 1;
-            if (i2 >= le)
-                i2 = loop_start;
-
-            double frac = read_pos - (double)i1;
-            double play =
-                (1.0 - frac) * (double)buffer[i1] + frac * (double)buffer[i2];
+            double play = loop_read(s, buffer, loop_start, le, read_pos,
+                                    playback_speed);
 
             const double xf = LOOP_FADE_SAMPLES;
             double env = 1.0;
@@ -521,7 +531,7 @@ static void looper_set_osc_param(Module *m, const char *param, float value) {
         }
         state->looper_state = STOPPED;
     } else {
-        fprintf(stderr, "[looper] Unknown OSC param: %s\n", param);
+        LOG_WARN("[looper] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
@@ -573,6 +583,14 @@ Module *create_module(const char *args, float sample_rate) {
     init_sine_table();
     init_smoother(&state->smooth_speed, 0.75f);
     init_smoother(&state->smooth_amp, 0.75f);
+    if (!state->buffer ||
+        !resampler_init(&state->rs, resampler_parse_quality(args))) {
+        LOG_ERROR("[looper] out of memory");
+        free(state->buffer);
+        pthread_mutex_destroy(&state->lock);
+        free(state);
+        return NULL;
+    }
     clamp_params(state);
 
     Module *m = calloc(1, sizeof(Module));
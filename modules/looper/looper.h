@@ -26,6 +26,7 @@ typedef struct {
 
     CParamSmooth smooth_speed;
     CParamSmooth smooth_amp;
+    Resampler rs;
 
     pthread_mutex_t lock;
 
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "dsp.h"
+#include "logger.h"
 #include "mixer.h"
 #include "module.h"
 #include "util.h"
@@ -22,6 +24,14 @@ static void mixer_process(Module *m, float *in, unsigned long frames) {
     float gain_s = process_smoother(&s->smooth_gain, base_gain);
     float disp_gain = gain_s;
 
+    int active = 0;
+    for (int ch = 0; ch < m->num_inputs; ch++) {
+        if (m->inputs[ch])
+            active++;
+    }
+    float norm = (active > 0) ? (0.707f / (float)active) : 0.0f;
+    dsp_mix(out, m->inputs, m->num_inputs, norm, frames);
+
     for (unsigned long i = 0; i < frames; i++) {
         float gain = gain_s;
 
@@ -41,18 +51,7 @@ static void mixer_process(Module *m, float *in, unsigned long frames) {
         clampf(&gain, 0.0f, 8.0f);
         disp_gain = gain;
 
-        float sum = 0.0f;
-        int active = 0;
-
-        for (int ch = 0; ch < m->num_inputs; ch++) {
-            if (m->inputs[ch]) {
-                sum += m->inputs[ch][i];
-                active++;
-            }
-        }
-
-        float norm = (active > 0) ? (0.707f / (float)active) : 0.0f;
-        out[i] = fminf(fmaxf(sum * norm * gain, -1.0f), 1.0f);
+        out[i] = fminf(fmaxf(out[i] * gain, -1.0f), 1.0f);
     }
 
     pthread_mutex_lock(&s->lock);
@@ -143,7 +142,7 @@ static void mixer_set_osc_param(Module *m, const char *param, float value) {
     if (strcmp(param, "gain") == 0) {
         s->gain = value;
     } else {
-        fprintf(stderr, "[mixer] Unknown OSC param: %s\n", param);
+        LOG_WARN("[mixer] Unknown OSC param: %s", param);
     }
 
     clamp_params(s);
@@ -178,7 +177,7 @@ Module *create_module(const char *args, float sample_rate) {
     m->name = "mixer";
     m->state = s;
 
-    m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
+    m->output_buffer = dsp_alloc(MAX_BLOCK_SIZE);
     m->process = mixer_process;
     m->draw_ui = mixer_draw_ui;
     m->handle_input = mixer_handle_input;
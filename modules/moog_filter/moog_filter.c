@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "moog_filter.h"
 #include "util.h"
@@ -28,6 +29,14 @@ static void moog_filter_process(Module *m, float *in, unsigned long frames) {
     float disp_co = co_s;
     float disp_res = res_s;
 
+    // Bad input is dropped before it can reach the oversampler's state
+    const int factor = state->os.factor;
+    for (unsigned long i = 0; i < frames; i++) {
+        float in_s = input ? input[i] : 0.0f;
+        state->in[i] = isfinite(in_s) ? in_s : 0.0f;
+    }
+    os_up(&state->os, state->in, state->up, frames);
+
     for (unsigned long i = 0; i < frames; i++) {
         float co = co_s;
         float res = res_s;
@@ -53,45 +62,46 @@ static void moog_filter_process(Module *m, float *in, unsigned long frames) {
         disp_co = co;
         disp_res = res;
 
-        float wc = 2.0f * M_PI * co / sample_rate;
+        float wc = 2.0f * M_PI * co / (sample_rate * factor);
         float g = wc / (wc + 1.0f); // Scale to appropriate ladder behavior
         float k = res;
-        float in_s = input ? input[i] : 0.0f;
 
-        if (!isfinite(in_s))
-            in_s = 0.0f;
-        float x = tanhf(in_s); // Input limiter
-
-        x -= k * z[3]; // Feedback line
-        x = tanhf(x);  // Soft saturation
-
-        z[0] += g * (x - z[0]);
-        z[1] += g * (z[0] - z[1]);
-        z[2] += g * (z[1] - z[2]);
-        z[3] += g * (z[2] - z[3]);
+        float *s = state->up + i * factor;
+        for (int n = 0; n < factor; n++) {
+            float x = tanhf(s[n]); // Input limiter
+
+            x -= k * z[3]; // Feedback line
+            x = tanhf(x);  // Soft saturation
+
+            z[0] += g * (x - z[0]);
+            z[1] += g * (z[0] - z[1]);
+            z[2] += g * (z[1] - z[2]);
+            z[3] += g * (z[2] - z[3]);
+
+            float y;
+            switch (filt_type) {
+            case LOWPASS:
+                y = tanhf(z[3]);
+                break;
+            case HIGHPASS:
+                y = tanhf(x - z[3]);
+                break;
+            case BANDPASS:
+                y = tanhf(z[2] - z[3]);
+                break;
+            case NOTCH:
+                y = tanhf(x - k * z[3]);
+                break;
+            case RESONANT:
+                y = tanhf(z[3] + k * (z[3] - z[2]));
+                break;
+            }
 
-        float y;
-        switch (filt_type) {
-        case LOWPASS:
-            y = tanhf(z[3]);
-            break;
-        case HIGHPASS:
-            y = tanhf(x - z[3]);
-            break;
-        case BANDPASS:
-            y = tanhf(z[2] - z[3]);
-            break;
-        case NOTCH:
-            y = tanhf(x - k * z[3]);
-            break;
-        case RESONANT:
-            y = tanhf(z[3] + k * (z[3] - z[2]));
-            break;
+            s[n] = fminf(fmaxf(y, -1.0f), 1.0f);
         }
-
-        float val = fminf(fmaxf(y, -1.0f), 1.0f);
-        out[i] = val;
     }
+    os_down(&state->os, state->up, out, frames);
+
     pthread_mutex_lock(&state->lock);
     state->display_cutoff = disp_co;
     state->display_resonance = disp_res;
@@ -135,6 +145,14 @@ static void moog_filter_draw_ui(Module *m, int y, int x) {
     printw(" %s", filt_names[filt_type]);
     CLR();
 
+    if (state->os.factor > 1) {
+        printw(" | ");
+        LABEL(2, "os:");
+        ORANGE();
+        printw(" %dx", state->os.factor);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x, "Real-time keys: -/= (cutoff), _/+ (res)");
     mvprintw(y + 2, x, "Command mode: :1 [cutoff], :2 [res] f: [type]");
@@ -232,7 +250,7 @@ static void moog_filter_set_osc_param(Module *m, const char *param,
             state->filt_type = (FilterType)((state->filt_type + 1) % 5);
         }
     } else {
-        fprintf(stderr, "[moog_filter] Unknown OSC param: %s\n", param);
+        LOG_WARN("[moog_filter] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
@@ -272,7 +290,7 @@ Module *create_module(const char *args, float sample_rate) {
         else if (strcmp(filt_str, "res") == 0)
             filt_type = RESONANT;
         else
-            fprintf(stderr, "[moog_filter] Unknown type: '%s'\n", filt_str);
+            LOG_WARN("[moog_filter] Unknown type: '%s'", filt_str);
     }
 
     MoogFilter *state = calloc(1, sizeof(MoogFilter));
@@ -280,6 +298,7 @@ Module *create_module(const char *args, float sample_rate) {
     state->resonance = resonance;
     state->filt_type = filt_type;
     state->sample_rate = sample_rate;
+    os_init(&state->os, os_factor_from_args(args));
     state->z[0] = state->z[1] = state->z[2] = state->z[3] = 1e-6f;
     pthread_mutex_init(&state->lock, NULL);
     init_smoother(&state->smooth_co, 0.75f);
@@ -1,6 +1,7 @@
 #ifndef MOOG_FILTER_H
 #define MOOG_FILTER_H
 
+#include "oversample.h"
 #include "util.h"
 #include <pthread.h>
 
@@ -14,6 +15,11 @@ typedef struct {
 
     FilterType filt_type;
 
+    // The ladder runs at os.factor times the rate, over `up`
+    Oversampler os;
+    float in[MAX_BLOCK_SIZE];
+    float up[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+
     CParamSmooth smooth_co;
     CParamSmooth smooth_res;
     pthread_mutex_t lock;
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "logger.h"
 #include "module.h"
 #include "noise.h"
 #include "pink_filter.h"
@@ -181,7 +182,7 @@ static void noise_set_osc_param(Module *m, const char *param, float value) {
             state->noise_type = (NoiseType)((state->noise_type + 1) % 3);
         }
     } else {
-        fprintf(stderr, "[noise] Unknown OSC param: %s\n", param);
+        LOG_WARN("[noise] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
@@ -212,7 +213,7 @@ Module *create_module(const char *args, float sample_rate) {
         else if (strcmp(noise_str, "brown") == 0)
             noise_type = BROWN_NOISE;
         else
-            fprintf(stderr, "[noise] Unknown type: '%s'\n", noise_str);
+            LOG_WARN("[noise] Unknown type: '%s'", noise_str);
     }
 
     Noise *state = calloc(1, sizeof(Noise));
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "pm_mod.h"
 #include "util.h"
@@ -16,8 +17,9 @@ static void pm_mod_process(Module *m, float *in, unsigned long frames) {
     float *out = m->output_buffer;
 
     if (!in_car || !in_mod) {
-        if (!in_mod) {
-            printf("[pm_mod] WARNING: missing 2nd audio input\n");
+        if (!in_mod && !state->warned_no_mod) {
+            LOG_WARN("[pm_mod] missing 2nd audio input");
+            state->warned_no_mod = 1;
         }
         memset(out, 0, frames * sizeof(float));
         return;
@@ -42,6 +44,10 @@ static void pm_mod_process(Module *m, float *in, unsigned long frames) {
     float disp_freq = freq_s;
     float disp_idx = idx_s;
 
+    const int factor = state->os_car.factor;
+    os_up(&state->os_car, in_car, state->up_car, frames);
+    os_up(&state->os_mod, in_mod, state->up_mod, frames);
+
     for (unsigned long i = 0; i < frames; i++) {
         float car_amp = car_amp_s;
         float mod_amp = mod_amp_s;
@@ -77,17 +83,22 @@ static void pm_mod_process(Module *m, float *in, unsigned long frames) {
         disp_freq = freq;
         disp_idx = idx;
 
-        float car = in_car[i] * car_amp;
-        float mod = in_mod[i] * mod_amp;
+        float *car_up = state->up_car + i * factor;
+        float *mod_up = state->up_mod + i * factor;
+        for (int n = 0; n < factor; n++) {
+            float car = car_up[n] * car_amp;
+            float mod = mod_up[n] * mod_amp;
 
-        float fm = car * sinf(phase + idx * mod);
+            float fm = car * sinf(phase + idx * mod);
 
-        phase += TWO_PI * freq / sr;
-        if (phase >= TWO_PI)
-            phase -= TWO_PI;
+            phase += TWO_PI * freq / (sr * factor);
+            if (phase >= TWO_PI)
+                phase -= TWO_PI;
 
-        out[i] = fm;
+            car_up[n] = fm;
+        }
     }
+    os_down(&state->os_car, state->up_car, out, frames);
 
     pthread_mutex_lock(&state->lock);
     state->display_mod_amp = disp_mod_amp;
@@ -141,6 +152,14 @@ static void pm_mod_draw_ui(Module *m, int y, int x) {
     printw(" %.2f", idx);
     CLR();
 
+    if (state->os_car.factor > 1) {
+        printw(" | ");
+        LABEL(2, "os:");
+        ORANGE();
+        printw(" %dx", state->os_car.factor);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x,
              "Real-time keys: -/= (base_freq), _/+ (car_amp), {/} (mod_amp) "
@@ -254,7 +273,7 @@ static void pm_mod_set_osc_param(Module *m, const char *param, float value) {
         float hz = min_hz * powf(max_hz / min_hz, norm);
         state->base_freq = hz;
     } else {
-        fprintf(stderr, "[pm_mod] Unknown OSC param: %s\n", param);
+        LOG_WARN("[pm_mod] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
@@ -289,6 +308,9 @@ Module *create_module(const char *args, float sample_rate) {
     state->base_freq = base_freq;
     state->index = index;
     state->sample_rate = sample_rate;
+    int factor = os_factor_from_args(args);
+    os_init(&state->os_car, factor);
+    os_init(&state->os_mod, factor);
     pthread_mutex_init(&state->lock, NULL);
     init_smoother(&state->smooth_car_amp, 0.75f);
     init_smoother(&state->smooth_mod_amp, 0.75f);
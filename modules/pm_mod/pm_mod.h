@@ -1,6 +1,7 @@
 #ifndef PM_MOD_H
 #define PM_MOD_H
 
+#include "oversample.h"
 #include "util.h"
 #include <pthread.h>
 
@@ -13,12 +14,20 @@ typedef struct {
     float modulator_phase;
     float sample_rate;
 
+    // Both inputs go up to os.factor times the rate, where the product is
+    // formed, and the result comes down through os_car
+    Oversampler os_car;
+    Oversampler os_mod;
+    float up_car[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+    float up_mod[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+
     CParamSmooth smooth_car_amp;
     CParamSmooth smooth_mod_amp;
     CParamSmooth smooth_base_freq;
     CParamSmooth smooth_index;
 
     pthread_mutex_t lock;
+    int warned_no_mod; // logged once, not every block
 
     float display_car_amp;
     float display_mod_amp;
@@ -1,9 +1,12 @@
 #include <math.h>
 #include <ncurses.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "dsp.h"
+#include "logger.h"
 #include "module.h"
 #include "res_bank.h"
 #include "util.h"
@@ -77,11 +80,268 @@ static inline float soft_sat(float x, float drive) {
     return y / (1.0f + fabsf(y)); // fast soft clip
 }
 
+/* --- Modal mode --- */
+
+typedef float v4f __attribute__((vector_size(16)));
+
+// sin and cos of x in [0, pi]: Taylor series at the half angle, then the
+// double-angle identities; good to about 1e-7
+static inline void v_sincos(v4f x, v4f *sn, v4f *cs) {
+    v4f h = 0.5f * x;
+    v4f h2 = h * h;
+    v4f s = h * (1.0f +
+                 h2 * (-1.0f / 6 +
+                       h2 * (1.0f / 120 +
+                             h2 * (-1.0f / 5040 +
+                                   h2 * (1.0f / 362880 +
+                                         h2 * (-1.0f / 39916800))))));
+    v4f c = 1.0f +
+            h2 * (-0.5f +
+                  h2 * (1.0f / 24 +
+                        h2 * (-1.0f / 720 +
+                              h2 * (1.0f / 40320 +
+                                    h2 * (-1.0f / 3628800 +
+                                          h2 * (1.0f / 479001600))))));
+    *sn = 2.0f * s * c;
+    *cs = c * c - s * s;
+}
+
+// e^-a for a in [0, 0.5], Taylor to the 7th power
+static inline v4f v_exp_neg(v4f a) {
+    return 1.0f -
+           a * (1.0f -
+                a * (0.5f -
+                     a * (1.0f / 6 -
+                          a * (1.0f / 24 -
+                               a * (1.0f / 120 -
+                                    a * (1.0f / 720 - a * (1.0f / 5040)))))));
+}
+
+// Partial k (from 0) of n sits at (k + 1) * f0, stretched by stiffness as
+// in a bar or stiff string and detuned by its fixed jitter. Decay rates
+// grow with the square root of the partial's frequency. Tilt and odd weight
+// the modes as they weight the bands. No trig: poles come from the
+// polynomials above, once per change.
+static void rebuild_modes(ResBank *s, const float *shape, int n) {
+    float f0 = shape[0], hi = shape[1], inharm = shape[2];
+    float spread = shape[3], decay = shape[4], tilt = shape[5];
+    float odd = shape[6];
+    float sr = s->sample_rate;
+    float top = fminf(hi, sr * 0.45f);
+    float stiff = 0.02f * inharm;
+    float sigma0 = 6.9078f / fmaxf(decay, 0.01f); // ln(1000) / T60
+    const int vecs = (n + 3) / 4;
+
+    float w[RES_MAX_MODES] DSP_ALIGNED, a[RES_MAX_MODES] DSP_ALIGNED;
+    float tilt_w = exp2f(-2.0f * tilt);
+    float tilt_step = n > 1 ? exp2f(4.0f * tilt / (float)(n - 1)) : 1.0f;
+    int active = 0;
+    for (int k = 0; k < vecs * 4; k++) {
+        float p = (float)(k + 1);
+        float f = f0 * p * sqrtf(1.0f + stiff * p * p) *
+                  (1.0f + 0.5f * spread * s->jitter[k]);
+        if (k >= n || f >= top || f <= 0.0f) {
+            w[k] = 0.0f;
+            a[k] = 0.5f;
+            s->weight[k] = 0.0f;
+            continue;
+        }
+        w[k] = TWO_PI * f / sr;
+        a[k] = fminf(sigma0 * sqrtf(f / f0) / sr, 0.5f);
+        float w_odd = (k & 1) ? (1.f + odd) : (1.f - odd);
+        s->weight[k] = tilt_w * w_odd;
+        tilt_w *= tilt_step;
+        active++;
+    }
+
+    // Each mode is scaled to pass noise at unit power; the sum is then
+    // scaled by the number of modes sounding
+    float norm = 1.0f / sqrtf((float)(active > 0 ? active : 1));
+    for (int v = 0; v < vecs; v++) {
+        v4f sn, cs;
+        v4f r = v_exp_neg(*(v4f *)(a + 4 * v));
+        v_sincos(*(v4f *)(w + 4 * v), &sn, &cs);
+        *(v4f *)(s->pole_re + 4 * v) = r * cs;
+        *(v4f *)(s->pole_im + 4 * v) = r * sn;
+        v4f g2 = (1.0f - r) * (1.0f + r);
+        for (int l = 0; l < 4; l++) {
+            int k = 4 * v + l;
+            s->gain[k] = s->weight[k] != 0.0f ? sqrtf(g2[l]) : 0.0f;
+            s->weight[k] *= norm;
+        }
+    }
+    for (int k = vecs * 4; k < RES_MAX_MODES; k++)
+        s->y_re[k] = s->y_im[k] = 0.0f;
+
+    memcpy(s->modal_shape, shape, sizeof(s->modal_shape));
+    s->modal_count = n;
+}
+
+static void res_bank_process_modal(Module *m, const float *input,
+                                   unsigned long frames) {
+    ResBank *s = (ResBank *)m->state;
+    float *out = m->output_buffer;
+
+    pthread_mutex_lock(&s->lock);
+    float base_mix = s->mix;
+    float base_lo = s->lo_hz;
+    float base_hi = s->hi_hz;
+    float base_tilt = s->tilt;
+    float base_odd = s->odd;
+    float base_drive = s->drive;
+    float base_regen = s->regen;
+    float base_inharm = s->inharm;
+    float base_spread = s->spread;
+    float base_decay = s->decay;
+    int bands = s->bands;
+    pthread_mutex_unlock(&s->lock);
+
+    float mix_s = process_smoother(&s->smooth_mix, base_mix);
+    float lo = process_smoother(&s->smooth_lo_hz, base_lo);
+    float hi = process_smoother(&s->smooth_hi_hz, base_hi);
+    float tilt = process_smoother(&s->smooth_tilt, base_tilt);
+    float odd = process_smoother(&s->smooth_odd, base_odd);
+    float drive_s = process_smoother(&s->smooth_drive, base_drive);
+    float regen_s = process_smoother(&s->smooth_regen, base_regen);
+    float inharm = process_smoother(&s->smooth_inharm, base_inharm);
+    float spread = process_smoother(&s->smooth_spread, base_spread);
+    float decay = process_smoother(&s->smooth_decay, base_decay);
+
+    // The modes' shape changes per block: its CV is read once per block
+    for (int j = 0; j < m->num_control_inputs; j++) {
+        if (!m->control_inputs[j] || !m->control_input_params[j])
+            continue;
+
+        const char *param = m->control_input_params[j];
+        float control = m->control_inputs[j][frames - 1];
+        control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+        if (strcmp(param, "lo") == 0)
+            lo += control * base_lo;
+        else if (strcmp(param, "hi") == 0)
+            hi += control * base_hi;
+        else if (strcmp(param, "tilt") == 0)
+            tilt += control;
+        else if (strcmp(param, "odd") == 0)
+            odd += control;
+        else if (strcmp(param, "inharm") == 0)
+            inharm += control;
+        else if (strcmp(param, "spread") == 0)
+            spread += control;
+        else if (strcmp(param, "decay") == 0)
+            decay += control * base_decay;
+        else if (strcmp(param, "bands") == 0)
+            bands += (int)lrintf(control);
+    }
+
+    float ny = s->sample_rate * 0.45f;
+    if (lo < 20.0f)
+        lo = 20.0f;
+    if (hi > ny)
+        hi = ny;
+    if (hi < lo + 1.0f)
+        hi = lo + 1.0f;
+    clampf(&tilt, -1.0f, 1.0f);
+    clampf(&odd, -1.0f, 1.0f);
+    clampf(&inharm, 0.0f, 1.0f);
+    clampf(&spread, 0.0f, 1.0f);
+    clampf(&decay, 0.01f, 30.0f);
+    if (bands < 1)
+        bands = 1;
+    if (bands > RES_MAX_MODES)
+        bands = RES_MAX_MODES;
+
+    float shape[8] = {lo, hi, inharm, spread, decay, tilt, odd, 0.0f};
+    if (bands != s->modal_count ||
+        memcmp(shape, s->modal_shape, sizeof(shape)) != 0)
+        rebuild_modes(s, shape, bands);
+
+    const int vecs = (bands + 3) / 4;
+    const v4f *pr = (const v4f *)s->pole_re;
+    const v4f *pi = (const v4f *)s->pole_im;
+    const v4f *g = (const v4f *)s->gain;
+    const v4f *w = (const v4f *)s->weight;
+    v4f *yr = (v4f *)s->y_re;
+    v4f *yi = (v4f *)s->y_im;
+
+    float disp_mix = mix_s, disp_drive = drive_s, disp_regen = regen_s;
+
+    for (unsigned long i = 0; i < frames; i++) {
+        float mix = mix_s;
+        float drive = drive_s;
+        float regen = regen_s;
+
+        for (int j = 0; j < m->num_control_inputs; j++) {
+            if (!m->control_inputs[j] || !m->control_input_params[j])
+                continue;
+
+            const char *param = m->control_input_params[j];
+            float control = m->control_inputs[j][i];
+            control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+            if (strcmp(param, "mix") == 0)
+                mix += control;
+            else if (strcmp(param, "drive") == 0)
+                drive += control;
+            else if (strcmp(param, "regen") == 0)
+                regen += control;
+        }
+
+        clampf(&mix, 0.0f, 1.0f);
+        clampf(&drive, 0.0f, 1.0f);
+        clampf(&regen, 0.0f, 1.0f);
+
+        disp_mix = mix;
+        disp_drive = drive;
+        disp_regen = regen;
+
+        float x = (input ? input[i] : 0.0f) + 1e-20f;
+        if (!isfinite(x))
+            x = 0.0f;
+        float xin = x + regen * 0.008f * tanhf(s->modal_fb);
+
+        v4f acc = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int v = 0; v < vecs; v++) {
+            v4f re = yr[v], im = yi[v];
+            yr[v] = pr[v] * re - pi[v] * im + g[v] * xin;
+            yi[v] = pr[v] * im + pi[v] * re;
+            acc += yi[v] * w[v];
+        }
+        float sum = acc[0] + acc[1] + acc[2] + acc[3];
+        s->modal_fb = sum;
+
+        float wet = soft_sat(sum, drive);
+        float yout = mix * wet + (1.0f - mix) * x;
+        if (!isfinite(yout))
+            yout = 0.0f;
+        out[i] = fminf(fmaxf(yout, -1.0f), 1.0f);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->display_mix = disp_mix;
+    s->display_lo_hz = lo;
+    s->display_hi_hz = hi;
+    s->display_tilt = tilt;
+    s->display_odd = odd;
+    s->display_drive = disp_drive;
+    s->display_regen = disp_regen;
+    s->display_bands = bands;
+    s->display_inharm = inharm;
+    s->display_spread = spread;
+    s->display_decay = decay;
+    pthread_mutex_unlock(&s->lock);
+}
+
 static void res_bank_process(Module *m, float *in, unsigned long frames) {
     ResBank *s = (ResBank *)m->state;
     float *input = (m->num_inputs > 0) ? m->inputs[0] : in;
     float *out = m->output_buffer;
 
+    if (s->modal) {
+        res_bank_process_modal(m, input, frames);
+        return;
+    }
+
     pthread_mutex_lock(&s->lock);
     float base_mix = s->mix;
     float base_q = s->q;
@@ -261,15 +521,20 @@ static void clamp_params(ResBank *s) {
     clampf(&s->tilt, -1.0f, 1.0f);
     clampf(&s->odd, -1.0f, 1.0f);
 
+    clampf(&s->inharm, 0.0f, 1.0f);
+    clampf(&s->spread, 0.0f, 1.0f);
+    clampf(&s->decay, 0.01f, 30.0f);
+
+    int max_bands = s->modal ? RES_MAX_MODES : RES_MAX_BANDS;
     if (s->bands < 1)
         s->bands = 1;
-    if (s->bands > RES_MAX_BANDS)
-        s->bands = RES_MAX_BANDS;
+    if (s->bands > max_bands)
+        s->bands = max_bands;
 }
 
 static void res_bank_draw_ui(Module *m, int y, int x) {
     ResBank *s = (ResBank *)m->state;
-    float mix, q, lo, hi, tilt, odd, drive, regen;
+    float mix, q, lo, hi, tilt, odd, drive, regen, inharm, spread, decay;
     int bands;
     char cmd[64] = "";
 
@@ -283,6 +548,9 @@ static void res_bank_draw_ui(Module *m, int y, int x) {
     drive = s->display_drive;
     regen = s->display_regen;
     bands = s->display_bands;
+    inharm = s->display_inharm;
+    spread = s->display_spread;
+    decay = s->display_decay;
     if (s->entering_command)
         snprintf(cmd, sizeof(cmd), ":%s", s->command_buffer);
     pthread_mutex_unlock(&s->lock);
@@ -296,10 +564,17 @@ static void res_bank_draw_ui(Module *m, int y, int x) {
     printw("%.2f", mix);
     CLR();
 
-    LABEL(2, "q:");
-    ORANGE();
-    printw("%.1f", q);
-    CLR();
+    if (s->modal) {
+        LABEL(2, "dec:");
+        ORANGE();
+        printw("%.2f", decay);
+        CLR();
+    } else {
+        LABEL(2, "q:");
+        ORANGE();
+        printw("%.1f", q);
+        CLR();
+    }
 
     LABEL(2, "lo:");
     ORANGE();
@@ -311,11 +586,23 @@ static void res_bank_draw_ui(Module *m, int y, int x) {
     printw("%.0f", hi);
     CLR();
 
-    LABEL(2, "bands:");
+    LABEL(2, s->modal ? "modes:" : "bands:");
     ORANGE();
     printw("%d", bands);
     CLR();
 
+    if (s->modal) {
+        LABEL(2, "inh:");
+        ORANGE();
+        printw("%.2f", inharm);
+        CLR();
+
+        LABEL(2, "spr:");
+        ORANGE();
+        printw("%.2f", spread);
+        CLR();
+    }
+
     LABEL(2, "tilt:");
     ORANGE();
     printw("%.2f", tilt);
@@ -339,10 +626,12 @@ static void res_bank_draw_ui(Module *m, int y, int x) {
     YELLOW();
     mvprintw(y + 1, x,
              "-/= mix _/+ q [/] lo {/} hi ;/\' bands ?/\" tilt ,/. odd </> drv "
-             "9/0 rgn");
+             "9/0 rgn%s",
+             s->modal ? " d/D dec i/I inh s/S spr" : "");
     mvprintw(y + 2, x,
              ":1[mix] :2[q] :3[lo] :4[hi] :5[bnd] :6[tilt] :7[odd] :8[drive] "
-             ":9[regen]");
+             ":9[regen]%s",
+             s->modal ? " :d[dec] :i[inh] :s[spr]" : "");
     BLACK();
 }
 
@@ -425,6 +714,30 @@ static void res_bank_handle_input(Module *m, int key) {
             s->regen -= 0.01f;
             handled = 1;
             break;
+        case 'D':
+            s->decay *= 1.05f;
+            handled = 1;
+            break;
+        case 'd':
+            s->decay /= 1.05f;
+            handled = 1;
+            break;
+        case 'I':
+            s->inharm += 0.01f;
+            handled = 1;
+            break;
+        case 'i':
+            s->inharm -= 0.01f;
+            handled = 1;
+            break;
+        case 'S':
+            s->spread += 0.01f;
+            handled = 1;
+            break;
+        case 's':
+            s->spread -= 0.01f;
+            handled = 1;
+            break;
         case ':':
             s->entering_command = true;
             memset(s->command_buffer, 0, sizeof(s->command_buffer));
@@ -456,6 +769,12 @@ static void res_bank_handle_input(Module *m, int key) {
                     s->drive = val;
                 else if (type == '9')
                     s->regen = val;
+                else if (type == 'd')
+                    s->decay = val;
+                else if (type == 'i')
+                    s->inharm = val;
+                else if (type == 's')
+                    s->spread = val;
             }
             handled = 1;
         } else if (key == 27) { // ESC
@@ -507,9 +826,18 @@ static void res_bank_set_osc_param(Module *m, const char *param, float value) {
         s->drive = fminf(fmaxf(value, 0.0f), 1.0f);
     else if (strcmp(param, "regen") == 0)
         s->regen = fminf(fmaxf(value, 0.0f), 1.0f);
-    else if (strcmp(param, "bands") == 0) {
+    else if (strcmp(param, "inharm") == 0)
+        s->inharm = fminf(fmaxf(value, 0.0f), 1.0f);
+    else if (strcmp(param, "spread") == 0)
+        s->spread = fminf(fmaxf(value, 0.0f), 1.0f);
+    else if (strcmp(param, "decay") == 0) {
+        // 0..1 → 0.05..20 s (exp)
+        float norm = fminf(fmaxf(value, 0.0f), 1.0f);
+        s->decay = 0.05f * powf(20.0f / 0.05f, norm);
+    } else if (strcmp(param, "bands") == 0) {
         float norm = fminf(fmaxf(value, 0.0f), 1.0f);
-        float mapped = 1.0f + norm * (RES_MAX_BANDS - 1.0f);
+        int max_bands = s->modal ? RES_MAX_MODES : RES_MAX_BANDS;
+        float mapped = 1.0f + norm * (max_bands - 1.0f);
         s->bands = (int)(mapped + 0.5f);
         s->need_centers = 1;
     } else if (strcmp(param, "lo") == 0) {
@@ -524,7 +852,7 @@ static void res_bank_set_osc_param(Module *m, const char *param, float value) {
         s->hi_hz = min_hz * powf(max_hz / min_hz, norm);
         s->need_centers = 1;
     } else {
-        fprintf(stderr, "[res_bank] Unknown OSC param: %s\n", param);
+        LOG_WARN("[res_bank] Unknown OSC param: %s", param);
     }
 
     clamp_params(s);
@@ -533,8 +861,10 @@ static void res_bank_set_osc_param(Module *m, const char *param, float value) {
 
 static void res_bank_destroy(Module *m) {
     ResBank *s = (ResBank *)m->state;
-    if (s)
+    if (s) {
+        free(s->modes);
         pthread_mutex_destroy(&s->lock);
+    }
     destroy_base_module(m);
 }
 
@@ -542,7 +872,21 @@ Module *create_module(const char *args, float sample_rate) {
     // defaults
     float mix = 0.5f, q = 12.f, lo = 120.f, hi = 6000.f, tilt = 0.f, odd = 0.f,
           drive = 0.2f, regen = 0.1f;
+    float inharm = 0.0f, spread = 0.0f, decay = 1.5f;
     int bands = 12;
+    bool modal = false;
+
+    // mode=modal: a bank of struck modes over lo instead of bandpasses
+    if (args && strstr(args, "mode=")) {
+        char v[16] = {0};
+        sscanf(strstr(args, "mode="), "mode=%15[^, ]", v);
+        if (strcmp(v, "modal") == 0) {
+            modal = true;
+            bands = 32;
+        } else if (strcmp(v, "filter") != 0) {
+            LOG_WARN("[res_bank] Unknown mode '%s', using filter", v);
+        }
+    }
 
     if (args && strstr(args, "mix="))
         sscanf(strstr(args, "mix="), "mix=%f", &mix);
@@ -562,6 +906,14 @@ Module *create_module(const char *args, float sample_rate) {
         sscanf(strstr(args, "regen="), "regen=%f", &regen);
     if (args && strstr(args, "bands="))
         sscanf(strstr(args, "bands="), "bands=%d", &bands);
+    if (args && strstr(args, "modes="))
+        sscanf(strstr(args, "modes="), "modes=%d", &bands);
+    if (args && strstr(args, "inharm="))
+        sscanf(strstr(args, "inharm="), "inharm=%f", &inharm);
+    if (args && strstr(args, "spread="))
+        sscanf(strstr(args, "spread="), "spread=%f", &spread);
+    if (args && strstr(args, "decay="))
+        sscanf(strstr(args, "decay="), "decay=%f", &decay);
 
     ResBank *s = calloc(1, sizeof(ResBank));
     s->sample_rate = sample_rate;
@@ -574,8 +926,34 @@ Module *create_module(const char *args, float sample_rate) {
     s->drive = drive;
     s->regen = regen;
     s->bands = bands;
+    s->modal = modal;
+    s->inharm = inharm;
+    s->spread = spread;
+    s->decay = decay;
     pthread_mutex_init(&s->lock, NULL);
 
+    if (modal) {
+        s->modes = dsp_alloc(6 * RES_MAX_MODES);
+        if (!s->modes) {
+            LOG_ERROR("[res_bank] out of memory for %d modes", RES_MAX_MODES);
+            pthread_mutex_destroy(&s->lock);
+            free(s);
+            return NULL;
+        }
+        s->pole_re = s->modes;
+        s->pole_im = s->modes + RES_MAX_MODES;
+        s->gain = s->modes + 2 * RES_MAX_MODES;
+        s->weight = s->modes + 3 * RES_MAX_MODES;
+        s->y_re = s->modes + 4 * RES_MAX_MODES;
+        s->y_im = s->modes + 5 * RES_MAX_MODES;
+        // Fixed detuning, the same every time the module is made
+        uint32_t seed = 0x9e3779b9u;
+        for (int k = 0; k < RES_MAX_MODES; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            s->jitter[k] = (float)(seed >> 8) / 8388608.0f - 1.0f;
+        }
+    }
+
     init_smoother(&s->smooth_mix, 0.50f);
     init_smoother(&s->smooth_q, 0.75f);
     init_smoother(&s->smooth_lo_hz, 0.75f);
@@ -584,6 +962,9 @@ Module *create_module(const char *args, float sample_rate) {
     init_smoother(&s->smooth_odd, 0.50f);
     init_smoother(&s->smooth_drive, 0.50f);
     init_smoother(&s->smooth_regen, 0.75f);
+    init_smoother(&s->smooth_inharm, 0.75f);
+    init_smoother(&s->smooth_spread, 0.75f);
+    init_smoother(&s->smooth_decay, 0.75f);
 
     clamp_params(s);
     s->need_centers = 1;
@@ -5,6 +5,7 @@
 #include <pthread.h>
 
 #define RES_MAX_BANDS 24
+#define RES_MAX_MODES 256 // modal mode
 
 typedef struct {
     float sample_rate;
@@ -17,7 +18,13 @@ typedef struct {
     float odd;
     float drive;
     float regen;
-    int bands;
+    int bands; // modes, in modal mode
+
+    // Modal mode: `lo` is the fundamental, modes stop at `hi`
+    bool modal;
+    float inharm; // 0..1, stiffness stretching the partials
+    float spread; // 0..1, fixed per-mode detuning
+    float decay;  // seconds to -60 dB at the fundamental
 
     float display_mix;
     float display_q;
@@ -28,6 +35,9 @@ typedef struct {
     float display_drive;
     float display_regen;
     int display_bands;
+    float display_inharm;
+    float display_spread;
+    float display_decay;
 
     CParamSmooth smooth_mix;
     CParamSmooth smooth_q;
@@ -38,6 +48,9 @@ typedef struct {
     CParamSmooth smooth_drive;
     CParamSmooth smooth_regen;
     CParamSmooth smooth_bands;
+    CParamSmooth smooth_inharm;
+    CParamSmooth smooth_spread;
+    CParamSmooth smooth_decay;
 
     float b0[RES_MAX_BANDS], b1[RES_MAX_BANDS], b2[RES_MAX_BANDS];
     float a1[RES_MAX_BANDS], a2[RES_MAX_BANDS];
@@ -49,6 +62,17 @@ typedef struct {
     int need_centers;
     int need_coeffs;
 
+    // Modal mode: a complex one-pole per mode, y = p * y + g * x, four
+    // modes per vector. The arrays share one aligned allocation.
+    float *modes;
+    float *pole_re, *pole_im;
+    float *gain, *weight;
+    float *y_re, *y_im;
+    float jitter[RES_MAX_MODES]; // -1..1, scaled by spread
+    float modal_shape[8];        // params the poles were last built for
+    int modal_count;
+    float modal_fb; // last wet sum, for regen
+
     bool entering_command;
     char command_buffer[64];
     int command_index;
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "ring_mod.h"
 #include "util.h"
@@ -15,8 +16,9 @@ static void ringmod_process(Module *m, float *in, unsigned long frames) {
     float *out = m->output_buffer;
 
     if (!in_car || !in_mod) {
-        if (!in_mod) {
-            printf("[ring_mod] WARNING: missing 2nd audio input\n");
+        if (!in_mod && !state->warned_no_mod) {
+            LOG_WARN("[ring_mod] missing 2nd audio input");
+            state->warned_no_mod = 1;
         }
         memset(out, 0, frames * sizeof(float));
         return;
@@ -213,7 +215,7 @@ static void ring_mod_set_osc_param(Module *m, const char *param, float value) {
     } else if (strcmp(param, "mod_amp") == 0) {
         state->mod_amp = fminf(fmaxf(value, 0.0f), 1.0f);
     } else {
-        fprintf(stderr, "[ring_mod] Unknown OSC param: %s\n", param);
+        LOG_WARN("[ring_mod] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
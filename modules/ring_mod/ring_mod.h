@@ -16,6 +16,7 @@ typedef struct {
     CParamSmooth smooth_depth;
 
     pthread_mutex_t lock;
+    int warned_no_mod; // logged once, not every block
 
     float display_car_amp;
     float display_mod_amp;
@@ -5,18 +5,35 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "spec_hold.h"
 #include "util.h"
 
-#define FFT_SIZE 2048
-#define HOP_SIZE (FFT_SIZE / 2)
-
-static float hann[FFT_SIZE];
-
-static void init_hann_window() {
-    for (int i = 0; i < FFT_SIZE; i++) {
-        hann[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / (FFT_SIZE - 1)));
+// Runs once per frame, possibly on the STFT helper thread. The tilt is
+// +/-3 dB per octave around the pivot; the DC bin is dropped.
+static void spec_hold_bins(void *user, const void *params,
+                           fftwf_complex *const *in, fftwf_complex *out,
+                           int k0, int k1) {
+    SpecHold *state = (SpecHold *)user;
+    const SpecHoldFrame *f = (const SpecHoldFrame *)params;
+
+    // 10^(tilt * 3 * log2(hz / pivot) / 20) as a power of two
+    float slope = f->tilt * 3.0f / 20.0f * log2f(10.0f);
+    float log2_pivot = log2f(f->pivot_hz);
+
+    for (int k = k0; k < k1; k++) {
+        if (!f->freeze) {
+            state->frozen[k][0] = in[0][k][0];
+            state->frozen[k][1] = in[0][k][1];
+        }
+        float gain = exp2f(slope * (state->log2_hz[k] - log2_pivot));
+        out[k][0] = gain * state->frozen[k][0];
+        out[k][1] = gain * state->frozen[k][1];
+    }
+    if (k0 == 0) {
+        out[0][0] = 0.0f;
+        out[0][1] = 0.0f;
     }
 }
 
@@ -33,111 +50,39 @@ static void spec_hold_process(Module *m, float *in, unsigned long frames) {
     float sample_rate = state->sample_rate;
     pthread_mutex_unlock(&state->lock);
 
-    float pivot_s = process_smoother(&state->smooth_pivot_hz, base_pivot);
-    float tilt_s = process_smoother(&state->smooth_tilt, base_tilt);
-
-    float disp_pivot = pivot_s;
-    float disp_tilt = tilt_s;
+    float pivot = process_smoother(&state->smooth_pivot_hz, base_pivot);
+    float tilt = process_smoother(&state->smooth_tilt, base_tilt);
 
-    for (unsigned long i = 0; i < frames; i++) {
-        float pivot = pivot_s;
-        float tilt = tilt_s;
+    // Spectral params only change per frame: CV is read once per block
+    for (int j = 0; j < m->num_control_inputs; j++) {
+        if (!m->control_inputs[j] || !m->control_input_params[j])
+            continue;
 
-        for (int j = 0; j < m->num_control_inputs; j++) {
-            if (!m->control_inputs[j] || !m->control_input_params[j])
-                continue;
+        const char *param = m->control_input_params[j];
+        float control = m->control_inputs[j][frames - 1];
+        control = fminf(fmaxf(control, -1.0f), 1.0f);
 
-            const char *param = m->control_input_params[j];
-            float control = m->control_inputs[j][i];
-            control = fminf(fmaxf(control, -1.0f), 1.0f);
-
-            if (strcmp(param, "pivot") == 0) {
-                pivot += control * base_pivot;
-            } else if (strcmp(param, "tilt") == 0) {
-                tilt += control;
-            }
+        if (strcmp(param, "pivot") == 0) {
+            pivot += control * base_pivot;
+        } else if (strcmp(param, "tilt") == 0) {
+            tilt += control;
         }
+    }
 
-        clampf(&pivot, 1.0f, sample_rate * 0.45f);
-        clampf(&tilt, -1.0f, 1.0f);
-
-        disp_pivot = pivot;
-        disp_tilt = tilt;
-
-        state->input_buffer[state->in_write_index] = input ? input[i] : 0.0f;
-        state->in_write_index++;
-        if (state->in_write_index >= FFT_SIZE)
-            state->in_write_index = 0;
-
-        state->hop_write_index++;
-
-        if (state->hop_write_index >= HOP_SIZE) {
-            state->hop_write_index = 0;
-
-            unsigned int idx = state->in_write_index;
-            for (int k = 0; k < FFT_SIZE; k++) {
-                state->time_buffer[k] = state->input_buffer[idx] * hann[k];
-                idx++;
-                if (idx >= FFT_SIZE)
-                    idx = 0;
-            }
-
-            fftwf_execute(state->fft_plan);
-
-            int bins = FFT_SIZE / 2 + 1;
-            float nyquist = sample_rate * 0.5f;
-
-            for (int k = 0; k < bins; k++) {
-                float mag, phase;
-
-                if (!freeze) {
-                    mag = hypotf(state->freq_buffer[k][0],
-                                 state->freq_buffer[k][1]);
-                    phase = atan2f(state->freq_buffer[k][1],
-                                   state->freq_buffer[k][0]);
-                    state->frozen_mag[k] = mag;
-                    state->frozen_phase[k] = phase;
-                } else {
-                    mag = state->frozen_mag[k];
-                    phase = state->frozen_phase[k];
-                }
-
-                float hz = ((float)k / (float)bins) * nyquist;
-                if (hz < 1.0f)
-                    hz = 1.0f;
-
-                float gain_db = tilt * 3.0f * log2f(hz / pivot);
-                float gain = powf(10.0f, gain_db / 20.0f);
-
-                state->freq_buffer[k][0] = gain * mag * cosf(phase);
-                state->freq_buffer[k][1] = gain * mag * sinf(phase);
-            }
-
-            fftwf_execute(state->ifft_plan);
-
-            float dc = 0.0f;
-            for (int k = 0; k < FFT_SIZE; k++)
-                dc += state->time_buffer[k];
-            dc /= FFT_SIZE;
-            for (int k = 0; k < FFT_SIZE; k++)
-                state->time_buffer[k] -= dc;
-
-            for (int k = 0; k < FFT_SIZE; k++) {
-                state->output_buffer[k] += state->time_buffer[k] / FFT_SIZE;
-            }
-        }
+    clampf(&pivot, 1.0f, sample_rate * 0.45f);
+    clampf(&tilt, -1.0f, 1.0f);
 
-        out[i] = state->output_buffer[i];
-    }
+    SpecHoldFrame *f = stft_params(state->stft);
+    f->tilt = tilt;
+    f->pivot_hz = pivot;
+    f->freeze = freeze;
 
-    memmove(state->output_buffer, state->output_buffer + frames,
-            sizeof(float) * (FFT_SIZE - frames));
-    memset(state->output_buffer + (FFT_SIZE - frames), 0,
-           sizeof(float) * frames);
+    const float *inputs[1] = {input};
+    stft_process(state->stft, inputs, out, frames);
 
     pthread_mutex_lock(&state->lock);
-    state->display_pivot = disp_pivot;
-    state->display_tilt = disp_tilt;
+    state->display_pivot = pivot;
+    state->display_tilt = tilt;
     pthread_mutex_unlock(&state->lock);
 }
 
@@ -272,7 +217,7 @@ static void spec_hold_set_osc_param(Module *m, const char *param, float value) {
         if (value > 0.5f)
             state->freeze = !state->freeze;
     } else {
-        fprintf(stderr, "[spec_hold] Unknown OSC param: %s\n", param);
+        LOG_WARN("[spec_hold] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
@@ -284,14 +229,9 @@ static void spec_hold_destroy(Module *m) {
         return;
     SpecHold *state = (SpecHold *)m->state;
     if (state) {
-        fftwf_destroy_plan(state->fft_plan);
-        fftwf_destroy_plan(state->ifft_plan);
-        fftwf_free(state->time_buffer);
-        fftwf_free(state->freq_buffer);
-        free(state->input_buffer);
-        free(state->output_buffer);
-        free(state->frozen_mag);
-        free(state->frozen_phase);
+        stft_destroy(state->stft);
+        fftwf_free(state->frozen);
+        free(state->log2_hz);
         pthread_mutex_destroy(&state->lock);
         // Do NOT free(state) — destroy_base_module() will
     }
@@ -318,29 +258,29 @@ Module *create_module(const char *args, float sample_rate) {
     init_smoother(&state->smooth_pivot_hz, 0.75f);
     clamp_params(state);
 
-    init_hann_window();
-
-    state->input_buffer = calloc(FFT_SIZE, sizeof(float));
-    state->output_buffer = calloc(FFT_SIZE, sizeof(float));
-    state->time_buffer = fftwf_alloc_real(FFT_SIZE);
-    state->freq_buffer = fftwf_alloc_complex(FFT_SIZE / 2 + 1);
-    state->frozen_mag = calloc(FFT_SIZE / 2 + 1, sizeof(float));
-    state->frozen_phase = calloc(FFT_SIZE / 2 + 1, sizeof(float));
+    StftConfig cfg = {.size = SPEC_HOLD_FFT_SIZE,
+                      .hop = SPEC_HOLD_HOP_SIZE,
+                      .inputs = 1,
+                      .window = STFT_WINDOW_HANN,
+                      .mode = STFT_AUTO};
+    stft_config_from_args(&cfg, args);
+    state->stft =
+        stft_create(&cfg, spec_hold_bins, state, sizeof(SpecHoldFrame));
+
+    int bins = stft_bins(state->stft);
+    state->frozen = fftwf_alloc_complex(bins);
+    memset(state->frozen, 0, bins * sizeof(fftwf_complex));
+    state->log2_hz = malloc(bins * sizeof(float));
+    for (int k = 0; k < bins; k++) {
+        float hz = ((float)k / (float)bins) * sample_rate * 0.5f;
+        state->log2_hz[k] = log2f(hz < 1.0f ? 1.0f : hz);
+    }
     state->freeze = false;
-    memset(state->output_buffer, 0, sizeof(float) * FFT_SIZE);
-
-    state->fft_plan = fftwf_plan_dft_r2c_1d(FFT_SIZE, state->time_buffer,
-                                            state->freq_buffer, FFTW_ESTIMATE);
-    state->ifft_plan = fftwf_plan_dft_c2r_1d(FFT_SIZE, state->freq_buffer,
-                                             state->time_buffer, FFTW_ESTIMATE);
-
-    state->hop_write_index = 0;
-    state->in_write_index = 0;
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "spec_tilt";
     m->state = state;
-    m->output_buffer = calloc(HOP_SIZE, sizeof(float));
+    m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
     m->process = spec_hold_process;
     m->draw_ui = spec_hold_draw_ui;
     m->handle_input = spec_hold_handle_input;
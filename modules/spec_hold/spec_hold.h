@@ -2,18 +2,28 @@
 #define SPEC_HOLD
 
 #include "module.h"
+#include "stft.h"
 #include "util.h"
 #include <fftw3.h>
 #include <pthread.h>
 
+#define SPEC_HOLD_FFT_SIZE 2048
+#define SPEC_HOLD_HOP_SIZE (SPEC_HOLD_FFT_SIZE / 2)
+
+// Taken with each STFT frame
+typedef struct {
+    float tilt;
+    float pivot_hz;
+    bool freeze;
+} SpecHoldFrame;
+
 typedef struct {
     float sample_rate;
     float tilt;     // -1.0 to +1.0 (negative = dark, positive = light)
     float pivot_hz; // point of tilt
 
     bool freeze;
-    float *frozen_mag;
-    float *frozen_phase;
+    fftwf_complex *frozen; // last spectrum before freeze
 
     CParamSmooth smooth_tilt;
     CParamSmooth smooth_pivot_hz;
@@ -23,18 +33,8 @@ typedef struct {
     float display_tilt;
     float display_pivot;
 
-    // FFT state
-    float *time_buffer;
-    fftwf_complex *freq_buffer;
-    fftwf_plan fft_plan;
-    fftwf_plan ifft_plan;
-
-    // Overlap-add buffers
-    float *input_buffer;
-    float *output_buffer;
-
-    int hop_write_index;
-    unsigned int in_write_index;
+    Stft *stft;
+    float *log2_hz; // per bin, for the tilt curve
 
     // For command mode input
     bool entering_command;
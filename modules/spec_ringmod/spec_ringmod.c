@@ -5,10 +5,88 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "spec_ringmod.h"
 #include "util.h"
 
+// Runs once per frame, possibly on the STFT helper thread: in[0] is the
+// carrier, in[1] the modulator
+static void spec_ringmod_bins(void *user, const void *params,
+                              fftwf_complex *const *in, fftwf_complex *out,
+                              int k0, int k1) {
+    SpecRingMod *s = (SpecRingMod *)user;
+    const SpecRingFrame *f = (const SpecRingFrame *)params;
+    const int bins = stft_bins(s->stft);
+
+    int bin_low = (int)((f->bandlimit_low / f->nyquist) * (bins - 1));
+    int bin_high = (int)((f->bandlimit_high / f->nyquist) * (bins - 1));
+    clampi(&bin_low, 0, bins - 1);
+    clampi(&bin_high, 0, bins - 1);
+
+    for (int k = k0; k < k1; k++) {
+        /* smooth mod magnitudes once per frame */
+        float y_mag = hypotf(in[1][k][0], in[1][k][1]);
+        const float a = 0.15f;
+        s->y_mag_smooth[k] = (1.0f - a) * s->y_mag_smooth[k] + a * y_mag;
+
+        float xr = in[0][k][0];
+        float xi = in[0][k][1];
+
+        if (k < bin_low || k > bin_high) {
+            out[k][0] = xr;
+            out[k][1] = xi;
+            continue;
+        }
+
+        float x_mag = hypotf(xr, xi) + 1e-12f; // carrier magnitude
+        y_mag = s->y_mag_smooth[k];            // modulator magnitude
+        float env = y_mag / x_mag;             // dimensionless envelope
+        float scale;
+
+        switch (f->op) {
+
+        case SPEC_OP_RING:
+            scale = 1.0f;
+            break;
+
+        case SPEC_OP_AMP_ONLY:
+            scale = fminf(env, 1.0f);
+            break;
+
+        case SPEC_OP_CROSS_SYNTH:
+            scale = env;
+            break;
+
+        case SPEC_OP_SPECTRAL_AM:
+            scale = 1.0f + env;
+            break;
+
+        case SPEC_OP_SUBTRACT:
+            scale = fmaxf(0.0f, 1.0f - env);
+            break;
+
+        case SPEC_OP_MIN_MAG:
+            scale = fminf(1.0f, env);
+            break;
+
+        default:
+            scale = 1.0f;
+            break;
+        }
+        clampf(&scale, 0.0f, 8.0f);
+
+        if (f->op == SPEC_OP_RING) {
+            float mag = x_mag * fminf(y_mag, 1.0f);
+            out[k][0] = (xr / x_mag) * mag;
+            out[k][1] = (xi / x_mag) * mag;
+        } else {
+            out[k][0] = xr * scale;
+            out[k][1] = xi * scale;
+        }
+    }
+}
+
 static void spec_ringmod_process(Module *m, float *in, unsigned long frames) {
     SpecRingMod *s = (SpecRingMod *)m->state;
     float *in_car = (m->num_inputs > 0) ? m->inputs[0] : in;
@@ -26,6 +104,7 @@ static void spec_ringmod_process(Module *m, float *in, unsigned long frames) {
     float base_mod = s->mod_amp;
     float base_bl = s->bandlimit_low;
     float base_bh = s->bandlimit_high;
+    SpecRingOp op = s->op;
     float sr = s->sample_rate;
     pthread_mutex_unlock(&s->lock);
 
@@ -39,9 +118,6 @@ static void spec_ringmod_process(Module *m, float *in, unsigned long frames) {
     float disp_bl = base_bl;
     float disp_bh = base_bh;
 
-    const int N = SPEC_RINGMOD_FFT_SIZE;
-    const int H = SPEC_RINGMOD_HOP_SIZE;
-    const int bins = N / 2 + 1;
     const float nyq = sr * 0.5f;
 
     for (unsigned long i = 0; i < frames; i++) {
@@ -85,135 +161,28 @@ static void spec_ringmod_process(Module *m, float *in, unsigned long frames) {
         disp_bl = bl;
         disp_bh = bh;
 
-        /* write input (raw history) */
-        s->td_car[s->write_pos] = in_car[i] * car;
-        s->td_mod[s->write_pos] = in_mod[i] * mod;
-        s->write_pos++;
-
-        /* output ring (NO per-sample memmove) */
-        int ola_r = s->hop_pos; /* reuse hop_pos as OLA read index */
-        float y = s->ola_buffer[ola_r];
-        out[i] = y * mix + in_car[i] * (1.0f - mix);
-
-        /* consume one sample from the OLA ring */
-        s->ola_buffer[ola_r] = 0.0f;
-        ola_r++;
-        if (ola_r >= N)
-            ola_r = 0;
-        s->hop_pos = ola_r;
-
-        if (s->write_pos < N)
-            continue;
-
-        /* analysis window */
-        for (int n = 0; n < N; n++) {
-            s->td_car_win[n] = s->td_car[n] * s->window[n];
-            s->td_mod_win[n] = s->td_mod[n] * s->window[n];
-        }
-
-        fftwf_execute(s->plan_car_fwd);
-        fftwf_execute(s->plan_mod_fwd);
-
-        int bin_low = (int)((bl / nyq) * (bins - 1));
-        int bin_high = (int)((bh / nyq) * (bins - 1));
-        clampi(&bin_low, 0, bins - 1);
-        clampi(&bin_high, 0, bins - 1);
-
-        /* smooth + hold mod magnitudes ONCE per frame */
-        for (int k = 0; k < bins; k++) {
-            float yr = s->Y[k][0];
-            float yi = s->Y[k][1];
-            float y_mag = hypotf(yr, yi);
-
-            const float a = 0.15f;
-            s->y_mag_smooth[k] = (1.0f - a) * s->y_mag_smooth[k] + a * y_mag;
-
-            s->y_mag_hold[k] = s->y_mag_smooth[k];
-        }
-
-        /* spectral processing */
-        for (int k = 0; k < bins; k++) {
-
-            float xr = s->X[k][0];
-            float xi = s->X[k][1];
-
-            if (k < bin_low || k > bin_high) {
-                s->Z[k][0] = xr;
-                s->Z[k][1] = xi;
-                continue;
-            }
-
-            float x_mag = hypotf(xr, xi) + 1e-12f; // carrier magnitude
-            float y_mag = s->y_mag_hold[k];        // modulator magnitude
-            float env = y_mag / x_mag;             // dimensionless envelope
-            float scale;
-
-            switch (s->op) {
-
-            case SPEC_OP_RING:
-                scale = 1.0f;
-                break;
-
-            case SPEC_OP_AMP_ONLY:
-                scale = fminf(env, 1.0f);
-                break;
-
-            case SPEC_OP_CROSS_SYNTH:
-                scale = env;
-                break;
-
-            case SPEC_OP_SPECTRAL_AM:
-                scale = 1.0f + env;
-                break;
-
-            case SPEC_OP_SUBTRACT:
-                scale = fmaxf(0.0f, 1.0f - env);
-                break;
-
-            case SPEC_OP_MIN_MAG:
-                scale = fminf(1.0f, env);
-                break;
-
-            default:
-                scale = 1.0f;
-                break;
-            }
-            clampf(&scale, 0.0f, 8.0f);
-
-            if (s->op == SPEC_OP_RING) {
-                float mag = x_mag * fminf(y_mag, 1.0f);
-                s->Z[k][0] = (xr / x_mag) * mag;
-                s->Z[k][1] = (xi / x_mag) * mag;
-            } else {
-                s->Z[k][0] = xr * scale;
-                s->Z[k][1] = xi * scale;
-            }
-        }
-
-        fftwf_execute(s->plan_inv);
-
-        /* IFFT scaling + synthesis window (sqrt-Hann) */
-        const float invN = 1.0f / (float)N;
-        for (int n = 0; n < N; n++) {
-            s->td_out[n] = s->td_out[n] * invN * s->window[n];
-        }
+        s->car_block[i] = in_car[i] * car;
+        s->mod_block[i] = in_mod[i] * mod;
+        s->mix_block[i] = mix;
+    }
 
-        /* overlap-add into ring, aligned to current read head */
-        int w0 = s->hop_pos;
-        for (int n = 0; n < N; n++) {
-            int idx = w0 + n;
-            if (idx >= N)
-                idx -= N;
-            s->ola_buffer[idx] += s->td_out[n];
-        }
+    // Band limits apply per frame: the block's last value is taken
+    SpecRingFrame *f = stft_params(s->stft);
+    f->bandlimit_low = disp_bl;
+    f->bandlimit_high = disp_bh;
+    f->nyquist = nyq;
+    f->op = op;
 
-        /* shift input history by hop (still block-rate, not sample-rate) */
-        memmove(s->td_car, s->td_car + H, sizeof(float) * (N - H));
-        memmove(s->td_mod, s->td_mod + H, sizeof(float) * (N - H));
-        memset(s->td_car + (N - H), 0, sizeof(float) * H);
-        memset(s->td_mod + (N - H), 0, sizeof(float) * H);
+    const float *inputs[2] = {s->car_block, s->mod_block};
+    stft_process(s->stft, inputs, s->wet_block, frames);
 
-        s->write_pos = (N - H);
+    for (unsigned long i = 0; i < frames; i++) {
+        float dry = s->dry[s->dry_pos];
+        s->dry[s->dry_pos] = in_car[i];
+        if (++s->dry_pos == s->dry_len)
+            s->dry_pos = 0;
+        float mix = s->mix_block[i];
+        out[i] = s->wet_block[i] * mix + dry * (1.0f - mix);
     }
 
     pthread_mutex_lock(&s->lock);
@@ -405,7 +374,7 @@ static void spec_ringmod_set_osc_param(Module *m, const char *p, float v) {
         if (v > 0.5f)
             s->op = (SpecRingOp)((s->op + 1) % 6);
     } else {
-        fprintf(stderr, "[spec_ringmod] Unknown OSC param: %s\n", p);
+        LOG_WARN("[spec_ringmod] Unknown OSC param: %s", p);
     }
 
     clamp_params(s);
@@ -417,24 +386,9 @@ static void spec_ringmod_destroy(Module *m) {
     if (!s)
         return;
 
-    fftwf_destroy_plan(s->plan_car_fwd);
-    fftwf_destroy_plan(s->plan_mod_fwd);
-    fftwf_destroy_plan(s->plan_inv);
-
-    fftwf_free(s->X);
-    fftwf_free(s->Y);
-    fftwf_free(s->Z);
-    fftwf_free(s->td_car);
-    fftwf_free(s->td_mod);
-    fftwf_free(s->td_car_win);
-    fftwf_free(s->td_mod_win);
-    fftwf_free(s->td_out);
-
+    stft_destroy(s->stft);
     free(s->y_mag_smooth);
-    free(s->y_mag_hold);
-
-    free(s->window);
-    free(s->ola_buffer);
+    free(s->dry);
     pthread_mutex_destroy(&s->lock);
     destroy_base_module(m);
 }
@@ -460,7 +414,7 @@ Module *create_module(const char *args, float sample_rate) {
         sscanf(strstr(args, "mod_amp="), "mod_amp=%f", &mod_amp);
     }
     if (args && strstr(args, "mix=")) {
-        sscanf(strstr(args, "mix="), "mix=%f", &mod_amp);
+        sscanf(strstr(args, "mix="), "mix=%f", &mix);
     }
     if (args && strstr(args, "op=")) {
         char op_str[32] = {0};
@@ -478,7 +432,7 @@ Module *create_module(const char *args, float sample_rate) {
         else if (strcmp(op_str, "min") == 0)
             op = SPEC_OP_MIN_MAG;
         else
-            fprintf(stderr, "[SpecRingMod] Unknown type: '%s'\n", op_str);
+            LOG_WARN("[SpecRingMod] Unknown type: '%s'", op_str);
     }
     SpecRingMod *s = calloc(1, sizeof(SpecRingMod));
     s->mix = mix;
@@ -487,8 +441,6 @@ Module *create_module(const char *args, float sample_rate) {
     s->bandlimit_low = band_low;
     s->bandlimit_high = band_high;
     s->op = op;
-    s->td_car_win = fftwf_alloc_real(SPEC_RINGMOD_FFT_SIZE);
-    s->td_mod_win = fftwf_alloc_real(SPEC_RINGMOD_FFT_SIZE);
 
     s->sample_rate = sample_rate;
 
@@ -498,39 +450,16 @@ Module *create_module(const char *args, float sample_rate) {
     init_smoother(&s->smooth_mod_amp, 0.75f);
     clamp_params(s);
 
-    s->td_car = fftwf_alloc_real(SPEC_RINGMOD_FFT_SIZE);
-    s->td_mod = fftwf_alloc_real(SPEC_RINGMOD_FFT_SIZE);
-    s->td_out = fftwf_alloc_real(SPEC_RINGMOD_FFT_SIZE);
-    s->ola_buffer = calloc(SPEC_RINGMOD_FFT_SIZE, sizeof(float));
-
-    memset(s->td_car, 0, sizeof(float) * SPEC_RINGMOD_FFT_SIZE);
-    memset(s->td_mod, 0, sizeof(float) * SPEC_RINGMOD_FFT_SIZE);
-    memset(s->td_car_win, 0, sizeof(float) * SPEC_RINGMOD_FFT_SIZE);
-    memset(s->td_mod_win, 0, sizeof(float) * SPEC_RINGMOD_FFT_SIZE);
-    memset(s->td_out, 0, sizeof(float) * SPEC_RINGMOD_FFT_SIZE);
-
-    s->write_pos = 0;
-    s->hop_pos = 0;
-    s->y_mag_smooth = calloc((SPEC_RINGMOD_FFT_SIZE / 2 + 1), sizeof(float));
-    s->y_mag_hold = calloc((SPEC_RINGMOD_FFT_SIZE / 2 + 1), sizeof(float));
-
-    s->window = malloc(sizeof(float) * SPEC_RINGMOD_FFT_SIZE);
-    for (int i = 0; i < SPEC_RINGMOD_FFT_SIZE; i++) {
-        float w =
-            0.5f * (1.0f - cosf(2.0f * M_PI * i / (SPEC_RINGMOD_FFT_SIZE - 1)));
-        s->window[i] = sqrtf(w);
-    }
-
-    s->X = fftwf_alloc_complex(SPEC_RINGMOD_FFT_SIZE);
-    s->Y = fftwf_alloc_complex(SPEC_RINGMOD_FFT_SIZE);
-    s->Z = fftwf_alloc_complex(SPEC_RINGMOD_FFT_SIZE);
-
-    s->plan_car_fwd = fftwf_plan_dft_r2c_1d(SPEC_RINGMOD_FFT_SIZE,
-                                            s->td_car_win, s->X, FFTW_ESTIMATE);
-    s->plan_mod_fwd = fftwf_plan_dft_r2c_1d(SPEC_RINGMOD_FFT_SIZE,
-                                            s->td_mod_win, s->Y, FFTW_ESTIMATE);
-    s->plan_inv = fftwf_plan_dft_c2r_1d(SPEC_RINGMOD_FFT_SIZE, s->Z, s->td_out,
-                                        FFTW_ESTIMATE);
+    StftConfig cfg = {.size = SPEC_RINGMOD_FFT_SIZE,
+                      .hop = SPEC_RINGMOD_HOP_SIZE,
+                      .inputs = 2,
+                      .window = STFT_WINDOW_SQRT_HANN,
+                      .mode = STFT_AUTO};
+    stft_config_from_args(&cfg, args);
+    s->stft = stft_create(&cfg, spec_ringmod_bins, s, sizeof(SpecRingFrame));
+    s->y_mag_smooth = calloc(stft_bins(s->stft), sizeof(float));
+    s->dry_len = stft_latency(s->stft);
+    s->dry = calloc(s->dry_len, sizeof(float));
 
     Module *m = calloc(1, sizeof(Module));
     m->name = "spec_ringmod";
@@ -2,6 +2,7 @@
 #define SPEC_RINGMOD_H
 
 #include "module.h"
+#include "stft.h"
 #include "util.h"
 #include <fftw3.h>
 #include <pthread.h>
@@ -21,6 +22,14 @@ typedef enum {
     SPEC_OP_MIN_MAG,     // min(|X|,|Y|) + phase(X)
 } SpecRingOp;
 
+// Taken with each STFT frame
+typedef struct {
+    float bandlimit_low;
+    float bandlimit_high;
+    float nyquist;
+    SpecRingOp op;
+} SpecRingFrame;
+
 typedef struct {
     float mix;
     float car_amp;
@@ -29,10 +38,7 @@ typedef struct {
     float bandlimit_high;
     SpecRingOp op;
 
-    float *td_car_win;
-    float *td_mod_win;
     float *y_mag_smooth;
-    float *y_mag_hold;
 
     float sample_rate;
 
@@ -50,26 +56,16 @@ typedef struct {
 
     pthread_mutex_t lock;
 
-    float *td_car;
-    float *td_mod;
-    float *td_out;
-
-    fftwf_complex *X;
-    fftwf_complex *Y;
-    fftwf_complex *Z;
-
-    fftwf_plan plan_car_fwd;
-    fftwf_plan plan_mod_fwd;
-    fftwf_plan plan_inv;
-
-    float *window;
-    float *ola_buffer;
-    float ola_norm;
-    int write_pos;
-    int hop_pos;
+    Stft *stft;
+    float car_block[MAX_BLOCK_SIZE];
+    float mod_block[MAX_BLOCK_SIZE];
+    float mix_block[MAX_BLOCK_SIZE];
+    float wet_block[MAX_BLOCK_SIZE];
 
-    int bin_low;
-    int bin_high;
+    // Dry carrier, delayed by the STFT latency to line up with the wet
+    float *dry;
+    int dry_len;
+    int dry_pos;
 
     /* ---- Command mode ---- */
     bool entering_command;
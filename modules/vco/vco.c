@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 #include "vco.h"
@@ -322,7 +323,7 @@ static void vco_set_osc_param(Module *m, const char *param, float value) {
             state->waveform = (Waveform)((state->waveform + 1) % 4);
         }
     } else {
-        fprintf(stderr, "[vco] Unknown OSC param: %s\n", param);
+        LOG_WARN("[vco] Unknown OSC param: %s", param);
     }
 
     clamp_params(state);
@@ -360,7 +361,7 @@ Module *create_module(const char *args, float sample_rate) {
         else if (strcmp(wave_str, "triangle") == 0)
             wave = WAVE_TRIANGLE;
         else
-            fprintf(stderr, "[vco] Unknown wave type: '%s'\n", wave_str);
+            LOG_WARN("[vco] Unknown wave type: '%s'", wave_str);
     }
 
     VCO *state = calloc(1, sizeof(VCO));
@@ -5,10 +5,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 #include "vocoder.h"
 
+#define VOCODER_Q 3.0f
+/* A band's gain at its centre: Q per stage, VOCODER_STAGES of them */
+#define VOCODER_PEAK_GAIN (VOCODER_Q * VOCODER_Q * VOCODER_Q)
+
 static float bark_centers[VOCODER_BANDS] = {
     80,    120,   180,   260,   360,   510,   720,   1000,
     1400,  2000,  2800,  3700,  4800,  6200,  8000,  10000,
@@ -19,6 +24,10 @@ static inline float hz_to_bark(float f) {
            3.5f * atanf((f / 7500.0f) * (f / 7500.0f));
 }
 
+static inline float hz_to_mel(float f) {
+    return 2595.0f * log10f(1.0f + f / 700.0f);
+}
+
 static inline float tilt_gain(int i, float tilt) {
     float t = (float)i / (float)(VOCODER_BANDS - 1);
     return powf(2.0f, tilt * (t - 0.5f) * 4.0f);
@@ -81,7 +90,7 @@ static void rebuild_filters(Vocoder *s) {
         s->fc[i] = fc;
 
         /* less peaky */
-        s->Q[i] = 3.0f;
+        s->Q[i] = VOCODER_Q;
 
         for (int st = 0; st < VOCODER_STAGES; st++) {
             float omega = TWO_PI * fc / s->sample_rate;
@@ -124,6 +133,11 @@ static void clamp_params(Vocoder *s) {
     if (s->sel_band > VOCODER_BANDS - 1)
         s->sel_band = VOCODER_BANDS - 1;
 
+    if (s->bands < VOCODER_MIN_BANDS)
+        s->bands = VOCODER_MIN_BANDS;
+    if (s->bands > VOCODER_MAX_BANDS)
+        s->bands = VOCODER_MAX_BANDS;
+
     for (int i = 0; i < VOCODER_BANDS; i++)
         clampf(&s->band_gain[i], 0.0f, 1.0f);
 }
@@ -150,6 +164,242 @@ static int parse_band_gain_param(const char *param) {
     return -1;
 }
 
+/* --- STFT mode --- */
+
+/* The 24 per-band gains as points spread evenly over 0..1 */
+static inline float band_gain_at(const float *g, float t) {
+    float u = t * (float)(VOCODER_BANDS - 1);
+    int i = (int)u;
+    if (i >= VOCODER_BANDS - 1)
+        return g[VOCODER_BANDS - 1];
+    return g[i] + (u - (float)i) * (g[i + 1] - g[i]);
+}
+
+/* A bin between band centres lo and lo + 1, `frac` of the way */
+static inline int bin_band(const Vocoder *s, int k, int bands, float *frac) {
+    float u = s->bin_pos[k] * (float)(bands - 1);
+    int lo = (int)u;
+    if (lo >= bands - 1) {
+        *frac = 0.0f;
+        return bands - 1;
+    }
+    *frac = u - (float)lo;
+    return lo;
+}
+
+/* Runs once per frame, possibly on the STFT helper thread. The first piece
+   measures the modulator's band energies over all bins, follows them at the
+   frame rate and builds the per-bin gain; every piece then applies it to
+   the carrier. Band gains are shaped per band and interpolated between
+   band centres, so the per-bin cost doesn't depend on the band count. */
+static void vocoder_bins(void *user, const void *params,
+                         fftwf_complex *const *in, fftwf_complex *out,
+                         int k0, int k1) {
+    Vocoder *s = (Vocoder *)user;
+    const VocoderFrame *f = (const VocoderFrame *)params;
+    const int bands = f->bands;
+    const int bins = stft_bins(s->stft);
+
+    if (k0 == 0) {
+        float energy[VOCODER_MAX_BANDS] = {0};
+        float g[VOCODER_MAX_BANDS];
+
+        for (int k = 1; k < bins; k++) {
+            float re = in[0][k][0], im = in[0][k][1];
+            float p = re * re + im * im;
+            float frac;
+            int lo = bin_band(s, k, bands, &frac);
+            energy[lo] += (1.0f - frac) * p;
+            if (lo + 1 < bands)
+                energy[lo + 1] += frac * p;
+        }
+
+        float frame_s = (float)stft_hop(s->stft) / s->sample_rate;
+        float a = expf(-frame_s / (fmaxf(f->atk_ms, 0.1f) * 0.001f));
+        float r = expf(-frame_s / (fmaxf(f->rel_ms, 1.0f) * 0.001f));
+        float sigma = fmaxf(f->width, 0.02f);
+        /* Level at a band centre as in filter mode */
+        const float level = VOCODER_PEAK_GAIN / sqrtf((float)VOCODER_BANDS);
+
+        for (int b = 0; b < bands; b++) {
+            float x = sqrtf(energy[b]) * s->spec_norm;
+            if (!isfinite(x))
+                x = 0.0f;
+            float e = s->spec_env[b];
+            float c = x > e ? a : r;
+            e = c * e + (1.0f - c) * x;
+            if (e < 1e-8f)
+                e = 0.0f;
+            s->spec_env[b] = e;
+
+            float t = (float)b / (float)(bands - 1);
+            float env_shaped = powf(e / (e + 0.5f), f->env_curve);
+            float gain = band_gain_at(f->band_gain, t);
+            clampf(&gain, 0.0f, 1.0f);
+            float d = t - f->center;
+            float w = expf(-(d * d) / (2.0f * sigma * sigma));
+            float tilt = powf(2.0f, f->tilt * (t - 0.5f) * 4.0f);
+            g[b] = env_shaped * gain * w * tilt * level;
+        }
+
+        s->bin_gain[0] = 0.0f; /* DC */
+        for (int k = 1; k < bins; k++) {
+            float frac;
+            int lo = bin_band(s, k, bands, &frac);
+            float hi = lo + 1 < bands ? g[lo + 1] : g[lo];
+            s->bin_gain[k] = g[lo] + frac * (hi - g[lo]);
+        }
+    }
+
+    for (int k = k0; k < k1; k++) {
+        out[k][0] = s->bin_gain[k] * in[1][k][0];
+        out[k][1] = s->bin_gain[k] * in[1][k][1];
+    }
+}
+
+/* Spectral params only change per frame: their CV is read once per block.
+   Mix, drive and trim stay per sample, on the STFT output and the carrier
+   delayed to line up with it. */
+static void vocoder_process_stft(Module *m, const float *mod,
+                                 const float *car, unsigned long frames) {
+    Vocoder *s = (Vocoder *)m->state;
+    float *out = m->output_buffer;
+
+    VocoderFrame *f = stft_params(s->stft);
+    float base_mix, base_drive, base_out_trim;
+    float base_tilt, base_center, base_width;
+    float base_atk, base_rel, base_curve;
+
+    pthread_mutex_lock(&s->lock);
+    base_mix = s->mix;
+    base_drive = s->drive;
+    base_out_trim = s->out_trim;
+    base_tilt = s->tilt;
+    base_center = s->center;
+    base_width = s->width;
+    base_atk = s->atk_ms;
+    base_rel = s->rel_ms;
+    base_curve = s->env_curve;
+    f->bands = s->bands;
+    memcpy(f->band_gain, s->band_gain, sizeof(f->band_gain));
+    pthread_mutex_unlock(&s->lock);
+
+    float mix_s = process_smoother(&s->smooth_mix, base_mix);
+    float drive_s = process_smoother(&s->smooth_drive, base_drive);
+    float trim_s = process_smoother(&s->smooth_out_trim, base_out_trim);
+
+    float tilt = process_smoother(&s->smooth_tilt, base_tilt);
+    float center = process_smoother(&s->smooth_center, base_center);
+    float width = process_smoother(&s->smooth_width, base_width);
+    float atk_ms = process_smoother(&s->smooth_atk_ms, base_atk);
+    float rel_ms = process_smoother(&s->smooth_rel_ms, base_rel);
+    float env_curve = process_smoother(&s->smooth_env_curve, base_curve);
+
+    for (int j = 0; j < m->num_control_inputs; j++) {
+        if (!m->control_inputs[j] || !m->control_input_params[j])
+            continue;
+        const char *param = m->control_input_params[j];
+        float control = m->control_inputs[j][frames - 1];
+        control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+        if (strcmp(param, "tilt") == 0)
+            tilt += control;
+        else if (strcmp(param, "center") == 0)
+            center += control;
+        else if (strcmp(param, "width") == 0)
+            width += control;
+        else if (strcmp(param, "atk") == 0 || strcmp(param, "atk_ms") == 0)
+            atk_ms += 50.0f * control;
+        else if (strcmp(param, "rel") == 0 || strcmp(param, "rel_ms") == 0)
+            rel_ms += 200.0f * control;
+        else if (strcmp(param, "curve") == 0 ||
+                 strcmp(param, "env_curve") == 0)
+            env_curve += control;
+        else {
+            int idx = parse_band_gain_param(param);
+            if (idx >= 0)
+                f->band_gain[idx] += control;
+        }
+    }
+
+    clampf(&tilt, -1.0f, 1.0f);
+    clampf(&center, 0.0f, 1.0f);
+    clampf(&width, 0.02f, 1.0f);
+    clampf(&atk_ms, 0.1f, 200.0f);
+    clampf(&rel_ms, 1.0f, 1000.0f);
+    clampf(&env_curve, 0.25f, 4.0f);
+
+    f->tilt = tilt;
+    f->center = center;
+    f->width = width;
+    f->atk_ms = atk_ms;
+    f->rel_ms = rel_ms;
+    f->env_curve = env_curve;
+
+    const float *inputs[2] = {mod, car};
+    stft_process(s->stft, inputs, out, frames);
+
+    float disp_mix = mix_s, disp_drive = drive_s, disp_trim = trim_s;
+
+    for (unsigned long i = 0; i < frames; i++) {
+        float mix = mix_s;
+        float drive = drive_s;
+        float out_trim = trim_s;
+
+        for (int j = 0; j < m->num_control_inputs; j++) {
+            if (!m->control_inputs[j] || !m->control_input_params[j])
+                continue;
+            const char *param = m->control_input_params[j];
+            float control = m->control_inputs[j][i];
+            control = fminf(fmaxf(control, -1.0f), 1.0f);
+
+            if (strcmp(param, "mix") == 0)
+                mix += control;
+            else if (strcmp(param, "drive") == 0)
+                drive += control;
+            else if (strcmp(param, "trim") == 0 ||
+                     strcmp(param, "out_trim") == 0)
+                out_trim += control;
+        }
+
+        clampf(&mix, 0.0f, 1.0f);
+        clampf(&drive, 0.0f, 1.0f);
+        clampf(&out_trim, 0.0f, 1.0f);
+
+        disp_mix = mix;
+        disp_drive = drive;
+        disp_trim = out_trim;
+
+        float cx = car[i];
+        if (!isfinite(cx))
+            cx = 0.0f;
+        float dry = s->dry[s->dry_pos];
+        s->dry[s->dry_pos] = cx;
+        if (++s->dry_pos == s->dry_len)
+            s->dry_pos = 0;
+
+        float wet_out = soft_sat(out[i] * out_trim, drive);
+        float y = mix * wet_out + (1.0f - mix) * dry;
+        out[i] = fminf(fmaxf(y, -1.0f), 1.0f);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->display_mix = disp_mix;
+    s->display_drive = disp_drive;
+    s->display_out_trim = disp_trim;
+
+    s->display_tilt = tilt;
+    s->display_center = center;
+    s->display_width = width;
+
+    s->display_atk_ms = atk_ms;
+    s->display_rel_ms = rel_ms;
+    s->display_env_curve = env_curve;
+
+    s->display_sel_gain = s->band_gain[s->sel_band];
+    pthread_mutex_unlock(&s->lock);
+}
+
 static void vocoder_process(Module *m, float *in, unsigned long frames) {
     (void)in;
     Vocoder *s = (Vocoder *)m->state;
@@ -167,6 +417,11 @@ static void vocoder_process(Module *m, float *in, unsigned long frames) {
     if (!car)
         car = mod;
 
+    if (s->stft_mode) {
+        vocoder_process_stft(m, mod, car, frames);
+        return;
+    }
+
     float base_band[VOCODER_BANDS];
     float base_mix, base_drive, base_out_trim;
     float base_tilt, base_center, base_width;
@@ -363,7 +618,7 @@ static void vocoder_draw_ui(Module *m, int y, int x) {
     Vocoder *s = (Vocoder *)m->state;
 
     float mix, drive, trim, tilt, center, width, atk, rel, curve;
-    int sb;
+    int sb, bands;
     float sg;
 
     pthread_mutex_lock(&s->lock);
@@ -381,6 +636,7 @@ static void vocoder_draw_ui(Module *m, int y, int x) {
 
     sb = s->sel_band;
     sg = s->display_sel_gain;
+    bands = s->bands;
     pthread_mutex_unlock(&s->lock);
 
     BLUE();
@@ -434,14 +690,22 @@ static void vocoder_draw_ui(Module *m, int y, int x) {
     ORANGE();
     printw("%.1f", sg);
     CLR();
+    if (s->stft_mode) {
+        LABEL(2, "n:");
+        ORANGE();
+        printw("%d", bands);
+        CLR();
+    }
 
     YELLOW();
     mvprintw(y + 1, x,
              "-/= mix _/+ d [/] tr {/} t ;/' c w/W w"
-             " a/A a r/R r c/C crv b/B b g/G g");
+             " a/A a r/R r c/C crv b/B b g/G g%s",
+             s->stft_mode ? " n/N n" : "");
     mvprintw(y + 2, x,
              ":1[mix] :2[d] :3[tr] :4[t] :5[c] :6[w]"
-             " :7[a] :8[r] :9[crv] :b[b] :g[g]");
+             " :7[a] :8[r] :9[crv] :b[b] :g[g]%s",
+             s->stft_mode ? " :n[n]" : "");
     BLACK();
 }
 
@@ -551,6 +815,15 @@ static void vocoder_handle_input(Module *m, int key) {
             handled = 1;
             break;
 
+        case 'N':
+            s->bands += 1;
+            handled = 1;
+            break;
+        case 'n':
+            s->bands -= 1;
+            handled = 1;
+            break;
+
         case ':':
             s->entering_command = true;
             memset(s->command_buffer, 0, sizeof(s->command_buffer));
@@ -587,6 +860,8 @@ static void vocoder_handle_input(Module *m, int key) {
                     s->sel_band = (int)val;
                 else if (type == 'g')
                     s->band_gain[s->sel_band] = val;
+                else if (type == 'n')
+                    s->bands = (int)val;
             }
             handled = 1;
         } else if (key == 27) {
@@ -634,6 +909,8 @@ static void vocoder_set_osc_param(Module *m, const char *param, float value) {
         s->rel_ms = value;
     else if (strcmp(param, "curve") == 0 || strcmp(param, "env_curve") == 0)
         s->env_curve = value;
+    else if (strcmp(param, "bands") == 0)
+        s->bands = (int)value;
 
     else {
         int idx = parse_band_gain_param(param);
@@ -647,8 +924,13 @@ static void vocoder_set_osc_param(Module *m, const char *param, float value) {
 
 static void vocoder_destroy(Module *m) {
     Vocoder *s = (Vocoder *)m->state;
-    if (s)
+    if (s) {
+        stft_destroy(s->stft);
+        free(s->bin_pos);
+        free(s->bin_gain);
+        free(s->dry);
         pthread_mutex_destroy(&s->lock);
+    }
     destroy_base_module(m);
 }
 
@@ -701,6 +983,24 @@ create_module(const char *args, float sample_rate) {
     if (args && strstr(args, "curve="))
         sscanf(strstr(args, "curve="), "curve=%f", &s->env_curve);
 
+    /* mode=stft: bands= of them on a bark (or scale=mel) spacing */
+    s->bands = VOCODER_BANDS;
+    if (args && strstr(args, "mode=")) {
+        char v[16] = {0};
+        sscanf(strstr(args, "mode="), "mode=%15[^, ]", v);
+        if (strcmp(v, "stft") == 0)
+            s->stft_mode = true;
+        else if (strcmp(v, "filter") != 0)
+            LOG_WARN("[vocoder] Unknown mode '%s', using filter", v);
+    }
+    if (args && strstr(args, "bands="))
+        sscanf(strstr(args, "bands="), "bands=%d", &s->bands);
+    if (args && strstr(args, "scale=")) {
+        char v[16] = {0};
+        sscanf(strstr(args, "scale="), "scale=%15[^, ]", v);
+        s->mel = strcmp(v, "mel") == 0;
+    }
+
     pthread_mutex_init(&s->lock, NULL);
 
     init_smoother(&s->smooth_mix, 0.50f);
@@ -726,6 +1026,41 @@ create_module(const char *args, float sample_rate) {
     s->bark_min = s->bark_pos[0];
     s->bark_max = s->bark_pos[VOCODER_BANDS - 1];
 
+    if (s->stft_mode) {
+        StftConfig cfg = {.size = VOCODER_FFT_SIZE,
+                          .hop = VOCODER_HOP_SIZE,
+                          .inputs = 2,
+                          .window = STFT_WINDOW_HANN,
+                          .mode = STFT_AUTO};
+        stft_config_from_args(&cfg, args);
+        s->stft = stft_create(&cfg, vocoder_bins, s, sizeof(VocoderFrame));
+
+        /* Band centres span the filter bank's range; bins outside it
+           follow the end bands */
+        int bins = stft_bins(s->stft);
+        float lo = bark_centers[0];
+        float hi = fminf(bark_centers[VOCODER_BANDS - 1],
+                         sample_rate * 0.45f);
+        float p_lo = s->mel ? hz_to_mel(lo) : hz_to_bark(lo);
+        float p_hi = s->mel ? hz_to_mel(hi) : hz_to_bark(hi);
+        s->bin_pos = malloc(bins * sizeof(float));
+        s->bin_gain = calloc(bins, sizeof(float));
+        for (int k = 0; k < bins; k++) {
+            float hz = (float)k / (float)(bins - 1) * sample_rate * 0.5f;
+            float p = s->mel ? hz_to_mel(hz) : hz_to_bark(hz);
+            float t = (p - p_lo) / (p_hi - p_lo);
+            s->bin_pos[k] = fminf(fmaxf(t, 0.0f), 1.0f);
+        }
+
+        /* A sine's Hann main lobe reads as its amplitude, times the
+           filter bank's peak gain so the envelopes match filter mode's */
+        int n = 2 * (bins - 1);
+        s->spec_norm = 4.0f / ((float)n * sqrtf(1.5f)) * VOCODER_PEAK_GAIN;
+
+        s->dry_len = stft_latency(s->stft);
+        s->dry = calloc(s->dry_len, sizeof(float));
+    }
+
     /* init display */
     s->display_mix = s->mix;
     s->display_drive = s->drive;
@@ -2,6 +2,7 @@
 #ifndef VOCODER_H
 #define VOCODER_H
 
+#include "stft.h"
 #include "util.h"
 #include <pthread.h>
 #include <stdbool.h>
@@ -9,6 +10,20 @@
 #define VOCODER_BANDS 24
 #define VOCODER_STAGES 3
 
+/* STFT mode */
+#define VOCODER_MAX_BANDS 128
+#define VOCODER_MIN_BANDS 4
+#define VOCODER_FFT_SIZE 1024
+#define VOCODER_HOP_SIZE (VOCODER_FFT_SIZE / 4)
+
+/* Taken with each STFT frame */
+typedef struct {
+    int bands;
+    float tilt, center, width;
+    float atk_ms, rel_ms, env_curve;
+    float band_gain[VOCODER_BANDS];
+} VocoderFrame;
+
 typedef struct {
     float sample_rate;
 
@@ -29,9 +44,23 @@ typedef struct {
     float rel_ms;    /* 1..1000 */
     float env_curve; /* 0.25..4.0 */
 
-    /* per-band gain */
+    /* per-band gain; in STFT mode, points spread across the bands */
     float band_gain[VOCODER_BANDS];
 
+    /* STFT mode: the modulator's envelope on `bands` bands evenly spaced
+       in bark (or mel), each bin between two band centres */
+    bool stft_mode;
+    bool mel;
+    int bands;
+    Stft *stft;
+    float *bin_pos;  /* per bin, 0..1 from the lowest to highest centre */
+    float *bin_gain; /* per bin, rebuilt each frame */
+    float spec_env[VOCODER_MAX_BANDS];
+    float spec_norm; /* band energy to amplitude */
+    float *dry;      /* carrier delayed to match the STFT */
+    int dry_len;
+    int dry_pos;
+
     /* display */
     float display_mod_gain;
     float display_car_gain;
@@ -5,11 +5,146 @@
 #include <sndfile.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "dsp.h"
+#include "logger.h"
 #include "module.h"
 #include "util.h"
 #include "wav_player.h"
 
+// Audio thread: n frames from frame i0 into dst, from the resident head
+// and the streaming window; frames outside the file read as silence.
+// False when the reader has not caught up yet (just after a seek).
+static bool stream_span(PlayerStream *st, int64_t i0, int n, int64_t total,
+                        float *dst) {
+    int64_t head = (int64_t)st->head_frames;
+    int64_t start = __atomic_load_n(&st->start, __ATOMIC_ACQUIRE);
+    int64_t end = __atomic_load_n(&st->end, __ATOMIC_ACQUIRE);
+    int64_t ring_lo = i0 + n, ring_hi = i0;
+
+    for (int j = 0; j < n; j++) {
+        int64_t idx = i0 + j;
+        if (idx < 0 || idx >= total) {
+            dst[j] = 0.0f;
+        } else if (idx < head) {
+            dst[j] = st->head[idx];
+        } else {
+            if (idx < start || idx >= end)
+                return false;
+            dst[j] = st->ring[idx & st->mask];
+            if (idx < ring_lo)
+                ring_lo = idx;
+            ring_hi = idx;
+        }
+    }
+    if (ring_hi >= ring_lo) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&st->start, __ATOMIC_RELAXED) > ring_lo)
+            return false; // evicted while we read it
+    }
+    return true;
+}
+
+// Points *x at the resampler taps around frame i1, gathering into buf
+// where the file edge or the stream gets in the way
+static inline bool read_taps(Player *s, const float *data, sf_count_t i1,
+                             float *buf, const float **x) {
+    int n = s->rs.taps;
+    int64_t i0 = (int64_t)i1 - (n / 2 - 1);
+    int64_t total = (int64_t)s->num_frames;
+
+    if (s->streaming) {
+        *x = buf;
+        return stream_span(&s->stream, i0, n, total, buf);
+    }
+    if (i0 >= 0 && i0 + n <= total) {
+        *x = data + i0;
+        return true;
+    }
+    for (int j = 0; j < n; j++) {
+        int64_t idx = i0 + j;
+        buf[j] = (idx >= 0 && idx < total) ? data[idx] : 0.0f;
+    }
+    *x = buf;
+    return true;
+}
+
+// Decodes up to n frames at `frame` into st->chunk, downmixed to mono
+static sf_count_t stream_read(PlayerStream *st, int64_t frame, sf_count_t n) {
+    if (st->file_pos != frame) {
+        if (sf_seek(st->file, frame, SEEK_SET) < 0)
+            return 0;
+        st->file_pos = frame;
+    }
+    sf_count_t got = sf_readf_float(st->file, st->chunk, n);
+    if (got <= 0)
+        return 0;
+    st->file_pos += got;
+
+    int ch = st->channels;
+    if (ch > 1) // in place
+        dsp_downmix(st->chunk, st->chunk, ch, 1.0f / (float)ch,
+                    (unsigned long)got);
+    return got;
+}
+
+// Evicting frames below `start` must be visible before they are rewritten
+static void stream_set_start(PlayerStream *st, int64_t start) {
+    __atomic_store_n(&st->start, start, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void *stream_reader_main(void *arg) {
+    Player *s = (Player *)arg;
+    PlayerStream *st = &s->stream;
+    int64_t ring_frames = (int64_t)st->mask + 1;
+    int64_t back = ring_frames / 4; // not evicted, for short scrubs back
+    int64_t total = (int64_t)s->num_frames;
+    int64_t head = (int64_t)st->head_frames;
+
+    while (__atomic_load_n(&st->running, __ATOMIC_ACQUIRE)) {
+        int64_t want = __atomic_load_n(&st->want, __ATOMIC_RELAXED);
+        if (want < head)
+            want = head; // looped or scrubbed into the head: refill after it
+
+        int64_t start = st->start;
+        int64_t end = st->end;
+        if (want < start || want > end + ring_frames / 2) {
+            // Seek: empty the window and restart it at the target (less the
+            // resampler's look-behind), so audio resumes after one chunk
+            int64_t ns = want - RESAMPLE_MAX_TAPS;
+            if (ns < head)
+                ns = head;
+            __atomic_store_n(&st->end, start, __ATOMIC_RELEASE);
+            stream_set_start(st, ns);
+            __atomic_store_n(&st->end, ns, __ATOMIC_RELEASE);
+            start = end = ns;
+        }
+
+        if (end >= total || end - want >= ring_frames - back) {
+            usleep(STREAM_POLL_US);
+            continue;
+        }
+
+        sf_count_t n = STREAM_CHUNK_FRAMES;
+        if (n > total - end)
+            n = (sf_count_t)(total - end);
+        if (end + n - ring_frames > start)
+            stream_set_start(st, end + n - ring_frames);
+
+        sf_count_t got = stream_read(st, end, n);
+        if (got <= 0) {
+            usleep(STREAM_POLL_US);
+            continue;
+        }
+        for (sf_count_t i = 0; i < got; i++)
+            st->ring[(end + i) & st->mask] = st->chunk[i];
+        __atomic_store_n(&st->end, end + got, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
 static void player_process(Module *m, float *in, unsigned long frames) {
     Player *s = (Player *)m->state;
     float *out = m->output_buffer;
@@ -25,7 +160,7 @@ static void player_process(Module *m, float *in, unsigned long frames) {
     float base_amp = s->amp;
     bool playing = s->playing;
     bool loop = s->loop;
-    float *data = s->data;
+    const float *data = s->data;
     float file_rate = s->file_rate;
     float sr = s->sample_rate;
     pthread_mutex_unlock(&s->lock);
@@ -45,6 +180,8 @@ static void player_process(Module *m, float *in, unsigned long frames) {
 
     clampd(&scrub_target, 0.0f, (double)(max_frames - 1));
     clampd(&pos, 0.0f, (double)(max_frames - 1));
+    bool starved = false;
+    float taps[RESAMPLE_MAX_TAPS];
 
     for (unsigned long i = 0; i < frames; i++) {
         float speed = speed_s;
@@ -100,13 +237,18 @@ static void player_process(Module *m, float *in, unsigned long frames) {
             i1 = 0;
         if (i1 > (sf_count_t)(max_frames - 2))
             i1 = (sf_count_t)(max_frames - 2);
-        sf_count_t i2 = i1 + 1;
         float frac = (float)(pos - (double)i1);
 
-        float s1 = data[i1];
-        float s2 = data[i2];
+        const float *x;
+        if (!read_taps(s, data, i1, taps, &x)) {
+            // Hold the head until the reader has the frames
+            out[i] = 0.0f;
+            starved = true;
+            continue;
+        }
 
-        float val = (1.0f - frac) * s1 + frac * s2;
+        resampler_set_step(&s->rs, speed * (file_rate / sr));
+        float val = resampler_interp(&s->rs, x, frac);
 
         out[i] = val * amp * fade;
         last_pos = pos;
@@ -142,7 +284,14 @@ static void player_process(Module *m, float *in, unsigned long frames) {
     s->display_pos = disp_pos;
     s->display_speed = disp_speed;
     s->display_amp = disp_amp;
+    if (starved)
+        s->starved_blocks++;
     pthread_mutex_unlock(&s->lock);
+
+    if (s->streaming)
+        __atomic_store_n(&s->stream.want,
+                         (int64_t)(playing ? pos : scrub_target),
+                         __ATOMIC_RELAXED);
 }
 
 static void clamp_params(Player *state) {
@@ -163,6 +312,8 @@ static void player_draw_ui(Module *m, int y, int x) {
     float pos_sec = pos / state->file_rate;
     bool is_playing = state->playing;
     bool loop = state->loop;
+    bool streaming = state->streaming;
+    unsigned int starved = state->starved_blocks;
     char cmd[64];
     strncpy(cmd, state->command_buffer, sizeof(cmd));
     cmd[sizeof(cmd) - 1] = '\0';
@@ -192,6 +343,19 @@ static void player_draw_ui(Module *m, int y, int x) {
     printw(" %s", loop ? "on" : "off");
     CLR();
 
+    if (streaming) {
+        int64_t end = __atomic_load_n(&state->stream.end, __ATOMIC_RELAXED);
+        float ahead = (float)(end - (int64_t)pos) / state->file_rate;
+        if (pos < state->stream.head_frames || ahead < 0.0f)
+            ahead = 0.0f;
+        LABEL(2, "|buf:");
+        ORANGE();
+        printw(" %.1fs", ahead);
+        if (starved)
+            printw(" starved:%u", starved);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(
         y + 1, x,
@@ -322,11 +486,67 @@ static void player_set_osc_param(Module *m, const char *param, float value) {
 
 static void player_destroy(Module *m) {
     Player *state = (Player *)m->state;
-    if (state)
+    if (state) {
+        if (state->streaming) {
+            PlayerStream *st = &state->stream;
+            if (st->running) {
+                __atomic_store_n(&st->running, 0, __ATOMIC_RELEASE);
+                pthread_join(st->thread, NULL);
+            }
+            sf_close(st->file);
+            free(st->head);
+            free(st->ring);
+            free(st->chunk);
+        }
+        sample_pool_release(state->sample);
         pthread_mutex_destroy(&state->lock);
+    }
     destroy_base_module(m);
 }
 
+// Loads the resident head and starts the reader; the file stays open
+static bool stream_open(Player *state, SNDFILE *f, const SF_INFO *info) {
+    PlayerStream *st = &state->stream;
+    st->file = f;
+    st->channels = info->channels;
+
+    unsigned long head =
+        (unsigned long)(STREAM_HEAD_SECONDS * info->samplerate);
+    if (head > (unsigned long)info->frames)
+        head = (unsigned long)info->frames;
+
+    unsigned long ring = 1;
+    while (ring < (unsigned long)(STREAM_RING_SECONDS * info->samplerate))
+        ring <<= 1;
+
+    st->head = calloc(head ? head : 1, sizeof(float));
+    st->ring = calloc(ring, sizeof(float));
+    st->chunk = calloc((size_t)STREAM_CHUNK_FRAMES * info->channels,
+                       sizeof(float));
+    if (!st->head || !st->ring || !st->chunk)
+        return false;
+    st->mask = ring - 1;
+
+    while (st->head_frames < head) {
+        sf_count_t n = STREAM_CHUNK_FRAMES;
+        if (n > (sf_count_t)(head - st->head_frames))
+            n = (sf_count_t)(head - st->head_frames);
+        sf_count_t got = stream_read(st, (int64_t)st->head_frames, n);
+        if (got <= 0)
+            break;
+        memcpy(st->head + st->head_frames, st->chunk, got * sizeof(float));
+        st->head_frames += (unsigned long)got;
+    }
+    st->start = st->end = (int64_t)st->head_frames;
+
+    st->running = 1;
+    if (pthread_create(&st->thread, NULL, stream_reader_main, state) != 0) {
+        st->running = 0;
+        return false;
+    }
+    return true;
+}
+
 Module *create_module(const char *args, float sample_rate) {
     char filepath[512] = "sample.wav"; // default
 
@@ -345,30 +565,46 @@ Module *create_module(const char *args, float sample_rate) {
     SF_INFO info = {0};
     SNDFILE *f = sf_open(filepath, SFM_READ, &info);
     if (!f) {
-        fprintf(
-            stderr,
-            "[Player] failed to open wav file, file not found at '%s'; or file "
-            "is not mono.\n",
-            filepath);
+        LOG_ERROR("[Player] failed to open wav file, file not found at '%s'; "
+                  "or file is not mono.",
+                  filepath);
         if (f)
             sf_close(f);
         return NULL;
     }
 
-    float *raw = calloc(info.frames * info.channels, sizeof(float));
-    sf_read_float(f, raw, info.frames * info.channels);
+    // stream=on|off, default: stream long files only
+    bool streaming =
+        (float)info.frames > STREAM_AUTO_SECONDS * (float)info.samplerate;
+    if (args && strstr(args, "stream=")) {
+        char v[8] = {0};
+        sscanf(strstr(args, "stream="), "stream=%7[^, ]", v);
+        streaming = !strcmp(v, "1") || !strcmp(v, "on") ||
+                    !strcmp(v, "yes") || !strcmp(v, "true");
+    }
+
+    // cache=on keeps a decoded copy on disk for the next load
+    bool disk_cache = false;
+    if (args && strstr(args, "cache=")) {
+        char v[8] = {0};
+        sscanf(strstr(args, "cache="), "cache=%7[^, ]", v);
+        disk_cache = !strcmp(v, "1") || !strcmp(v, "on") ||
+                     !strcmp(v, "yes") || !strcmp(v, "true");
+    }
 
-    float *data = calloc(info.frames, sizeof(float));
-    for (sf_count_t i = 0; i < info.frames; i++) {
-        float sum = 0.0f;
-        for (int ch = 0; ch < info.channels; ch++) {
-            sum += raw[i * info.channels + ch];
+    // Resident files come from the shared pool, one copy per file
+    const Sample *sample = NULL;
+    if (!streaming) {
+        sf_close(f);
+        f = NULL;
+        sample = sample_pool_acquire(filepath, SAMPLE_MONO, disk_cache);
+        if (!sample) {
+            LOG_ERROR("[Player] failed to decode '%s'", filepath);
+            return NULL;
         }
-        data[i] = sum / info.channels; // average for mono
+        info.frames = (sf_count_t)sample->frames;
+        info.samplerate = sample->samplerate;
     }
-    free(raw);
-
-    sf_close(f);
 
     float playback_speed = 1.0f;
     float amp = 1.0f;
@@ -393,7 +629,8 @@ Module *create_module(const char *args, float sample_rate) {
     Player *state = calloc(1, sizeof(Player));
     state->sample_rate = sample_rate;
     state->file_rate = (float)info.samplerate;
-    state->data = data;
+    state->sample = sample;
+    state->data = sample ? sample->data : NULL;
     state->num_frames = info.frames;
     state->scrub_target = 0.0f;
     state->external_play_pos = 0.0f;
@@ -408,11 +645,28 @@ Module *create_module(const char *args, float sample_rate) {
     pthread_mutex_init(&state->lock, NULL);
     init_smoother(&state->smooth_speed, 0.75f);
     init_smoother(&state->smooth_amp, 0.75f);
+    bool rs_ok = resampler_init(&state->rs, resampler_parse_quality(args));
     clamp_params(state);
 
     Module *m = calloc(1, sizeof(Module));
-    m->name = "player";
     m->state = state;
+    if (!rs_ok) {
+        LOG_ERROR("[Player] out of memory for the resampler");
+        if (f)
+            sf_close(f);
+        player_destroy(m);
+        return NULL;
+    }
+    if (streaming) {
+        state->streaming = true;
+        if (!stream_open(state, f, &info)) {
+            LOG_ERROR("[Player] could not start streaming '%s'", filepath);
+            player_destroy(m);
+            return NULL;
+        }
+    }
+
+    m->name = "player";
     m->output_buffer = calloc(MAX_BLOCK_SIZE, sizeof(float));
     m->process = player_process;
     m->draw_ui = player_draw_ui;
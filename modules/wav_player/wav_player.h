@@ -2,16 +2,51 @@
 #define PLAYER_H
 
 #include "module.h"
+#include "sample_pool.h"
 #include "util.h"
 #include <pthread.h>
+#include <sndfile.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define SCRUB_FADE_SAMPLES 64
 
+// Streaming mode: files longer than STREAM_AUTO_SECONDS (or stream=on) are
+// not loaded. The first STREAM_HEAD_SECONDS stay resident so playback and
+// loop wraps start instantly; the rest is served from a window of
+// STREAM_RING_SECONDS that a reader thread keeps ahead of the play head.
+#define STREAM_AUTO_SECONDS 60.0f
+#define STREAM_HEAD_SECONDS 2.0f
+#define STREAM_RING_SECONDS 8.0f
+#define STREAM_CHUNK_FRAMES 4096
+#define STREAM_POLL_US 2000
+
+typedef struct {
+    SNDFILE *file;
+    int channels;
+    sf_count_t file_pos; // reader's position in the file, to skip seeks
+
+    float *head; // frames [0, head_frames), never evicted
+    unsigned long head_frames;
+
+    // Window of frames [start, end) held in ring[frame & mask]. The reader
+    // is the only writer; the audio thread validates reads against start.
+    float *ring;
+    unsigned long mask;
+    int64_t start;
+    int64_t end;
+    int64_t want; // frame the audio thread needs next, published per block
+
+    float *chunk; // interleaved read buffer, reader thread only
+    pthread_t thread;
+    int running;
+} PlayerStream;
+
 typedef struct {
     float sample_rate;
     float file_rate;
-    float *data;
+    const Sample *sample; // shared with other players of the same file
+    const float *data;
     unsigned long num_frames;
 
     double play_pos;
@@ -26,9 +61,14 @@ typedef struct {
 
     CParamSmooth smooth_speed;
     CParamSmooth smooth_amp;
+    Resampler rs;
 
     pthread_mutex_t lock;
 
+    bool streaming;
+    PlayerStream stream;
+    unsigned int starved_blocks; // blocks that waited on the reader
+
     // Display
     double display_pos;
     float display_speed;
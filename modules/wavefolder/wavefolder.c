@@ -44,6 +44,9 @@ static void wavefolder_process(Module *m, float *in, unsigned long frames) {
     float disp_blend = blend_s;
     float disp_drive = drive_s;
 
+    const int factor = state->os.factor;
+    os_up(&state->os, input, state->up, frames);
+
     for (unsigned long i = 0; i < frames; i++) {
         float fold = fold_s;
         float blend = blend_s;
@@ -74,12 +77,18 @@ static void wavefolder_process(Module *m, float *in, unsigned long frames) {
         disp_blend = blend;
         disp_drive = drive;
 
-        float in_s = input ? input[i] : 0.0f;
-        float driven = in_s * drive;
-        float folded = wavefold(driven, fold);
-        float val = (1.0f - blend) * in_s + blend * folded;
-        out[i] = val;
+        // Dry and folded are blended at the high rate so both see the
+        // same filters on the way down
+        float *x = state->up + i * factor;
+        for (int j = 0; j < factor; j++) {
+            float in_s = x[j];
+            float driven = in_s * drive;
+            float folded = wavefold(driven, fold);
+            x[j] = (1.0f - blend) * in_s + blend * folded;
+        }
     }
+    os_down(&state->os, state->up, out, frames);
+
     pthread_mutex_lock(&state->lock);
     state->display_fold = disp_fold;
     state->display_blend = disp_blend;
@@ -123,6 +132,14 @@ static void wavefolder_draw_ui(Module *m, int y, int x) {
     printw(" %.2f", drive);
     CLR();
 
+    if (state->os.factor > 1) {
+        printw(" | ");
+        LABEL(2, "os:");
+        ORANGE();
+        printw(" %dx", state->os.factor);
+        CLR();
+    }
+
     YELLOW();
     mvprintw(y + 1, x, "Real-time keys: -/= (fold), _/+ (blend), [/] (drive)");
     mvprintw(y + 2, x, "Command mode: :1 [fold], :2 [blend], :3 [drive]");
@@ -248,6 +265,7 @@ Module *create_module(const char *args, float sample_rate) {
     state->blend = blend;
     state->drive = drive;
     state->sample_rate = sample_rate;
+    os_init(&state->os, os_factor_from_args(args));
     pthread_mutex_init(&state->lock, NULL);
     init_smoother(&state->smooth_fold, 0.75f);
     init_smoother(&state->smooth_blend, 0.75f);
@@ -1,6 +1,7 @@
 #ifndef WAVEFOLDER_H
 #define WAVEFOLDER_H
 
+#include "oversample.h"
 #include "util.h"
 #include <pthread.h>
 
@@ -11,6 +12,10 @@ typedef struct {
     float sample_rate;
     float lp_z;
 
+    // Folding runs at os.factor times the rate, over `up`
+    Oversampler os;
+    float up[MAX_BLOCK_SIZE * OS_MAX_FACTOR];
+
     CParamSmooth smooth_fold;
     CParamSmooth smooth_blend;
     CParamSmooth smooth_drive;
@@ -1,5 +1,9 @@
 #include "engine.h" // for get_module_count()
+#include "logger.h"
 #include "module.h" // for Module struct
+#include "perf.h"
+#include "retro.h"
+#include "trace.h"
 #include <lo/lo.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,8 +13,8 @@ static char current_osc_port[16] = "";
 
 // Optional error handler for liblo
 void osc_error_handler(int num, const char *msg, const char *path) {
-    fprintf(stderr, "[osc] liblo error %d in path %s: %s\n", num,
-            path ? path : "(none)", msg);
+    LOG_ERROR("[osc] liblo error %d in path %s: %s", num,
+              path ? path : "(none)", msg);
 }
 
 static int module_param_handler(const char *path, const char *types,
@@ -22,25 +26,117 @@ static int module_param_handler(const char *path, const char *types,
     // Path format: /<alias>/<param>
     char alias[64], param[64];
     if (sscanf(path, "/%63[^/]/%63s", alias, param) != 2) {
-        fprintf(stderr, "[osc] Invalid path: %s\n", path);
+        LOG_WARN("[osc] Invalid path: %s", path);
         return 1;
     }
 
     float value = (types[0] == 'f') ? argv[0]->f : (float)argv[0]->i;
 
+    trace_set_thread_name("osc");
     int module_count = get_module_count();
     for (int i = 0; i < module_count; i++) {
         Module *m = get_module(i);
         if (m && strcmp(alias, get_module_alias(i)) == 0 && m->set_param) {
+            TRACE_BEGIN(t0);
             m->set_param(m, param, value);
+            TRACE_END(t0, "osc", get_module_alias(i));
             return 0;
         }
     }
 
-    fprintf(stderr, "[osc] No matching module for alias '%s'\n", alias);
+    LOG_WARN("[osc] No matching module for alias '%s'", alias);
     return 1;
 }
 
+// Replies go back to the sender's host, on the port given as the first
+// argument when present (most OSC apps listen on a fixed port).
+static lo_address reply_address(const char *types, lo_arg **argv, int argc,
+                                lo_message msg) {
+    lo_address src = lo_message_get_source(msg);
+    if (!src)
+        return NULL;
+    char port[16];
+    if (argc >= 1 && types[0] == 'i')
+        snprintf(port, sizeof(port), "%d", argv[0]->i);
+    else if (argc >= 1 && types[0] == 'f')
+        snprintf(port, sizeof(port), "%d", (int)argv[0]->f);
+    else
+        snprintf(port, sizeof(port), "%s", lo_address_get_port(src));
+    return lo_address_new(lo_address_get_hostname(src), port);
+}
+
+// /perf/stats [port]  -> /perf/stats callbacks misses xruns p50 p99 max deadline
+// /perf/xruns [port]  -> /perf/xrun time flags dur deadline (name cost) x3
+// /perf/dump          -> writes the JSON report
+static int perf_handler(const char *path, const char *types, lo_arg **argv,
+                        int argc, lo_message msg, void *user_data) {
+    if (strcmp(path, "/perf/dump") == 0) {
+        char out[256];
+        if (perf_dump_json(out, sizeof(out)) != 0)
+            LOG_ERROR("[osc] perf dump failed");
+        return 0;
+    }
+
+    lo_address dst = reply_address(types, argv, argc, msg);
+    if (!dst)
+        return 0;
+
+    PerfStats s;
+    perf_get_stats(&s);
+
+    if (strcmp(path, "/perf/stats") == 0) {
+        lo_send(dst, "/perf/stats", "iiiiiii", (int)s.callbacks,
+                (int)s.deadline_misses, (int)s.xruns,
+                (int)perf_percentile_us(&s, 0.50),
+                (int)perf_percentile_us(&s, 0.99), (int)s.max_us,
+                (int)s.deadline_us);
+    } else if (strcmp(path, "/perf/xruns") == 0) {
+        PerfXrun xr[16];
+        int n = perf_get_xruns(xr, 16);
+        for (int i = 0; i < n; i++) {
+            const char *names[PERF_TOP_MODULES];
+            for (int k = 0; k < PERF_TOP_MODULES; k++) {
+                names[k] = get_module_alias(xr[i].top_module[k]);
+                if (!names[k])
+                    names[k] = "";
+            }
+            char flags[96];
+            perf_flag_names(xr[i].flags, flags, sizeof(flags));
+            lo_send(dst, "/perf/xrun", "fsiisisisi", (float)xr[i].time, flags,
+                    (int)xr[i].duration_us, (int)xr[i].deadline_us, names[0],
+                    (int)xr[i].top_cost_us[0], names[1],
+                    (int)xr[i].top_cost_us[1], names[2],
+                    (int)xr[i].top_cost_us[2]);
+        }
+    }
+
+    lo_address_free(dst);
+    return 0;
+}
+
+// /trace/start, /trace/stop
+static int trace_handler(const char *path, const char *types, lo_arg **argv,
+                         int argc, lo_message msg, void *user_data) {
+    if (strcmp(path, "/trace/start") == 0)
+        trace_start();
+    else
+        trace_stop();
+    return 0;
+}
+
+// /retro/dump [minutes] -> writes the last minutes (all held when omitted)
+static int retro_handler(const char *path, const char *types, lo_arg **argv,
+                         int argc, lo_message msg, void *user_data) {
+    float minutes = 0.0f;
+    if (argc >= 1 && types[0] == 'f')
+        minutes = argv[0]->f;
+    else if (argc >= 1 && types[0] == 'i')
+        minutes = (float)argv[0]->i;
+    if (retro_dump(minutes * 60.0f) != 0)
+        LOG_WARN("[osc] /retro/dump: capture off or a dump is running");
+    return 0;
+}
+
 lo_server_thread start_osc_server(void) {
     const int base_port = 61245;
     const int max_attempts = 100;
@@ -53,6 +149,19 @@ lo_server_thread start_osc_server(void) {
         st = lo_server_thread_new_with_proto(port_str, LO_UDP,
                                              osc_error_handler);
         if (st) {
+            // Engine diagnostics, registered ahead of the wildcard
+            lo_server_thread_add_method(st, "/perf/stats", NULL, perf_handler,
+                                        NULL);
+            lo_server_thread_add_method(st, "/perf/xruns", NULL, perf_handler,
+                                        NULL);
+            lo_server_thread_add_method(st, "/perf/dump", NULL, perf_handler,
+                                        NULL);
+            lo_server_thread_add_method(st, "/trace/start", NULL,
+                                        trace_handler, NULL);
+            lo_server_thread_add_method(st, "/trace/stop", NULL, trace_handler,
+                                        NULL);
+            lo_server_thread_add_method(st, "/retro/dump", NULL, retro_handler,
+                                        NULL);
             // Wildcard match for any /alias/param
             lo_server_thread_add_method(st, NULL, NULL, module_param_handler,
                                         NULL);
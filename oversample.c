@@ -0,0 +1,182 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "logger.h"
+#include "oversample.h"
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef int v4i __attribute__((vector_size(16)));
+
+#ifdef __clang__
+#define SHUF(a, b, i, j, k, l) __builtin_shufflevector(a, b, i, j, k, l)
+#else
+#define SHUF(a, b, i, j, k, l) __builtin_shuffle(a, b, (v4i){i, j, k, l})
+#endif
+
+// Transition band of each stage, as a fraction of its high rate. The first
+// stage has to keep everything up to 20 kHz at 44.1 kHz; later ones only
+// see what the first let through, so they can be wider and deeper.
+static const double stage_tbw[OS_MAX_STAGES] = {0.04, 0.12, 0.18};
+
+// Elliptic half-band coefficients for 2 * OS_SECTIONS allpasses (after
+// Laurent de Soras' hiir designer)
+static double acc_num(double q, int order, int c) {
+    double acc = 0.0, term;
+    int i = 0, sign = 1;
+    do {
+        term = pow(q, i * (i + 1)) * sin((i * 2 + 1) * c * M_PI / order) *
+               sign;
+        acc += term;
+        sign = -sign;
+        i++;
+    } while (fabs(term) > 1e-100);
+    return acc;
+}
+
+static double acc_den(double q, int order, int c) {
+    double acc = 0.0, term;
+    int i = 1, sign = -1;
+    do {
+        term = pow(q, i * i) * cos(i * 2 * c * M_PI / order) * sign;
+        acc += term;
+        sign = -sign;
+        i++;
+    } while (fabs(term) > 1e-100);
+    return acc;
+}
+
+static void design(OsStage *st, double tbw) {
+    const int count = 2 * OS_SECTIONS;
+    const int order = count * 2 + 1;
+
+    double k = tan((1.0 - tbw * 2.0) * M_PI / 4.0);
+    k *= k;
+    double kk = pow(1.0 - k * k, 0.25);
+    double e = 0.5 * (1.0 - kk) / (1.0 + kk);
+    double e4 = e * e * e * e;
+    double q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+    for (int i = 0; i < count; i++) {
+        double ww = acc_num(q, order, i + 1) * pow(q, 0.25) /
+                    (acc_den(q, order, i + 1) + 0.5);
+        double ww2 = ww * ww;
+        double x = sqrt((1.0 - ww2 * k) * (1.0 - ww2 / k)) / (1.0 + ww2);
+        st->coef[i & 1][i >> 1] = (float)((1.0 - x) / (1.0 + x));
+    }
+}
+
+int os_factor_from_args(const char *args) {
+    int factor = 1;
+    if (args && strstr(args, "os="))
+        sscanf(strstr(args, "os="), "os=%d", &factor);
+    if (factor != 1 && factor != 2 && factor != 4 && factor != 8) {
+        LOG_WARN("[oversample] os=%d is not 1, 2, 4 or 8, using 1", factor);
+        factor = 1;
+    }
+    return factor;
+}
+
+void os_init(Oversampler *os, int factor) {
+    memset(os, 0, sizeof(*os));
+    os->factor = factor;
+    while ((1 << os->stages) < factor)
+        os->stages++;
+    for (int s = 0; s < os->stages; s++) {
+        design(&os->up[s], stage_tbw[s]);
+        memcpy(os->down[s].coef, os->up[s].coef, sizeof(os->up[s].coef));
+    }
+}
+
+// One 2x stage each way. Each path is a chain of OS_SECTIONS allpasses
+//     y = (in - y') * c + x'
+// run as one vector: lane k holds section k, working one sample behind
+// lane k - 1, so a step feeds the new input into lane 0 and every other
+// lane the output its neighbour made the step before. Lane 3 is the path's
+// output, OS_SECTIONS - 1 samples late.
+static void stage_up(OsStage *st, const float *in, float *out,
+                     unsigned long n) {
+    v4f c0, c1, x0, x1, y0, y1;
+    memcpy(&c0, st->coef[0], sizeof(v4f));
+    memcpy(&c1, st->coef[1], sizeof(v4f));
+    memcpy(&x0, st->x[0], sizeof(v4f));
+    memcpy(&x1, st->x[1], sizeof(v4f));
+    memcpy(&y0, st->y[0], sizeof(v4f));
+    memcpy(&y1, st->y[1], sizeof(v4f));
+
+    for (unsigned long i = 0; i < n; i++) {
+        v4f s = {in ? in[i] : 0.0f};
+        v4f a0 = SHUF(y0, s, 4, 0, 1, 2);
+        v4f a1 = SHUF(y1, s, 4, 0, 1, 2);
+        y0 = (a0 - y0) * c0 + x0;
+        y1 = (a1 - y1) * c1 + x1;
+        x0 = a0;
+        x1 = a1;
+        out[2 * i] = y0[3];
+        out[2 * i + 1] = y1[3];
+    }
+
+    memcpy(st->x[0], &x0, sizeof(v4f));
+    memcpy(st->x[1], &x1, sizeof(v4f));
+    memcpy(st->y[0], &y0, sizeof(v4f));
+    memcpy(st->y[1], &y1, sizeof(v4f));
+}
+
+// Safe in place: out[i] is written after in[2i] and in[2i + 1] are read
+static void stage_down(OsStage *st, const float *in, float *out,
+                       unsigned long n) {
+    v4f c0, c1, x0, x1, y0, y1;
+    memcpy(&c0, st->coef[0], sizeof(v4f));
+    memcpy(&c1, st->coef[1], sizeof(v4f));
+    memcpy(&x0, st->x[0], sizeof(v4f));
+    memcpy(&x1, st->x[1], sizeof(v4f));
+    memcpy(&y0, st->y[0], sizeof(v4f));
+    memcpy(&y1, st->y[1], sizeof(v4f));
+
+    for (unsigned long i = 0; i < n; i++) {
+        v4f s0 = {in[2 * i + 1]};
+        v4f s1 = {in[2 * i]};
+        v4f a0 = SHUF(y0, s0, 4, 0, 1, 2);
+        v4f a1 = SHUF(y1, s1, 4, 0, 1, 2);
+        y0 = (a0 - y0) * c0 + x0;
+        y1 = (a1 - y1) * c1 + x1;
+        x0 = a0;
+        x1 = a1;
+        out[i] = 0.5f * (y0[3] + y1[3]);
+    }
+
+    memcpy(st->x[0], &x0, sizeof(v4f));
+    memcpy(st->x[1], &x1, sizeof(v4f));
+    memcpy(st->y[0], &y0, sizeof(v4f));
+    memcpy(st->y[1], &y1, sizeof(v4f));
+}
+
+void os_up(Oversampler *os, const float *in, float *out,
+           unsigned long frames) {
+    if (os->stages == 0) {
+        if (in)
+            memcpy(out, in, frames * sizeof(float));
+        else
+            memset(out, 0, frames * sizeof(float));
+        return;
+    }
+
+    // Alternate between out and tmp so the last stage lands in out
+    const float *src = in;
+    for (int s = 0; s < os->stages; s++) {
+        float *dst = ((os->stages - 1 - s) & 1) ? os->tmp : out;
+        stage_up(&os->up[s], src, dst, frames << s);
+        src = dst;
+    }
+}
+
+void os_down(Oversampler *os, float *in, float *out, unsigned long frames) {
+    if (os->stages == 0) {
+        memcpy(out, in, frames * sizeof(float));
+        return;
+    }
+
+    for (int s = os->stages - 1; s > 0; s--)
+        stage_down(&os->down[s], in, in, frames << s);
+    stage_down(&os->down[0], in, out, frames);
+}
@@ -0,0 +1,49 @@
+#ifndef OVERSAMPLE_H
+#define OVERSAMPLE_H
+
+#include "util.h"
+
+// 2x, 4x or 8x oversampling for nonlinear modules, as a cascade of 2x
+// half-band stages. Each stage is a polyphase pair of allpass chains (the
+// classic elliptic half-band IIR): cheap, steep, and not linear phase. The
+// sections of a chain are pipelined across SIMD lanes, one sample apart,
+// which adds OS_SECTIONS - 1 samples of delay per stage at its low rate.
+//
+// A module upsamples its input with os_up(), runs its nonlinearity at
+// factor * sample_rate over the result, and brings it back with os_down().
+// Up and down keep their own state, so a module with two inputs uses one
+// Oversampler per input and takes the output down through either.
+
+#define OS_MAX_FACTOR 8
+#define OS_MAX_STAGES 3
+#define OS_SECTIONS 4 // first-order allpasses per path, one SIMD vector
+
+typedef struct {
+    float coef[2][OS_SECTIONS]; // [path][section]
+    float x[2][OS_SECTIONS];    // last input of each section
+    float y[2][OS_SECTIONS];    // last output of each section
+} OsStage;
+
+typedef struct {
+    int factor; // 1 (off), 2, 4 or 8
+    int stages;
+    OsStage up[OS_MAX_STAGES];
+    OsStage down[OS_MAX_STAGES];
+    float tmp[MAX_BLOCK_SIZE * OS_MAX_FACTOR / 2]; // between up stages
+} Oversampler;
+
+// os=1|2|4|8 from module args; 1 when absent
+int os_factor_from_args(const char *args);
+
+void os_init(Oversampler *os, int factor);
+
+// `frames` samples of `in` (NULL reads silence) up to frames * factor in
+// `out`. With factor 1 this is a copy.
+void os_up(Oversampler *os, const float *in, float *out,
+           unsigned long frames);
+
+// frames * factor samples of `in` down to `frames` in `out`; `in` is used
+// as scratch and clobbered
+void os_down(Oversampler *os, float *in, float *out, unsigned long frames);
+
+#endif
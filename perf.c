@@ -0,0 +1,255 @@
+#include <portaudio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "engine.h"
+#include "perf.h"
+
+#define DIAG_DIR "e_output_files/diagnostics"
+
+// Single-writer counters: plain load/store keeps them off the lock prefix
+#define BUMP(x, n)                                                             \
+    __atomic_store_n(&(x), __atomic_load_n(&(x), __ATOMIC_RELAXED) + (n),      \
+                     __ATOMIC_RELAXED)
+
+static PerfStats stats;
+static PerfXrun journal[PERF_XRUN_JOURNAL];
+static uint64_t xrun_count = 0;
+static uint64_t first_ns = 0;
+
+// Per-module cost of the current and previous block. An underflow flag
+// arrives one callback after the late block, so it is charged to `prev`.
+static uint32_t cost_ns[2][MAX_MODULES];
+static int cost_cur = 0;
+static int cost_used = 0;
+
+void perf_block_begin(void) {
+    cost_cur ^= 1;
+    memset(cost_ns[cost_cur], 0, sizeof(uint32_t) * (size_t)cost_used);
+}
+
+void perf_module_cost(int index, uint64_t ns) {
+    if (index < 0 || index >= MAX_MODULES)
+        return;
+    cost_ns[cost_cur][index] += (uint32_t)ns;
+    if (index >= cost_used)
+        cost_used = index + 1;
+}
+
+static void top_modules(const uint32_t *costs, PerfXrun *e) {
+    for (int k = 0; k < PERF_TOP_MODULES; k++) {
+        e->top_module[k] = -1;
+        e->top_cost_us[k] = 0;
+    }
+    for (int i = 0; i < cost_used; i++) {
+        uint32_t c = costs[i];
+        if (!c)
+            continue;
+        for (int k = 0; k < PERF_TOP_MODULES; k++) {
+            if (e->top_module[k] < 0 || c > e->top_cost_us[k]) {
+                for (int j = PERF_TOP_MODULES - 1; j > k; j--) {
+                    e->top_module[j] = e->top_module[j - 1];
+                    e->top_cost_us[j] = e->top_cost_us[j - 1];
+                }
+                e->top_module[k] = i;
+                e->top_cost_us[k] = c;
+                break;
+            }
+        }
+    }
+    for (int k = 0; k < PERF_TOP_MODULES; k++)
+        e->top_cost_us[k] /= 1000;
+}
+
+void perf_block_end(uint64_t start_ns, unsigned long frames, float sample_rate,
+                    double stream_time, unsigned long status_flags) {
+    uint64_t end_ns = perf_now_ns();
+    if (first_ns == 0)
+        first_ns = start_ns;
+
+    uint64_t dur_us = (end_ns - start_ns) / 1000;
+    uint32_t deadline_us =
+        (sample_rate > 0.0f) ? (uint32_t)(1e6 * frames / sample_rate) : 0;
+
+    int b = dur_us ? 64 - __builtin_clzll(dur_us) : 0;
+    if (b >= PERF_HIST_BUCKETS)
+        b = PERF_HIST_BUCKETS - 1;
+
+    BUMP(stats.hist[b], 1);
+    BUMP(stats.callbacks, 1);
+    __atomic_store_n(&stats.deadline_us, deadline_us, __ATOMIC_RELAXED);
+    if (dur_us > stats.max_us)
+        __atomic_store_n(&stats.max_us, (uint32_t)dur_us, __ATOMIC_RELAXED);
+
+    unsigned long flags =
+        status_flags & (paInputUnderflow | paInputOverflow |
+                        paOutputUnderflow | paOutputOverflow);
+    int missed = deadline_us && dur_us > deadline_us;
+    if (missed) {
+        BUMP(stats.deadline_misses, 1);
+        flags |= PERF_XRUN_DEADLINE;
+    }
+    if (!flags)
+        return;
+
+    uint64_t n = xrun_count;
+    PerfXrun *e = &journal[n % PERF_XRUN_JOURNAL];
+
+    __atomic_store_n(&e->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->time = (double)(start_ns - first_ns) * 1e-9;
+    e->stream_time = stream_time;
+    e->flags = flags;
+    e->duration_us = (uint32_t)dur_us;
+    e->deadline_us = deadline_us;
+    top_modules(cost_ns[missed ? cost_cur : cost_cur ^ 1], e);
+    __atomic_store_n(&e->seq, 2 * n + 2, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&xrun_count, n + 1, __ATOMIC_RELEASE);
+    BUMP(stats.xruns, 1);
+}
+
+void perf_get_stats(PerfStats *out) {
+    out->callbacks = __atomic_load_n(&stats.callbacks, __ATOMIC_RELAXED);
+    out->deadline_misses =
+        __atomic_load_n(&stats.deadline_misses, __ATOMIC_RELAXED);
+    out->xruns = __atomic_load_n(&stats.xruns, __ATOMIC_RELAXED);
+    out->max_us = __atomic_load_n(&stats.max_us, __ATOMIC_RELAXED);
+    out->deadline_us = __atomic_load_n(&stats.deadline_us, __ATOMIC_RELAXED);
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++)
+        out->hist[b] = __atomic_load_n(&stats.hist[b], __ATOMIC_RELAXED);
+}
+
+int perf_get_xruns(PerfXrun *out, int max) {
+    uint64_t n = __atomic_load_n(&xrun_count, __ATOMIC_ACQUIRE);
+    uint64_t first = (n > PERF_XRUN_JOURNAL) ? n - PERF_XRUN_JOURNAL : 0;
+    if (max > 0 && n - first > (uint64_t)max)
+        first = n - (uint64_t)max;
+
+    int count = 0;
+    for (uint64_t k = first; k < n; k++) {
+        const PerfXrun *e = &journal[k % PERF_XRUN_JOURNAL];
+        uint64_t s1 = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        PerfXrun copy = *e;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t s2 = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+        if (s1 != s2 || s1 != 2 * k + 2)
+            continue; // overwritten while reading
+        out[count++] = copy;
+    }
+    return count;
+}
+
+// Upper edge of the bucket holding the p-th fraction of callbacks
+uint32_t perf_percentile_us(const PerfStats *s, double p) {
+    if (s->callbacks == 0)
+        return 0;
+    uint64_t target = (uint64_t)(p * (double)s->callbacks);
+    uint64_t seen = 0;
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+        seen += s->hist[b];
+        if (seen > target)
+            return (uint32_t)1 << b;
+    }
+    return s->max_us;
+}
+
+const char *perf_flag_names(unsigned long flags, char *buf, int len) {
+    static const struct {
+        unsigned long bit;
+        const char *name;
+    } names[] = {
+        {paInputUnderflow, "in_underflow"},
+        {paInputOverflow, "in_overflow"},
+        {paOutputUnderflow, "out_underflow"},
+        {paOutputOverflow, "out_overflow"},
+        {PERF_XRUN_DEADLINE, "deadline"},
+    };
+
+    int pos = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!(flags & names[i].bit) || pos >= len)
+            continue;
+        pos += snprintf(buf + pos, (size_t)(len - pos), "%s%s",
+                        pos ? "," : "", names[i].name);
+    }
+    return buf;
+}
+
+int perf_dump_json(char *path_out, int path_len) {
+    PerfStats s;
+    perf_get_stats(&s);
+
+    static PerfXrun xr[PERF_XRUN_JOURNAL];
+    int nx = perf_get_xruns(xr, PERF_XRUN_JOURNAL);
+
+    mkdir("e_output_files", 0755);
+    mkdir(DIAG_DIR, 0755);
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+
+    char path[256];
+    snprintf(path, sizeof(path), DIAG_DIR "/perf_%s.json", stamp);
+
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"callbacks\": %llu,\n", (unsigned long long)s.callbacks);
+    fprintf(f, "  \"deadline_us\": %u,\n", s.deadline_us);
+    fprintf(f, "  \"deadline_misses\": %llu,\n",
+            (unsigned long long)s.deadline_misses);
+    fprintf(f, "  \"xruns\": %llu,\n", (unsigned long long)s.xruns);
+    fprintf(f, "  \"max_us\": %u,\n", s.max_us);
+    fprintf(f, "  \"p50_us\": %u,\n", perf_percentile_us(&s, 0.50));
+    fprintf(f, "  \"p99_us\": %u,\n", perf_percentile_us(&s, 0.99));
+    fprintf(f, "  \"p999_us\": %u,\n", perf_percentile_us(&s, 0.999));
+
+    fprintf(f, "  \"histogram_us\": [");
+    int first = 1;
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+        if (!s.hist[b])
+            continue;
+        fprintf(f, "%s\n    {\"lo\": %u, \"hi\": %u, \"count\": %llu}",
+                first ? "" : ",", b ? 1u << (b - 1) : 0u, 1u << b,
+                (unsigned long long)s.hist[b]);
+        first = 0;
+    }
+    fprintf(f, "\n  ],\n");
+
+    fprintf(f, "  \"xrun_journal\": [");
+    for (int i = 0; i < nx; i++) {
+        char flags[96];
+        perf_flag_names(xr[i].flags, flags, sizeof(flags));
+        fprintf(f,
+                "%s\n    {\"time\": %.6f, \"stream_time\": %.6f, "
+                "\"flags\": \"%s\", \"duration_us\": %u, "
+                "\"deadline_us\": %u, \"top\": [",
+                i ? "," : "", xr[i].time, xr[i].stream_time, flags,
+                xr[i].duration_us, xr[i].deadline_us);
+        int nt = 0;
+        for (int k = 0; k < PERF_TOP_MODULES; k++) {
+            const char *alias = get_module_alias(xr[i].top_module[k]);
+            if (!alias)
+                continue;
+            fprintf(f, "%s{\"module\": \"%s\", \"us\": %u}", nt ? ", " : "",
+                    alias, xr[i].top_cost_us[k]);
+            nt++;
+        }
+        fprintf(f, "]}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+
+    if (path_out)
+        snprintf(path_out, (size_t)path_len, "%s", path);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Callback timing and xrun journal. The audio thread is the only writer;
+// the UI, OSC and exit paths read without locks.
+
+#define PERF_HIST_BUCKETS 24 // log2 microseconds: [2^(b-1), 2^b) us
+#define PERF_XRUN_JOURNAL 256
+#define PERF_TOP_MODULES 3
+
+// Set alongside PaStreamCallbackFlags when our own callback overran
+#define PERF_XRUN_DEADLINE 0x10000UL
+
+typedef struct {
+    uint64_t seq;
+    double time;        // seconds since the first callback
+    double stream_time; // PortAudio stream clock
+    unsigned long flags;
+    uint32_t duration_us;
+    uint32_t deadline_us;
+    int top_module[PERF_TOP_MODULES]; // engine index, -1 = none
+    uint32_t top_cost_us[PERF_TOP_MODULES];
+} PerfXrun;
+
+typedef struct {
+    uint64_t callbacks;
+    uint64_t deadline_misses;
+    uint64_t xruns;
+    uint32_t max_us;
+    uint32_t deadline_us;
+    uint64_t hist[PERF_HIST_BUCKETS];
+} PerfStats;
+
+static inline uint64_t perf_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Audio thread
+void perf_block_begin(void);
+void perf_module_cost(int index, uint64_t ns);
+void perf_block_end(uint64_t start_ns, unsigned long frames, float sample_rate,
+                    double stream_time, unsigned long status_flags);
+
+// Readers
+void perf_get_stats(PerfStats *out);
+int perf_get_xruns(PerfXrun *out, int max); // oldest first, returns count
+uint32_t perf_percentile_us(const PerfStats *s, double p);
+const char *perf_flag_names(unsigned long flags, char *buf, int len);
+
+// Writes e_output_files/diagnostics/perf_<time>.json; returns 0 on success
+int perf_dump_json(char *path_out, int path_len);
+
+#endif
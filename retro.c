@@ -0,0 +1,886 @@
+#include <math.h>
+#include <pthread.h>
+#include <sndfile.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "logger.h"
+#include "retro.h"
+#include "trace.h"
+#include "util.h"
+
+#define RETRO_DIR "e_output_files/retro"
+#define RETRO_MAX_TAPS 8
+#define RETRO_MAX_SOURCE_CHANNELS 8
+#define RETRO_MAX_WIDTH 32         // ring channels: master plus taps
+#define RETRO_HEADROOM_SECONDS 10  // 16-bit: lead a dump keeps on the writer
+#define RETRO_STAGE_SECONDS 8      // packed: 16-bit staging for the encoder
+#define RETRO_BLOCK_FRAMES 4096    // packed: frames per encoded block
+#define RETRO_PACK_MS 50
+#define RETRO_DUMP_FRAMES 16384
+#define RETRO_RICE_LIMIT 24 // quotient that escapes to a raw value
+#define RETRO_RICE_RAW 20   // bits of an escaped value
+
+// Encoded channel modes, one byte ahead of each channel of a block
+enum { PACK_CONSTANT, PACK_VERBATIM, PACK_RICE };
+
+typedef struct {
+    float minutes;
+    int channels;
+    char taps[RETRO_MAX_TAPS][32];
+    int num_taps;
+    bool pack;
+    float mb; // 0 = default
+    bool off;
+} RetroConfig;
+
+typedef struct {
+    char name[32];
+    const float *buf[2]; // taps; the master reads the interleaved output
+    int channels;
+    int column; // first ring channel
+} RetroSource;
+
+typedef struct {
+    uint64_t first; // frame index
+    uint32_t offset; // into the store
+    uint32_t bytes;
+} RetroBlock;
+
+static RetroConfig config = {.minutes = 5.0f, .channels = 2};
+
+static RetroSource sources[1 + RETRO_MAX_TAPS];
+static int num_sources = 0;
+static int width = 0; // ring channels
+static int rate = 0;
+static uint64_t history_frames = 0;
+static uint64_t memory_bytes = 0;
+static int enabled = 0;
+
+// 16-bit ring, written by the audio thread only; in packed mode this is
+// the staging area the encoder drains
+static int16_t *ring = NULL;
+static uint64_t ring_frames = 0;
+static uint64_t write_pos = 0; // frames captured
+
+// Packed store: encoded blocks in a byte ring, oldest evicted first
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char *store = NULL;
+static uint32_t store_bytes = 0;
+static RetroBlock *blocks = NULL;
+static uint32_t max_blocks = 0;
+static uint32_t block_head = 0;
+static uint32_t block_count = 0;
+static uint64_t packed_pos = 0; // frames encoded
+static pthread_t packer;
+static int packer_running = 0;
+static int16_t *pack_frames = NULL;
+static int32_t *pack_chan = NULL;
+static unsigned char *pack_buf = NULL;
+static uint32_t pack_buf_bytes = 0;
+// Packed dumps decode one block at a time through these, set aside at init
+static unsigned char *dump_bytes = NULL;
+static int16_t *dump_frames = NULL;
+static int32_t *dump_chan = NULL;
+
+static int dumping = 0;
+static float dump_seconds = 0.0f;
+static char last_path[256] = "";
+
+static bool parse_bool(const char *val) {
+    return !val || !(strcmp(val, "0") == 0 || strcasecmp(val, "off") == 0 ||
+                     strcasecmp(val, "no") == 0);
+}
+
+void retro_config_parse(const char *args) {
+    if (!args)
+        return;
+
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", args);
+
+    for (char *tok = strtok(buf, " ,\t"); tok; tok = strtok(NULL, " ,\t")) {
+        char *val = strchr(tok, '=');
+        if (val)
+            *val++ = '\0';
+
+        if (strcmp(tok, "minutes") == 0 && val) {
+            config.minutes = (float)atof(val);
+            config.off = false;
+        } else if (strcmp(tok, "channels") == 0 && val) {
+            config.channels = atoi(val);
+        } else if (strcmp(tok, "taps") == 0 && val) {
+            config.num_taps = 0;
+            for (char *t = val; *t && config.num_taps < RETRO_MAX_TAPS;) {
+                size_t n = strcspn(t, "+");
+                snprintf(config.taps[config.num_taps], sizeof(config.taps[0]),
+                         "%.*s", (int)n, t);
+                if (n > 0)
+                    config.num_taps++;
+                t += n;
+                if (*t == '+')
+                    t++;
+            }
+        } else if (strcmp(tok, "pack") == 0) {
+            config.pack = parse_bool(val);
+        } else if (strcmp(tok, "mb") == 0 && val) {
+            config.mb = (float)atof(val);
+        } else if (strcmp(tok, "off") == 0) {
+            config.off = true;
+        } else if (strcmp(tok, "on") == 0) {
+            config.off = false;
+        } else {
+            LOG_WARN("[retro] Unknown setting: %s", tok);
+        }
+    }
+
+    if (config.minutes < 0.1f)
+        config.minutes = 0.1f;
+    if (config.channels < 1)
+        config.channels = 1;
+    if (config.channels > RETRO_MAX_SOURCE_CHANNELS)
+        config.channels = RETRO_MAX_SOURCE_CHANNELS;
+    if (config.mb < 0.0f)
+        config.mb = 0.0f;
+}
+
+void retro_config_from_patch(const char *patch_text) {
+    char *patch = strdup(patch_text);
+    char *save = NULL;
+
+    for (char *line = strtok_r(patch, "\r\n", &save); line;
+         line = strtok_r(NULL, "\r\n", &save)) {
+        char *clean_line = trim_whitespace(line);
+        if (strncmp(clean_line, "retro ", 6) == 0)
+            retro_config_parse(clean_line + 6);
+    }
+
+    free(patch);
+}
+
+// ---------------------------------------------------------------------------
+// Capture
+
+static inline int16_t to_s16(float x) {
+    x *= 32767.0f;
+    if (x > 32767.0f)
+        x = 32767.0f;
+    if (x < -32768.0f)
+        x = -32768.0f;
+    return (int16_t)lrintf(x);
+}
+
+void retro_capture(const float *output, int channels, unsigned long frames) {
+    if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+        return;
+
+    uint64_t w = __atomic_load_n(&write_pos, __ATOMIC_RELAXED);
+    uint64_t pos = w % ring_frames;
+    unsigned long done = 0;
+
+    while (done < frames) {
+        unsigned long n = frames - done;
+        if (n > ring_frames - pos)
+            n = (unsigned long)(ring_frames - pos);
+        int16_t *dst = ring + pos * width;
+
+        for (int s = 0; s < num_sources; s++) {
+            const RetroSource *src = &sources[s];
+            for (int c = 0; c < src->channels; c++) {
+                int16_t *d = dst + src->column + c;
+                if (s > 0) {
+                    const float *in = src->buf[c] + done;
+                    for (unsigned long i = 0; i < n; i++)
+                        d[i * width] = to_s16(in[i]);
+                } else if (c < channels) {
+                    const float *in = output + done * channels + c;
+                    for (unsigned long i = 0; i < n; i++)
+                        d[i * width] = to_s16(in[i * channels]);
+                } else {
+                    for (unsigned long i = 0; i < n; i++)
+                        d[i * width] = 0;
+                }
+            }
+        }
+        done += n;
+        pos = 0;
+    }
+
+    __atomic_store_n(&write_pos, w + frames, __ATOMIC_RELEASE);
+}
+
+// Frames [from, from + n) out of the ring; the caller checks afterwards
+// that the writer has not lapped them
+static void ring_read(int16_t *dst, uint64_t from, uint64_t n) {
+    uint64_t pos = from % ring_frames;
+    while (n > 0) {
+        uint64_t run = ring_frames - pos < n ? ring_frames - pos : n;
+        memcpy(dst, ring + pos * width, (size_t)(run * width) * 2);
+        dst += run * width;
+        n -= run;
+        pos = 0;
+    }
+}
+
+// Leaves room for the block the audio thread may be writing past write_pos
+// while the reader copies
+static bool ring_intact(uint64_t from) {
+    return __atomic_load_n(&write_pos, __ATOMIC_ACQUIRE) - from <=
+           ring_frames - MAX_BLOCK_SIZE;
+}
+
+// ---------------------------------------------------------------------------
+// Lossless block coding: per channel, the best of three fixed polynomial
+// predictors (orders 0-2) and Rice-coded residuals, or the samples as-is
+// when that comes out smaller
+
+typedef struct {
+    unsigned char *p, *end;
+    uint64_t acc;
+    int bits;
+    bool full;
+} BitWriter;
+
+static inline void bw_put(BitWriter *b, uint32_t v, int n) {
+    b->acc = (b->acc << n) | v;
+    b->bits += n;
+    while (b->bits >= 8) {
+        b->bits -= 8;
+        if (b->p == b->end) {
+            b->full = true;
+            return;
+        }
+        *b->p++ = (unsigned char)(b->acc >> b->bits);
+    }
+}
+
+static inline void bw_flush(BitWriter *b) {
+    if (b->bits > 0)
+        bw_put(b, 0, 8 - b->bits);
+}
+
+typedef struct {
+    const unsigned char *p, *end;
+    uint64_t acc;
+    int bits;
+} BitReader;
+
+static inline uint32_t br_get(BitReader *b, int n) {
+    while (b->bits < n) {
+        b->acc = (b->acc << 8) | (b->p < b->end ? *b->p++ : 0);
+        b->bits += 8;
+    }
+    b->bits -= n;
+    return (uint32_t)(b->acc >> b->bits) & (uint32_t)((1ull << n) - 1);
+}
+
+static inline int32_t predict(const int32_t *x, int n, int order) {
+    switch (order) {
+    case 0:
+        return 0;
+    case 1:
+        return x[n - 1];
+    default:
+        return 2 * x[n - 1] - x[n - 2];
+    }
+}
+
+static void put_s16(unsigned char *p, int32_t v) {
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+static int32_t get_s16(const unsigned char *p) {
+    return (int16_t)(uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t encode_channel(const int32_t *x, int n, unsigned char *out) {
+    uint64_t cost[3] = {0, 0, 0};
+    bool constant = true;
+    for (int i = 2; i < n; i++) {
+        cost[0] += (uint64_t)abs(x[i]);
+        cost[1] += (uint64_t)abs(x[i] - x[i - 1]);
+        cost[2] += (uint64_t)abs(x[i] - 2 * x[i - 1] + x[i - 2]);
+    }
+    for (int i = 1; i < n && constant; i++)
+        constant = x[i] == x[0];
+    if (constant) {
+        out[0] = PACK_CONSTANT;
+        put_s16(out + 1, x[0]);
+        return 3;
+    }
+
+    int order = 0;
+    for (int o = 1; o < 3; o++)
+        if (cost[o] < cost[order])
+            order = o;
+
+    // Rice parameter from the mean zigzagged residual
+    uint64_t mean = 2 * cost[order] / (uint64_t)(n - 2);
+    int k = 0;
+    while (k < RETRO_RICE_RAW - 1 && (2ull << k) <= mean)
+        k++;
+
+    uint32_t raw = 1 + 2 * (uint32_t)n;
+    out[0] = PACK_RICE + order;
+    out[1] = (unsigned char)k;
+    for (int i = 0; i < order; i++)
+        put_s16(out + 2 + 2 * i, x[i]);
+
+    BitWriter b = {out + 2 + 2 * order, out + raw, 0, 0, false};
+    for (int i = order; i < n && !b.full; i++) {
+        int32_t e = x[i] - predict(x, i, order);
+        uint32_t u = ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+        uint32_t q = u >> k;
+        if (q < RETRO_RICE_LIMIT) {
+            bw_put(&b, ((1u << q) - 1) << 1, (int)q + 1);
+            if (k > 0)
+                bw_put(&b, u & ((1u << k) - 1), k);
+        } else {
+            bw_put(&b, (1u << RETRO_RICE_LIMIT) - 1, RETRO_RICE_LIMIT);
+            bw_put(&b, u, RETRO_RICE_RAW);
+        }
+    }
+    bw_flush(&b);
+    if (!b.full && b.p < out + raw)
+        return (uint32_t)(b.p - out);
+
+    out[0] = PACK_VERBATIM;
+    for (int i = 0; i < n; i++)
+        put_s16(out + 1 + 2 * i, x[i]);
+    return raw;
+}
+
+static const unsigned char *decode_channel(const unsigned char *in,
+                                           const unsigned char *end,
+                                           int32_t *x, int n) {
+    if (in >= end)
+        return end;
+    int mode = in[0];
+    if (mode == PACK_CONSTANT) {
+        int32_t v = get_s16(in + 1);
+        for (int i = 0; i < n; i++)
+            x[i] = v;
+        return in + 3;
+    }
+    if (mode == PACK_VERBATIM) {
+        for (int i = 0; i < n; i++)
+            x[i] = get_s16(in + 1 + 2 * i);
+        return in + 1 + 2 * n;
+    }
+
+    int order = mode - PACK_RICE;
+    int k = in[1];
+    for (int i = 0; i < order; i++)
+        x[i] = get_s16(in + 2 + 2 * i);
+
+    BitReader b = {in + 2 + 2 * order, end, 0, 0};
+    for (int i = order; i < n; i++) {
+        uint32_t q = 0;
+        while (q < RETRO_RICE_LIMIT && br_get(&b, 1))
+            q++;
+        uint32_t u;
+        if (q < RETRO_RICE_LIMIT)
+            u = (q << k) | (k > 0 ? br_get(&b, k) : 0);
+        else
+            u = br_get(&b, RETRO_RICE_RAW);
+        int32_t e = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+        x[i] = e + predict(x, i, order);
+    }
+    return b.p;
+}
+
+static uint32_t encode_block(const int16_t *frames, unsigned char *out) {
+    uint32_t len = 0;
+    for (int c = 0; c < width; c++) {
+        for (int i = 0; i < RETRO_BLOCK_FRAMES; i++)
+            pack_chan[i] = frames[i * width + c];
+        len += encode_channel(pack_chan, RETRO_BLOCK_FRAMES, out + len);
+    }
+    return len;
+}
+
+static void decode_block(const unsigned char *in, uint32_t len,
+                         int16_t *frames, int32_t *chan) {
+    const unsigned char *end = in + len;
+    for (int c = 0; c < width; c++) {
+        in = decode_channel(in, end, chan, RETRO_BLOCK_FRAMES);
+        for (int i = 0; i < RETRO_BLOCK_FRAMES; i++)
+            frames[i * width + c] = (int16_t)chan[i];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Packed store
+
+static void evict_oldest(void) {
+    block_head = (block_head + 1) % max_blocks;
+    block_count--;
+}
+
+// Called with store_lock held
+static void store_block(uint64_t first, const unsigned char *data,
+                        uint32_t len) {
+    uint32_t off = 0;
+    if (block_count > 0) {
+        const RetroBlock *last =
+            &blocks[(block_head + block_count - 1) % max_blocks];
+        off = last->offset + last->bytes;
+    }
+    if (off + len > store_bytes) {
+        // Wrap: whatever lies past the cursor is the oldest audio
+        while (block_count > 0 && blocks[block_head].offset >= off)
+            evict_oldest();
+        off = 0;
+    }
+    while (block_count > 0 && blocks[block_head].offset >= off &&
+           blocks[block_head].offset < off + len)
+        evict_oldest();
+    if (block_count == max_blocks)
+        evict_oldest();
+
+    memcpy(store + off, data, len);
+    blocks[(block_head + block_count) % max_blocks] =
+        (RetroBlock){first, off, len};
+    block_count++;
+
+    uint64_t end = first + RETRO_BLOCK_FRAMES;
+    while (block_count > 1 &&
+           blocks[block_head].first + RETRO_BLOCK_FRAMES + history_frames <=
+               end)
+        evict_oldest();
+}
+
+static void pack_pending(void) {
+    uint64_t p = packed_pos;
+    for (;;) {
+        uint64_t w = __atomic_load_n(&write_pos, __ATOMIC_ACQUIRE);
+        if (w - p < RETRO_BLOCK_FRAMES)
+            break;
+
+        ring_read(pack_frames, p, RETRO_BLOCK_FRAMES);
+        if (!ring_intact(p)) {
+            // Fell a whole staging ring behind: skip ahead, leaving a gap
+            p = __atomic_load_n(&write_pos, __ATOMIC_ACQUIRE) -
+                ring_frames / 2;
+            LOG_WARN("[retro] encoder overrun, %d frames lost",
+                     (int)(p - packed_pos));
+            pthread_mutex_lock(&store_lock);
+            __atomic_store_n(&packed_pos, p, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&store_lock);
+            continue;
+        }
+
+        uint32_t len = encode_block(pack_frames, pack_buf);
+        pthread_mutex_lock(&store_lock);
+        store_block(p, pack_buf, len);
+        p += RETRO_BLOCK_FRAMES;
+        __atomic_store_n(&packed_pos, p, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&store_lock);
+    }
+}
+
+static void *packer_main(void *arg) {
+    (void)arg;
+    trace_set_thread_name("retro pack");
+    while (__atomic_load_n(&packer_running, __ATOMIC_ACQUIRE)) {
+        usleep(RETRO_PACK_MS * 1000);
+        pack_pending();
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Dump
+
+typedef struct {
+    SNDFILE *files[1 + RETRO_MAX_TAPS];
+    int16_t *split;
+    int16_t *silence;
+    uint64_t written;
+} DumpFiles;
+
+static int dump_open(DumpFiles *d) {
+    mkdir("e_output_files", 0755);
+    mkdir(RETRO_DIR, 0755);
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+
+    d->split = malloc((size_t)RETRO_DUMP_FRAMES * RETRO_MAX_SOURCE_CHANNELS *
+                      sizeof(int16_t));
+    d->silence = calloc((size_t)RETRO_DUMP_FRAMES * width, sizeof(int16_t));
+    if (!d->split || !d->silence)
+        return -1;
+
+    for (int s = 0; s < num_sources; s++) {
+        char path[256];
+        if (s == 0)
+            snprintf(path, sizeof(path), RETRO_DIR "/retro_%.31s.wav", stamp);
+        else
+            snprintf(path, sizeof(path), RETRO_DIR "/retro_%.31s_%.31s.wav",
+                     stamp, sources[s].name);
+
+        // RF64 that downgrades to plain WAV under 4 GB
+        SF_INFO info = {0};
+        info.samplerate = rate;
+        info.channels = sources[s].channels;
+        info.format = SF_FORMAT_RF64 | SF_FORMAT_PCM_16;
+        d->files[s] = sf_open(path, SFM_WRITE, &info);
+        if (!d->files[s]) {
+            LOG_ERROR("[retro] cannot write '%s': %s", path, sf_strerror(NULL));
+            return -1;
+        }
+        sf_command(d->files[s], SFC_RF64_AUTO_DOWNGRADE, NULL, SF_TRUE);
+        if (s == 0)
+            snprintf(last_path, sizeof(last_path), "%s", path);
+    }
+    return 0;
+}
+
+static void dump_close(DumpFiles *d) {
+    for (int s = 0; s < num_sources; s++)
+        if (d->files[s])
+            sf_close(d->files[s]);
+    free(d->split);
+    free(d->silence);
+}
+
+// Ring-layout frames out to one file per source; NULL writes silence
+static int dump_write(DumpFiles *d, const int16_t *frames, uint64_t n) {
+    while (n > 0) {
+        uint64_t run = n < RETRO_DUMP_FRAMES ? n : RETRO_DUMP_FRAMES;
+        const int16_t *in = frames ? frames : d->silence;
+        for (int s = 0; s < num_sources; s++) {
+            int ch = sources[s].channels;
+            for (uint64_t i = 0; i < run; i++)
+                memcpy(d->split + i * ch, in + i * width + sources[s].column,
+                       (size_t)ch * sizeof(int16_t));
+            if (sf_writef_short(d->files[s], d->split, (sf_count_t)run) !=
+                (sf_count_t)run)
+                return -1;
+        }
+        if (frames)
+            frames += run * width;
+        n -= run;
+        d->written += run;
+    }
+    return 0;
+}
+
+static int dump_pcm(DumpFiles *d, uint64_t want) {
+    uint64_t end = __atomic_load_n(&write_pos, __ATOMIC_ACQUIRE);
+    uint64_t n = want < end ? want : end;
+    int16_t *chunk = malloc((size_t)RETRO_DUMP_FRAMES * width * 2);
+    if (!chunk)
+        return -1;
+
+    int rc = 0;
+    for (uint64_t pos = end - n; pos < end && rc == 0;) {
+        uint64_t run = end - pos < RETRO_DUMP_FRAMES ? end - pos
+                                                     : RETRO_DUMP_FRAMES;
+        ring_read(chunk, pos, run);
+        if (!ring_intact(pos)) {
+            LOG_WARN("[retro] dump overtaken by capture");
+            rc = -1;
+            break;
+        }
+        rc = dump_write(d, chunk, run);
+        pos += run;
+    }
+    free(chunk);
+    return rc;
+}
+
+// Position of the first block ending after `pos`, block_count when none
+// does. Called with store_lock held.
+static uint32_t find_block(uint64_t pos) {
+    uint32_t lo = 0, hi = block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const RetroBlock *b = &blocks[(block_head + mid) % max_blocks];
+        if (b->first + RETRO_BLOCK_FRAMES <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// One block at a time: the lock is held only to find the block at the
+// cursor and copy its bytes out, so the packer never waits on a dump and a
+// dump needs no memory beyond what init set aside. Frames not encoded yet
+// are read straight from the staging ring.
+static int dump_packed(DumpFiles *d, uint64_t want) {
+    uint64_t end = __atomic_load_n(&write_pos, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&store_lock);
+    uint64_t oldest = block_count ? blocks[block_head].first : packed_pos;
+    pthread_mutex_unlock(&store_lock);
+
+    uint64_t cursor = end - (want < end ? want : end);
+    if (cursor < oldest)
+        cursor = oldest;
+
+    int rc = 0;
+    while (rc == 0 && cursor < end) {
+        RetroBlock b = {0};
+        bool have = false;
+        pthread_mutex_lock(&store_lock);
+        uint64_t packed = packed_pos;
+        if (cursor < packed) {
+            uint32_t i = find_block(cursor);
+            if (i < block_count) {
+                b = blocks[(block_head + i) % max_blocks];
+                have = true;
+                if (b.first <= cursor)
+                    memcpy(dump_bytes, store + b.offset, b.bytes);
+            }
+        }
+        pthread_mutex_unlock(&store_lock);
+
+        uint64_t n;
+        if (cursor >= packed) {
+            n = end - cursor < RETRO_BLOCK_FRAMES ? end - cursor
+                                                   : RETRO_BLOCK_FRAMES;
+            ring_read(dump_frames, cursor, n);
+            if (!ring_intact(cursor)) {
+                LOG_WARN("[retro] dump overtaken by capture");
+                return -1;
+            }
+            rc = dump_write(d, dump_frames, n);
+        } else if (!have || b.first > cursor) {
+            // An encoder overrun gap, or blocks evicted under the dump:
+            // silence keeps the files in time
+            uint64_t next = have ? b.first : packed;
+            n = (next < end ? next : end) - cursor;
+            rc = dump_write(d, NULL, n);
+        } else {
+            decode_block(dump_bytes, b.bytes, dump_frames, dump_chan);
+            uint64_t skip = cursor - b.first;
+            n = RETRO_BLOCK_FRAMES - skip;
+            if (n > end - cursor)
+                n = end - cursor;
+            rc = dump_write(d, dump_frames + skip * width, n);
+        }
+        cursor += n;
+    }
+    return rc;
+}
+
+static void *dump_main(void *arg) {
+    (void)arg;
+    trace_set_thread_name("retro dump");
+    TRACE_BEGIN(t0);
+
+    uint64_t want = history_frames;
+    if (dump_seconds > 0.0f && (uint64_t)(dump_seconds * rate) < want)
+        want = (uint64_t)(dump_seconds * rate);
+
+    DumpFiles d = {0};
+    int rc = dump_open(&d);
+    if (rc == 0)
+        rc = config.pack ? dump_packed(&d, want) : dump_pcm(&d, want);
+    uint64_t written = d.written;
+    dump_close(&d);
+
+    if (rc == 0)
+        LOG_INFO("[retro] wrote %.1f s to %s", (float)written / (float)rate,
+                 last_path);
+    else
+        LOG_ERROR("[retro] dump to %s failed", last_path);
+
+    TRACE_END(t0, "retro", "dump");
+    __atomic_store_n(&dumping, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int retro_dump(float seconds) {
+    if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+        return -1;
+    int idle = 0;
+    if (!__atomic_compare_exchange_n(&dumping, &idle, 1, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return -1;
+
+    dump_seconds = seconds;
+    pthread_t t;
+    if (pthread_create(&t, NULL, dump_main, NULL) != 0) {
+        __atomic_store_n(&dumping, 0, __ATOMIC_RELEASE);
+        return -1;
+    }
+    pthread_detach(t);
+    return 0;
+}
+
+int retro_dumping(void) { return __atomic_load_n(&dumping, __ATOMIC_ACQUIRE); }
+
+const char *retro_last_path(void) { return last_path; }
+
+float retro_seconds(void) {
+    if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+        return 0.0f;
+    uint64_t end = __atomic_load_n(&write_pos, __ATOMIC_ACQUIRE);
+    uint64_t oldest = 0;
+    if (config.pack) {
+        pthread_mutex_lock(&store_lock);
+        oldest = block_count ? blocks[block_head].first : packed_pos;
+        pthread_mutex_unlock(&store_lock);
+    } else if (end > history_frames) {
+        oldest = end - history_frames;
+    }
+    return (float)(end - oldest) / (float)rate;
+}
+
+uint64_t retro_memory_bytes(void) { return memory_bytes; }
+
+// ---------------------------------------------------------------------------
+// Setup
+
+// Touches every page so the audio thread never takes the first fault
+static void *alloc_touched(size_t bytes) {
+    unsigned char *p = malloc(bytes);
+    if (!p)
+        return NULL;
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0)
+        page = 4096;
+    for (size_t i = 0; i < bytes; i += (size_t)page)
+        ((volatile unsigned char *)p)[i] = 0;
+    memory_bytes += bytes;
+    return p;
+}
+
+static void add_tap(const char *alias) {
+    for (int i = 0; i < get_module_count(); i++) {
+        Module *m = get_module(i);
+        if (!m || strcmp(get_module_alias(i), alias) != 0)
+            continue;
+
+        RetroSource *s = &sources[num_sources];
+        snprintf(s->name, sizeof(s->name), "%s", alias);
+        if (m->output_bufferL && m->output_bufferR) {
+            s->buf[0] = m->output_bufferL;
+            s->buf[1] = m->output_bufferR;
+            s->channels = 2;
+        } else if (m->output_buffer) {
+            s->buf[0] = m->output_buffer;
+            s->channels = 1;
+        } else {
+            LOG_WARN("[retro] tap '%s' has no audio output", alias);
+            return;
+        }
+        if (width + s->channels > RETRO_MAX_WIDTH) {
+            LOG_WARN("[retro] too many channels, tap '%s' dropped", alias);
+            return;
+        }
+        s->column = width;
+        width += s->channels;
+        num_sources++;
+        return;
+    }
+    LOG_WARN("[retro] no module named '%s' to tap", alias);
+}
+
+int retro_init(float sample_rate) {
+    if (config.off)
+        return 0;
+
+    rate = (int)sample_rate;
+    sources[0] = (RetroSource){.name = "master", .channels = config.channels};
+    width = config.channels;
+    num_sources = 1;
+    for (int t = 0; t < config.num_taps; t++)
+        add_tap(config.taps[t]);
+
+    history_frames = (uint64_t)(config.minutes * 60.0f * (float)rate);
+    ring_frames = (uint64_t)rate * (config.pack ? RETRO_STAGE_SECONDS
+                                                : RETRO_HEADROOM_SECONDS);
+    if (!config.pack)
+        ring_frames += history_frames;
+    ring = alloc_touched((size_t)(ring_frames * width) * sizeof(int16_t));
+    if (!ring)
+        goto fail;
+
+    if (config.pack) {
+        uint32_t block_max = (uint32_t)width * (1 + 2 * RETRO_BLOCK_FRAMES);
+        double mb = config.mb > 0.0f
+                        ? config.mb * 1048576.0
+                        : (double)history_frames * width; // half of 16-bit
+        if (mb > 4000.0 * 1048576.0)
+            mb = 4000.0 * 1048576.0;
+        store_bytes = (uint32_t)mb;
+        if (store_bytes < 2 * block_max)
+            store_bytes = 2 * block_max;
+        max_blocks = (uint32_t)(history_frames / RETRO_BLOCK_FRAMES) + 2;
+        pack_buf_bytes = block_max;
+
+        store = alloc_touched(store_bytes);
+        blocks = alloc_touched(max_blocks * sizeof(RetroBlock));
+        pack_buf = alloc_touched(pack_buf_bytes);
+        pack_frames = alloc_touched((size_t)RETRO_BLOCK_FRAMES * width * 2);
+        pack_chan = alloc_touched(RETRO_BLOCK_FRAMES * sizeof(int32_t));
+        dump_bytes = alloc_touched(pack_buf_bytes);
+        dump_frames = alloc_touched((size_t)RETRO_BLOCK_FRAMES * width * 2);
+        dump_chan = alloc_touched(RETRO_BLOCK_FRAMES * sizeof(int32_t));
+        if (!store || !blocks || !pack_buf || !pack_frames || !pack_chan ||
+            !dump_bytes || !dump_frames || !dump_chan)
+            goto fail;
+
+        packer_running = 1;
+        if (pthread_create(&packer, NULL, packer_main, NULL) != 0) {
+            packer_running = 0;
+            goto fail;
+        }
+    }
+
+    LOG_INFO("[retro] %.1f min of %d ch at %d Hz%s, %d MB", config.minutes,
+             width, rate, config.pack ? " packed" : "",
+             (int)((memory_bytes + 1048575) / 1048576));
+    __atomic_store_n(&enabled, 1, __ATOMIC_RELEASE);
+    return 0;
+
+fail:
+    LOG_ERROR("[retro] cannot allocate the capture buffers");
+    retro_shutdown();
+    return -1;
+}
+
+void retro_shutdown(void) {
+    __atomic_store_n(&enabled, 0, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&dumping, __ATOMIC_ACQUIRE))
+        usleep(10000);
+    if (packer_running) {
+        __atomic_store_n(&packer_running, 0, __ATOMIC_RELEASE);
+        pthread_join(packer, NULL);
+    }
+
+    free(ring);
+    free(store);
+    free(blocks);
+    free(pack_buf);
+    free(pack_frames);
+    free(pack_chan);
+    free(dump_bytes);
+    free(dump_frames);
+    free(dump_chan);
+    ring = NULL;
+    store = NULL;
+    blocks = NULL;
+    pack_buf = NULL;
+    pack_frames = NULL;
+    pack_chan = NULL;
+    dump_bytes = NULL;
+    dump_frames = NULL;
+    dump_chan = NULL;
+    memory_bytes = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef RETRO_H
+#define RETRO_H
+
+#include <stdint.h>
+
+// Retroactive capture: the master bus, and optionally the outputs of named
+// modules (taps), go into a fixed preallocated ring at all times, so the last
+// few minutes can be written out after the fact. Configured with a `retro`
+// line in the patch and/or `--retro` on the command line (CLI wins). Keys,
+// separated by spaces or commas:
+//   minutes=N      history kept (default 5)
+//   channels=N     master bus channels (default 2)
+//   taps=a+b       module aliases to capture alongside the master
+//   pack[=0|1]     compress in the background instead of keeping 16-bit
+//   mb=N           packed store size (default half the 16-bit size)
+//   off            no capture, no memory
+//
+// 16-bit storage costs exactly (minutes + headroom) x rate x channels x 2
+// bytes. Packed storage keeps a few seconds of 16-bit staging that a
+// background thread encodes losslessly into a store of `mb`; it holds up to
+// `minutes` while the audio compresses, less when it does not. Either way the
+// memory is allocated and touched at startup and never grows.
+
+void retro_config_parse(const char *args);
+void retro_config_from_patch(const char *patch_text);
+
+// After the engine is built (taps are looked up by alias) and before the
+// stream starts
+int retro_init(float sample_rate);
+void retro_shutdown(void);
+
+// Audio thread, at the end of each block
+void retro_capture(const float *output, int channels, unsigned long frames);
+
+// Writes the last `seconds` (everything with <= 0) to
+// e_output_files/retro/ on a background thread; -1 when off or busy
+int retro_dump(float seconds);
+int retro_dumping(void);
+const char *retro_last_path(void);
+float retro_seconds(void); // history currently held
+uint64_t retro_memory_bytes(void);
+
+#endif
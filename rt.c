@@ -0,0 +1,330 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <alloca.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+#include "rt.h"
+#include "util.h"
+
+#define RT_MAX_CPUS 64
+#define RT_DEFAULT_STACK_KB 256
+
+static RtConfig config = {
+    .priority = 0,
+    .worker_priority = 0,
+    .audio_cpus = 0,
+    .worker_cpus = 0,
+    .aux_cpus = 0,
+    .mlock = false,
+    .stack_kb = RT_DEFAULT_STACK_KB,
+    .ftz = true,
+};
+
+// Outcome of each step, for rt_report()
+typedef struct {
+    int configured;
+    int priority; // achieved SCHED_FIFO priority, 0 = none
+    int sched_err;
+    int affinity; // 1 ok, 0 not requested, -1 failed/unsupported
+    int ftz;      // 1 on, 0 off, -1 unsupported
+} RtThreadResult;
+
+static RtThreadResult audio_result;
+static int mlock_result = 0; // 1 ok, 0 not requested, -errno on failure
+static int aux_result = 0;
+
+static uint64_t parse_cpu_list(const char *s) {
+    uint64_t mask = 0;
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10);
+        if (end == s)
+            break;
+        long b = a;
+        s = end;
+        if (*s == '-') {
+            b = strtol(s + 1, &end, 10);
+            s = end;
+        }
+        for (long c = a; c <= b; c++) {
+            if (c >= 0 && c < RT_MAX_CPUS)
+                mask |= (uint64_t)1 << c;
+        }
+        if (*s == '+')
+            s++;
+        else
+            break;
+    }
+    return mask;
+}
+
+static void format_cpu_list(uint64_t mask, char *buf, size_t len) {
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (int c = 0; c < RT_MAX_CPUS && pos < len; c++) {
+        if (!(mask & ((uint64_t)1 << c)))
+            continue;
+        int e = c;
+        while (e + 1 < RT_MAX_CPUS && (mask & ((uint64_t)1 << (e + 1))))
+            e++;
+        int n = (e > c) ? snprintf(buf + pos, len - pos, "%s%d-%d",
+                                   pos ? "+" : "", c, e)
+                        : snprintf(buf + pos, len - pos, "%s%d",
+                                   pos ? "+" : "", c);
+        if (n < 0)
+            break;
+        pos += (size_t)n;
+        c = e;
+    }
+    if (!mask)
+        snprintf(buf, len, "any");
+}
+
+static bool parse_bool(const char *val) {
+    return !val || !(strcmp(val, "0") == 0 || strcasecmp(val, "off") == 0 ||
+                     strcasecmp(val, "no") == 0);
+}
+
+void rt_config_parse(const char *args) {
+    if (!args)
+        return;
+
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", args);
+
+    for (char *tok = strtok(buf, " ,\t"); tok; tok = strtok(NULL, " ,\t")) {
+        char *val = strchr(tok, '=');
+        if (val)
+            *val++ = '\0';
+
+        if (strcmp(tok, "priority") == 0 && val) {
+            config.priority = atoi(val);
+        } else if (strcmp(tok, "worker_prio") == 0 && val) {
+            config.worker_priority = atoi(val);
+        } else if (strcmp(tok, "cpu") == 0 && val) {
+            config.audio_cpus = parse_cpu_list(val);
+        } else if (strcmp(tok, "worker_cpus") == 0 && val) {
+            config.worker_cpus = parse_cpu_list(val);
+        } else if (strcmp(tok, "aux_cpus") == 0 && val) {
+            config.aux_cpus = parse_cpu_list(val);
+        } else if (strcmp(tok, "mlock") == 0) {
+            config.mlock = parse_bool(val);
+        } else if (strcmp(tok, "stack_kb") == 0 && val) {
+            config.stack_kb = atoi(val);
+        } else if (strcmp(tok, "ftz") == 0) {
+            config.ftz = parse_bool(val);
+        } else {
+            fprintf(stderr, "[rt] Unknown setting: %s\n", tok);
+        }
+    }
+
+    if (config.priority < 0)
+        config.priority = 0;
+    if (config.priority > 99)
+        config.priority = 99;
+    if (config.worker_priority < 0 || config.worker_priority > 99)
+        config.worker_priority = 0;
+    if (config.stack_kb < 0)
+        config.stack_kb = 0;
+}
+
+void rt_config_from_patch(const char *patch_text) {
+    char *patch = strdup(patch_text);
+    char *save = NULL;
+
+    for (char *line = strtok_r(patch, "\r\n", &save); line;
+         line = strtok_r(NULL, "\r\n", &save)) {
+        char *clean_line = trim_whitespace(line);
+        if (strncmp(clean_line, "rt ", 3) == 0)
+            rt_config_parse(clean_line + 3);
+    }
+
+    free(patch);
+}
+
+const RtConfig *rt_get_config(void) { return &config; }
+
+static int enable_ftz(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_setcsr(_mm_getcsr() | 0x8040); // FTZ | DAZ
+    return 1;
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    fpcr |= (uint64_t)1 << 24; // FZ
+    __asm__ volatile("msr fpcr, %0" : : "r"(fpcr));
+    return 1;
+#elif defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+    uint32_t fpscr;
+    __asm__ volatile("vmrs %0, fpscr" : "=r"(fpscr));
+    fpscr |= (uint32_t)1 << 24; // FZ
+    __asm__ volatile("vmsr fpscr, %0" : : "r"(fpscr));
+    return 1;
+#else
+    return -1;
+#endif
+}
+
+static int set_affinity(uint64_t mask) {
+    if (!mask)
+        return 0;
+#ifdef __linux__
+    if (mask == ~(uint64_t)0) {
+        // Undo an inherited aux pinning: allow every online CPU
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        mask = (n >= RT_MAX_CPUS || n <= 0) ? ~(uint64_t)0
+                                            : (((uint64_t)1 << n) - 1);
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c = 0; c < RT_MAX_CPUS; c++) {
+        if (mask & ((uint64_t)1 << c))
+            CPU_SET(c, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0
+               ? 1
+               : -1;
+#else
+    return -1; // no hard affinity on macOS
+#endif
+}
+
+static int set_fifo(int priority, int *err) {
+    if (priority <= 0)
+        return 0;
+    struct sched_param sp = {.sched_priority = priority};
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (rc != 0) {
+        *err = rc;
+        return 0;
+    }
+    return priority;
+}
+
+// Touch the stack now so the first deep call on an RT thread doesn't fault
+static void prefault_stack(int kb) {
+    if (kb <= 0)
+        return;
+    size_t bytes = (size_t)kb * 1024;
+    volatile unsigned char *probe = alloca(bytes);
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0)
+        page = 4096;
+    for (size_t i = 0; i < bytes; i += (size_t)page)
+        probe[i] = 0;
+}
+
+void rt_init(void) {
+    if (config.mlock) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            mlock_result = 1;
+            prefault_stack(config.stack_kb);
+        } else {
+            mlock_result = -errno;
+        }
+    }
+    aux_result = set_affinity(config.aux_cpus);
+}
+
+// DSP threads are spawned (directly or by PortAudio) from a thread already
+// moved onto the aux cores, so with no explicit mask they are widened again.
+static uint64_t dsp_mask(uint64_t mask) {
+    if (mask)
+        return mask;
+    return config.aux_cpus ? ~(uint64_t)0 : 0;
+}
+
+void rt_thread_setup(RtThreadRole role) {
+    RtThreadResult r = {0};
+
+    switch (role) {
+    case RT_THREAD_AUDIO:
+        r.priority = set_fifo(config.priority, &r.sched_err);
+        r.affinity = set_affinity(dsp_mask(config.audio_cpus));
+        break;
+    case RT_THREAD_WORKER: {
+        int prio = config.worker_priority;
+        if (prio == 0 && config.priority > 1)
+            prio = config.priority - 1;
+        r.priority = set_fifo(prio, &r.sched_err);
+        r.affinity = set_affinity(dsp_mask(
+            config.worker_cpus ? config.worker_cpus : config.audio_cpus));
+        break;
+    }
+    case RT_THREAD_AUX:
+        r.affinity = set_affinity(config.aux_cpus);
+        return;
+    }
+
+    r.ftz = config.ftz ? enable_ftz() : 0;
+    if (config.mlock && mlock_result == 1)
+        prefault_stack(config.stack_kb / 4);
+
+    if (role == RT_THREAD_AUDIO) {
+        audio_result = r;
+        __atomic_store_n(&audio_result.configured, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static const char *affinity_str(int result, uint64_t mask, char *buf,
+                                size_t len) {
+    if (result == 0)
+        return "unpinned";
+    if (result < 0)
+        return "failed";
+    format_cpu_list(mask, buf, len);
+    return buf;
+}
+
+void rt_report(void) {
+    for (int i = 0; i < 100; i++) {
+        if (__atomic_load_n(&audio_result.configured, __ATOMIC_ACQUIRE))
+            break;
+        usleep(10000);
+    }
+
+    char cpus[128];
+    RtThreadResult a = audio_result;
+
+    if (!a.configured) {
+        fprintf(stderr, "[rt] audio thread not started yet\n");
+    } else {
+        if (config.priority > 0 && a.priority == 0)
+            fprintf(stderr, "[rt] audio  : SCHED_FIFO %d denied (%s)\n",
+                    config.priority, strerror(a.sched_err));
+        else if (a.priority > 0)
+            fprintf(stderr, "[rt] audio  : SCHED_FIFO %d\n", a.priority);
+        else
+            fprintf(stderr, "[rt] audio  : default scheduling\n");
+        fprintf(stderr, "[rt] audio  : cpu %s | ftz/daz %s\n",
+                affinity_str(a.affinity, config.audio_cpus, cpus,
+                             sizeof(cpus)),
+                a.ftz > 0 ? "on" : (a.ftz < 0 ? "unsupported" : "off"));
+    }
+
+    fprintf(stderr, "[rt] aux    : cpu %s\n",
+            affinity_str(aux_result, config.aux_cpus, cpus, sizeof(cpus)));
+
+    if (mlock_result == 1)
+        fprintf(stderr, "[rt] memory : locked, %d KB stack prefault\n",
+                config.stack_kb);
+    else if (mlock_result < 0)
+        fprintf(stderr, "[rt] memory : mlockall failed (%s)\n",
+                strerror(-mlock_result));
+    else
+        fprintf(stderr, "[rt] memory : not locked\n");
+}
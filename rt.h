@@ -0,0 +1,47 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Real-time configuration, from an `rt` line in the patch and/or `--rt` on
+// the command line (CLI wins). Keys, separated by spaces or commas:
+//   priority=N      SCHED_FIFO priority of the audio thread (0 = untouched)
+//   worker_prio=N   SCHED_FIFO priority of DSP worker threads
+//   cpu=LIST        audio thread affinity, e.g. 3 or 2-3
+//   worker_cpus=LIST
+//   aux_cpus=LIST   UI, OSC and MIDI threads
+//   mlock[=0|1]     mlockall(MCL_CURRENT|MCL_FUTURE) and prefault stacks
+//   stack_kb=N      stack prefault size
+//   ftz[=0|1]       flush denormals to zero on DSP threads (default on)
+
+typedef enum { RT_THREAD_AUDIO, RT_THREAD_WORKER, RT_THREAD_AUX } RtThreadRole;
+
+typedef struct {
+    int priority;
+    int worker_priority;
+    uint64_t audio_cpus; // affinity masks, 0 = unpinned
+    uint64_t worker_cpus;
+    uint64_t aux_cpus;
+    bool mlock;
+    int stack_kb;
+    bool ftz;
+} RtConfig;
+
+void rt_config_parse(const char *args);
+void rt_config_from_patch(const char *patch_text);
+const RtConfig *rt_get_config(void);
+
+// Process-wide setup, called from the main thread before any other thread is
+// spawned: memory locking plus moving main onto the aux cores so the UI,
+// OSC and MIDI threads inherit that affinity.
+void rt_init(void);
+
+// Per-thread setup; DSP threads call it once from the thread itself
+void rt_thread_setup(RtThreadRole role);
+
+// Print the effective settings; waits briefly for the audio thread to
+// configure itself on its first callback
+void rt_report(void);
+
+#endif
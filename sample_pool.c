@@ -0,0 +1,306 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sndfile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dsp.h"
+#include "logger.h"
+#include "sample_pool.h"
+
+#define CACHE_DIR "e_output_files/sample_cache"
+#define CACHE_MAGIC 0x31435053u // "SPC1"
+#define CACHE_HEADER_BYTES 64   // keeps the floats 16-byte aligned in the map
+#define DECODE_CHUNK_FRAMES 4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t layout;
+    uint64_t frames;
+    int32_t channels;
+    int32_t samplerate;
+    int64_t src_size;
+    int64_t src_mtime_sec;
+    int64_t src_mtime_nsec;
+} CacheHeader;
+
+typedef struct PoolEntry {
+    Sample sample; // first, so a Sample * is its entry
+    char path[PATH_MAX];
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    SampleLayout layout;
+    int refs;
+    // Set under pool_lock once the loader has finished; until then the
+    // entry is a placeholder that others with the same file wait on
+    bool ready;
+    bool failed;
+
+    void *map; // cache file mapping, or NULL when `owned` holds the data
+    size_t map_len;
+    float *owned;
+
+    struct PoolEntry *next;
+} PoolEntry;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_loaded = PTHREAD_COND_INITIALIZER;
+static PoolEntry *pool = NULL;
+
+static int64_t stat_mtime_nsec(const struct stat *st) {
+#ifdef __APPLE__
+    return st->st_mtimespec.tv_nsec;
+#else
+    return st->st_mtim.tv_nsec;
+#endif
+}
+
+static void cache_path(const PoolEntry *e, char *out, size_t len) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (const char *p = e->path; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ull;
+    }
+    snprintf(out, len, CACHE_DIR "/%016llx_%c.f32", (unsigned long long)h,
+             e->layout == SAMPLE_MONO ? 'm' : 'i');
+}
+
+// Maps a cache file written for this exact source, or returns false
+static bool cache_map(PoolEntry *e, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    CacheHeader h;
+    bool ok = fstat(fd, &st) == 0 &&
+              read(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+              h.magic == CACHE_MAGIC && h.layout == (uint32_t)e->layout &&
+              h.src_size == e->size && h.src_mtime_sec == e->mtime_sec &&
+              h.src_mtime_nsec == e->mtime_nsec && h.channels > 0 &&
+              (uint64_t)st.st_size ==
+                  CACHE_HEADER_BYTES +
+                      h.frames * (uint64_t)h.channels * sizeof(float);
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    e->map = map;
+    e->map_len = (size_t)st.st_size;
+    e->sample.data = (const float *)((const char *)map + CACHE_HEADER_BYTES);
+    e->sample.frames = h.frames;
+    e->sample.channels = h.channels;
+    e->sample.samplerate = h.samplerate;
+    return true;
+}
+
+// Decodes into memory, or with `sink` straight into an open cache file so
+// long files never need a second full-size buffer
+static bool decode(PoolEntry *e, FILE *sink) {
+    SF_INFO info = {0};
+    SNDFILE *f = sf_open(e->path, SFM_READ, &info);
+    if (!f)
+        return false;
+
+    int in_ch = info.channels;
+    int out_ch = (e->layout == SAMPLE_MONO) ? 1 : in_ch;
+    uint64_t frames = info.frames > 0 ? (uint64_t)info.frames : 0;
+
+    float *data = NULL;
+    if (!sink)
+        data = calloc(frames ? frames * out_ch : 1, sizeof(float));
+    float *chunk = malloc((size_t)DECODE_CHUNK_FRAMES * in_ch * sizeof(float));
+    float *mono = malloc((size_t)DECODE_CHUNK_FRAMES * sizeof(float));
+    if ((!sink && !data) || !chunk || !mono) {
+        free(data);
+        free(chunk);
+        free(mono);
+        sf_close(f);
+        return false;
+    }
+
+    uint64_t pos = 0;
+    bool ok = true;
+    while (pos < frames) {
+        sf_count_t got = sf_readf_float(f, chunk, DECODE_CHUNK_FRAMES);
+        if (got <= 0)
+            break;
+        if ((uint64_t)got > frames - pos)
+            got = (sf_count_t)(frames - pos);
+
+        const float *src = chunk;
+        if (out_ch != in_ch) {
+            // average for mono
+            dsp_downmix(mono, chunk, in_ch, 1.0f / (float)in_ch,
+                        (unsigned long)got);
+            src = mono;
+        }
+
+        size_t n = (size_t)got * out_ch;
+        if (sink) {
+            if (fwrite(src, sizeof(float), n, sink) != n) {
+                ok = false;
+                break;
+            }
+        } else {
+            memcpy(data + pos * out_ch, src, n * sizeof(float));
+        }
+        pos += (uint64_t)got;
+    }
+    free(chunk);
+    free(mono);
+    sf_close(f);
+
+    e->owned = data;
+    e->sample.data = data;
+    e->sample.frames = sink ? pos : frames;
+    e->sample.channels = out_ch;
+    e->sample.samplerate = info.samplerate;
+    return ok;
+}
+
+// Decoded under a temporary name and renamed, so readers never see a
+// partial file; the header goes in last, once the length is known
+static bool cache_build(PoolEntry *e, const char *path) {
+    mkdir("e_output_files", 0755);
+    mkdir(CACHE_DIR, 0755);
+
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        LOG_WARN("[sample_pool] cannot write cache '%s'", tmp);
+        return false;
+    }
+
+    unsigned char header[CACHE_HEADER_BYTES] = {0};
+    bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header) &&
+              decode(e, f);
+    if (ok) {
+        CacheHeader h = {CACHE_MAGIC,          (uint32_t)e->layout,
+                         e->sample.frames,     e->sample.channels,
+                         e->sample.samplerate, e->size,
+                         e->mtime_sec,         e->mtime_nsec};
+        memcpy(header, &h, sizeof(h));
+        ok = fseek(f, 0, SEEK_SET) == 0 &&
+             fwrite(header, 1, sizeof(header), f) == sizeof(header);
+    }
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmp, path) != 0) {
+        LOG_WARN("[sample_pool] cache write failed for '%s'", path);
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+const Sample *sample_pool_acquire(const char *path, SampleLayout layout,
+                                  bool disk_cache) {
+    char resolved[PATH_MAX];
+    struct stat st;
+    if (!realpath(path, resolved) || stat(resolved, &st) != 0)
+        return NULL;
+
+    pthread_mutex_lock(&pool_lock);
+
+    for (PoolEntry *e = pool; e; e = e->next) {
+        if (e->layout == layout && e->size == (int64_t)st.st_size &&
+            e->mtime_sec == (int64_t)st.st_mtime &&
+            e->mtime_nsec == stat_mtime_nsec(&st) &&
+            !strcmp(e->path, resolved)) {
+            // Another module is loading this file: wait for its result
+            e->refs++;
+            while (!e->ready && !e->failed)
+                pthread_cond_wait(&pool_loaded, &pool_lock);
+            const Sample *sample = e->failed ? NULL : &e->sample;
+            if (e->failed && --e->refs == 0)
+                free(e);
+            pthread_mutex_unlock(&pool_lock);
+            return sample;
+        }
+    }
+
+    // A placeholder goes in first so the decode can run without the lock:
+    // loads of other files carry on, loads of this one wait for it
+    PoolEntry *e = calloc(1, sizeof(PoolEntry));
+    if (!e) {
+        pthread_mutex_unlock(&pool_lock);
+        return NULL;
+    }
+    snprintf(e->path, sizeof(e->path), "%s", resolved);
+    e->size = (int64_t)st.st_size;
+    e->mtime_sec = (int64_t)st.st_mtime;
+    e->mtime_nsec = stat_mtime_nsec(&st);
+    e->layout = layout;
+    e->refs = 1;
+    e->next = pool;
+    pool = e;
+    pthread_mutex_unlock(&pool_lock);
+
+    char cpath[PATH_MAX];
+    cache_path(e, cpath, sizeof(cpath));
+
+    bool mapped = false;
+    if (disk_cache) {
+        mapped = cache_map(e, cpath) ||
+                 (cache_build(e, cpath) && cache_map(e, cpath));
+    }
+    bool ok = mapped || decode(e, NULL);
+
+    pthread_mutex_lock(&pool_lock);
+    if (ok) {
+        e->ready = true;
+    } else {
+        // Unlisted now; whoever drops the last reference frees it
+        for (PoolEntry **pp = &pool; *pp; pp = &(*pp)->next) {
+            if (*pp == e) {
+                *pp = e->next;
+                break;
+            }
+        }
+        free(e->owned);
+        e->owned = NULL;
+        e->failed = true;
+    }
+    pthread_cond_broadcast(&pool_loaded);
+    bool last = !ok && --e->refs == 0;
+    pthread_mutex_unlock(&pool_lock);
+
+    if (last)
+        free(e);
+    return ok ? &e->sample : NULL;
+}
+
+void sample_pool_release(const Sample *sample) {
+    if (!sample)
+        return;
+
+    pthread_mutex_lock(&pool_lock);
+    for (PoolEntry **pp = &pool; *pp; pp = &(*pp)->next) {
+        PoolEntry *e = *pp;
+        if (&e->sample != sample)
+            continue;
+        if (--e->refs == 0) {
+            *pp = e->next;
+            if (e->map)
+                munmap(e->map, e->map_len);
+            free(e->owned);
+            free(e);
+        }
+        break;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
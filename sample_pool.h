@@ -0,0 +1,35 @@
+#ifndef SAMPLE_POOL_H
+#define SAMPLE_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Process-wide cache of decoded sample files. Modules that load the same
+// file share one read-only float buffer, keyed by resolved path, mtime,
+// size and channel layout, and freed with its last reference. With
+// `disk_cache` the decoded floats are also kept in
+// e_output_files/sample_cache/ and mapped straight back in on later loads,
+// so reloading a patch skips decoding.
+//
+// Acquire and release take a mutex and may decode: call them from create
+// and destroy, never from process(). The decode runs outside the mutex, so
+// loads of different files overlap; a second acquire of a file still
+// loading waits for it.
+
+typedef enum {
+    SAMPLE_MONO,       // channels averaged to one
+    SAMPLE_INTERLEAVED // file's own channel count
+} SampleLayout;
+
+typedef struct {
+    const float *data; // frames * channels, read-only
+    uint64_t frames;
+    int channels;
+    int samplerate;
+} Sample;
+
+const Sample *sample_pool_acquire(const char *path, SampleLayout layout,
+                                  bool disk_cache);
+void sample_pool_release(const Sample *sample);
+
+#endif
@@ -0,0 +1,404 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "rt.h"
+#include "stft.h"
+#include "util.h"
+
+#define STFT_MIN_SIZE 64
+#define STFT_MAX_SIZE 65536
+#define STFT_BIN_CHUNKS 4 // spread: bin work pieces per frame
+#define STFT_IDLE_WAIT_MS 5
+
+struct Stft {
+    StftConfig cfg;
+    int bins;
+    StftBinsFn fn;
+    void *user;
+
+    float *window_a;
+    float *window_s; // NULL for analysis-only windows
+    float gain;      // 1/N and the overlap-add sum
+
+    // Input history, a ring of `size` per input
+    float *history[STFT_MAX_INPUTS];
+    int in_pos;
+    int hop_pos; // samples since the last frame was taken
+
+    // Output accumulator, a ring of `size` read (and cleared) at ola_pos
+    float *ola;
+    int ola_pos;
+
+    // The frame in flight
+    float *time[STFT_MAX_INPUTS];
+    fftwf_complex *spec[STFT_MAX_INPUTS];
+    fftwf_complex *out_spec;
+    float *out_time;
+    fftwf_plan fwd[STFT_MAX_INPUTS];
+    fftwf_plan inv;
+    bool pending;
+    int pieces; // spread: inputs + bin chunks + inverse
+    int piece;
+
+    int params_bytes;
+    void *params;       // written by the module
+    void *frame_params; // copy taken with the frame
+
+    // Thread mode
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool thread_started;
+    int posted;
+    int done;
+    int stop;
+    uint32_t late;
+};
+
+static int is_pow2(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+void stft_config_from_args(StftConfig *cfg, const char *args) {
+    if (!args)
+        return;
+    if (strstr(args, "fft="))
+        sscanf(strstr(args, "fft="), "fft=%d", &cfg->size);
+    if (strstr(args, "hop="))
+        sscanf(strstr(args, "hop="), "hop=%d", &cfg->hop);
+    if (strstr(args, "stft=")) {
+        char mode[16] = {0};
+        sscanf(strstr(args, "stft="), "stft=%15[a-z]", mode);
+        if (strcmp(mode, "auto") == 0)
+            cfg->mode = STFT_AUTO;
+        else if (strcmp(mode, "spread") == 0)
+            cfg->mode = STFT_SPREAD;
+        else if (strcmp(mode, "thread") == 0)
+            cfg->mode = STFT_THREAD;
+        else if (strcmp(mode, "sync") == 0)
+            cfg->mode = STFT_SYNC;
+        else
+            LOG_WARN("[stft] Unknown mode '%s'", mode);
+    }
+}
+
+const char *stft_mode_name(StftMode mode) {
+    switch (mode) {
+    case STFT_AUTO:
+        return "auto";
+    case STFT_THREAD:
+        return "thread";
+    case STFT_SYNC:
+        return "sync";
+    default:
+        return "spread";
+    }
+}
+
+// --- Frame work ---
+
+static void run_piece(Stft *st, int p) {
+    int inputs = st->cfg.inputs;
+    if (p < inputs) {
+        fftwf_execute(st->fwd[p]);
+    } else if (p < inputs + STFT_BIN_CHUNKS) {
+        int c = p - inputs;
+        int k0 = st->bins * c / STFT_BIN_CHUNKS;
+        int k1 = st->bins * (c + 1) / STFT_BIN_CHUNKS;
+        st->fn(st->user, st->frame_params, st->spec, st->out_spec, k0, k1);
+    } else {
+        fftwf_execute(st->inv);
+        int n = st->cfg.size;
+        float g = st->gain;
+        if (st->window_s) {
+            for (int i = 0; i < n; i++)
+                st->out_time[i] *= g * st->window_s[i];
+        } else {
+            for (int i = 0; i < n; i++)
+                st->out_time[i] *= g;
+        }
+    }
+}
+
+static void run_frame(Stft *st) {
+    for (int p = 0; p < st->pieces; p++)
+        run_piece(st, p);
+}
+
+// Windows the last `size` samples of each input into the frame buffers
+static void take_frame(Stft *st) {
+    int n = st->cfg.size;
+    int head = n - st->in_pos; // oldest sample sits at in_pos
+    for (int c = 0; c < st->cfg.inputs; c++) {
+        const float *h = st->history[c];
+        float *t = st->time[c];
+        for (int i = 0; i < head; i++)
+            t[i] = h[st->in_pos + i] * st->window_a[i];
+        for (int i = head; i < n; i++)
+            t[i] = h[i - head] * st->window_a[i];
+    }
+    memcpy(st->frame_params, st->params, st->params_bytes);
+}
+
+// Adds the finished frame at the read head
+static void overlap_add(Stft *st) {
+    int n = st->cfg.size;
+    int head = n - st->ola_pos;
+    float *o = st->ola;
+    for (int i = 0; i < head; i++)
+        o[st->ola_pos + i] += st->out_time[i];
+    for (int i = head; i < n; i++)
+        o[i - head] += st->out_time[i];
+}
+
+static void *helper_main(void *arg) {
+    Stft *st = arg;
+    rt_thread_setup(RT_THREAD_WORKER);
+
+    for (;;) {
+        pthread_mutex_lock(&st->lock);
+        while (!__atomic_load_n(&st->stop, __ATOMIC_ACQUIRE) &&
+               __atomic_load_n(&st->posted, __ATOMIC_ACQUIRE) == st->done) {
+            // The audio thread only signals when it gets the lock without
+            // waiting, so a missed wakeup costs at most this long
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += STFT_IDLE_WAIT_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&st->cond, &st->lock, &until);
+        }
+        pthread_mutex_unlock(&st->lock);
+        if (__atomic_load_n(&st->stop, __ATOMIC_ACQUIRE))
+            break;
+
+        int posted = __atomic_load_n(&st->posted, __ATOMIC_ACQUIRE);
+        run_frame(st);
+        __atomic_store_n(&st->done, posted, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void post_frame(Stft *st) {
+    __atomic_store_n(&st->posted, st->posted + 1, __ATOMIC_RELEASE);
+    if (pthread_mutex_trylock(&st->lock) == 0) {
+        pthread_cond_signal(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+    }
+}
+
+// Every `hop` samples: the frame taken a hop ago is finished and added,
+// and the next one is taken
+static void frame_boundary(Stft *st) {
+    if (st->cfg.mode == STFT_SYNC) {
+        take_frame(st);
+        run_frame(st);
+        overlap_add(st);
+        return;
+    }
+
+    if (st->cfg.mode == STFT_THREAD &&
+        __atomic_load_n(&st->done, __ATOMIC_ACQUIRE) != st->posted) {
+        // Helper still busy: drop its frame rather than wait for it or add
+        // it a hop late, and take no new one while it holds the buffers
+        if (st->pending)
+            __atomic_fetch_add(&st->late, 1, __ATOMIC_RELAXED);
+        st->pending = false;
+        return;
+    }
+
+    if (st->pending) {
+        if (st->cfg.mode == STFT_SPREAD) {
+            while (st->piece < st->pieces)
+                run_piece(st, st->piece++);
+        }
+        overlap_add(st);
+    }
+
+    take_frame(st);
+    st->pending = true;
+    if (st->cfg.mode == STFT_SPREAD)
+        st->piece = 0;
+    else
+        post_frame(st);
+}
+
+void stft_process(Stft *st, const float *const *in, float *out,
+                  unsigned long frames) {
+    const int n = st->cfg.size;
+    const int hop = st->cfg.hop;
+
+    for (unsigned long i = 0; i < frames;) {
+        int run = hop - st->hop_pos;
+        if ((unsigned long)run > frames - i)
+            run = (int)(frames - i);
+
+        for (int c = 0; c < st->cfg.inputs; c++) {
+            float *h = st->history[c];
+            int pos = st->in_pos;
+            for (int k = 0; k < run; k++) {
+                h[pos] = in[c] ? in[c][i + k] : 0.0f;
+                if (++pos == n)
+                    pos = 0;
+            }
+        }
+        st->in_pos = (st->in_pos + run) & (n - 1);
+
+        for (int k = 0; k < run; k++) {
+            out[i + k] = st->ola[st->ola_pos];
+            st->ola[st->ola_pos] = 0.0f;
+            st->ola_pos = (st->ola_pos + 1) & (n - 1);
+        }
+
+        i += run;
+        st->hop_pos += run;
+        if (st->hop_pos == hop) {
+            st->hop_pos = 0;
+            frame_boundary(st);
+        }
+    }
+
+    // Spread: keep pace so the frame is done by the next boundary
+    if (st->cfg.mode == STFT_SPREAD && st->pending) {
+        int due = (st->pieces * st->hop_pos + hop - 1) / hop;
+        while (st->piece < due)
+            run_piece(st, st->piece++);
+    }
+}
+
+void *stft_params(Stft *st) { return st->params; }
+
+int stft_bins(const Stft *st) { return st->bins; }
+
+int stft_hop(const Stft *st) { return st->cfg.hop; }
+
+int stft_latency(const Stft *st) {
+    return st->cfg.size + (st->cfg.mode == STFT_SYNC ? 0 : st->cfg.hop);
+}
+
+uint32_t stft_late(const Stft *st) {
+    return __atomic_load_n(&st->late, __ATOMIC_RELAXED);
+}
+
+// --- Setup ---
+
+Stft *stft_create(const StftConfig *cfg, StftBinsFn fn, void *user,
+                  int params_bytes) {
+    StftConfig c = *cfg;
+    if (!is_pow2(c.size) || c.size < STFT_MIN_SIZE || c.size > STFT_MAX_SIZE) {
+        LOG_WARN("[stft] fft=%d is not a power of two in 64-65536, using 2048",
+                 c.size);
+        c.size = 2048;
+    }
+    if (!is_pow2(c.hop) || c.hop > c.size / 2) {
+        LOG_WARN("[stft] hop=%d must be a power of two up to fft/2, using %d",
+                 c.hop, c.size / 2);
+        c.hop = c.size / 2;
+    }
+    if (c.inputs < 1 || c.inputs > STFT_MAX_INPUTS)
+        c.inputs = 1;
+    if (c.mode == STFT_AUTO) {
+        bool helper = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+        c.mode = helper && c.hop >= MAX_BLOCK_SIZE ? STFT_THREAD : STFT_SPREAD;
+    } else if (c.mode == STFT_THREAD && c.hop < MAX_BLOCK_SIZE) {
+        // A block could then take two frames while the helper has one
+        LOG_WARN("[stft] thread mode needs hop >= %d, spreading instead",
+                 MAX_BLOCK_SIZE);
+        c.mode = STFT_SPREAD;
+    }
+
+    Stft *st = calloc(1, sizeof(Stft));
+    if (!st)
+        return NULL;
+    st->cfg = c;
+    st->bins = c.size / 2 + 1;
+    st->fn = fn;
+    st->user = user;
+    st->pieces = c.inputs + STFT_BIN_CHUNKS + 1;
+    st->params_bytes = params_bytes;
+    st->params = calloc(1, params_bytes > 0 ? params_bytes : 1);
+    st->frame_params = calloc(1, params_bytes > 0 ? params_bytes : 1);
+
+    int n = c.size;
+    st->window_a = malloc(n * sizeof(float));
+    if (c.window == STFT_WINDOW_SQRT_HANN)
+        st->window_s = malloc(n * sizeof(float));
+    st->ola = calloc(n, sizeof(float));
+    st->out_time = fftwf_alloc_real(n);
+    st->out_spec = fftwf_alloc_complex(st->bins);
+    for (int i = 0; i < c.inputs; i++) {
+        st->history[i] = calloc(n, sizeof(float));
+        st->time[i] = fftwf_alloc_real(n);
+        st->spec[i] = fftwf_alloc_complex(st->bins);
+    }
+
+    // Periodic Hann, which overlap-adds to a constant at these hops
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        float w = 0.5f * (1.0f - cosf(2.0f * (float)M_PI * i / n));
+        if (st->window_s) {
+            st->window_a[i] = st->window_s[i] = sqrtf(w);
+            sum += w;
+        } else {
+            st->window_a[i] = w;
+            sum += w;
+        }
+    }
+    st->gain = (float)((double)c.hop / (sum * n));
+
+    for (int i = 0; i < c.inputs; i++)
+        st->fwd[i] = fftwf_plan_dft_r2c_1d(n, st->time[i], st->spec[i],
+                                           FFTW_ESTIMATE);
+    st->inv =
+        fftwf_plan_dft_c2r_1d(n, st->out_spec, st->out_time, FFTW_ESTIMATE);
+    memset(st->out_spec, 0, st->bins * sizeof(fftwf_complex));
+
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->cond, NULL);
+    if (c.mode == STFT_THREAD) {
+        st->thread_started =
+            pthread_create(&st->thread, NULL, helper_main, st) == 0;
+        if (!st->thread_started) {
+            LOG_WARN("[stft] no helper thread, spreading instead");
+            st->cfg.mode = STFT_SPREAD;
+        }
+    }
+    return st;
+}
+
+void stft_destroy(Stft *st) {
+    if (!st)
+        return;
+    if (st->thread_started) {
+        __atomic_store_n(&st->stop, 1, __ATOMIC_RELEASE);
+        pthread_mutex_lock(&st->lock);
+        pthread_cond_signal(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        pthread_join(st->thread, NULL);
+    }
+    pthread_mutex_destroy(&st->lock);
+    pthread_cond_destroy(&st->cond);
+
+    for (int i = 0; i < st->cfg.inputs; i++) {
+        fftwf_destroy_plan(st->fwd[i]);
+        free(st->history[i]);
+        fftwf_free(st->time[i]);
+        fftwf_free(st->spec[i]);
+    }
+    fftwf_destroy_plan(st->inv);
+    fftwf_free(st->out_time);
+    fftwf_free(st->out_spec);
+    free(st->ola);
+    free(st->window_a);
+    free(st->window_s);
+    free(st->params);
+    free(st->frame_params);
+    free(st);
+}
@@ -0,0 +1,76 @@
+#ifndef STFT_H
+#define STFT_H
+
+#include <fftw3.h>
+#include <stdint.h>
+
+// Short-time Fourier transform with overlap-add resynthesis, shared by the
+// spectral modules. The module feeds blocks of one or more input signals
+// and supplies the per-bin work; the engine windows, transforms and
+// overlap-adds, and decides when that work runs:
+//
+//   STFT_AUTO    thread when another core can run the helper and the hop
+//                is at least a block, spread otherwise
+//   STFT_SPREAD  each frame's transforms and bin work are cut into pieces
+//                spread over the callbacks of the following hop
+//   STFT_THREAD  each frame goes to a helper thread, collected a hop later
+//   STFT_SYNC    the whole frame runs in the callback that completes it
+//
+// Spread and thread add one hop of latency (size + hop in total). Thread
+// keeps the cost per callback flat; spread evens it out only down to one
+// whole transform, which some callbacks of each hop still pay. Sync has a
+// latency of size but pays a whole frame in one callback per hop.
+
+#define STFT_MAX_INPUTS 2
+
+typedef enum { STFT_AUTO, STFT_SPREAD, STFT_THREAD, STFT_SYNC } StftMode;
+
+typedef enum {
+    STFT_WINDOW_HANN,      // Hann analysis, no synthesis window
+    STFT_WINDOW_SQRT_HANN, // sqrt-Hann analysis and synthesis
+} StftWindow;
+
+typedef struct {
+    int size; // power of two
+    int hop;  // power of two, at most size / 2; thread mode: >= a block
+    int inputs;
+    StftWindow window;
+    StftMode mode;
+} StftConfig;
+
+// Bins [k0, k1) of one frame: in[i] is the spectrum of input i, out the
+// spectrum to resynthesise. `params` is the module's parameter block as it
+// was when the frame was taken (see stft_params()). May run on the helper
+// thread. A frame's pieces run in bin order after all its inputs are
+// transformed, so every in[] is whole and the k0 == 0 call comes first.
+typedef void (*StftBinsFn)(void *user, const void *params,
+                           fftwf_complex *const *in, fftwf_complex *out,
+                           int k0, int k1);
+
+typedef struct Stft Stft;
+
+// fft=, hop= and stft=auto|spread|thread|sync from module args
+void stft_config_from_args(StftConfig *cfg, const char *args);
+
+Stft *stft_create(const StftConfig *cfg, StftBinsFn fn, void *user,
+                  int params_bytes);
+void stft_destroy(Stft *st);
+
+// Audio thread: the module fills this each block; it is copied for each
+// frame as the frame is taken, so the bin work sees a consistent snapshot
+void *stft_params(Stft *st);
+
+// Audio thread: `frames` samples of each input (NULL reads silence) in,
+// `frames` samples out
+void stft_process(Stft *st, const float *const *in, float *out,
+                  unsigned long frames);
+
+int stft_bins(const Stft *st);
+int stft_hop(const Stft *st);
+int stft_latency(const Stft *st);
+// Thread mode: frames dropped because the helper had not finished them by
+// the time they were due
+uint32_t stft_late(const Stft *st);
+const char *stft_mode_name(StftMode mode);
+
+#endif
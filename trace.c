@@ -0,0 +1,286 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define DIAG_DIR "e_output_files/diagnostics"
+#define TRACE_MAX_THREADS 32
+#define TRACE_RING_SIZE 16384 // events per thread, power of two
+#define TRACE_FLUSH_MS 20
+
+typedef struct {
+    const char *cat;
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} TraceEvent;
+
+// A ring goes back to the pool once its thread has exited and the flusher
+// has emptied it
+enum { RING_FREE, RING_CLAIMING, RING_OWNED, RING_RETIRED };
+
+// Single producer (the owning thread), single consumer (the flusher)
+typedef struct {
+    TraceEvent *events;
+    uint32_t write;
+    uint32_t read;
+    uint32_t dropped;
+    int state;
+    int tid; // fresh per owner, so a reused ring gets its own track
+    char thread_name[32];
+    int announced; // tid last announced in the current file
+} TraceRing;
+
+int trace_active = 0;
+
+static TraceRing rings[TRACE_MAX_THREADS];
+static int next_tid = 0;
+static int rings_allocated = 0;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static __thread TraceRing *tls_ring = NULL;
+static __thread const char *tls_name = NULL;
+
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t flusher;
+static int flusher_running = 0;
+static FILE *trace_file = NULL;
+static uint64_t trace_origin_ns = 0;
+static int first_event_written = 0;
+static char last_path[256] = "";
+static uint32_t last_dropped = 0;
+
+void trace_set_thread_name(const char *name) {
+    tls_name = name;
+    if (tls_ring)
+        snprintf(tls_ring->thread_name, sizeof(tls_ring->thread_name), "%s",
+                 name);
+}
+
+// Runs as the owning thread exits; the flusher frees the ring once drained
+static void release_ring(void *ring) {
+    __atomic_store_n(&((TraceRing *)ring)->state, RING_RETIRED,
+                     __ATOMIC_RELEASE);
+}
+
+static void make_ring_key(void) { pthread_key_create(&ring_key, release_ring); }
+
+// First event from a thread claims a free ring from the preallocated pool
+static TraceRing *claim_ring(void) {
+    if (!__atomic_load_n(&rings_allocated, __ATOMIC_ACQUIRE))
+        return NULL;
+    pthread_once(&ring_key_once, make_ring_key);
+
+    for (int idx = 0; idx < TRACE_MAX_THREADS; idx++) {
+        TraceRing *r = &rings[idx];
+        int expected = RING_FREE;
+        if (!__atomic_compare_exchange_n(&r->state, &expected, RING_CLAIMING, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        r->tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+        if (tls_name)
+            snprintf(r->thread_name, sizeof(r->thread_name), "%s", tls_name);
+        else
+            snprintf(r->thread_name, sizeof(r->thread_name), "thread %d",
+                     r->tid);
+        __atomic_store_n(&r->state, RING_OWNED, __ATOMIC_RELEASE);
+        pthread_setspecific(ring_key, r);
+        return r;
+    }
+    return NULL;
+}
+
+void trace_complete(const char *cat, const char *name, uint64_t start_ns,
+                    uint64_t end_ns) {
+    if (!trace_on())
+        return;
+
+    TraceRing *r = tls_ring;
+    if (!r) {
+        r = tls_ring = claim_ring();
+        if (!r)
+            return;
+    }
+
+    uint32_t w = r->write;
+    uint32_t rd = __atomic_load_n(&r->read, __ATOMIC_ACQUIRE);
+    if (w - rd >= TRACE_RING_SIZE) {
+        r->dropped++;
+        return;
+    }
+
+    TraceEvent *e = &r->events[w & (TRACE_RING_SIZE - 1)];
+    e->cat = cat;
+    e->name = name ? name : "?";
+    e->start_ns = start_ns;
+    e->end_ns = end_ns;
+    __atomic_store_n(&r->write, w + 1, __ATOMIC_RELEASE);
+}
+
+void trace_mutex_lock(pthread_mutex_t *mutex, const char *name) {
+    if (!trace_on() || pthread_mutex_trylock(mutex) != 0) {
+        uint64_t t0 = trace_on() ? perf_now_ns() : 0;
+        pthread_mutex_lock(mutex);
+        if (t0)
+            trace_complete("lock", name, t0, perf_now_ns());
+    }
+}
+
+static void write_escaped(FILE *f, const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        if ((unsigned char)*s >= 0x20)
+            fputc(*s, f);
+    }
+}
+
+static void drain(void) {
+    for (int t = 0; t < TRACE_MAX_THREADS; t++) {
+        TraceRing *r = &rings[t];
+        int state = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+        if (state == RING_FREE || state == RING_CLAIMING)
+            continue;
+
+        if (r->announced != r->tid) {
+            fprintf(trace_file,
+                    "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"name\":\"",
+                    first_event_written ? "," : "", r->tid);
+            write_escaped(trace_file, r->thread_name);
+            fprintf(trace_file, "\"}}");
+            first_event_written = 1;
+            r->announced = r->tid;
+        }
+
+        uint32_t w = __atomic_load_n(&r->write, __ATOMIC_ACQUIRE);
+        uint32_t rd = r->read;
+        for (; rd != w; rd++) {
+            const TraceEvent *e = &r->events[rd & (TRACE_RING_SIZE - 1)];
+            if (e->start_ns < trace_origin_ns)
+                continue; // left over from a previous session
+            fprintf(trace_file, ",\n{\"name\":\"");
+            write_escaped(trace_file, e->name);
+            fprintf(trace_file,
+                    "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                    "\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                    e->cat, (e->start_ns - trace_origin_ns) / 1000.0,
+                    (e->end_ns - e->start_ns) / 1000.0, r->tid);
+        }
+        __atomic_store_n(&r->read, rd, __ATOMIC_RELEASE);
+    }
+}
+
+// Hands rings of exited threads back to the pool. Their events are in the
+// file already; with no file open they are stale and dropped.
+static void recycle(void) {
+    for (int t = 0; t < TRACE_MAX_THREADS; t++) {
+        TraceRing *r = &rings[t];
+        if (__atomic_load_n(&r->state, __ATOMIC_ACQUIRE) != RING_RETIRED)
+            continue;
+        uint32_t w = __atomic_load_n(&r->write, __ATOMIC_ACQUIRE);
+        if (!trace_file)
+            __atomic_store_n(&r->read, w, __ATOMIC_RELEASE);
+        if (r->read == w)
+            __atomic_store_n(&r->state, RING_FREE, __ATOMIC_RELEASE);
+    }
+}
+
+static void *flusher_main(void *arg) {
+    (void)arg;
+    trace_set_thread_name("trace flush");
+    while (__atomic_load_n(&flusher_running, __ATOMIC_ACQUIRE)) {
+        usleep(TRACE_FLUSH_MS * 1000);
+        pthread_mutex_lock(&control_lock);
+        if (trace_file)
+            drain();
+        recycle();
+        pthread_mutex_unlock(&control_lock);
+    }
+    return NULL;
+}
+
+int trace_start(void) {
+    pthread_mutex_lock(&control_lock);
+    if (trace_file) {
+        pthread_mutex_unlock(&control_lock);
+        return 0;
+    }
+
+    if (!rings_allocated) {
+        for (int t = 0; t < TRACE_MAX_THREADS; t++) {
+            rings[t].events = calloc(TRACE_RING_SIZE, sizeof(TraceEvent));
+            if (!rings[t].events) {
+                pthread_mutex_unlock(&control_lock);
+                return -1;
+            }
+        }
+        __atomic_store_n(&rings_allocated, 1, __ATOMIC_RELEASE);
+    }
+
+    mkdir("e_output_files", 0755);
+    mkdir(DIAG_DIR, 0755);
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32], path[256];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+    snprintf(path, sizeof(path), DIAG_DIR "/trace_%s.json", stamp);
+
+    trace_file = fopen(path, "w");
+    if (!trace_file) {
+        pthread_mutex_unlock(&control_lock);
+        return -1;
+    }
+    snprintf(last_path, sizeof(last_path), "%s", path);
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    first_event_written = 0;
+    for (int t = 0; t < TRACE_MAX_THREADS; t++)
+        rings[t].announced = 0;
+    trace_origin_ns = perf_now_ns();
+
+    __atomic_store_n(&trace_active, 1, __ATOMIC_RELEASE);
+    if (!flusher_running) {
+        flusher_running = 1;
+        pthread_create(&flusher, NULL, flusher_main, NULL);
+    }
+    pthread_mutex_unlock(&control_lock);
+    return 0;
+}
+
+void trace_stop(void) {
+    __atomic_store_n(&trace_active, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&control_lock);
+    if (trace_file) {
+        drain();
+        fprintf(trace_file, "\n]}\n");
+        fclose(trace_file);
+        trace_file = NULL;
+
+        last_dropped = 0;
+        for (int t = 0; t < TRACE_MAX_THREADS; t++)
+            last_dropped += rings[t].dropped;
+    }
+    pthread_mutex_unlock(&control_lock);
+}
+
+const char *trace_last_path(void) { return last_path; }
+
+uint32_t trace_dropped(void) { return last_dropped; }
+
+int trace_toggle(void) {
+    if (trace_on()) {
+        trace_stop();
+        return 0;
+    }
+    return trace_start() == 0;
+}
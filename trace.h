@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "perf.h"
+
+// Span tracing across the audio, worker, UI, OSC and MIDI threads, written
+// as Chrome trace-event JSON (opens in ui.perfetto.dev or chrome://tracing).
+// Each thread records into its own lock-free ring; a background thread
+// drains them to e_output_files/diagnostics/trace_<time>.json.
+//
+// Names and categories are stored by pointer and must outlive the trace:
+// string literals and module aliases are fine.
+
+extern int trace_active;
+
+static inline int trace_on(void) {
+    return __atomic_load_n(&trace_active, __ATOMIC_RELAXED);
+}
+
+// Label for the calling thread's track; call before its first span
+void trace_set_thread_name(const char *name);
+
+void trace_complete(const char *cat, const char *name, uint64_t start_ns,
+                    uint64_t end_ns);
+
+// Times the wait when the mutex is contended
+void trace_mutex_lock(pthread_mutex_t *mutex, const char *name);
+
+int trace_start(void);
+void trace_stop(void);
+int trace_toggle(void); // returns 1 when tracing after the call
+const char *trace_last_path(void);
+uint32_t trace_dropped(void); // events lost to full rings, as of last stop
+
+#define TRACE_BEGIN(var) uint64_t var = trace_on() ? perf_now_ns() : 0
+#define TRACE_END(var, cat, name)                                              \
+    do {                                                                       \
+        if (var)                                                               \
+            trace_complete((cat), (name), (var), perf_now_ns());               \
+    } while (0)
+
+#endif
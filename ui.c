@@ -1,5 +1,6 @@
 #include <ncurses.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/resource.h>
@@ -7,11 +8,18 @@
 #include <unistd.h>
 
 #include "engine.h"
+#include "logger.h"
 #include "midi.h"
 #include "module.h"
 #include "osc.h"
+#include "perf.h"
+#include "retro.h"
+#include "trace.h"
+#include "util.h"
 
 #define COLUMN_WIDTH 72
+#define LOG_PANEL_ROWS 8
+#define PERF_PANEL_ROWS 7
 #define TRUNC_WIDTH 48
 
 static struct timespec last_time = {0};
@@ -46,10 +54,91 @@ float get_cpu_percent() {
     return (float)(100.0 * delta_cpu / delta_time);
 }
 
+// Callback timing summary and the most recent xruns, toggled with 'P'
+static void draw_perf_panel(int y) {
+    PerfStats s;
+    PerfXrun xr[PERF_PANEL_ROWS - 3];
+    perf_get_stats(&s);
+    int nx = perf_get_xruns(xr, PERF_PANEL_ROWS - 3);
+
+    attrset(A_NORMAL);
+    mvhline(y, 0, ACS_HLINE, COLS);
+    BLUE();
+    mvprintw(y, 2, "[perf]");
+    CLR();
+    printw(" cb:%llu miss:%llu xrun:%llu | p50 %uus p99 %uus max %uus "
+           "| deadline %uus",
+           (unsigned long long)s.callbacks,
+           (unsigned long long)s.deadline_misses, (unsigned long long)s.xruns,
+           perf_percentile_us(&s, 0.50), perf_percentile_us(&s, 0.99),
+           s.max_us, s.deadline_us);
+
+    move(y + 1, 2);
+    for (int b = 0; b < PERF_HIST_BUCKETS; b++) {
+        if (!s.hist[b])
+            continue;
+        if ((uint32_t)1 << b > s.deadline_us && s.deadline_us)
+            ORANGE();
+        else
+            GREEN();
+        printw("<%uus:%llu ", 1u << b, (unsigned long long)s.hist[b]);
+        CLR();
+    }
+
+    for (int i = 0; i < nx; i++) {
+        const PerfXrun *e = &xr[nx - 1 - i];
+        char flags[96];
+        perf_flag_names(e->flags, flags, sizeof(flags));
+        move(y + 2 + i, 2);
+        ORANGE();
+        printw("%9.3fs %-24s %5u/%uus", e->time, flags, e->duration_us,
+               e->deadline_us);
+        CLR();
+        for (int k = 0; k < PERF_TOP_MODULES; k++) {
+            const char *alias = get_module_alias(e->top_module[k]);
+            if (alias)
+                printw(" %s:%uus", alias, e->top_cost_us[k]);
+        }
+    }
+}
+
+// Module diagnostics from the logger, toggled with 'M', PgUp/PgDn scroll
+static void draw_log_panel(int y, int *scroll) {
+    static char lines[LOG_PANEL_ROWS - 1][LOG_LINE_BYTES];
+    LogLevel levels[LOG_PANEL_ROWS - 1];
+    int total = 0;
+    int n = log_get_lines(lines, levels, LOG_PANEL_ROWS - 1, *scroll, &total);
+
+    int max_scroll = total - (LOG_PANEL_ROWS - 1);
+    if (max_scroll < 0)
+        max_scroll = 0;
+    if (*scroll > max_scroll)
+        *scroll = max_scroll;
+
+    attrset(A_NORMAL);
+    mvhline(y, 0, ACS_HLINE, COLS);
+    BLUE();
+    mvprintw(y, 2, "[log]");
+    CLR();
+    if (*scroll)
+        printw(" %d lines back (PgDn)", *scroll);
+
+    for (int i = 0; i < n; i++) {
+        if (levels[i] != LOG_LEVEL_INFO)
+            ORANGE();
+        mvprintw(y + 1 + i, 2, "%.*s", COLS - 4, lines[i]);
+        CLR();
+    }
+}
+
+static volatile sig_atomic_t quit_requested = 0;
+
+void ui_request_quit(void) { quit_requested = 1; }
+
 void ui_loop() {
     if (!ui_enabled) {
         fprintf(stderr, "[ui] Skipping UI (disabled by patch flag)\n");
-        while (1)
+        while (!quit_requested)
             usleep(100000); // keep audio thread alive
         return;
     }
@@ -71,11 +160,15 @@ void ui_loop() {
     scrollok(stdscr, FALSE);
     keypad(stdscr, TRUE);
     nodelay(stdscr, TRUE);
+    log_set_echo(0); // stderr would tear through the curses screen
 
     int cpu_refresh_counter = 0;
     float cpu = 0.0f;
 
     int focused_module_index = 0;
+    int show_perf = 0;
+    int show_log = 0;
+    int log_scroll = 0;
     int in_command_mode = 0;
     char command[128] = "";
     int cmd_index = 0;
@@ -87,10 +180,21 @@ void ui_loop() {
     // Stopwatch timer
     struct timespec start_time;
     clock_gettime(CLOCK_MONOTONIC, &start_time);
-    while (running) {
+    while (running && !quit_requested) {
+        TRACE_BEGIN(redraw_t0);
         erase();
         attrset(A_NORMAL);
         mvprintw(0, 2, "--- Signal Crate ---");
+        if (trace_on()) {
+            ORANGE();
+            printw(" [TRACE]");
+            CLR();
+        }
+        if (retro_dumping()) {
+            ORANGE();
+            printw(" [RETRO]");
+            CLR();
+        }
 
         // CPU Usage
         cpu_refresh_counter++;
@@ -164,17 +268,28 @@ void ui_loop() {
             }
         }
 
+        int panel_y = LINES - 3;
+        if (show_log) {
+            panel_y -= LOG_PANEL_ROWS;
+            draw_log_panel(panel_y, &log_scroll);
+        }
+        if (show_perf)
+            draw_perf_panel(panel_y - PERF_PANEL_ROWS);
+
         if (in_command_mode) {
             attrset(A_NORMAL);
             mvprintw(LINES - 2, 2, ": %s", command);
         } else {
             attrset(A_NORMAL);
             mvprintw(LINES - 2, 2,
-                     "[TAB] switch module | [t] show/hide cmds | [:q] quit | "
-                     "[:] cmd mode | [ESCx2] exit cmd mode");
+                     "[TAB] switch module | [t] show/hide cmds | [P] perf | "
+                     "[M] log | [T] trace | [H] retro dump | [:q] quit | "
+                     "[:] cmd mode | "
+                     "[ESCx2] exit cmd mode");
         }
 
         refresh();
+        TRACE_END(redraw_t0, "ui", "redraw");
         int ch = getch();
 
         if (ch == ERR) {
@@ -266,6 +381,22 @@ void ui_loop() {
                     focused->handle_input(focused, ch);
             } else if (ch == 't') {
                 truncated = !truncated;
+            } else if (ch == 'P') {
+                show_perf = !show_perf;
+            } else if (ch == 'M') {
+                show_log = !show_log;
+                log_scroll = 0;
+            } else if (show_log && ch == KEY_PPAGE) {
+                log_scroll += LOG_PANEL_ROWS - 2;
+            } else if (show_log && ch == KEY_NPAGE) {
+                log_scroll -= LOG_PANEL_ROWS - 2;
+                if (log_scroll < 0)
+                    log_scroll = 0;
+            } else if (ch == 'T') {
+                trace_toggle();
+            } else if (ch == 'H') {
+                if (retro_dump(0.0f) != 0)
+                    LOG_WARN("[retro] capture off or a dump is running");
             } else {
                 if (focused && focused->handle_input)
                     focused->handle_input(focused, ch);
@@ -274,4 +405,5 @@ void ui_loop() {
     }
 
     endwin();
+    log_set_echo(1);
 }
@@ -2,5 +2,7 @@
 #define UI_H
 
 void ui_loop(void);
+// Makes ui_loop() return at its next pass; async-signal-safe
+void ui_request_quit(void);
 
 #endif
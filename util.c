@@ -1,5 +1,7 @@
 #include <ctype.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,3 +61,153 @@ char *trim_whitespace(char *str) {
     end[1] = '\0';
     return str;
 }
+
+// --- Resampler ---
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4f_u __attribute__((vector_size(16), aligned(4)));
+
+#define RESAMPLE_BANDS 13 // quarter octaves: steps up to 8x
+
+static const struct {
+    int taps;
+    int phases;
+    float cutoff; // at unity step, fraction of Nyquist
+    float beta;   // Kaiser window
+} resample_specs[] = {
+    [RESAMPLE_FAST] = {8, 64, 0.80f, 6.0f},
+    [RESAMPLE_GOOD] = {16, 128, 0.90f, 8.0f},
+    [RESAMPLE_BEST] = {32, 256, 0.94f, 10.0f},
+};
+
+static float *resample_tables[3];
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum)
+            break;
+    }
+    return sum;
+}
+
+static float *build_resample_table(ResampleQuality q) {
+    int taps = resample_specs[q].taps;
+    int phases = resample_specs[q].phases;
+    double beta = resample_specs[q].beta;
+    size_t rows = (size_t)RESAMPLE_BANDS * (size_t)(phases + 1);
+
+    void *mem = NULL;
+    if (posix_memalign(&mem, 16, rows * (size_t)taps * sizeof(float)) != 0)
+        return NULL;
+    float *table = mem;
+
+    double half = taps / 2;
+    double i0_beta = bessel_i0(beta);
+    for (int b = 0; b < RESAMPLE_BANDS; b++) {
+        double fc = resample_specs[q].cutoff * pow(2.0, -b / 4.0);
+        for (int p = 0; p <= phases; p++) {
+            float *row = table + ((size_t)b * (phases + 1) + p) * taps;
+            double sum = 0.0;
+            for (int k = 0; k < taps; k++) {
+                // Distance from tap k to the read point
+                double t = (double)(k - (taps / 2 - 1)) - (double)p / phases;
+                double x = fc * t;
+                double sinc =
+                    (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+                double w = t / half;
+                double win =
+                    (fabs(w) >= 1.0) ? 0.0
+                                     : bessel_i0(beta * sqrt(1.0 - w * w)) /
+                                           i0_beta;
+                row[k] = (float)(sinc * win);
+                sum += row[k];
+            }
+            for (int k = 0; k < taps; k++) // unity gain at DC for every phase
+                row[k] = (float)(row[k] / sum);
+        }
+    }
+    return table;
+}
+
+// Once per quality, however many modules are created at the same time
+static pthread_once_t resample_once[3] = {PTHREAD_ONCE_INIT, PTHREAD_ONCE_INIT,
+                                          PTHREAD_ONCE_INIT};
+
+static void build_fast(void) {
+    resample_tables[RESAMPLE_FAST] = build_resample_table(RESAMPLE_FAST);
+}
+static void build_good(void) {
+    resample_tables[RESAMPLE_GOOD] = build_resample_table(RESAMPLE_GOOD);
+}
+static void build_best(void) {
+    resample_tables[RESAMPLE_BEST] = build_resample_table(RESAMPLE_BEST);
+}
+
+bool resampler_init(Resampler *r, ResampleQuality q) {
+    static void (*const build[3])(void) = {build_fast, build_good, build_best};
+    if (q < RESAMPLE_FAST || q > RESAMPLE_BEST)
+        q = RESAMPLE_GOOD;
+    pthread_once(&resample_once[q], build[q]);
+    if (!resample_tables[q])
+        return false;
+
+    r->taps = resample_specs[q].taps;
+    r->phases = resample_specs[q].phases;
+    r->bands = resample_tables[q];
+    r->table = r->bands;
+    r->step_lo = 0.0f;
+    r->step_hi = 0.0f; // forces band selection on the first set_step
+    resampler_set_step(r, 1.0f);
+    return true;
+}
+
+ResampleQuality resampler_parse_quality(const char *args) {
+    const char *q = args ? strstr(args, "quality=") : NULL;
+    if (!q)
+        return RESAMPLE_GOOD;
+    q += 8;
+    if (strncmp(q, "fast", 4) == 0)
+        return RESAMPLE_FAST;
+    if (strncmp(q, "best", 4) == 0)
+        return RESAMPLE_BEST;
+    return RESAMPLE_GOOD;
+}
+
+void resampler_set_step(Resampler *r, float step) {
+    if (step > r->step_lo && step <= r->step_hi)
+        return;
+
+    int b = 0;
+    if (step > 1.0f)
+        b = (int)ceilf(4.0f * log2f(step) - 1e-4f);
+    if (b >= RESAMPLE_BANDS)
+        b = RESAMPLE_BANDS - 1;
+
+    r->table = r->bands + (size_t)b * (r->phases + 1) * r->taps;
+    r->step_lo = b ? exp2f((b - 1) / 4.0f) : 0.0f;
+    r->step_hi = (b < RESAMPLE_BANDS - 1) ? exp2f(b / 4.0f) : INFINITY;
+}
+
+float resampler_interp(const Resampler *r, const float *x, float frac) {
+    float pf = frac * (float)r->phases;
+    int p = (int)pf;
+    if (p >= r->phases)
+        p = r->phases - 1;
+    float t = pf - (float)p;
+
+    const float *c0 = r->table + (size_t)p * r->taps;
+    const float *c1 = c0 + r->taps;
+    const v4f tv = {t, t, t, t};
+    v4f acc = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (int k = 0; k < r->taps; k += 4) {
+        v4f a = *(const v4f *)(c0 + k);
+        v4f b = *(const v4f *)(c1 + k);
+        v4f xv = *(const v4f_u *)(x + k);
+        acc += (a + (b - a) * tv) * xv;
+    }
+    return acc[0] + acc[1] + acc[2] + acc[3];
+}
@@ -52,4 +52,31 @@ void init_smoother(CParamSmooth *s, float a);
 float process_smoother(CParamSmooth *s, float in);
 char *trim_whitespace(char *str);
 
+// Band-limited interpolation for file playback and varispeed: Kaiser
+// windowed-sinc polyphase tables, linearly interpolated between phases.
+// Above unity speed the cutoff is lowered in quarter-octave bands so
+// pitching up does not alias.
+typedef enum { RESAMPLE_FAST, RESAMPLE_GOOD, RESAMPLE_BEST } ResampleQuality;
+
+#define RESAMPLE_MAX_TAPS 32
+
+typedef struct {
+    int taps; // input samples per output sample: 8, 16 or 32
+    int phases;
+    const float *bands; // [band][phases + 1][taps]
+    const float *table; // current band
+    float step_lo, step_hi; // step range the current band covers
+} Resampler;
+
+// Builds the shared tables on first use: call from create, not process.
+// False when the table could not be allocated.
+bool resampler_init(Resampler *r, ResampleQuality q);
+// "fast", "good" or "best" from a quality= argument; RESAMPLE_GOOD otherwise
+ResampleQuality resampler_parse_quality(const char *args);
+// Input samples consumed per output sample (speed * file_rate / rate)
+void resampler_set_step(Resampler *r, float step);
+// x holds r->taps input samples with the one at floor(pos) at
+// x[r->taps / 2 - 1]; frac is pos - floor(pos).
+float resampler_interp(const Resampler *r, const float *x, float frac);
+
 #endif